@@ -0,0 +1,85 @@
+-- bench_workers_queue.lua
+-- Micro-benchmark du transport worker -> parent.
+--
+-- Compare, pour N petits records émis par un worker :
+--   1. worker.send / w:recv            (anneau SPSC, un message à la fois)
+--   2. worker.send_many / w:recv_many  (anneau SPSC, par lots)
+--   3. ch:send / ch:recv               (channel : file mutex + condvar,
+--                                       l'ancienne implémentation des
+--                                       inbox/outbox)
+--
+-- Usage : babet examples/bench_workers_queue.lua [N] [batch]
+
+local W = babet.workers
+
+local N = tonumber(arg and arg[1]) or 1000000
+local BATCH = tonumber(arg and arg[2]) or 256
+local CAPACITY = 1024
+
+local function report(label, t0)
+    local dt = babet.monotonic() - t0
+    print(string.format("%-34s %8.3f s  %10.0f msg/s", label, dt, N / dt))
+end
+
+-- 1. Anneau SPSC, message par message.
+do
+    local t0 = babet.monotonic()
+    local w = W.spawn([[
+        for i = 1, worker.args.n do worker.send(i) end
+    ]], { n = N }, { outbox_capacity = CAPACITY })
+    local got = 0
+    while true do
+        local ok = w:recv()
+        if not ok then break end
+        got = got + 1
+    end
+    w:join()
+    assert(got == N, "ring: got " .. got)
+    report("ring send/recv", t0)
+end
+
+-- 2. Anneau SPSC, par lots.
+do
+    local t0 = babet.monotonic()
+    local w = W.spawn([[
+        local n, batch = worker.args.n, worker.args.batch
+        local buf = {}
+        for i = 1, n do
+            buf[#buf + 1] = i
+            if #buf == batch then
+                worker.send_many(buf)
+                buf = {}
+            end
+        end
+        if #buf > 0 then worker.send_many(buf) end
+    ]], { n = N, batch = BATCH }, { outbox_capacity = CAPACITY })
+    local got = 0
+    while true do
+        local ok, items = w:recv_many(BATCH)
+        if not ok then break end
+        got = got + #items
+    end
+    w:join()
+    assert(got == N, "ring batch: got " .. got)
+    report("ring send_many/recv_many (" .. BATCH .. ")", t0)
+end
+
+-- 3. Channel (MessageQueue : mutex + condvar par message).
+do
+    local t0 = babet.monotonic()
+    local ch = W.channel(CAPACITY)
+    local w = W.spawn([[
+        local ch = worker.args.ch
+        for i = 1, worker.args.n do ch:send(i) end
+        ch:close()
+    ]], { n = N, ch = ch })
+    local got = 0
+    while true do
+        local ok = ch:recv()
+        if not ok then break end
+        got = got + 1
+    end
+    w:join()
+    assert(got == N, "channel: got " .. got)
+    report("channel send/recv (mutex queue)", t0)
+end
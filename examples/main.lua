@@ -1496,12 +1496,601 @@ do
                 type(rq) == "table" and rq.status == 200,
                 "status=" .. tostring(rq and rq.status))
 
+            -- session keep-alive : 1 miss (création) puis des hits,
+            -- un seul Client au repos pour l'origine.
+            local sess = babet.http.session({ max_per_host = 2 })
+            local codes = {}
+            for i = 1, 3 do
+                local r = sess:get(base .. "/probe.bin", { timeout = 5 })
+                codes[i] = r and r.status
+            end
+            local rs = sess:request({ url = base .. "/nexiste_pas",
+                timeout = 5 })
+            ok("session: 3 GET + request -> 200,200,200,404",
+                codes[1] == 200 and codes[2] == 200 and codes[3] == 200
+                and rs and rs.status == 404,
+                table.concat({ tostring(codes[1]), tostring(codes[2]),
+                    tostring(codes[3]), tostring(rs and rs.status) }, ","))
+            local st = sess:stats()
+            ok("  stats: 1 miss, 3 hits, 1 idle client on 1 host",
+                st.misses == 1 and st.hits == 3 and st.idle == 1
+                and st.hosts == 1,
+                string.format("misses=%d hits=%d idle=%d hosts=%d",
+                    st.misses, st.hits, st.idle, st.hosts))
+            local rb = sess:get(base .. "/probe.bin", { timeout = 5 })
+            ok("  session body binary-safe",
+                rb and rb.body and #rb.body == 5 and rb.body:byte(3) == 0)
+            sess:close()
+
+            -- opts.sink / opts.max_body
+            local dl = SBH .. "/dl.bin"
+            local rf, ef = babet.http.get(base .. "/probe.bin",
+                { timeout = 5, sink = dl })
+            local fh = io.open(dl, "rb")
+            local got = fh and fh:read("a")
+            if fh then fh:close() end
+            ok("sink=path -> file holds the body, result.bytes == 5",
+                rf and rf.status == 200 and rf.body == nil
+                and rf.bytes == 5 and got == "AB\0CD",
+                "err=" .. tostring(ef) .. " bytes="
+                .. tostring(rf and rf.bytes))
+
+            local parts = {}
+            local rc = babet.http.get(base .. "/probe.bin", {
+                timeout = 5,
+                sink = function(chunk) parts[#parts + 1] = chunk end,
+            })
+            ok("sink=function receives the body by chunks",
+                rc and rc.status == 200 and rc.bytes == 5
+                and table.concat(parts) == "AB\0CD")
+
+            local rm, em = babet.http.get(base .. "/probe.bin",
+                { timeout = 5, max_body = 4 })
+            ok_fail("max_body below Content-Length -> (nil, err)", rm, em)
+            ok("  message mentions 'max_body'",
+                type(em) == "string"
+                and em:find("max_body", 1, true) ~= nil,
+                "err=" .. tostring(em))
+            local rok = babet.http.get(base .. "/probe.bin",
+                { timeout = 5, max_body = 5 })
+            ok("max_body == size -> body in memory",
+                rok and rok.body and #rok.body == 5)
+
+            local dl2 = SBH .. "/dl2.bin"
+            rm, em = babet.http.get(base .. "/probe.bin",
+                { timeout = 5, sink = dl2, max_body = 2 })
+            ok_fail("sink=path + max_body exceeded -> (nil, err)", rm, em)
+            ok("  no partial file left", io.open(dl2, "rb") == nil)
+
+            rm, em = babet.http.get(base .. "/probe.bin", {
+                timeout = 5,
+                sink = function() return false end,
+            })
+            ok_fail("sink callback returning false -> (nil, err)", rm, em)
+            ok("  message is 'http: sink aborted'",
+                em == "http: sink aborted", "err=" .. tostring(em))
+
+            local pok, perr = pcall(babet.http.get, base .. "/probe.bin", {
+                timeout = 5,
+                sink = function() error("boom") end,
+            })
+            ok("error in sink callback is re-raised",
+                pok == false and tostring(perr):find("boom", 1, true) ~= nil,
+                "perr=" .. tostring(perr))
+
+            -- fetch_all : ordre préservé, échecs isolés, pool partagé.
+            local batch = {}
+            for i = 1, 12 do
+                batch[i] = base .. "/probe.bin"
+            end
+            batch[5] = { url = base .. "/nexiste_pas", timeout = 5 }
+            batch[9] = "ftp://example.com/"
+            local fsess = babet.http.session()
+            local fres, ferr = babet.http.fetch_all(batch,
+                { concurrency = 4, session = fsess })
+            local okall = #fres == 12
+            for i = 1, 12 do
+                if i ~= 5 and i ~= 9 then
+                    okall = okall and fres[i] and fres[i].status == 200
+                        and fres[i].body == "AB\0CD"
+                end
+            end
+            ok("fetch_all: 10 x 200 in order", okall)
+            ok("  404 is a result, not an error",
+                fres[5] and fres[5].status == 404 and ferr[5] == nil)
+            ok("  invalid entry -> results[i] == false + errors[i]",
+                fres[9] == false and type(ferr[9]) == "string"
+                and ferr[9]:find("scheme", 1, true) ~= nil,
+                "err=" .. tostring(ferr[9]))
+            local fst = fsess:stats()
+            ok("  session stats cover the batch (11 requests)",
+                fst.hits + fst.misses == 11 and fst.misses <= 4,
+                string.format("hits=%d misses=%d", fst.hits, fst.misses))
+            fsess:close()
+
+            -- Corps de requête en flux (body_file, body fonction,
+            -- multipart) : petit serveur d'écho HTTP/1.1 qui renvoie
+            -- le corps reçu, son Content-Type et s'il était chunked.
+            local echo_py = SBH .. "/echo.py"
+            local fpy = io.open(echo_py, "w")
+            fpy:write([[
+import http.server, sys
+class H(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    def do_POST(self):
+        chunked = self.headers.get("Transfer-Encoding", "").lower() == "chunked"
+        if chunked:
+            body = b""
+            while True:
+                n = int(self.rfile.readline().split(b";")[0], 16)
+                if n == 0:
+                    while self.rfile.readline() not in (b"\r\n", b"\n", b""):
+                        pass
+                    break
+                body += self.rfile.read(n)
+                self.rfile.readline()
+        else:
+            body = self.rfile.read(int(self.headers.get("Content-Length", "0")))
+        self.send_response(200)
+        self.send_header("Content-Type", self.headers.get("Content-Type", ""))
+        self.send_header("X-Chunked", "1" if chunked else "0")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+    do_PUT = do_POST
+    def log_message(self, *a):
+        pass
+http.server.ThreadingHTTPServer(("127.0.0.1", int(sys.argv[1])), H).serve_forever()
+]])
+            fpy:close()
+            local eport = port + 1
+            local eboot = babet.exec("sh", { "-c",
+                "{ setsid python3 " .. echo_py .. " " .. eport
+                .. " >/dev/null 2>&1 </dev/null & } ; echo $!" },
+                { timeout = 5 })
+            local echo_pid = type(eboot) == "table" and eboot.stdout
+                and eboot.stdout:gsub("%s+$", "")
+            local ebase = "http://127.0.0.1:" .. eport
+            local eup = false
+            for _ = 1, 15 do
+                babet.sleep(200, "ms")
+                local pr = babet.http.post(ebase .. "/", "x", { timeout = 1 })
+                if pr and pr.status == 200 then
+                    eup = true
+                    break
+                end
+            end
+            if not eup then
+                print("[INFO] http: echo server unavailable, streamed "
+                    .. "upload tests skipped (optional)")
+            else
+                local big = string.rep("0123456789abcdef", 8192) -- 128 Kio
+                local upf = SBH .. "/up.bin"
+                local fu = io.open(upf, "wb")
+                fu:write(big)
+                fu:close()
+
+                local ru, eu = babet.http.post(ebase .. "/",
+                    { timeout = 5, body_file = upf })
+                ok("body_file -> body echoed, Content-Length framing",
+                    ru and ru.status == 200 and ru.body == big
+                    and ru.headers["x-chunked"] == "0"
+                    and ru.headers["content-type"]
+                        == "application/octet-stream",
+                    "err=" .. tostring(eu))
+
+                local pieces = { "alpha,", "", "beta,", "gamma" }
+                local k = 0
+                local rp, ep = babet.http.request({
+                    url = ebase .. "/", method = "PUT", timeout = 5,
+                    headers = { ["Content-Type"] = "text/plain" },
+                    body = function()
+                        k = k + 1
+                        return pieces[k]
+                    end,
+                })
+                ok("body function -> chunked transfer, chunks in order",
+                    rp and rp.body == "alpha,beta,gamma"
+                    and rp.headers["x-chunked"] == "1"
+                    and rp.headers["content-type"] == "text/plain",
+                    "err=" .. tostring(ep) .. " body="
+                    .. tostring(rp and rp.body))
+
+                local rmp, emp = babet.http.post(ebase .. "/", {
+                    timeout = 5,
+                    multipart = {
+                        { name = "meta", data = "{\"v\":1}" },
+                        { name = "upload", file = upf },
+                    },
+                })
+                local ct = rmp and rmp.headers["content-type"] or ""
+                local boundary = ct:match("boundary=(.+)$")
+                ok("multipart -> form-data with boundary",
+                    rmp and rmp.status == 200 and boundary ~= nil,
+                    "err=" .. tostring(emp) .. " ct=" .. ct)
+                if boundary then
+                    local want = "--" .. boundary .. "\r\n"
+                        .. "Content-Disposition: form-data; name=\"meta\""
+                        .. "\r\n\r\n{\"v\":1}\r\n"
+                        .. "--" .. boundary .. "\r\n"
+                        .. "Content-Disposition: form-data; name=\"upload\";"
+                        .. " filename=\"up.bin\"\r\n"
+                        .. "Content-Type: application/octet-stream\r\n\r\n"
+                        .. big .. "\r\n"
+                        .. "--" .. boundary .. "--\r\n"
+                    ok("  multipart body byte-exact (file part streamed)",
+                        rmp.body == want,
+                        "len=" .. #rmp.body .. " want=" .. #want)
+                end
+
+                local pok, perr = pcall(babet.http.post, ebase .. "/", {
+                    timeout = 5,
+                    body = function() error("kaboom") end,
+                })
+                ok("error in body function is re-raised",
+                    pok == false
+                    and tostring(perr):find("kaboom", 1, true) ~= nil,
+                    "perr=" .. tostring(perr))
+
+                local rb, eb = babet.http.post(ebase .. "/", {
+                    timeout = 5,
+                    body = function() return 42 end,
+                })
+                ok_fail("body function returning a number -> (nil, err)",
+                    rb, eb)
+            end
+            if echo_pid and echo_pid ~= "" then
+                babet.exec("kill", { echo_pid })
+                babet.sleep(100, "ms")
+                babet.exec("kill", { "-9", echo_pid })
+            end
+
             babet.exec("kill", { srv_pid })
             babet.sleep(100, "ms")
             babet.exec("kill", { "-9", srv_pid })
             babet.rmdirAll(SBH)
         end
     end
+
+    -- --- sink / max_body : contrat hermétique -------------------------
+    do
+        local v, e = H.get("http://127.0.0.1:1/", { sink = 42 })
+        ok_fail("sink=number -> (nil, err)", v, e)
+        v, e = H.get("http://127.0.0.1:1/", { sink = "" })
+        ok_fail("sink='' -> (nil, err)", v, e)
+        v, e = H.get("http://127.0.0.1:1/", { max_body = 1.5 })
+        ok_fail("max_body=1.5 -> (nil, err)", v, e)
+        v, e = H.get("http://127.0.0.1:1/", { max_body = 0 })
+        ok_fail("max_body=0 -> (nil, err)", v, e)
+
+        -- Serveur injoignable : le fichier n'est jamais créé.
+        local path = os.tmpname()
+        os.remove(path)
+        v, e = H.get("http://127.0.0.1:1/", { timeout = 1, sink = path })
+        ok_fail("sink=path, closed port -> (nil, err)", v, e)
+        ok("  sink file not created", io.open(path, "rb") == nil)
+    end
+
+    -- --- corps en flux : contrat hermétique ---------------------------
+    do
+        local v, e = H.post("http://127.0.0.1:1/", { body = true })
+        ok_fail("body=boolean -> (nil, err)", v, e)
+        v, e = H.post("http://127.0.0.1:1/", { body_file = 1 })
+        ok_fail("body_file=number -> (nil, err)", v, e)
+        v, e = H.request({ url = "http://127.0.0.1:1/", method = "POST",
+            body = "x", body_file = "/etc/hostname" })
+        ok_fail("body + body_file -> (nil, err)", v, e)
+        ok("  message mentions 'mutually exclusive'",
+            type(e) == "string"
+            and e:find("mutually exclusive", 1, true) ~= nil,
+            "err=" .. tostring(e))
+        v, e = H.get("http://127.0.0.1:1/", { body_file = "/etc/hostname" })
+        ok_fail("body_file on GET -> (nil, err)", v, e)
+        v, e = H.post("http://127.0.0.1:1/",
+            { body_file = "/nonexistent/babet.bin", timeout = 1 })
+        ok_fail("body_file missing -> (nil, err) before connecting", v, e)
+        ok("  message names body_file",
+            type(e) == "string" and e:find("body_file", 1, true) ~= nil,
+            "err=" .. tostring(e))
+        v, e = H.post("http://127.0.0.1:1/", { body_file = "/tmp" })
+        ok_fail("body_file directory -> (nil, err)", v, e)
+
+        v, e = H.post("http://127.0.0.1:1/", { multipart = {} })
+        ok_fail("multipart={} -> (nil, err)", v, e)
+        v, e = H.post("http://127.0.0.1:1/",
+            { multipart = { { data = "x" } } })
+        ok_fail("multipart part without name -> (nil, err)", v, e)
+        v, e = H.post("http://127.0.0.1:1/",
+            { multipart = { { name = "a", data = "x", file = "/etc/hostname" } } })
+        ok_fail("multipart part with data AND file -> (nil, err)", v, e)
+        v, e = H.post("http://127.0.0.1:1/",
+            { multipart = { "x" } })
+        ok_fail("multipart part not a table -> (nil, err)", v, e)
+    end
+
+    -- --- fetch_all : contrat hermétique -------------------------------
+    do
+        ok("fetch_all(non-table) raises",
+            pcall(H.fetch_all, "x") == false)
+        ok("fetch_all({42}) raises",
+            pcall(H.fetch_all, { 42 }) == false)
+        ok("fetch_all{concurrency=1.5} raises",
+            pcall(H.fetch_all, {}, { concurrency = 1.5 }) == false)
+        ok("fetch_all{session='x'} raises",
+            pcall(H.fetch_all, {}, { session = "x" }) == false)
+        local v, e = H.fetch_all({}, { concurrency = 0 })
+        ok_fail("fetch_all{concurrency=0} -> (nil, err)", v, e)
+
+        local r, errs = H.fetch_all({})
+        ok("fetch_all({}) -> empty results, empty errors",
+            type(r) == "table" and #r == 0 and next(errs) == nil)
+
+        r, errs = H.fetch_all({
+            { url = "http://127.0.0.1:1/", timeout = 1 },
+            "notaurl",
+            { url = "http://127.0.0.1:1/", sink = function() end },
+            { url = "http://127.0.0.1:1/", timeout = 1 },
+        }, { concurrency = 3 })
+        ok("fetch_all failures -> false at each index",
+            #r == 4 and r[1] == false and r[2] == false
+            and r[3] == false and r[4] == false)
+        ok("  transport error prefixed with 'http: '",
+            type(errs[1]) == "string"
+            and errs[1]:find("http: ", 1, true) == 1,
+            "err=" .. tostring(errs[1]))
+        ok("  callback sink refused",
+            type(errs[3]) == "string"
+            and errs[3]:find("not supported", 1, true) ~= nil,
+            "err=" .. tostring(errs[3]))
+
+        local closed = H.session()
+        closed:close()
+        v, e = H.fetch_all({}, { session = closed })
+        ok_fail("fetch_all on closed session -> (nil, err)", v, e)
+    end
+
+    -- --- sessions keep-alive : contrat hermétique ---------------------
+    do
+        ok("session(non-table) raises",
+            pcall(H.session, "x") == false)
+        ok("session{max_per_host=1.5} raises",
+            pcall(H.session, { max_per_host = 1.5 }) == false)
+        ok("session{idle_timeout='x'} raises",
+            pcall(H.session, { idle_timeout = "x" }) == false)
+        local v, e = H.session({ max_per_host = 0 })
+        ok_fail("session{max_per_host=0} -> (nil, err)", v, e)
+        v, e = H.session({ idle_timeout = 0 })
+        ok_fail("session{idle_timeout=0} -> (nil, err)", v, e)
+
+        local sess = H.session()
+        ok("session() -> userdata", type(sess) == "userdata")
+        local st = sess:stats()
+        ok("  fresh stats are zero",
+            st.hits == 0 and st.misses == 0 and st.expired == 0
+            and st.idle == 0 and st.hosts == 0)
+
+        -- Mauvaise valeur : (nil, err) AVANT tout emprunt au pool.
+        v, e = sess:get("ftp://example.com/")
+        ok_fail("sess:get(bad scheme) -> (nil, err)", v, e)
+        ok("  parse error does not touch the pool",
+            sess:stats().misses == 0)
+
+        -- Échec transport : le Client créé (miss) n'est pas rendu.
+        v, e = sess:get("http://127.0.0.1:1/", { timeout = 1 })
+        ok_fail("sess:get(closed port) -> (nil, err)", v, e)
+        ok("  err prefixed with 'http: '",
+            type(e) == "string" and e:find("http: ", 1, true) == 1,
+            "err=" .. tostring(e))
+        v, e = sess:post("http://127.0.0.1:1/", "x", { timeout = 1 })
+        ok_fail("sess:post(closed port) -> (nil, err)", v, e)
+        st = sess:stats()
+        ok("  failed clients are not pooled (2 misses, 0 idle)",
+            st.misses == 2 and st.hits == 0 and st.idle == 0,
+            string.format("misses=%d hits=%d idle=%d",
+                st.misses, st.hits, st.idle))
+
+        ok("sess:request(non-table) raises",
+            pcall(sess.request, sess, "x") == false)
+
+        sess:close()
+        sess:close() -- idempotent
+        v, e = sess:get("http://127.0.0.1:1/")
+        ok_fail("get on closed session -> (nil, err)", v, e)
+        ok("  message mentions 'closed'",
+            type(e) == "string" and e:find("closed", 1, true) ~= nil,
+            "err=" .. tostring(e))
+        ok("  stats still readable after close",
+            sess:stats().misses == 2)
+    end
+
+    -- --- serveur embarqué : hermétique (loopback, port du noyau) -----
+    do
+        ok("server(non-table) raises", pcall(H.server, "x") == false)
+        ok("server{threads=1.5} raises",
+            pcall(H.server, { threads = 1.5 }) == false)
+        ok("server{init=1} raises", pcall(H.server, { init = 1 }) == false)
+        local v, e = H.server({ threads = 0 })
+        ok_fail("server{threads=0} -> (nil, err)", v, e)
+        v, e = H.server({ read_timeout = 0 })
+        ok_fail("server{read_timeout=0} -> (nil, err)", v, e)
+
+        local served = os.tmpname()
+        local fh = io.open(served, "wb")
+        fh:write(string.rep("0123456789", 10000))
+        fh:close()
+
+        local srv = H.server({
+            threads = 2,
+            init = [[
+                counter = 0
+                handlers = { ping = function() return "pong" end }
+            ]],
+        })
+        ok("server() -> userdata", type(srv) == "userdata")
+        ok("route(TRACE) raises",
+            pcall(srv.route, srv, "TRACE", "/x", "return 1") == false)
+        ok("route(GET, stream) raises",
+            pcall(srv.route, srv, "GET", "/x", "return 1",
+                { stream = true }) == false)
+        ok("route(syntax error) raises",
+            pcall(srv.route, srv, "GET", "/x", "return (") == false)
+        ok("route(pattern without '/') raises",
+            pcall(srv.route, srv, "GET", "x", "return 1") == false)
+
+        srv:route("GET", "/hello", [[ return "hello" ]])
+            :route("get", "/ping", "handlers.ping")
+            :route("GET", "/users/:id", [[
+                local req = ...
+                return {
+                    status = 201,
+                    headers = { ["X-Id"] = req.params.id,
+                                ["Content-Type"] = "application/x-test" },
+                    body = req.params.id .. ":" .. tostring(req.query.q),
+                }
+            ]])
+            :route("POST", "/echo", [[
+                local req = ...
+                return { body = req.body,
+                         headers = { ["X-Method"] = req.method } }
+            ]])
+            :route("POST", "/upload", [[
+                local req = ...
+                local n = 0
+                local bytes = assert(req.read(function(chunk)
+                    n = n + #chunk
+                end))
+                return n .. "/" .. bytes
+            ]], { stream = true })
+            :route("GET", "/chunks", [[
+                local i = 0
+                return { body = function()
+                    i = i + 1
+                    if i <= 3 then return "c" .. i end
+                end }
+            ]])
+            :route("GET", "/file", string.format(
+                "return { file = %q }", served))
+            :route("GET", "/count", [[
+                counter = counter + 1
+                return tostring(counter)
+            ]])
+            :route("GET", "/empty", [[ return nil ]])
+            :route("GET", "/boom", [[ error("kaboom") ]])
+
+        ok("wait() before start -> true", srv:wait(0) == true)
+        local port, perr = srv:start()
+        ok("srv:start() -> port",
+            math.type(port) == "integer" and port > 0, "err=" .. tostring(perr))
+        if port then
+            local base = "http://127.0.0.1:" .. port
+            v, e = srv:start()
+            ok_fail("start() twice -> (nil, err)", v, e)
+            ok("wait(0.05) while running -> false", srv:wait(0.05) == false)
+
+            local r = H.get(base .. "/hello", { timeout = 5 })
+            ok("string handler -> 200 text/plain",
+                r and r.status == 200 and r.body == "hello"
+                and r.headers["content-type"]:find("text/plain", 1, true) == 1,
+                r and r.body)
+            r = H.get(base .. "/ping", { timeout = 5 })
+            ok("function path handler from init",
+                r and r.status == 200 and r.body == "pong", r and r.body)
+            r = H.get(base .. "/users/42?q=x", { timeout = 5 })
+            ok("path params, query, status and headers",
+                r and r.status == 201 and r.body == "42:x"
+                and r.headers["x-id"] == "42"
+                and r.headers["content-type"] == "application/x-test",
+                r and r.body)
+            r = H.post(base .. "/echo", "payload", { timeout = 5 })
+            ok("POST body echoed",
+                r and r.body == "payload" and r.headers["x-method"] == "POST",
+                r and r.body)
+
+            local big = string.rep("a", 100000)
+            r = H.post(base .. "/upload", big, { timeout = 5 })
+            ok("stream route reads a sized body",
+                r and r.body == "100000/100000", r and r.body)
+            local parts = 0
+            r = H.post(base .. "/upload", {
+                timeout = 5,
+                body = function()
+                    parts = parts + 1
+                    if parts <= 4 then return string.rep("b", 1000) end
+                end,
+            })
+            ok("stream route reads a chunked body",
+                r and r.body == "4000/4000", r and r.body)
+
+            r = H.get(base .. "/chunks", { timeout = 5 })
+            ok("body function -> chunked response",
+                r and r.status == 200 and r.body == "c1c2c3", r and r.body)
+            r = H.get(base .. "/file", { timeout = 5 })
+            ok("file response",
+                r and r.body == string.rep("0123456789", 10000)
+                and r.headers["content-length"] == "100000")
+            r = H.get(base .. "/empty", { timeout = 5 })
+            ok("nil -> 204", r and r.status == 204)
+            r = H.get(base .. "/nope", { timeout = 5 })
+            ok("unknown route -> 404", r and r.status == 404)
+            r = H.get(base .. "/boom", { timeout = 5 })
+            ok("handler error -> 500", r and r.status == 500)
+
+            -- Une connexion keep-alive reste sur un thread : son état
+            -- (counter) persiste d'une requête à l'autre.
+            local sess = H.session()
+            local seen = {}
+            for i = 1, 3 do
+                local rc = sess:get(base .. "/count", { timeout = 5 })
+                seen[i] = rc and rc.body
+            end
+            ok("keep-alive connection keeps its handler state",
+                seen[1] ~= nil and tonumber(seen[2]) == tonumber(seen[1]) + 1
+                and tonumber(seen[3]) == tonumber(seen[1]) + 2,
+                table.concat(seen, ","))
+            ok("  session reused the connection", sess:stats().hits == 2)
+            sess:close()
+
+            local st = srv:stats()
+            ok("stats: requests, errors, last_error",
+                st.requests >= 13 and st.errors == 1
+                and type(st.last_error) == "string"
+                and st.last_error:find("kaboom", 1, true) ~= nil,
+                string.format("requests=%s errors=%s", tostring(st.requests),
+                    tostring(st.errors)))
+            ok("stats: threads, port, running",
+                st.threads == 2 and st.port == port and st.running == true)
+
+            srv:stop()
+            srv:stop() -- idempotent
+            ok("wait() after stop -> true", srv:wait(1) == true)
+            ok("stats after stop: not running", srv:stats().running == false)
+            v, e = H.get(base .. "/hello", { timeout = 1 })
+            ok_fail("request after stop -> (nil, err)", v, e)
+
+            port = srv:start()
+            ok("restart after stop", math.type(port) == "integer")
+            if port then
+                r = H.get("http://127.0.0.1:" .. port .. "/hello",
+                    { timeout = 5 })
+                ok("  serves again", r and r.body == "hello")
+            end
+            srv:stop()
+        end
+        os.remove(served)
+
+        local bad = H.server({ threads = 1, init = "error('no init')" })
+        v, e = bad:start()
+        ok_fail("failing init -> start() (nil, err)", v, e)
+        ok("  message mentions init",
+            type(e) == "string" and e:find("init", 1, true) ~= nil,
+            "err=" .. tostring(e))
+        bad = H.server({ threads = 1 })
+        bad:route("GET", "/", "missing.handler")
+        v, e = bad:start()
+        ok_fail("unknown function path -> start() (nil, err)", v, e)
+        v, e = bad:start("127.0.0.1", 70000)
+        ok_fail("port out of range -> (nil, err)", v, e)
+    end
     -- --- dette de test post-Chantier 1 (4 cas inscrits au `todo`) ----
 
     -- 1. http.post(url, opts) without body: 2-arg form (opts in 2nd
@@ -3615,6 +4204,113 @@ do
                 end
             end
 
+            -- ----- tampon de lecture : recv_until, mélanges -----------
+
+            do
+                local c5, ce = S.connect("127.0.0.1", port, 2)
+                ok_val("5th connect (for read buffer tests)", c5, ce)
+                local p5, pe = srv:accept()
+                ok_val("5th accept", p5, pe)
+                if c5 and p5 then
+                    p5:set_timeout(2)
+
+                    -- Plusieurs lignes + un en-tête HTTP dans UN send :
+                    -- tout arrive dans un seul remplissage du tampon.
+                    c5:send("a\nb\r\nGET / HTTP/1.1\r\nHost: x\r\n\r\nrest")
+                    ok("recv_line from buffer #1", p5:recv_line() == "a")
+                    ok("recv_line from buffer #2 (CRLF)", p5:recv_line() == "b")
+                    local head, herr = p5:recv_until("\r\n\r\n")
+                    ok_val("recv_until('\\r\\n\\r\\n') -> (head, nil)",
+                        head, herr)
+                    ok("  delimiter consumed, not returned",
+                        head == "GET / HTTP/1.1\r\nHost: x",
+                        "head=" .. tostring(head))
+                    -- recv(n) sert d'abord les octets déjà bufferisés.
+                    local r = p5:recv(2)
+                    ok("recv(2) after recv_until reads buffered bytes",
+                        r == "re", "r=" .. tostring(r))
+                    ok("recv(100) returns the rest only",
+                        p5:recv(100) == "st")
+
+                    -- Délimiteur multi-octets coupé entre deux send.
+                    c5:send("x=1\r")
+                    p5:set_timeout(0.1)
+                    local v0, e0 = p5:recv_until("\r\n", 64)
+                    ok("recv_until: half delimiter -> (nil, 'timeout')",
+                        v0 == nil and e0 == "timeout")
+                    p5:set_timeout(2)
+                    c5:send("\ny=2\0")
+                    ok("recv_until: delimiter split across sends",
+                        p5:recv_until("\r\n") == "x=1")
+                    ok("recv_until('\\0') binary delimiter",
+                        p5:recv_until("\0") == "y=2")
+
+                    -- Timeout au milieu d'une ligne : rien n'est perdu.
+                    c5:send("par")
+                    p5:set_timeout(0.1)
+                    local v, e = p5:recv_line()
+                    ok("recv_line mid-line timeout -> (nil, 'timeout')",
+                        v == nil and e == "timeout")
+                    c5:send("tial\n")
+                    p5:set_timeout(2)
+                    local l = p5:recv_line()
+                    ok("  next recv_line keeps earlier bytes",
+                        l == "partial", "l=" .. tostring(l))
+
+                    -- max dépassé : "too long", le tampon est vidé.
+                    c5:send(string.rep("z", 32) .. "\n")
+                    local v2, e2 = p5:recv_until("\n", 16)
+                    ok("recv_until past max -> (nil, 'too long')",
+                        v2 == nil and e2 == "too long",
+                        "e=" .. tostring(e2))
+
+                    -- Argument invalide.
+                    local v3, e3 = p5:recv_until("")
+                    ok_fail("recv_until('') -> (nil, err)", v3, e3)
+                    ok("recv_until(nil) raises",
+                        not pcall(p5.recv_until, p5, nil))
+
+                    -- recv_all rend aussi ce qui est déjà bufferisé.
+                    c5:send("one\ntwo\nthree")
+                    ok("recv_line before recv_all", p5:recv_line() == "one")
+                    c5:close()
+                    local body = p5:recv_all()
+                    ok("recv_all includes buffered bytes",
+                        body == "two\nthree", "body=" .. tostring(body))
+                    p5:close()
+                end
+            end
+
+            -- ----- recv_line : beaucoup de lignes (tampon + memchr) ----
+            -- 2000 lignes courtes écrites d'un bloc (~20 KiB, sous le
+            -- buffer noyau, cf. note 8 KiB ci-dessus sur le Pi 0 :
+            -- on envoie en plusieurs fois en lisant entre deux).
+            do
+                local c6, ce = S.connect("127.0.0.1", port, 2)
+                local p6 = c6 and srv:accept()
+                if c6 and p6 then
+                    p6:set_timeout(2)
+                    local good = true
+                    for chunk = 0, 9 do
+                        local lines = {}
+                        for i = 1, 200 do
+                            lines[i] = "line-" .. (chunk * 200 + i)
+                        end
+                        c6:send(table.concat(lines, "\n") .. "\n")
+                        for i = 1, 200 do
+                            if p6:recv_line() ~= "line-" .. (chunk * 200 + i) then
+                                good = false
+                            end
+                        end
+                    end
+                    ok("recv_line: 2000 lines in order", good)
+                    c6:close()
+                    p6:close()
+                else
+                    ok("6th connect/accept (many lines)", false, ce)
+                end
+            end
+
             -- ----- accept with timeout: no client -> timeout --
 
             do
@@ -3666,6 +4362,697 @@ do
             lst:close()
         end
     end
+
+    -- ----- poller (epoll) : plusieurs sockets, timers, inotify --------
+
+    do
+        ok("poller is a function", type(S.poller) == "function")
+        local p, perr = S.poller()
+        ok_val("poller() -> (poller, nil)", p, perr)
+        local v0, e0 = S.poller(0)
+        ok_fail("poller(0) -> (nil, err)", v0, e0)
+
+        local srv = S.listen("127.0.0.1", 0)
+        local port = srv and srv:sockname().port
+        if p and srv then
+            ok_act("p:add(listening socket)", p:add(srv))
+            local v, e = p:add(srv)
+            ok_fail("p:add twice -> (nil, err)", v, e)
+            ok("p:add({}) raises", not pcall(p.add, p, {}))
+            local v1, e1 = p:add(srv, "x")
+            ok_fail("p:add bad events -> (nil, err)", v1, e1)
+
+            -- Rien de prêt : timeout court.
+            local none, terr = p:wait(0.05)
+            ok("wait with nothing ready -> (nil, 'timeout')",
+                none == nil and terr == "timeout")
+
+            -- Trois clients ; le serveur accepte au fil des événements.
+            local clients, peers = {}, {}
+            for i = 1, 3 do clients[i] = S.connect("127.0.0.1", port, 2) end
+            local accepted = 0
+            for _ = 1, 10 do
+                local evs = p:wait(1)
+                for _, ev in ipairs(evs or {}) do
+                    if ev.obj == srv and ev.readable then
+                        local c = srv:accept()
+                        if c then
+                            accepted = accepted + 1
+                            peers[#peers + 1] = c
+                            c:set_timeout(1)
+                            p:add(c, "r")
+                        end
+                    end
+                end
+                if accepted == 3 then break end
+            end
+            ok("poller: 3 connections accepted via events", accepted == 3,
+                "accepted=" .. accepted)
+
+            -- Deux clients écrivent : un seul lot, les bons objets.
+            clients[1]:send("one\ntwo\n")
+            clients[3]:send("three\n")
+            babet.sleep(50, "ms")
+            local evs = p:wait(1) or {}
+            local ready = {}
+            for _, ev in ipairs(evs) do
+                if ev.readable then ready[ev.obj] = true end
+            end
+            ok("wait returns a batch with both ready peers",
+                ready[peers[1]] and ready[peers[3]] and not ready[peers[2]],
+                "n=" .. #evs)
+
+            -- Octets restés dans le tampon du socket : readable sans
+            -- nouvel octet côté noyau.
+            ok("recv_line on ready peer", peers[1]:recv_line() == "one")
+            local again = p:wait(0) or {}
+            local still = false
+            for _, ev in ipairs(again) do
+                if ev.obj == peers[1] and ev.readable then still = true end
+            end
+            ok("buffered bytes reported readable", still)
+            ok("  next line served from buffer", peers[1]:recv_line() == "two")
+            ok("  other peer", peers[3]:recv_line() == "three")
+            local drained = true
+            for _, ev in ipairs(p:wait(0) or {}) do
+                if ev.obj == peers[1] then drained = false end
+            end
+            ok("drained buffer no longer reported", drained)
+
+            -- Inscrit avec des octets déjà en tampon : prêt tout de suite.
+            p:remove(peers[3])
+            clients[3]:send("four\nfive\n")
+            babet.sleep(50, "ms")
+            ok("  recv_line before add", peers[3]:recv_line() == "four")
+            p:add(peers[3])
+            local pre = false
+            for _, ev in ipairs(p:wait(0) or {}) do
+                if ev.obj == peers[3] and ev.readable then pre = true end
+            end
+            ok("add with buffered bytes -> readable at once", pre)
+            ok("  buffered line", peers[3]:recv_line() == "five")
+
+            -- Hangup : fermeture côté client.
+            clients[2]:close()
+            local hup = false
+            for _, ev in ipairs(p:wait(1) or {}) do
+                if ev.obj == peers[2] and ev.readable then
+                    local d, de = peers[2]:recv(10)
+                    hup = (d == nil and de == "closed")
+                end
+            end
+            ok("peer close -> readable then recv 'closed'", hup)
+            ok_act("p:remove(socket)", p:remove(peers[2]))
+            local v2, e2 = p:remove(peers[2])
+            ok_fail("p:remove twice -> (nil, err)", v2, e2)
+
+            -- modify : intérêt écriture.
+            ok_act("p:modify(peer, 'w')", p:modify(peers[3], "w"))
+            local w = false
+            for _, ev in ipairs(p:wait(1) or {}) do
+                if ev.obj == peers[3] and ev.writable then w = true end
+            end
+            ok("writable event after modify", w)
+            p:modify(peers[3], "r")
+
+            -- remove d'un socket fermé entre-temps.
+            peers[1]:close()
+            ok_act("p:remove(closed socket)", p:remove(peers[1]))
+
+            for _, c in ipairs(clients) do c:close() end
+            peers[3]:close()
+            p:remove(peers[3])
+        end
+
+        -- Timers : one-shot, repeat, cancel.
+        if p then
+            local t1 = p:timer(0.02)
+            local t2 = p:timer(0.01, true)
+            local t3 = p:timer(0.01)
+            ok_act("p:cancel(id)", p:cancel(t3))
+            local v, e = p:cancel(t3)
+            ok_fail("p:cancel twice -> (nil, err)", v, e)
+            local v1, e1 = p:timer(-1)
+            ok_fail("p:timer(-1) -> (nil, err)", v1, e1)
+            local seen = { [t1] = 0, [t2] = 0, [t3] = 0 }
+            local t0 = babet.monotonic()
+            while babet.monotonic() - t0 < 0.1 do
+                for _, ev in ipairs(p:wait(0.2) or {}) do
+                    if ev.timer then seen[ev.timer] = seen[ev.timer] + 1 end
+                end
+            end
+            ok("one-shot timer fires once", seen[t1] == 1,
+                "n=" .. seen[t1])
+            ok("repeating timer fires several times", seen[t2] >= 3,
+                "n=" .. seen[t2])
+            ok("cancelled timer never fires", seen[t3] == 0)
+            p:cancel(t2)
+        end
+
+        -- inotify : un watcher dans le même lot que les sockets.
+        if p and babet.inotify then
+            local dir = sb("poller_d")
+            babet.mkdir(dir)
+            local wt = babet.inotify.new()
+            wt:add(dir, { "close_write" })
+            ok_act("p:add(inotify watcher)", p:add(wt))
+            local f = io.open(dir .. "/x.txt", "w")
+            f:write("x")
+            f:close()
+            local got = false
+            for _, ev in ipairs(p:wait(1) or {}) do
+                if ev.obj == wt and ev.readable then
+                    local list = wt:read(0)
+                    got = list ~= nil and #list >= 1
+                end
+            end
+            ok("inotify watcher event via poller", got)
+            p:remove(wt)
+            wt:close()
+        end
+
+        if p then
+            ok_act("p:close()", p:close())
+            local v, e = p:wait(0)
+            ok_fail("wait on closed poller -> (nil, err)", v, e)
+        end
+        if srv then srv:close() end
+    end
+
+    -- ----- scheduler : coroutines, I/O suspendues sur epoll ----------
+
+    do
+        ok("scheduler is a function", type(S.scheduler) == "function")
+        local sc, serr = S.scheduler()
+        ok_val("scheduler() -> (sched, nil)", sc, serr)
+        if sc then
+            ok_act("run() with no task", sc:run())
+            ok("sleep outside a task raises", not pcall(sc.sleep, sc, 0))
+
+            -- Serveur echo : une tâche accepte, une tâche par client ;
+            -- trois clients dans le même thread.
+            local srv = S.listen("127.0.0.1", 0)
+            local port = srv:sockname().port
+            srv:set_timeout(2)
+            local replies, served = {}, 0
+            sc:spawn(function()
+                for _ = 1, 3 do
+                    local c = assert(srv:accept())
+                    sc:spawn(function(conn)
+                        conn:set_timeout(2)
+                        local line = conn:recv_line()
+                        conn:send("echo:" .. tostring(line) .. "\n")
+                        conn:close()
+                        served = served + 1
+                    end, c)
+                end
+            end)
+            for i = 1, 3 do
+                sc:spawn(function(n, delay)
+                    local c = assert(S.connect("127.0.0.1", port, 2))
+                    sc:sleep(delay)
+                    c:send("client" .. n .. "\n")
+                    replies[n] = c:recv_line()
+                    c:close()
+                end, i, (4 - i) * 0.02)
+            end
+            local t0 = babet.monotonic()
+            ok_act("run() echo server + 3 clients", sc:run(5))
+            ok("scheduler: 3 clients served", served == 3,
+                "served=" .. served)
+            ok("scheduler: replies routed to the right task",
+                replies[1] == "echo:client1" and replies[2] == "echo:client2"
+                and replies[3] == "echo:client3")
+            ok("scheduler: clients ran concurrently",
+                babet.monotonic() - t0 < 0.5)
+            srv:close()
+
+            -- Timeout : la deadline de l'appel est respectée en tâche,
+            -- et les autres tâches avancent pendant l'attente.
+            local l2 = S.listen("127.0.0.1", 0)
+            local p2 = l2:sockname().port
+            local cl = S.connect("127.0.0.1", p2, 2)
+            local pe = l2:accept()
+            l2:close()
+            local res, ticks = {}, 0
+            sc:spawn(function()
+                pe:set_timeout(0.1)
+                local t1 = babet.monotonic()
+                res.v, res.e = pe:recv_line()
+                res.dt = babet.monotonic() - t1
+            end)
+            sc:spawn(function()
+                for _ = 1, 5 do
+                    ticks = ticks + 1
+                    sc:sleep(0.01)
+                end
+            end)
+            sc:run(2)
+            ok("task recv_line timeout -> (nil, 'timeout')",
+                res.v == nil and res.e == "timeout")
+            ok("task timeout honours the call deadline",
+                res.dt and res.dt >= 0.09 and res.dt < 0.5,
+                "dt=" .. tostring(res.dt))
+            ok("other task ran during the wait", ticks == 5)
+
+            -- Gros send (plus que le buffer noyau) face à un recv_all :
+            -- send cède en cours de route sans perdre sa progression.
+            local big = string.rep("0123456789abcdef", 256 * 1024) -- 4 MiB
+            local got
+            pe:set_timeout(5)
+            cl:set_timeout(5)
+            sc:spawn(function()
+                local n = cl:send(big)
+                res.sent = n
+                cl:close()
+            end)
+            sc:spawn(function()
+                got = pe:recv_all()
+            end)
+            ok_act("run() big send / recv_all", sc:run(10))
+            ok("task send: all bytes sent", res.sent == #big)
+            ok("task recv_all: same bytes", got == big,
+                "len=" .. tostring(got and #got))
+            pe:close()
+
+            -- sleep concurrents, coroutine.yield nu.
+            local order = {}
+            sc:spawn(function()
+                order[#order + 1] = "a1"
+                coroutine.yield()
+                order[#order + 1] = "a2"
+            end)
+            sc:spawn(function()
+                order[#order + 1] = "b1"
+                sc:sleep(0.05)
+                order[#order + 1] = "b2"
+            end)
+            sc:spawn(function()
+                sc:sleep(0.05)
+                order[#order + 1] = "c"
+            end)
+            local t2 = babet.monotonic()
+            sc:run()
+            ok("sleeps overlap", babet.monotonic() - t2 < 0.09)
+            ok("coroutine.yield passes the turn",
+                table.concat(order, ",", 1, 3) == "a1,b1,a2")
+            local sv, se
+            sc:spawn(function() sv, se = sc:sleep(-1) end)
+            sc:run()
+            ok_fail("sleep(-1) in a task -> (nil, err)", sv, se)
+
+            -- Erreur dans une tâche : run() rend (nil, msg) ; les
+            -- autres tâches restent suspendues.
+            sc:spawn(function() error("boom") end)
+            local rv, re = sc:run()
+            ok("task error -> (nil, 'task N failed: ...')",
+                rv == nil and tostring(re):find("failed: .*boom") ~= nil,
+                tostring(re))
+
+            -- run(timeout) avec une tâche qui attend sans fin.
+            local l3 = S.listen("127.0.0.1", 0)
+            sc:spawn(function() l3:accept() end)
+            local tv, te = sc:run(0.05)
+            ok("run(timeout) with pending task -> (nil, 'timeout')",
+                tv == nil and te == "timeout")
+            ok_act("sched:close()", sc:close())
+            local cv, ce = sc:run()
+            ok_fail("run on closed scheduler -> (nil, err)", cv, ce)
+            l3:close()
+        end
+    end
+
+    -- ----- listen : options, SO_REUSEPORT, listen_workers -----------
+
+    do
+        local a, ae = S.listen("127.0.0.1", 0, { reuseport = true, backlog = 64 })
+        ok_val("listen(opts{reuseport, backlog})", a, ae)
+        if a then
+            local port = a:sockname().port
+            local b, be = S.listen("127.0.0.1", port, { reuseport = true })
+            ok_val("second reuseport listener on the same port", b, be)
+            local c, ce = S.listen("127.0.0.1", port)
+            ok_fail("plain listener on a reuseport port -> (nil, err)", c, ce)
+            if b then b:close() end
+            a:close()
+        end
+        local v, e = S.listen("127.0.0.1", 0, { backlog = 0 })
+        ok_fail("listen backlog = 0 -> (nil, err)", v, e)
+        ok("listen reuseport = 'yes' raises",
+            not pcall(S.listen, "127.0.0.1", 0, { reuseport = "yes" }))
+        local old = S.listen("127.0.0.1", 0, 32)
+        ok("listen(host, port, backlog) still accepted", old ~= nil)
+        if old then old:close() end
+
+        ok("listen_workers is a function", type(S.listen_workers) == "function")
+        local ws, werr = S.listen_workers("127.0.0.1", 0, [[
+            local l = worker.listener
+            worker.send({ shard = worker.shard, port = l:sockname().port })
+            l:set_timeout(1)
+            local n = 0
+            while true do
+                local c = l:accept()
+                if not c then break end
+                c:send(worker.shard .. "\n")
+                c:close()
+                n = n + 1
+            end
+            return n
+        ]], nil, { workers = 2 })
+        ok_val("listen_workers(..., {workers = 2})", ws, werr)
+        if ws then
+            local ports, shards = {}, {}
+            for _, w in ipairs(ws) do
+                local _, m = w:recv(2)
+                if m then
+                    ports[#ports + 1] = m.port
+                    shards[m.shard] = true
+                end
+            end
+            ok("listen_workers: one listener per worker, same port",
+                #ports == 2 and ports[1] == ports[2] and ports[1] > 0)
+            ok("listen_workers: worker.shard = 1..N", shards[1] and shards[2])
+            for _ = 1, 10 do
+                local c = S.connect("127.0.0.1", ports[1], 2)
+                if c then
+                    c:recv_line()
+                    c:close()
+                end
+            end
+            local total = 0
+            for _, w in ipairs(ws) do
+                local _, n = w:join()
+                total = total + (n or 0)
+            end
+            ok("listen_workers: all connections accepted", total == 10,
+                "total=" .. total)
+        end
+        local zv, ze = S.listen_workers("127.0.0.1", 0, "", nil, { workers = 0 })
+        ok_fail("listen_workers workers = 0 -> (nil, err)", zv, ze)
+    end
+
+    -- ----- UDP et AF_UNIX ---------------------------------------------
+
+    do
+        ok("udp is a function", type(S.udp) == "function")
+        local srv, serr = S.udp("127.0.0.1", 0)
+        ok_val("udp(host, 0) -> (socket, nil)", srv, serr)
+        local cli, cerr = S.udp()
+        ok_val("udp() -> unbound socket", cli, cerr)
+        if srv and cli then
+            srv:set_timeout(2)
+            cli:set_timeout(2)
+            local port = srv:sockname().port
+            ok("udp: tostring says datagram",
+                tostring(srv):find("datagram", 1, true) ~= nil)
+            ok("sendto -> bytes", cli:sendto("ping", "127.0.0.1", port) == 4)
+            local data, host, from_port = srv:recvfrom()
+            ok("recvfrom -> data, host, port",
+                data == "ping" and host == "127.0.0.1"
+                and from_port == cli:sockname().port,
+                tostring(data) .. " " .. tostring(host))
+            ok("sendto reply to the sender",
+                srv:sendto("pong", host, from_port) == 4)
+            ok("recvfrom on the unbound socket", cli:recvfrom() == "pong")
+            cli:sendto("", "127.0.0.1", port)
+            ok("empty datagram is not EOF", srv:recvfrom() == "")
+            cli:sendto("0123456789", "127.0.0.1", port)
+            ok("recv(n) truncates a datagram", srv:recv(4) == "0123")
+
+            local msgs = {}
+            for i = 1, 5 do
+                msgs[i] = { data = "m" .. i, host = "127.0.0.1", port = port }
+            end
+            ok("sendmmsg -> count", cli:sendmmsg(msgs) == 5)
+            local batch = srv:recvmmsg(16)
+            ok("recvmmsg -> one entry per datagram",
+                batch and #batch == 5 and batch[1].data == "m1"
+                and batch[5].data == "m5" and batch[1].port == from_port)
+            cli:sendto(string.rep("x", 100), "127.0.0.1", port)
+            local tb = srv:recvmmsg(4, 10)
+            ok("recvmmsg: truncated flag",
+                tb and tb[1].truncated == true and #tb[1].data == 10)
+
+            srv:set_timeout(0.05)
+            local tv, te = srv:recvfrom()
+            ok("recvfrom timeout -> (nil, 'timeout')",
+                tv == nil and te == "timeout")
+            local bv, be = cli:sendto("x", "127.0.0.1", 70000)
+            ok_fail("sendto port out of range -> (nil, err)", bv, be)
+            local rv, re = srv:recv_line()
+            ok_fail("recv_line on a datagram socket -> (nil, err)", rv, re)
+            local mv, me = cli:recvmmsg(0)
+            ok_fail("recvmmsg max = 0 -> (nil, err)", mv, me)
+            ok("sendmmsg bad item raises",
+                not pcall(cli.sendmmsg, cli, { 42 }))
+
+            local uc, ucerr = S.udp_connect("127.0.0.1", port)
+            ok_val("udp_connect -> (socket, nil)", uc, ucerr)
+            if uc then
+                ok("connected udp: send", uc:send("hello") == 5)
+                ok("connected udp: peer receives", srv:recvfrom() == "hello")
+                ok("connected udp: sendmmsg of strings",
+                    uc:sendmmsg({ "a", "b" }) == 2)
+                local ab = srv:recvmmsg()
+                ok("connected udp: batch received", ab and #ab == 2)
+                uc:close()
+            end
+            local ut, uterr = S.udp_connect("127.0.0.1", port, 1)
+            ok_val("udp_connect with timeout -> (socket, nil)", ut, uterr)
+            if ut then ut:close() end
+            local un, unerr = S.udp_connect("127.0.0.1", port, -1)
+            ok_fail("udp_connect negative timeout -> (nil, err)", un, unerr)
+
+            -- Tâches : recvfrom suspend la coroutine.
+            local sc = S.scheduler()
+            local got
+            srv:set_timeout(2)
+            sc:spawn(function() got = srv:recvfrom() end)
+            sc:spawn(function()
+                sc:sleep(0.02)
+                cli:sendto("task", "127.0.0.1", port)
+            end)
+            ok_act("run() udp tasks", sc:run(2))
+            ok("recvfrom suspended in a task", got == "task")
+            sc:close()
+            srv:close()
+            cli:close()
+        end
+
+        -- Flux unix : echo via un fichier de socket.
+        local path = "/tmp/lp_unix_" .. tostring(babet.pid()) .. ".sock"
+        os.remove(path)
+        local ul, ulerr = S.unix_listen(path)
+        ok_val("unix_listen(path) -> (socket, nil)", ul, ulerr)
+        if ul then
+            ul:set_timeout(2)
+            local uc, ucerr = S.unix_connect(path, 2)
+            ok_val("unix_connect(path) -> (socket, nil)", uc, ucerr)
+            local peer = ul:accept()
+            if uc and peer then
+                uc:send("hi unix\n")
+                peer:set_timeout(2)
+                ok("unix stream: recv_line", peer:recv_line() == "hi unix")
+                ok("unix: sockname -> { path }", ul:sockname().path == path)
+                uc:close()
+                peer:close()
+            end
+            local dv, de = S.unix_listen(path)
+            ok_fail("unix_listen on an existing file -> (nil, err)", dv, de)
+            ul:close()
+            os.remove(path)
+        end
+        local nv, ne = S.unix_connect(path)
+        ok_fail("unix_connect to a missing path -> (nil, err)", nv, ne)
+        local lv, le = S.unix_connect(string.rep("p", 200))
+        ok_fail("unix_connect path too long -> (nil, err)", lv, le)
+
+        -- Datagrammes unix, espace abstrait.
+        local name = "@lp_dgram_" .. tostring(babet.pid())
+        local ud, uderr = S.unix_dgram(name)
+        ok_val("unix_dgram(@abstract) -> (socket, nil)", ud, uderr)
+        local us = S.unix_dgram(name .. "_c")
+        if ud and us then
+            ud:set_timeout(2)
+            us:set_timeout(2)
+            ok("unix sendto(data, path)", us:sendto("dgram", name) == 5)
+            local d, from = ud:recvfrom()
+            ok("unix recvfrom -> data, path",
+                d == "dgram" and from == name .. "_c",
+                tostring(d) .. " " .. tostring(from))
+            ud:sendto("back", from)
+            ok("unix reply to the sender path", us:recvfrom() == "back")
+            us:sendmmsg({ { data = "u1", path = name }, { data = "u2", path = name } })
+            local ub = ud:recvmmsg()
+            ok("unix recvmmsg -> path field",
+                ub and #ub == 2 and ub[2].path == name .. "_c")
+            ud:close()
+            us:close()
+        end
+    end
+
+    -- ----- sendfile ----------------------------------------------------
+
+    do
+        local srv = S.listen("127.0.0.1", 0)
+        ok("sendfile is a method", type(srv.sendfile) == "function")
+        local fpath = "/tmp/lp_sendfile_" .. tostring(babet.pid()) .. ".bin"
+        local parts = {}
+        for i = 1, 20000 do parts[i] = string.format("%07d\n", i) end
+        local content = table.concat(parts) -- 160000 octets
+        local f = assert(io.open(fpath, "wb"))
+        f:write(content)
+        f:close()
+
+        local port = srv:sockname().port
+        srv:set_timeout(2)
+        local c = S.connect("127.0.0.1", port, 2)
+        local p = srv:accept()
+        if c and p then
+            c:set_timeout(2)
+            p:set_timeout(2)
+            local n, e = c:sendfile(fpath)
+            ok_val("sendfile(path) -> bytes", n, e)
+            ok("sendfile: whole file sent", n == #content, "n=" .. tostring(n))
+            local got = p:recv(#content)
+            while got and #got < #content do
+                got = got .. p:recv(#content - #got)
+            end
+            ok("sendfile: bytes match the file", got == content)
+            ok("sendfile(path, offset, len)", c:sendfile(fpath, 8, 16) == 16)
+            ok("sendfile: range content", p:recv(16) == content:sub(9, 24))
+            ok("sendfile: len past EOF stops at EOF",
+                c:sendfile(fpath, #content - 8, 100) == 8)
+            ok("sendfile: tail content", p:recv(8) == content:sub(-8))
+            local mv, me = c:sendfile(fpath .. ".missing")
+            ok_fail("sendfile(missing path) -> (nil, err)", mv, me)
+            local ov, oe = c:sendfile(fpath, #content + 1)
+            ok_fail("sendfile offset beyond EOF -> (nil, err)", ov, oe)
+            local nv, ne = c:sendfile(fpath, -1)
+            ok_fail("sendfile negative offset -> (nil, err)", nv, ne)
+            ok("sendfile({}) raises", not pcall(c.sendfile, c, {}))
+            c:close()
+            p:close()
+        end
+        srv:close()
+        os.remove(fpath)
+    end
+
+    -- ----- sendv / setopt ----------------------------------------------
+
+    do
+        local srv = S.listen("127.0.0.1", 0)
+        local port = srv:sockname().port
+        srv:set_timeout(2)
+        local c = S.connect("127.0.0.1", port, 2)
+        local p = srv:accept()
+        if c and p then
+            c:set_timeout(2)
+            p:set_timeout(2)
+            local n, e = c:sendv({ "GET ", "/x", " HTTP/1.0", "", "\r\n" })
+            ok_val("sendv(parts) -> bytes", n, e)
+            ok("sendv: total length", n == 17)
+            ok("sendv: parts arrive in order", p:recv_line() == "GET /x HTTP/1.0")
+            local big, expect = {}, {}
+            for i = 1, 3000 do
+                big[i] = string.rep(string.char(65 + i % 26), i % 97 + 1)
+            end
+            expect = table.concat(big)
+            local pieces = {}
+            local sc = S.scheduler()
+            sc:spawn(function() n = c:sendv(big) end)
+            sc:spawn(function()
+                local got = 0
+                while got < #expect do
+                    local d = p:recv(65536)
+                    if not d then break end
+                    pieces[#pieces + 1] = d
+                    got = got + #d
+                end
+            end)
+            ok_act("run() sendv of 3000 parts", sc:run(5))
+            sc:close()
+            ok("sendv: > IOV_MAX parts, bytes match",
+                n == #expect and table.concat(pieces) == expect)
+            ok("sendv({}) -> 0", c:sendv({}) == 0)
+            ok("sendv with a non-string part raises",
+                not pcall(c.sendv, c, { "a", 1 }))
+
+            ok_act("setopt{nodelay = true}", c:setopt({ nodelay = true }))
+            ok_act("setopt{keepalive, sndbuf, rcvbuf}",
+                c:setopt({ keepalive = true, sndbuf = 65536, rcvbuf = 65536 }))
+            ok_act("setopt{cork = true}", c:setopt({ cork = true }))
+            c:send("ab")
+            c:send("cd\n")
+            ok_act("setopt{cork = false} flushes", c:setopt({ cork = false }))
+            ok("corked sends arrive", p:recv_line() == "abcd")
+            local bv, be = c:setopt({ sndbuf = 0 })
+            ok_fail("setopt sndbuf = 0 -> (nil, err)", bv, be)
+            ok("setopt unknown option raises",
+                not pcall(c.setopt, c, { nodelai = true }))
+            ok("setopt nodelay = 1 raises",
+                not pcall(c.setopt, c, { nodelay = 1 }))
+            local u = S.udp()
+            local uv, ue = u:setopt({ nodelay = true })
+            ok_fail("setopt nodelay on udp -> (nil, err)", uv, ue)
+            u:close()
+            c:close()
+            p:close()
+        end
+        srv:close()
+    end
+
+    -- ----- DNS : cache, entrées épinglées, resolve --------------------
+
+    do
+        ok("resolve is a function", type(S.resolve) == "function")
+        ok("resolve() without host raises", not pcall(S.resolve))
+        ok("dns_config() without opts raises", not pcall(S.dns_config))
+        ok("dns_config ttl = 'x' raises",
+            not pcall(S.dns_config, { ttl = "x" }))
+        ok("dns_config hosts = { name = 1 } raises",
+            not pcall(S.dns_config, { hosts = { ["a.test"] = 1 } }))
+        local v, e = S.dns_config({ ttl = -1 })
+        ok_fail("dns_config ttl < 0 -> (nil, err)", v, e)
+        v, e = S.dns_config({ hosts = { ["a.test"] = "not-an-ip" } })
+        ok_fail("dns_config hosts non-numeric -> (nil, err)", v, e)
+        v, e = S.resolve("")
+        ok_fail("resolve('') -> (nil, err)", v, e)
+
+        local lit = S.resolve("127.0.0.1")
+        ok("resolve(literal) -> { '127.0.0.1' }", lit and lit[1] == "127.0.0.1")
+
+        -- Résolveur de test : un nom épinglé, jamais envoyé au pool.
+        ok_act("dns_config{hosts = ...}",
+            S.dns_config({ hosts = { ["babet-svc.test"] = { "127.0.0.1" } } }))
+        local before = S.dns_stats()
+        local l = S.listen("127.0.0.1", 0)
+        local c, ce = S.connect("Babet-Svc.test", l:sockname().port, 2)
+        ok_val("connect to a pinned name (case-insensitive)", c, ce)
+        local after = S.dns_stats()
+        ok("pinned name served by the cache",
+            after.hits == before.hits + 1 and after.misses == before.misses)
+        if c then c:close() end
+        l:close()
+
+        -- Vrai résolveur : "localhost" passe par le pool, puis par le
+        -- cache.
+        local r1 = S.resolve("localhost", 5)
+        local mid = S.dns_stats()
+        local r2 = S.resolve("localhost", 5)
+        local last = S.dns_stats()
+        ok("resolve('localhost') -> addresses", r1 and #r1 > 0)
+        ok("second lookup is a cache hit",
+            last.hits == mid.hits + 1 and last.misses == mid.misses
+            and r2 and r2[1] == r1[1])
+        ok("lookup ran on the resolver pool", last.threads >= 1)
+
+        ok_act("dns_config{flush = true, hosts = {}}",
+            S.dns_config({ flush = true, hosts = {} }))
+        ok("flush empties the cache", S.dns_stats().entries == 0)
+        local nv, ne = S.resolve("babet-svc.test", 5)
+        ok_fail("unpinned name no longer resolves -> (nil, err)", nv, ne)
+    end
 end
 
 -- =====================================================================
@@ -3768,6 +5155,31 @@ do
         end
     end
 
+    -- ----- listen_tls / accept_tls : mauvais usage -----------------
+
+    do
+        ok("listen_tls is a function", type(S.listen_tls) == "function")
+        ok("listen_tls(host, port) without opts raises",
+            pcall(S.listen_tls, "127.0.0.1", 0) == false)
+        local v, e = S.listen_tls("127.0.0.1", 0, { key = "/x.pem" })
+        ok_fail("listen_tls without opts.cert -> (nil, err)", v, e)
+        v, e = S.listen_tls("127.0.0.1", 0,
+            { cert = "/nonexistent.pem", key = "/nonexistent.pem" })
+        ok_fail("listen_tls unreadable cert -> (nil, err)", v, e)
+        ok("  err prefixed with 'tls: '",
+            type(e) == "string" and e:find("tls: ", 1, true) == 1)
+        v, e = S.listen_tls("127.0.0.1", 0,
+            { cert = "/x.pem", key = "/x.pem", alpn = "h2" })
+        ok_fail("listen_tls opts.alpn non-table -> (nil, err)", v, e)
+        v, e = S.connect_tls("127.0.0.1", 443, { alpn = { "" } })
+        ok_fail("connect_tls empty alpn entry -> (nil, err)", v, e)
+
+        local plain = S.listen("127.0.0.1", 0)
+        v, e = plain:accept_tls()
+        ok_fail("accept_tls on a plain listener -> (nil, err)", v, e)
+        plain:close()
+    end
+
     -- ===== POSITIVE TESTS with openssl s_server ==================
     -- Graceful skip if openssl CLI absent or s_server doesn't start
     -- in time. Everything stays on loopback (127.0.0.1).
@@ -3798,6 +5210,92 @@ do
                 and babet.fileExists(cert_path)) then
             print("[INFO] tls: cert generation failed, skipping positive tests")
         else
+            -- ----- côté serveur : listen_tls / accept_tls, le client
+            -- est un worker (connect_tls est bloquant)
+            do
+                local l, le = S.listen_tls("127.0.0.1", 0, {
+                    cert = cert_path,
+                    key = key_path,
+                    alpn = { "h2", "http/1.1" },
+                })
+                ok_val("listen_tls(cert, key, alpn) -> socket", l, le)
+                if l then
+                    l:set_timeout(5)
+                    local port = l:sockname().port
+                    local w = babet.workers.spawn([[
+                        local got = {}
+                        for i = 1, 3 do
+                            local c = babet.socket.connect_tls("127.0.0.1",
+                                worker.args.port, {
+                                    verify = true,
+                                    ca_cert = worker.args.ca,
+                                    hostname = "localhost",
+                                    timeout = 5,
+                                    alpn = { "http/1.1" },
+                                })
+                            if not c then return got end
+                            c:send("ping\n")
+                            local line = c:recv_line()
+                            local info = c:tls_info()
+                            got[i] = tostring(line) .. "|" .. tostring(info.alpn)
+                                .. "|" .. tostring(info.resumed)
+                            c:close()
+                        end
+                        return got
+                    ]], { port = port, ca = cert_path })
+
+                    local infos = {}
+                    local function serve(c)
+                        c:set_timeout(5)
+                        local line = c:recv_line()
+                        infos[#infos + 1] = c:tls_info()
+                        c:send("pong " .. tostring(line) .. "\n")
+                        c:close()
+                    end
+                    for i = 1, 2 do
+                        local c, ce = l:accept_tls()
+                        if i == 1 then
+                            ok_val("accept_tls() -> TLS socket", c, ce)
+                        end
+                        if c then serve(c) end
+                    end
+                    -- Troisième client dans une tâche : le handshake
+                    -- cède au lieu de bloquer.
+                    local sc = S.scheduler()
+                    sc:spawn(function()
+                        local c = l:accept_tls()
+                        if c then serve(c) end
+                    end)
+                    sc:run(5)
+                    sc:close()
+
+                    local _, got = w:join()
+                    got = got or {}
+                    ok("accept_tls: client got the reply over TLS",
+                        got[1] == "pong ping|http/1.1|false", tostring(got[1]))
+                    ok("accept_tls: second connection resumes the session",
+                        got[2] == "pong ping|http/1.1|true", tostring(got[2]))
+                    ok("accept_tls in a scheduler task",
+                        got[3] ~= nil and #infos == 3, tostring(got[3]))
+                    ok("server tls_info: alpn negotiated, resumed",
+                        infos[1] and infos[1].alpn == "http/1.1"
+                        and infos[1].resumed == false
+                        and infos[2] and infos[2].resumed == true)
+
+                    -- Client muet : le handshake expire, le socket
+                    -- d'écoute reste utilisable.
+                    l:close()
+                    l = S.listen_tls("127.0.0.1", 0,
+                        { cert = cert_path, key = key_path, timeout = 0.2 })
+                    local mute = S.connect("127.0.0.1", l:sockname().port, 1)
+                    local c, ce = l:accept_tls()
+                    ok("accept_tls: silent client -> (nil, 'timeout')",
+                        c == nil and ce == "timeout", tostring(ce))
+                    mute:close()
+                    l:close()
+                end
+            end
+
             -- 2. Lancer s_server en arrière-plan. On passe par sh -c
             --    pour asee le `&` de détachement. La string complète
             --    de la commande shell est UN argument after "-c", pas
@@ -3807,7 +5305,7 @@ do
             local tls_port = 19000 + (os.time() % 1000)
             local server_cmd = string.format(
                 'openssl s_server -accept %d -cert %s -key %s '
-                .. '-quiet -naccept 10 -ign_eof '
+                .. '-quiet -naccept 20 -ign_eof '
                 .. '> /dev/null 2>&1 &',
                 tls_port, cert_path, key_path)
             babet.exec("sh", { "-c", server_cmd },
@@ -3904,6 +5402,70 @@ do
                             "err=" .. tostring(err))
                     end
                 end
+
+                -- ----- sendfile sur TLS : repli pread + SSL_write
+                do
+                    local s = S.connect_tls("127.0.0.1", tls_port,
+                        { verify = false, timeout = 5 })
+                    if s then
+                        local n, e = s:sendfile(cert_path)
+                        local f = io.open(cert_path, "rb")
+                        local size = #f:read("a")
+                        f:close()
+                        ok_val("TLS sendfile(path) -> bytes", n, e)
+                        ok("  whole file sent", n == size)
+                        s:close()
+                    end
+                end
+
+                -- ----- sendv sur TLS : morceaux coalescés
+                do
+                    local s = S.connect_tls("127.0.0.1", tls_port,
+                        { verify = false, timeout = 5 })
+                    if s then
+                        local n, e = s:sendv({ "hello", "-", "sendv", "\n" })
+                        ok_val("TLS sendv(parts) -> bytes", n, e)
+                        ok("  n == 12", n == 12)
+                        s:close()
+                    end
+                end
+
+                -- ----- cache de SSL_CTX : ca_cert ne touche pas les
+                -- autres connexions (plus de context global modifié)
+                do
+                    local s, e = S.connect_tls("127.0.0.1", tls_port,
+                        {
+                            verify = true,
+                            timeout = 5,
+                            hostname = "localhost"
+                        })
+                    ok_fail("verify=true without CA after a ca_cert "
+                        .. "connection -> still (nil, err)", s, e)
+                end
+
+                -- ----- reprise de session : le ticket arrive après le
+                -- handshake, lu par le premier recv
+                do
+                    local opts = { verify = false, timeout = 5 }
+                    local s1 = S.connect_tls("127.0.0.1", tls_port, opts)
+                    if s1 then
+                        local info = s1:tls_info()
+                        ok("tls_info() -> version, resumed = false",
+                            info and type(info.version) == "string"
+                            and info.resumed == false)
+                        s1:set_timeout(0.3)
+                        s1:recv(1)
+                        s1:close()
+                        local s2 = S.connect_tls("127.0.0.1", tls_port, opts)
+                        ok("reconnect resumes the TLS session",
+                            s2 and s2:tls_info().resumed == true)
+                        if s2 then s2:close() end
+                    end
+                    local plain = S.listen("127.0.0.1", 0)
+                    local tv, te = plain:tls_info()
+                    ok_fail("tls_info on a plain socket -> (nil, err)", tv, te)
+                    plain:close()
+                end
             end
 
             -- 4. Cleanup s_server (best-effort, par port).
@@ -4347,6 +5909,64 @@ do
                 or e:find("deep", 1, true) ~= nil))
     end
 
+    -- ----- transport binaire : fidélité des valeurs ---------------
+
+    do
+        local bin = "a\0b\255\254" .. string.rep("\1", 300)
+        local w = W.spawn([[
+            local a = worker.args
+            return {
+                int_type = math.type(a.i),
+                float_type = math.type(a.f),
+                bin = a.bin,
+                seq = a.mixed[1] .. a.mixed[2],
+                name = a.mixed.name,
+                sparse = a.sparse[1000],
+                bool_key = a.keys[true],
+                float_key = a.keys[1.5],
+                nan = a.nan ~= a.nan,
+                inf = a.inf == math.huge,
+            }
+        ]], {
+            i = 3, f = 3.0, bin = bin,
+            mixed = { "x", "y", name = "n" },
+            sparse = { [1000] = "far" },
+            keys = { [true] = "t", [1.5] = "f" },
+            nan = 0 / 0, inf = math.huge,
+        })
+        local jok, r = w:join()
+        ok("binary transport: join ok", jok == true and type(r) == "table",
+            "r=" .. tostring(r))
+        r = r or {}
+        ok("binary transport: integer stays integer",
+            r.int_type == "integer", tostring(r.int_type))
+        ok("binary transport: float stays float",
+            r.float_type == "float", tostring(r.float_type))
+        ok("binary transport: binary string round-trips",
+            r.bin == bin)
+        ok("binary transport: mixed table (sequence + keys)",
+            r.seq == "xy" and r.name == "n")
+        ok("binary transport: sparse integer key",
+            r.sparse == "far")
+        ok("binary transport: boolean and float keys",
+            r.bool_key == "t" and r.float_key == "f")
+        ok("binary transport: NaN and Inf", r.nan == true and r.inf == true)
+    end
+
+    do
+        local w = W.spawn("return 2.0, 'ignored'")
+        local _, v = w:join()
+        ok("binary transport: float result stays float",
+            math.type(v) == "float", tostring(v))
+    end
+
+    do
+        local v, e = W.spawn("return 1", { [{}] = 1 })
+        ok_fail("spawn(code, {[table]=1}) -> (nil, err)", v, e)
+        ok("  err mentions 'key'",
+            type(e) == "string" and e:find("key", 1, true) ~= nil)
+    end
+
     -- ----- spawn + join : retours simples -------------------------
 
     do
@@ -4944,6 +6564,718 @@ do
         w1:join()
         w2:join()
     end
+
+    -- ----- buffers partagés -------------------------------------
+    ok("workers.buffer is a function", type(W.buffer) == "function")
+    ok("buffer(-1) raises",
+        pcall(function() return W.buffer(-1) end) == false)
+    ok("buffer({}) raises",
+        pcall(function() return W.buffer({}) end) == false)
+
+    do
+        local b = W.buffer(8)
+        ok("buffer(8): size 8, zero-filled",
+            b:size() == 8 and #b == 8 and b:tostring() == string.rep("\0", 8))
+        ok("buf:write(3, 'ab') -> (true, nil)", b:write(3, "ab") == true)
+        ok("buf:tostring() reflects write",
+            b:tostring() == "\0\0ab\0\0\0\0")
+        ok("buf:tostring(3, 4) == 'ab'", b:tostring(3, 4) == "ab")
+        ok("buf:write hors bornes raises",
+            pcall(function() b:write(8, "xy") end) == false)
+        ok("buf:frozen() == false", b:frozen() == false)
+        ok("buf:freeze() -> (true, nil)", b:freeze() == true)
+        ok("buf:write sur buffer gelé raises",
+            pcall(function() b:write(1, "x") end) == false)
+        ok("tostring(buf) starts with 'WorkerBuffer'",
+            tostring(b):find("WorkerBuffer", 1, true) == 1)
+    end
+
+    do
+        local b = W.buffer("hello world")
+        local s = b:slice(7)
+        ok("buf:slice(7) -> vue 'world'",
+            s:size() == 5 and s:tostring() == "world")
+        ok("buf:slice(-5, -2) -> 'worl'", b:slice(-5, -2):tostring() == "worl")
+        ok("slice d'une slice", s:slice(2, 3):tostring() == "or")
+        b:write(1, "J")
+        ok("la slice partage les octets du bloc",
+            b:slice(1, 5):tostring() == "Jello")
+        ok("slice vide hors bornes", b:slice(20):size() == 0)
+    end
+
+    do
+        -- Envoi par référence : le worker lit des slices disjointes.
+        local data = string.rep("abcd", 1024) .. "\0\255"
+        local b = W.buffer(data)
+        local w = W.spawn([[
+            local buf = worker.args.buf
+            local ok, part = worker.recv()
+            return {
+                size = buf:size(),
+                frozen = buf:frozen(),
+                head = buf:tostring(1, 4),
+                tail = buf:tostring(-2),
+                part = part:tostring(),
+                is_buf = tostring(part):find("WorkerBuffer", 1, true) == 1,
+                back = buf:slice(5, 8),
+            }
+        ]], { buf = b })
+        w:send(b:slice(2, 3))
+        local jok, r = w:join()
+        ok("buffer envoyé au worker : join ok",
+            jok == true and type(r) == "table", tostring(r))
+        r = r or {}
+        ok("worker voit la taille et les octets du buffer",
+            r.size == #data and r.head == "abcd" and r.tail == "\0\255")
+        ok("buffer gelé automatiquement à l'envoi",
+            r.frozen == true and b:frozen() == true)
+        ok("slice envoyée via send()", r.is_buf and r.part == "bc")
+        ok("buffer renvoyé en résultat",
+            r.back ~= nil and r.back:tostring() == "abcd")
+    end
+
+    -- ----- channels autonomes -----------------------------------
+    ok("workers.channel is a function", type(W.channel) == "function")
+    ok("workers.select is a function", type(W.select) == "function")
+    ok("channel(0) raises",
+        pcall(function() return W.channel(0) end) == false)
+    ok("select({}) raises",
+        pcall(function() return W.select({}) end) == false)
+    ok("select({42}) raises",
+        pcall(function() return W.select({ 42 }) end) == false)
+
+    do
+        local ch = W.channel(2)
+        ok("channel:send -> (true, nil)", ch:send("a") == true)
+        ch:send({ n = 1 })
+        local fok, freason = ch:send("c", 0)
+        ok("channel plein + send(v, 0) -> (false, 'full')",
+            fok == false and freason == "full")
+        local r1ok, r1 = ch:recv()
+        local _, r2 = ch:try_recv()
+        ok("channel FIFO: recv 'a' puis {n=1}",
+            r1ok == true and r1 == "a" and type(r2) == "table" and r2.n == 1)
+        local eok, ereason = ch:try_recv()
+        ok("try_recv sur channel vide -> (false, 'empty')",
+            eok == false and ereason == "empty")
+        local tok, treason = ch:recv(0.05)
+        ok("recv(0.05) sur channel vide -> (false, 'timeout')",
+            tok == false and treason == "timeout")
+        ok("channel:close() -> (true, nil)", ch:close() == true)
+        local cok, creason = ch:send("x")
+        ok("send après close -> (false, 'closed')",
+            cok == false and creason == "closed")
+        ok("tostring(channel) starts with 'WorkerChannel'",
+            tostring(ch):find("WorkerChannel", 1, true) == 1)
+    end
+
+    do
+        -- Pipeline : 2 producteurs -> stage -> parent, sans relais.
+        local src, dst = W.channel(8), W.channel(8)
+        local producers = {}
+        for p = 1, 2 do
+            producers[p] = W.spawn([[
+                local a = worker.args
+                for i = 1, 50 do a.out:send(a.id * 1000 + i) end
+                return true
+            ]], { out = src, id = p })
+        end
+        local stage = W.spawn([[
+            local a = worker.args
+            while true do
+                local ok, v = a.inp:recv()
+                if not ok then break end
+                a.out:send(v * 2)
+            end
+            a.out:close()
+            return true
+        ]], { inp = src, out = dst })
+
+        local sum, count = 0, 0
+        while true do
+            local ok, v = dst:recv(5)
+            if not ok then break end
+            sum = sum + v
+            count = count + 1
+            if count == 100 then
+                for _, w in ipairs(producers) do w:join() end
+                src:close()
+            end
+        end
+        stage:join()
+        local expected = 0
+        for p = 1, 2 do
+            for i = 1, 50 do expected = expected + 2 * (p * 1000 + i) end
+        end
+        ok("pipeline multi-producteurs via channels: 100 messages",
+            count == 100, "count=" .. count)
+        ok("pipeline multi-producteurs via channels: somme correcte",
+            sum == expected, "sum=" .. sum .. " expected=" .. expected)
+    end
+
+    do
+        local a, b = W.channel(), W.channel()
+        local eok, ereason = W.select({ a, b }, 0)
+        ok("select(…, 0) sans message -> (false, 'empty')",
+            eok == false and ereason == "empty")
+        b:send("from-b")
+        local sok, idx, v = W.select({ a, b })
+        ok("select -> (true, 2, 'from-b')",
+            sok == true and idx == 2 and v == "from-b")
+
+        local w = W.spawn([[
+            babet.sleep(50, "ms")
+            worker.args.ch:send("late")
+        ]], { ch = a })
+        local lok, lidx, lv = W.select({ a, b }, 5)
+        ok("select bloquant réveillé par un worker",
+            lok == true and lidx == 1 and lv == "late")
+        w:join()
+
+        local tok, treason = W.select({ a, b }, 0.05)
+        ok("select(…, 0.05) -> (false, 'timeout')",
+            tok == false and treason == "timeout")
+        a:close()
+        b:close()
+        local cok, creason = W.select({ a, b })
+        ok("select sur channels tous fermés -> (false, 'closed')",
+            cok == false and creason == "closed")
+    end
+
+    -- ----- pool : contrat de base + mauvais usage ---------------
+    ok("workers.pool is a function", type(W.pool) == "function")
+    ok("pool(0) raises",
+        pcall(function() return W.pool(0) end) == false)
+    ok("pool('x') raises",
+        pcall(function() return W.pool("x") end) == false)
+    ok("pool(1, {}) raises (init_code not a string)",
+        pcall(function() return W.pool(1, {}) end) == false)
+
+    -- ----- pool : init_code en erreur -> (nil, err) -------------
+    do
+        local p, e = W.pool(2, "error('boom')")
+        ok_fail("pool(2, bad init) -> (nil, err)", p, e)
+        ok("  err mentions 'boom'",
+            type(e) == "string" and e:find("boom", 1, true) ~= nil,
+            "err=" .. tostring(e))
+    end
+
+    -- ----- pool : submit code + fonction nommée -----------------
+    do
+        local p = W.pool(2, [[
+            function square(x) return x * x end
+            lib = { add = function(t) return t.a + t.b end }
+        ]])
+        ok("pool(2, init) -> userdata", p ~= nil, tostring(p))
+        ok("pool:size() == 2", p and p:size() == 2)
+        ok("tostring(pool) starts with 'WorkerPool'",
+            p and tostring(p):find("WorkerPool", 1, true) == 1)
+
+        local f1 = p:submit("return (...).n * 2", { n = 21 })
+        local j1ok, j1 = f1:join()
+        ok("submit(code, args) -> join (true, 42)",
+            j1ok == true and j1 == 42,
+            "got=(" .. tostring(j1ok) .. "," .. tostring(j1) .. ")")
+
+        local f2 = p:submit("square", 7)
+        local _, j2 = f2:join()
+        ok("submit('square', 7) -> 49", j2 == 49, "got=" .. tostring(j2))
+
+        local f3 = p:submit("lib.add", { a = 1, b = 2 })
+        local _, j3 = f3:join(5)
+        ok("submit('lib.add', {a,b}) -> 3", j3 == 3, "got=" .. tostring(j3))
+
+        local f4 = p:submit("return worker.args.x", { x = "hi" })
+        local _, j4 = f4:join()
+        ok("worker.args visible dans une tâche", j4 == "hi",
+            "got=" .. tostring(j4))
+
+        local jok, jerr = f4:join()
+        ok("future:join() 2 fois -> (false, 'already consumed')",
+            jok == false and type(jerr) == "string"
+            and jerr:find("already consumed", 1, true) ~= nil)
+
+        local f5 = p:submit("nope")
+        local e5ok, e5 = f5:join()
+        ok("submit('nope') (fonction absente) -> (false, err)",
+            e5ok == false and type(e5) == "string"
+            and e5:find("not a function", 1, true) ~= nil,
+            "err=" .. tostring(e5))
+
+        local f6 = p:submit("error('task-fail')")
+        local e6ok, e6 = f6:join()
+        ok("tâche en erreur -> (false, err)",
+            e6ok == false and type(e6) == "string"
+            and e6:find("task-fail", 1, true) ~= nil)
+
+        local v7, e7 = p:submit("return 1", function() end)
+        ok_fail("submit(code, function) -> (nil, err)", v7, e7)
+
+        -- Beaucoup de petites tâches : même code, états réutilisés.
+        local futures = {}
+        for i = 1, 200 do
+            futures[i] = p:submit("return (...) + 1", i)
+        end
+        local all_ok = true
+        for i = 1, 200 do
+            local fok, fv = futures[i]:join()
+            if not (fok and fv == i + 1) then all_ok = false end
+        end
+        ok("200 tâches soumises -> résultats corrects", all_ok)
+
+        local big = W.buffer(string.rep("x", 1000))
+        local _, bsz = p:submit("return (...):size()", big:slice(1, 100)):join()
+        ok("submit(code, buffer:slice) -> buffer reçu par référence",
+            bsz == 100, "size=" .. tostring(bsz))
+
+        -- poll : "running" puis "done".
+        local f8 = p:submit("local t = os.clock() + 0.05 "
+            .. "while os.clock() < t do end return 'late'")
+        local st, pv
+        for _ = 1, 200 do
+            st, pv = f8:poll()
+            if st ~= "running" then break end
+            babet.sleep(10, "ms")
+        end
+        ok("future:poll() -> ('done', value)",
+            st == "done" and pv == "late",
+            "st=" .. tostring(st) .. " v=" .. tostring(pv))
+
+        local f9 = p:submit("local t = os.clock() + 0.3 "
+            .. "while os.clock() < t do end return 1")
+        local tok, terr = f9:join(0)
+        ok("future:join(0) sur tâche en cours -> (false, 'timeout')",
+            tok == false and terr == "timeout")
+
+        local st0 = p:stats()
+        ok("pool:stats() -> table avec threads[2]",
+            type(st0) == "table" and type(st0.threads) == "table"
+            and #st0.threads == 2)
+        ok("pool:stats().tasks compte les tâches exécutées",
+            type(st0.tasks) == "number" and st0.tasks >= 200,
+            "tasks=" .. tostring(st0.tasks))
+        ok("pool:stats() threads[i] a tasks/steals/idle/queued",
+            type(st0.threads[1].tasks) == "number"
+            and type(st0.threads[1].steals) == "number"
+            and type(st0.threads[1].idle) == "number"
+            and type(st0.threads[1].queued) == "number")
+
+        ok("pool:close() -> (true, nil)", p:close() == true)
+        local f9ok, f9v = f9:join()
+        ok("tâche soumise avant close() terminée",
+            f9ok == true and f9v == 1)
+        ok("pool:size() == 0 après close", p:size() == 0)
+        local v10, e10 = p:submit("return 1")
+        ok_fail("submit après close -> (nil, err)", v10, e10)
+    end
+
+    -- ----- pool : vol de tâches sur un lot inégal ---------------
+    do
+        local p = W.pool(2)
+        -- Round-robin : la tâche lente et la moitié des courtes vont
+        -- au thread 1 ; le thread 2 doit venir voler les courtes.
+        local futures = { p:submit("babet.sleep(300, 'ms') return 0") }
+        for i = 1, 20 do
+            futures[#futures + 1] = p:submit("return (...)", i)
+        end
+        for _, f in ipairs(futures) do f:join() end
+        local st = p:stats()
+        ok("work stealing: steals > 0 sur lot inégal",
+            st.steals > 0, "steals=" .. tostring(st.steals))
+        ok("work stealing: 21 tâches comptées", st.tasks == 21,
+            "tasks=" .. tostring(st.tasks))
+        ok("work stealing: idle > 0 (thread 2 a attendu)",
+            st.idle > 0, "idle=" .. tostring(st.idle))
+        p:close()
+    end
+
+    -- ----- pool : métaméthodes hostiles dans l'état chaud ---------
+    -- worker.args et la résolution "mod.fn" passent en mode protégé :
+    -- une métaméthode qui lève donne une tâche en erreur, pas un
+    -- abort() du process.
+    do
+        local p = W.pool(1, [[
+            setmetatable(worker, { __newindex = function()
+                error("no args here")
+            end })
+        ]])
+        local hok, herr = p:submit("return 1", 1):join()
+        ok("pool: worker.__newindex qui lève -> (false, err)",
+            hok == false and type(herr) == "string"
+            and herr:find("no args here", 1, true) ~= nil,
+            "err=" .. tostring(herr))
+        hok, herr = p:submit("return 2"):join()
+        ok("pool: le thread survit et sert la tâche suivante",
+            hok == false and herr:find("no args here", 1, true) ~= nil)
+        p:close()
+    end
+
+    -- ----- send_many / recv_many (anneau SPSC) -----------------
+    do
+        local w = W.spawn([[
+            local total, batches = 0, 0
+            while true do
+                local ok, items = worker.recv_many(16)
+                if not ok then break end
+                batches = batches + 1
+                for _, v in ipairs(items) do total = total + v end
+            end
+            local sent_ok, n = worker.send_many({ "x", "y", "z" })
+            return { total = total, batches = batches,
+                     sent_ok = sent_ok, n = n }
+        ]], nil, { inbox_capacity = 8 })
+
+        local list = {}
+        for i = 1, 100 do list[i] = i end
+        local sok, sn = w:send_many(list)
+        ok("w:send_many(100 items, inbox 8) -> (true, 100)",
+            sok == true and sn == 100,
+            "got=(" .. tostring(sok) .. "," .. tostring(sn) .. ")")
+        w:close()
+
+        local jok, jval = w:join()
+        ok("worker.recv_many: somme des 100 items reçue",
+            jok == true and jval.total == 5050,
+            "total=" .. tostring(jval and jval.total))
+        ok("worker.recv_many: lots de 16 au plus",
+            jok == true and jval.batches >= 7)
+        ok("worker.send_many -> (true, 3)",
+            jok == true and jval.sent_ok == true and jval.n == 3)
+
+        local rok, items = w:recv_many(2, 0)
+        ok("w:recv_many(2, 0) -> 2 premiers messages",
+            rok == true and #items == 2
+            and items[1] == "x" and items[2] == "y")
+        rok, items = w:recv_many()
+        ok("w:recv_many() -> reste du lot", rok == true
+            and #items == 1 and items[1] == "z")
+        local eok, eerr = w:recv_many(nil, 0)
+        ok("w:recv_many() drainé -> (false, 'closed')",
+            eok == false and eerr == "closed")
+    end
+
+    -- ----- recv_many : un message indécodable ne perd pas le lot --
+    -- Le décodage échoue quand la pile Lua qui reçoit est pleine : on
+    -- cherche le plus grand nombre d'arguments qui laisse encore
+    -- entrer dans recv_many (LUA_MINSTACK de marge), puis on reçoit
+    -- un lot dont le message du milieu est trop imbriqué pour cette
+    -- marge. Les deux autres doivent revenir.
+    do
+        local filler = {}
+        for i = 1, 1100000 do filler[i] = false end
+        local function call(w, n)
+            return w:recv_many(8, 0, table.unpack(filler, 1, n))
+        end
+
+        local empty = W.spawn("return 0")
+        empty:join()
+        local lo, hi = 0, #filler
+        if pcall(call, empty, hi) then
+            lo = nil -- pile plus grande que prévu : cas non atteignable
+        else
+            while hi - lo > 1 do
+                local mid = (lo + hi) // 2
+                if pcall(call, empty, mid) then lo = mid else hi = mid end
+            end
+        end
+
+        local w = W.spawn([[
+            local deep = {}
+            local cur = deep
+            for _ = 1, 30 do cur.x = {} ; cur = cur.x end
+            worker.send_many({ "a", deep, "c" })
+            return 0
+        ]])
+        w:join()
+        if lo == nil then
+            print("[INFO] workers: Lua stack too large, recv_many decode "
+                .. "failure case skipped")
+        else
+            local pok, rok, items, rerr = pcall(call, w, lo)
+            ok("recv_many: message indécodable -> (true, reste, err)",
+                pok and rok == true and type(items) == "table"
+                and #items == 2 and items[1] == "a" and items[2] == "c"
+                and type(rerr) == "string"
+                and rerr:find("nested", 1, true) ~= nil,
+                "got=(" .. tostring(pok) .. "," .. tostring(rok) .. ","
+                .. tostring(items and #items) .. "," .. tostring(rerr) .. ")")
+        end
+        local dok, dreason = w:recv_many(8, 0)
+        ok("recv_many: lot consommé une seule fois",
+            dok == false and dreason == "closed")
+    end
+
+    -- ----- send_many : plein / fermé / non sérialisable ---------
+    do
+        local w = W.spawn([[
+            return 0
+        ]], nil, { inbox_capacity = 2 })
+        w:join()
+        local v, e = w:send_many({ 1, function() end })
+        ok_fail("w:send_many(function) -> (nil, err)", v, e)
+
+        local w2 = W.spawn([[
+            worker.recv()
+            return 0
+        ]], nil, { inbox_capacity = 2 })
+        babet.sleep(50, "ms")
+        -- Le worker consomme au plus un message : 1 + 2 en file.
+        local fok, freason, fsent = w2:send_many({ 1, 2, 3, 4, 5 }, 0.1)
+        ok("w:send_many sur inbox pleine -> (false, reason, sent)",
+            fok == false and (freason == "timeout" or freason == "closed")
+            and fsent >= 2 and fsent <= 3,
+            "got=(" .. tostring(fok) .. "," .. tostring(freason)
+            .. "," .. tostring(fsent) .. ")")
+        w2:join()
+        local cok, creason, csent = w2:send_many({ 1 })
+        ok("w:send_many après fin du worker -> 'closed', 0 envoyé",
+            cok == false and creason == "closed" and csent == 0)
+        ok("w:recv_many(0) -> luaL_error",
+            not pcall(w2.recv_many, w2, 0))
+    end
+
+    -- ----- workers.map : ordre, trous, streaming ----------------
+    do
+        local items = {}
+        for i = 1, 200 do items[i] = i end
+        local mok, res = W.map(items, "local x, i = ... return x * x + i",
+            { concurrency = 4, chunk = 7 })
+        local good = mok == true and #res == 200
+        for i = 1, 200 do
+            if res[i] ~= i * i + i then good = false end
+        end
+        ok("workers.map: 200 résultats dans l'ordre", good)
+
+        local seen = {}
+        local sok, sn = W.map(items, "babet.sleep(((...) % 3) * 2, 'ms') return ...",
+            { concurrency = 3, chunk = 5,
+              on_result = function(i, v) seen[#seen + 1] = i end })
+        local ordered = sok == true and sn == 200 and #seen == 200
+        for i = 1, #seen do
+            if seen[i] ~= i then ordered = false end
+        end
+        ok("workers.map on_result: appelé dans l'ordre des entrées", ordered)
+
+        local hok, holes = W.map({ 1, 2, 3 },
+            "local x = ... if x == 2 then return nil end return x",
+            { concurrency = 2, chunk = 1 })
+        ok("workers.map: résultat nil -> trou à la même position",
+            hok == true and holes[1] == 1 and holes[2] == nil
+            and holes[3] == 3)
+
+        local eok, eres = W.map({}, "return ...")
+        ok("workers.map({}) -> (true, {})",
+            eok == true and type(eres) == "table" and #eres == 0)
+
+        local fok, ferr = W.map({ 1, 2, 3 },
+            "if ... == 2 then error('boom') end return ...",
+            { concurrency = 2, chunk = 1 })
+        ok("workers.map: erreur d'élément -> (false, 'item 2: ...')",
+            fok == false and type(ferr) == "string"
+            and ferr:find("item 2", 1, true) ~= nil
+            and ferr:find("boom", 1, true) ~= nil,
+            "err=" .. tostring(ferr))
+
+        local cb_ok = pcall(W.map, { 1, 2 }, "return ...",
+            { on_result = function() error("cb boom") end })
+        ok("workers.map: erreur de on_result propagée", cb_ok == false)
+
+        ok("workers.map: opts.chunk = 0 -> luaL_error",
+            not pcall(W.map, { 1 }, "return ...", { chunk = 0 }))
+    end
+
+    -- ----- workers.map sur un pool existant ----------------------
+    do
+        local p = W.pool(2, "function twice(x) return 2 * x end")
+        local mok, res = W.map({ 5, 6, 7 }, "twice", { pool = p })
+        ok("workers.map(opts.pool, nom de fonction)",
+            mok == true and res[1] == 10 and res[2] == 12 and res[3] == 14)
+        ok("workers.map: le pool fourni reste ouvert", p:size() == 2)
+        p:close()
+        local cok, cerr = W.map({ 1 }, "twice", { pool = p })
+        ok("workers.map sur pool fermé -> (false, err)",
+            cok == false and type(cerr) == "string")
+    end
+
+    -- ----- workers.reduce ---------------------------------------
+    do
+        local items = {}
+        for i = 1, 1000 do items[i] = i end
+        local rok, sum = W.reduce(items, "local a, b = ... return a + b",
+            { concurrency = 4, chunk = 10 })
+        ok("workers.reduce: somme 1..1000", rok == true and sum == 500500,
+            "sum=" .. tostring(sum))
+
+        local cok, cat = W.reduce({ "b", "c", "d" },
+            "local a, b = ... return a .. b",
+            { init = "a", concurrency = 2, chunk = 2 })
+        ok("workers.reduce: ordre gardé (concat, init)",
+            cok == true and cat == "abcd", "cat=" .. tostring(cat))
+
+        local eok, ev = W.reduce({}, "local a, b = ... return a + b")
+        ok("workers.reduce({}) -> (true, nil)", eok == true and ev == nil)
+        local iok, iv = W.reduce({}, "local a, b = ... return a + b",
+            { init = 42 })
+        ok("workers.reduce({}, init) -> (true, init)",
+            iok == true and iv == 42)
+    end
+
+    -- ----- workers.share : snapshot en lecture seule -------------
+    do
+        local src = {
+            name = "ref", 10, 20, 30,
+            nested = { deep = { x = 1.5 } },
+            [true] = "yes", [2.5] = "float", [100] = "sparse",
+        }
+        src.self = src -- cycle : figé une seule fois
+        local sh, serr = W.share(src)
+        ok("workers.share(tbl) -> userdata", type(sh) == "userdata",
+            "err=" .. tostring(serr))
+        ok("shared: clés string / séquence / scalaires",
+            sh.name == "ref" and sh[1] == 10 and sh[3] == 30
+            and sh[true] == "yes" and sh[2.5] == "float"
+            and sh[100] == "sparse" and sh.missing == nil)
+        ok("shared: #t == 3 et t[2.0] == t[2]", #sh == 3 and sh[2.0] == 20)
+        ok("shared: sous-tables et cycle",
+            sh.nested.deep.x == 1.5 and sh.self.self.name == "ref")
+
+        local n = 0
+        for _ in pairs(sh) do n = n + 1 end
+        ok("shared: pairs voit toutes les entrées", n == 9, "n=" .. n)
+        local seq = {}
+        for i, v in ipairs(sh) do seq[i] = v end
+        ok("shared: ipairs", #seq == 3 and seq[2] == 20)
+
+        ok("shared: écriture -> erreur",
+            not pcall(function() sh.name = "x" end))
+        src.name = "changed"
+        ok("shared: snapshot indépendant de la source", sh.name == "ref")
+
+        local v, e = W.share({ f = function() end })
+        ok_fail("workers.share({function}) -> (nil, err)", v, e)
+
+        -- Transfert par référence : args, send, résultat.
+        local w = W.spawn([[
+            local sh = worker.args.sh
+            local ok, again = worker.recv()
+            return { name = sh.name, deep = sh.nested.deep.x,
+                     same = again.name, back = sh.nested }
+        ]], { sh = sh })
+        w:send(sh)
+        local jok, jval = w:join()
+        ok("shared: lu depuis un worker (args + send)",
+            jok == true and jval.name == "ref" and jval.deep == 1.5
+            and jval.same == "ref", "jval=" .. tostring(jval))
+        ok("shared: sous-table renvoyée au parent reste partagée",
+            jok == true and type(jval.back) == "userdata"
+            and jval.back.deep.x == 1.5)
+
+        local big = {}
+        for i = 1, 5000 do big["k" .. i] = i end
+        local bsh = W.share(big)
+        local p = W.pool(2)
+        local f = p:submit("local t = ... return t.k1 + t.k5000", bsh)
+        local fok, fv = f:join()
+        ok("shared: lookup depuis une tâche de pool",
+            fok == true and fv == 5001)
+        p:close()
+    end
+
+    -- ----- cpu_count / opts cpu, nice, stack_size ---------------
+    do
+        local n = W.cpu_count()
+        ok("workers.cpu_count() -> entier >= 1",
+            math.type(n) == "integer" and n >= 1, "n=" .. tostring(n))
+
+        local w = W.spawn("return 40 + 2", nil,
+            { cpu = 0, nice = 5, stack_size = 256 * 1024 })
+        local jok, jv = w:join()
+        ok("spawn opts cpu/nice/stack_size -> worker OK",
+            jok == true and jv == 42, "jv=" .. tostring(jv))
+
+        local p = W.pool(2, { cpu = { 0 }, nice = 3 })
+        local f = p:submit("return worker.id")
+        local fok = f:join()
+        ok("pool(n, opts) : threads démarrés avec les opts",
+            p ~= nil and fok == true)
+        p:close()
+
+        ok("spawn opts.nice = 42 -> luaL_error",
+            not pcall(W.spawn, "return 1", nil, { nice = 42 }))
+        ok("spawn opts.cpu = -1 -> luaL_error",
+            not pcall(W.spawn, "return 1", nil, { cpu = -1 }))
+        ok("pool opts.stack_size trop petit -> luaL_error",
+            not pcall(W.pool, 1, nil, { stack_size = 1024 }))
+
+        local mok, res = W.map({ 1, 2, 3 }, "return (...) + 1",
+            { concurrency = 2, cpu = { 0 } })
+        ok("workers.map accepte opts.cpu", mok == true and res[3] == 4)
+    end
+
+    -- ----- w:cancel() / opts.deadline ----------------------------
+    do
+        -- Boucle Lua pure, sans coopération : interrompue par le hook.
+        local w = W.spawn("while true do end")
+        babet.sleep(50, "ms")
+        ok("w:cancel() -> (true, nil)", w:cancel() == true)
+        local jok, jerr = w:join()
+        ok("boucle infinie + cancel -> join (false, 'cancelled')",
+            jok == false and jerr == "cancelled",
+            "got=(" .. tostring(jok) .. "," .. tostring(jerr) .. ")")
+
+        -- pcall du code utilisateur : l'annulation est relevée quand même.
+        local w2 = W.spawn([[
+            while true do pcall(function() for i = 1, 1e9 do end end) end
+        ]])
+        babet.sleep(50, "ms")
+        w2:cancel()
+        local j2ok, j2err = w2:join()
+        ok("cancel traverse un pcall utilisateur",
+            j2ok == false and j2err == "cancelled")
+
+        -- Coopératif : worker.cancelled() + recv débloqué.
+        local w3 = W.spawn([[
+            local ok, reason = worker.recv()
+            return { cancelled = worker.cancelled(), reason = reason }
+        ]])
+        babet.sleep(50, "ms")
+        w3:cancel()
+        local j3ok, j3 = w3:join()
+        ok("worker.cancelled() + recv 'closed' après cancel",
+            (j3ok == true and j3.cancelled == true and j3.reason == "closed")
+            or (j3ok == false and j3 == "cancelled"))
+
+        local t0 = babet.monotonic()
+        local w4 = W.spawn("while true do end", nil, { deadline = 0.1 })
+        local j4ok, j4err = w4:join()
+        local dt = babet.monotonic() - t0
+        ok("opts.deadline -> join (false, 'deadline')",
+            j4ok == false and j4err == "deadline",
+            "got=(" .. tostring(j4ok) .. "," .. tostring(j4err) .. ")")
+        ok("opts.deadline respectée (< 1 s)", dt < 1.0, "dt=" .. dt)
+
+        local w5 = W.spawn([[
+            local ok, r = worker.recv()
+            return r
+        ]], nil, { deadline = 0.1 })
+        local j5ok, j5 = w5:join()
+        ok("opts.deadline borne un worker.recv() bloquant",
+            (j5ok == false and j5 == "deadline")
+            or (j5ok == true and j5 == "timeout"),
+            "got=(" .. tostring(j5ok) .. "," .. tostring(j5) .. ")")
+
+        local w6 = W.spawn("return 7")
+        w6:join()
+        ok("cancel après fin : sans effet", w6:cancel() == true)
+
+        ok("opts.deadline = 0 -> luaL_error",
+            not pcall(W.spawn, "return 1", nil, { deadline = 0 }))
+
+        local w7 = W.spawn("return 8", nil, { deadline = 1e300 })
+        local j7ok, j7 = w7:join()
+        ok("opts.deadline énorme -> pas de deadline", j7ok == true and j7 == 8,
+            "got=(" .. tostring(j7ok) .. "," .. tostring(j7) .. ")")
+    end
 end
 
 -- =====================================================================
@@ -7,15 +7,42 @@
 
 #include "http.hpp"
 #include "lua_utils.hpp"
+#include "signal.hpp"
+#include "workers.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
 #include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <ctime>
+#include <deque>
 #include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <random>
 #include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 namespace
 {
 
@@ -236,33 +263,220 @@ namespace
         return true;
     }
 
-    // Empile (result, nil). Pile inchangée par ailleurs.
-    int push_response(lua_State *L, const httplib::Result &res)
+    // Issue d'une requête, sans état Lua : remplie par perform(),
+    // éventuellement sur un thread natif (fetch_all), puis convertie
+    // par push_outcome sur le thread Lua.
+    struct HttpOutcome
+    {
+        bool failed = false;
+        std::string err; // "http: ..." si failed
+        int status = 0;
+        httplib::Headers headers;
+        std::string body;
+        bool streamed = false; // corps livré à un sink : seul bytes
+        uint64_t bytes = 0;
+    };
+
+    // Table result { status, body | bytes, headers }.
+    void push_result_table(lua_State *L, const HttpOutcome &out)
     {
         lua_newtable(L);
 
-        lua_pushinteger(L, res->status);
+        lua_pushinteger(L, out.status);
         lua_setfield(L, -2, "status");
 
-        // Binaire-safe : le corps peut contenir des octets nuls.
-        lua_pushlstring(L, res->body.data(), res->body.size());
-        lua_setfield(L, -2, "body");
+        if (!out.streamed)
+        {
+            // Binaire-safe : le corps peut contenir des octets nuls.
+            lua_pushlstring(L, out.body.data(), out.body.size());
+            lua_setfield(L, -2, "body");
+        }
+        else
+        {
+            lua_pushinteger(L, static_cast<lua_Integer>(out.bytes));
+            lua_setfield(L, -2, "bytes");
+        }
 
         lua_newtable(L);
-        for (const auto &h : res->headers)
+        for (const auto &h : out.headers)
         {
             std::string key = to_lower(h.first); // dernière valeur gagne
             lua_pushlstring(L, h.second.data(), h.second.size());
             lua_setfield(L, -2, key.c_str());
         }
         lua_setfield(L, -2, "headers");
+    }
 
+    // Empile (result, nil) ou (nil, err). Pile inchangée par ailleurs.
+    int push_outcome(lua_State *L, const HttpOutcome &out)
+    {
+        if (out.failed)
+        {
+            return push_fail(L, out.err);
+        }
+        push_result_table(L, out);
         lua_pushnil(L);
         return 2;
     }
 
-    // Cœur partagé. `opts_idx` = table d'options sur la pile.
-    int http_perform(lua_State *L, int opts_idx)
+    // Requête validée, indépendante du Client qui l'exécute : un
+    // Client jetable (request/get/post) ou un Client emprunté au pool
+    // d'une session. Un seul chemin de parsing pour les deux.
+    // opts.sink : corps livré hors de result.body.
+    enum
+    {
+        SINK_NONE = 0,
+        SINK_FILE,     // chemin : écrit dans un fichier
+        SINK_FUNCTION, // callback Lua appelé par morceau
+    };
+
+    // Origine du corps de requête.
+    enum
+    {
+        BODY_NONE = 0,
+        BODY_STRING,    // opts.body string : en mémoire, tel quel
+        BODY_FUNCTION,  // opts.body fonction : morceaux, chunked
+        BODY_FILE,      // opts.body_file : lu par tranches
+        BODY_MULTIPART, // opts.multipart : multipart/form-data
+    };
+
+    // Une partie de opts.multipart : `data` en mémoire, ou `file`
+    // lu à l'envoi.
+    struct FormPart
+    {
+        std::string name;
+        std::string data;
+        std::string file;
+        bool is_file = false;
+        std::string filename;
+        bool has_filename = false;
+        std::string content_type;
+    };
+
+    struct HttpRequest
+    {
+        UrlParts parts;
+        std::string method = "GET";
+        std::string body;
+        bool has_body = false; // vrai pour TOUT body_kind != BODY_NONE
+        int body_kind = BODY_NONE;
+        std::string body_file;
+        std::vector<FormPart> form;
+        bool has_timeout = false;
+        double timeout_s = 0.0;
+        bool verify = true;
+        std::string ca_cert;
+        bool has_ca = false;
+        bool follow = false;
+        int sink = 0; // SINK_*
+        std::string sink_path;
+        uint64_t max_body = 0; // 0 = pas de plafond
+        std::vector<std::pair<std::string, std::string>> hdrs;
+        std::string content_type;
+        bool has_ct = false;
+    };
+
+    // Lit un champ string optionnel d'une table de partie multipart.
+    // false si présent mais pas string.
+    bool part_string(lua_State *L, int idx, const char *field,
+                     std::string &out, bool &present)
+    {
+        lua_getfield(L, idx, field);
+        present = !lua_isnil(L, -1);
+        if (present && lua_type(L, -1) != LUA_TSTRING)
+        {
+            lua_pop(L, 1);
+            return false;
+        }
+        if (present)
+        {
+            size_t len = 0;
+            const char *v = lua_tolstring(L, -1, &len);
+            out.assign(v, len);
+        }
+        lua_pop(L, 1);
+        return true;
+    }
+
+    // opts.multipart = { { name=, data= | file=, filename=?,
+    // content_type=? }, ... } : liste ordonnée, l'ordre d'envoi est
+    // celui du tableau.
+    bool parse_multipart(lua_State *L, int idx, std::vector<FormPart> &form,
+                         std::string &err)
+    {
+        lua_Unsigned n = lua_rawlen(L, idx);
+        if (n == 0)
+        {
+            err = "http: multipart must not be empty";
+            return false;
+        }
+        for (lua_Unsigned i = 1; i <= n; ++i)
+        {
+            std::string where = "http: multipart part " + std::to_string(i);
+            lua_rawgeti(L, idx, static_cast<lua_Integer>(i));
+            if (lua_type(L, -1) != LUA_TTABLE)
+            {
+                lua_pop(L, 1);
+                err = where + " must be a table";
+                return false;
+            }
+            int pidx = lua_gettop(L);
+            FormPart part;
+            bool has_name = false;
+            bool has_data = false;
+            bool has_ct = false;
+            if (!part_string(L, pidx, "name", part.name, has_name) ||
+                !has_name)
+            {
+                lua_pop(L, 1);
+                err = where + ": 'name' (string) is required";
+                return false;
+            }
+            if (!part_string(L, pidx, "data", part.data, has_data) ||
+                !part_string(L, pidx, "file", part.file, part.is_file) ||
+                !part_string(L, pidx, "filename", part.filename,
+                             part.has_filename) ||
+                !part_string(L, pidx, "content_type", part.content_type,
+                             has_ct))
+            {
+                lua_pop(L, 1);
+                err = where + ": data, file, filename and content_type "
+                              "must be strings";
+                return false;
+            }
+            lua_pop(L, 1);
+            if (has_data == part.is_file)
+            {
+                err = where + ": exactly one of 'data' or 'file' is required";
+                return false;
+            }
+            if (part.is_file && !part.has_filename)
+            {
+                auto slash = part.file.find_last_of('/');
+                part.filename = (slash == std::string::npos)
+                                    ? part.file
+                                    : part.file.substr(slash + 1);
+                part.has_filename = true;
+            }
+            if (part.content_type.find_first_of("\r\n") != std::string::npos)
+            {
+                err = where + ": content_type must not contain CR/LF";
+                return false;
+            }
+            if (part.is_file && !has_ct)
+            {
+                part.content_type = "application/octet-stream";
+            }
+            form.push_back(std::move(part));
+        }
+        return true;
+    }
+
+    // Lit et valide la table d'options à `opts_idx`. Renvoie false +
+    // remplit `err` sur toute option invalide (l'appelant fait
+    // push_fail) : même découpage (nil, err) qu'avant la session.
+    bool parse_request(lua_State *L, int opts_idx, HttpRequest &rq,
+                       std::string &err)
     {
         opts_idx = lua_absindex(L, opts_idx);
 
@@ -271,23 +485,24 @@ namespace
         if (lua_type(L, -1) != LUA_TSTRING)
         {
             lua_pop(L, 1);
-            return push_fail(L, "http: 'url' (string) is required");
+            err = "http: 'url' (string) is required";
+            return false;
         }
         std::string url = lua_tostring(L, -1);
         lua_pop(L, 1);
 
         // --- method (optionnel, défaut GET) ---------------------------
-        std::string method = "GET";
         lua_getfield(L, opts_idx, "method");
         if (!lua_isnil(L, -1))
         {
             if (lua_type(L, -1) != LUA_TSTRING)
             {
                 lua_pop(L, 1);
-                return push_fail(L, "http: 'method' must be a string");
+                err = "http: 'method' must be a string";
+                return false;
             }
-            method = lua_tostring(L, -1);
-            for (char &c : method)
+            rq.method = lua_tostring(L, -1);
+            for (char &c : rq.method)
             {
                 c = static_cast<char>(
                     std::toupper(static_cast<unsigned char>(c)));
@@ -295,75 +510,169 @@ namespace
         }
         lua_pop(L, 1);
 
-        // --- body (optionnel) -----------------------------------------
-        std::string body;
-        bool has_body = false;
+        // --- body (optionnel : string, ou fonction fournisseuse) ------
         lua_getfield(L, opts_idx, "body");
+        if (lua_type(L, -1) == LUA_TSTRING)
+        {
+            size_t blen = 0;
+            const char *bs = lua_tolstring(L, -1, &blen);
+            rq.body.assign(bs, blen);
+            rq.body_kind = BODY_STRING;
+        }
+        else if (lua_type(L, -1) == LUA_TFUNCTION)
+        {
+            rq.body_kind = BODY_FUNCTION;
+        }
+        else if (!lua_isnil(L, -1))
+        {
+            lua_pop(L, 1);
+            err = "http: 'body' must be a string or a function";
+            return false;
+        }
+        lua_pop(L, 1);
+
+        // --- body_file / multipart (optionnels, exclusifs) ------------
+        lua_getfield(L, opts_idx, "body_file");
         if (!lua_isnil(L, -1))
         {
             if (lua_type(L, -1) != LUA_TSTRING)
             {
                 lua_pop(L, 1);
-                return push_fail(L, "http: 'body' must be a string");
+                err = "http: 'body_file' must be a string";
+                return false;
             }
-            size_t blen = 0;
-            const char *bs = lua_tolstring(L, -1, &blen);
-            body.assign(bs, blen);
-            has_body = true;
+            if (rq.body_kind != BODY_NONE)
+            {
+                lua_pop(L, 1);
+                err = "http: body, body_file and multipart are "
+                      "mutually exclusive";
+                return false;
+            }
+            rq.body_file = lua_tostring(L, -1);
+            rq.body_kind = BODY_FILE;
+        }
+        lua_pop(L, 1);
+
+        lua_getfield(L, opts_idx, "multipart");
+        if (!lua_isnil(L, -1))
+        {
+            if (lua_type(L, -1) != LUA_TTABLE)
+            {
+                lua_pop(L, 1);
+                err = "http: 'multipart' must be a table";
+                return false;
+            }
+            if (rq.body_kind != BODY_NONE)
+            {
+                lua_pop(L, 1);
+                err = "http: body, body_file and multipart are "
+                      "mutually exclusive";
+                return false;
+            }
+            if (!parse_multipart(L, lua_gettop(L), rq.form, err))
+            {
+                lua_pop(L, 1);
+                return false;
+            }
+            rq.body_kind = BODY_MULTIPART;
         }
         lua_pop(L, 1);
+        rq.has_body = (rq.body_kind != BODY_NONE);
 
         // --- timeout (optionnel, secondes > 0) ------------------------
-        bool has_timeout = false;
-        double timeout_s = 0.0;
         lua_getfield(L, opts_idx, "timeout");
         if (!lua_isnil(L, -1))
         {
             if (lua_type(L, -1) != LUA_TNUMBER)
             {
                 lua_pop(L, 1);
-                return push_fail(L, "http: 'timeout' must be a number");
+                err = "http: 'timeout' must be a number";
+                return false;
             }
-            timeout_s = lua_tonumber(L, -1);
-            has_timeout = true;
+            rq.timeout_s = lua_tonumber(L, -1);
+            rq.has_timeout = true;
         }
         lua_pop(L, 1);
-        if (has_timeout && !(timeout_s > 0.0))
+        if (rq.has_timeout && !(rq.timeout_s > 0.0))
         {
-            return push_fail(L, "http: timeout must be > 0");
+            err = "http: timeout must be > 0";
+            return false;
         }
 
         // --- verify (optionnel, défaut true) --------------------------
-        bool verify = true;
         lua_getfield(L, opts_idx, "verify");
         if (!lua_isnil(L, -1))
         {
-            verify = lua_toboolean(L, -1) != 0;
+            rq.verify = lua_toboolean(L, -1) != 0;
         }
         lua_pop(L, 1);
 
         // --- ca_cert (optionnel) --------------------------------------
-        std::string ca_cert;
-        bool has_ca = false;
         lua_getfield(L, opts_idx, "ca_cert");
         if (!lua_isnil(L, -1))
         {
             if (lua_type(L, -1) != LUA_TSTRING)
             {
                 lua_pop(L, 1);
-                return push_fail(L, "http: 'ca_cert' must be a string");
+                err = "http: 'ca_cert' must be a string";
+                return false;
             }
-            ca_cert = lua_tostring(L, -1);
-            has_ca = true;
+            rq.ca_cert = lua_tostring(L, -1);
+            rq.has_ca = true;
         }
         lua_pop(L, 1);
 
         // --- follow_redirects (optionnel, défaut false) ---------------
-        bool follow = false;
         lua_getfield(L, opts_idx, "follow_redirects");
         if (!lua_isnil(L, -1))
         {
-            follow = lua_toboolean(L, -1) != 0;
+            rq.follow = lua_toboolean(L, -1) != 0;
+        }
+        lua_pop(L, 1);
+
+        // --- sink (optionnel : chemin ou fonction) --------------------
+        lua_getfield(L, opts_idx, "sink");
+        if (lua_type(L, -1) == LUA_TSTRING)
+        {
+            rq.sink = SINK_FILE;
+            rq.sink_path = lua_tostring(L, -1);
+            if (rq.sink_path.empty())
+            {
+                lua_pop(L, 1);
+                err = "http: sink path must not be empty";
+                return false;
+            }
+        }
+        else if (lua_type(L, -1) == LUA_TFUNCTION)
+        {
+            rq.sink = SINK_FUNCTION;
+        }
+        else if (!lua_isnil(L, -1))
+        {
+            lua_pop(L, 1);
+            err = "http: 'sink' must be a string or a function";
+            return false;
+        }
+        lua_pop(L, 1);
+
+        // --- max_body (optionnel, octets > 0) -------------------------
+        lua_getfield(L, opts_idx, "max_body");
+        if (!lua_isnil(L, -1))
+        {
+            if (!lua_isinteger(L, -1))
+            {
+                lua_pop(L, 1);
+                err = "http: 'max_body' must be an integer";
+                return false;
+            }
+            lua_Integer mb = lua_tointeger(L, -1);
+            if (mb <= 0)
+            {
+                lua_pop(L, 1);
+                err = "http: max_body must be > 0";
+                return false;
+            }
+            rq.max_body = static_cast<uint64_t>(mb);
         }
         lua_pop(L, 1);
 
@@ -372,16 +681,14 @@ namespace
         // passé via l'argument content_type dédié de httplib (évite un
         // header dupliqué). Pour les méthodes sans corps, tous les
         // headers passent tels quels.
-        std::vector<std::pair<std::string, std::string>> hdrs;
-        std::string content_type;
-        bool has_ct = false;
         lua_getfield(L, opts_idx, "headers");
         if (!lua_isnil(L, -1))
         {
             if (lua_type(L, -1) != LUA_TTABLE)
             {
                 lua_pop(L, 1);
-                return push_fail(L, "http: 'headers' must be a table");
+                err = "http: 'headers' must be a table";
+                return false;
             }
             int hidx = lua_absindex(L, -1);
             lua_pushnil(L);
@@ -389,28 +696,29 @@ namespace
             {
                 if (lua_type(L, -2) != LUA_TSTRING)
                 {
-                    lua_pop(L, 2);
-                    return push_fail(L, "http: header names must be strings");
+                    lua_pop(L, 3);
+                    err = "http: header names must be strings";
+                    return false;
                 }
                 std::string hk = lua_tostring(L, -2);
                 std::string hv;
                 if (!lua_value_to_string(L, -1, hv))
                 {
-                    lua_pop(L, 2);
-                    return push_fail(
-                        L, "http: header values must be strings or numbers");
+                    lua_pop(L, 3);
+                    err = "http: header values must be strings or numbers";
+                    return false;
                 }
                 bool is_body_method =
-                    (method == "POST" || method == "PUT" ||
-                     method == "PATCH" || method == "DELETE");
+                    (rq.method == "POST" || rq.method == "PUT" ||
+                     rq.method == "PATCH" || rq.method == "DELETE");
                 if (is_body_method && to_lower(hk) == "content-type")
                 {
-                    content_type = hv;
-                    has_ct = true;
+                    rq.content_type = hv;
+                    rq.has_ct = true;
                 }
                 else
                 {
-                    hdrs.emplace_back(hk, hv);
+                    rq.hdrs.emplace_back(hk, hv);
                 }
                 lua_pop(L, 1);
             }
@@ -418,11 +726,9 @@ namespace
         lua_pop(L, 1);
 
         // --- url + query ----------------------------------------------
-        UrlParts parts;
-        std::string err;
-        if (!split_url(url, parts, err))
+        if (!split_url(url, rq.parts, err))
         {
-            return push_fail(L, err);
+            return false;
         }
         lua_getfield(L, opts_idx, "query");
         if (!lua_isnil(L, -1))
@@ -430,229 +736,2675 @@ namespace
             if (lua_type(L, -1) != LUA_TTABLE)
             {
                 lua_pop(L, 1);
-                return push_fail(L, "http: 'query' must be a table");
+                err = "http: 'query' must be a table";
+                return false;
             }
-            if (!append_query(L, -1, parts.target, err))
+            if (!append_query(L, -1, rq.parts.target, err))
             {
                 lua_pop(L, 1);
-                return push_fail(L, err);
+                return false;
             }
         }
         lua_pop(L, 1);
 
         // --- méthode autorisée ? --------------------------------------
+        const std::string &method = rq.method;
         if (method != "GET" && method != "HEAD" && method != "OPTIONS" &&
             method != "POST" && method != "PUT" && method != "PATCH" &&
             method != "DELETE")
         {
-            return push_fail(L, "http: unsupported method '" + method + "'");
+            err = "http: unsupported method '" + method + "'";
+            return false;
         }
 
         // Pas de comportement muet : un body sur une méthode sans
         // corps est signalé, pas silencieusement ignoré.
-        if (has_body &&
+        if (rq.has_body &&
             (method == "GET" || method == "HEAD" || method == "OPTIONS"))
         {
-            return push_fail(L,
-                             "http: body not allowed for " + method);
+            err = "http: body not allowed for " + method;
+            return false;
         }
 
-        // --- exécution -------------------------------------------------
-        // try/catch : aucune exception C++ ne doit traverser vers Lua
-        // (invariant de correction). Le ctor Client peut lever, les
-        // appels réseau aussi selon les cas.
-        try
+        if (rq.has_body && !rq.has_ct)
         {
-            httplib::Client cli(parts.origin);
-            cli.set_follow_location(follow);
-            cli.enable_server_certificate_verification(verify);
-            if (has_ca)
-            {
-                cli.set_ca_cert_path(ca_cert);
-            }
-            if (has_timeout)
-            {
-                // Timeout GLOBAL de bout en bout, équivalent --max-time
-                // de curl (cpp-httplib v0.45.0+).
-                double ms = timeout_s * 1000.0;
-                size_t ms_int = (ms < 1.0) ? 1 : static_cast<size_t>(ms);
-                cli.set_max_timeout(ms_int);
+            rq.content_type = "application/octet-stream";
+        }
+        // Le Content-Type multipart porte la boundary : il est imposé
+        // par prepare_body, un Content-Type fourni serait faux.
+        if (rq.body_kind == BODY_MULTIPART)
+        {
+            rq.content_type.clear();
+        }
+        return true;
+    }
 
-                // CORRECTIF (diagnostic terrain Ubuntu) : set_max_timeout
-                // couvre les phases applicatives de cpp-httplib (envoi
-                // requête, réception réponse) mais PAS toujours la phase
-                // connect() qui peut bloquer dans le noyau bien plus
-                // longtemps. Cas reproduit : http://[::1]:1/ sur Ubuntu
-                // avec IPv6 loopback partiellement configuré -> connect()
-                // bloque ~60s+ malgré set_max_timeout(1s).
-                //
-                // Solution belt+suspenders : poser AUSSI un connection
-                // timeout dédié. cpp-httplib v0.45.0 expose
-                // set_connection_timeout(seconds, microseconds).
-                // En cumulé : la première limite atteinte gagne.
-                time_t conn_s = static_cast<time_t>(timeout_s);
-                time_t conn_us =
-                    static_cast<time_t>((timeout_s - conn_s) * 1e6);
-                // Plancher 1 ms : si timeout_s < 0.001, conn_s et
-                // conn_us seraient tous deux à 0 -> connection_timeout
-                // de 0 = pas de timeout, on évite ce piège.
-                if (conn_s == 0 && conn_us < 1000)
-                {
-                    conn_us = 1000;
-                }
-                cli.set_connection_timeout(conn_s, conn_us);
-            }
+    // Applique les options PAR REQUÊTE au Client. Appelé à chaque
+    // emprunt : un Client de pool garde les réglages de la requête
+    // précédente, donc le cas « pas de timeout » remet explicitement
+    // les valeurs par défaut de httplib au lieu de les laisser fuir.
+    void configure_client(httplib::Client &cli, const HttpRequest &rq)
+    {
+        cli.set_follow_location(rq.follow);
+        cli.enable_server_certificate_verification(rq.verify);
+        if (rq.has_ca)
+        {
+            cli.set_ca_cert_path(rq.ca_cert);
+        }
+        if (!rq.has_timeout)
+        {
+            cli.set_max_timeout(0); // 0 = pas de plafond global
+            cli.set_connection_timeout(CPPHTTPLIB_CONNECTION_TIMEOUT_SECOND,
+                                       CPPHTTPLIB_CONNECTION_TIMEOUT_USECOND);
+            return;
+        }
 
-            httplib::Headers headers;
-            for (const auto &kv : hdrs)
-            {
-                headers.emplace(kv.first, kv.second);
-            }
+        // Timeout GLOBAL de bout en bout, équivalent --max-time
+        // de curl (cpp-httplib v0.45.0+).
+        double ms = rq.timeout_s * 1000.0;
+        size_t ms_int = (ms < 1.0) ? 1 : static_cast<size_t>(ms);
+        cli.set_max_timeout(ms_int);
 
-            if (has_body && !has_ct)
-            {
-                content_type = "application/octet-stream";
-            }
+        // CORRECTIF (diagnostic terrain Ubuntu) : set_max_timeout
+        // couvre les phases applicatives de cpp-httplib (envoi
+        // requête, réception réponse) mais PAS toujours la phase
+        // connect() qui peut bloquer dans le noyau bien plus
+        // longtemps. Cas reproduit : http://[::1]:1/ sur Ubuntu
+        // avec IPv6 loopback partiellement configuré -> connect()
+        // bloque ~60s+ malgré set_max_timeout(1s).
+        //
+        // Solution belt+suspenders : poser AUSSI un connection
+        // timeout dédié. cpp-httplib v0.45.0 expose
+        // set_connection_timeout(seconds, microseconds).
+        // En cumulé : la première limite atteinte gagne.
+        time_t conn_s = static_cast<time_t>(rq.timeout_s);
+        time_t conn_us =
+            static_cast<time_t>((rq.timeout_s - conn_s) * 1e6);
+        // Plancher 1 ms : si timeout_s < 0.001, conn_s et
+        // conn_us seraient tous deux à 0 -> connection_timeout
+        // de 0 = pas de timeout, on évite ce piège.
+        if (conn_s == 0 && conn_us < 1000)
+        {
+            conn_us = 1000;
+        }
+        cli.set_connection_timeout(conn_s, conn_us);
+    }
 
-            // finish() factorise le tri (échec transport vs réponse) ;
-            // prend le Result par valeur (move depuis le prvalue).
-            auto finish = [&](httplib::Result res) -> int
-            {
-                if (!res)
-                {
-                    return push_fail(L, std::string("http: ") +
-                                            httplib::to_string(res.error()));
-                }
-                return push_response(L, res);
-            };
+    // Réception du corps hors de res->body, pour opts.sink et
+    // opts.max_body. Vit le temps d'une requête. Le binding décide
+    // seul des abandons : le message va dans `err` et le receiver
+    // renvoie false (httplib annule le transfert).
+    struct BodySink
+    {
+        lua_State *L = nullptr;
+        int fn_idx = 0;         // callback Lua (SINK_FUNCTION), 0 sinon
+        std::string path;       // fichier cible (SINK_FILE), vide sinon
+        int fd = -1;
+        bool check_length = true; // Content-Length d'un HEAD : pas de corps
+        uint64_t max_body = 0;
+        uint64_t bytes = 0;     // octets reçus, tous modes
+        std::string body;       // sans sink : corps collecté (max_body)
+        std::string err;
+        bool raised = false;    // erreur du callback au sommet de pile
 
-            if (method == "GET")
+        ~BodySink()
+        {
+            if (fd >= 0)
             {
-                return finish(cli.Get(parts.target, headers));
+                ::close(fd);
             }
-            if (method == "HEAD")
+        }
+
+        bool streamed() const { return fn_idx != 0 || !path.empty(); }
+    };
+
+    std::string max_body_error(uint64_t max_body)
+    {
+        return "http: body exceeds max_body (" +
+               std::to_string(max_body) + " bytes)";
+    }
+
+    // Appelé une fois les en-têtes reçus : refuse d'emblée un
+    // Content-Length trop grand, puis ouvre le fichier cible. Ouvrir
+    // ici plutôt qu'avant l'envoi évite de tronquer le fichier
+    // quand le serveur est injoignable.
+    bool sink_on_response(BodySink &s, const httplib::Response &res)
+    {
+        if (s.max_body != 0 && s.check_length &&
+            res.has_header("Content-Length"))
+        {
+            std::string cl = res.get_header_value("Content-Length");
+            unsigned long long n = std::strtoull(cl.c_str(), nullptr, 10);
+            if (n > s.max_body)
             {
-                return finish(cli.Head(parts.target, headers));
+                s.err = max_body_error(s.max_body);
+                return false;
             }
-            if (method == "OPTIONS")
+        }
+        if (!s.path.empty() && s.fd < 0)
+        {
+            s.fd = ::open(s.path.c_str(),
+                          O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (s.fd < 0)
             {
-                return finish(cli.Options(parts.target, headers));
+                s.err = "http: sink: " + s.path + ": " +
+                        std::strerror(errno);
+                return false;
             }
-            if (method == "POST")
+        }
+        return true;
+    }
+
+    bool sink_on_data(BodySink &s, const char *data, size_t len)
+    {
+        s.bytes += len;
+        if (s.max_body != 0 && s.bytes > s.max_body)
+        {
+            // Sans Content-Length (chunked) ou serveur menteur : le
+            // plafond tient quand même, compté sur les octets reçus.
+            s.err = max_body_error(s.max_body);
+            return false;
+        }
+        if (s.fd >= 0)
+        {
+            while (len > 0)
             {
-                return finish(
-                    cli.Post(parts.target, headers, body, content_type));
+                ssize_t w = ::write(s.fd, data, len);
+                if (w < 0)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+                    s.err = "http: sink: " + s.path + ": " +
+                            std::strerror(errno);
+                    return false;
+                }
+                data += w;
+                len -= static_cast<size_t>(w);
             }
-            if (method == "PUT")
+            return true;
+        }
+        if (s.fn_idx != 0)
+        {
+            // lua_pcall : une erreur du callback ne doit pas longjmp
+            // à travers httplib. Elle reste au sommet de pile et
+            // http_perform la relève une fois la requête démontée.
+            lua_State *L = s.L;
+            lua_pushvalue(L, s.fn_idx);
+            lua_pushlstring(L, data, len);
+            if (lua_pcall(L, 1, 1, 0) != LUA_OK)
             {
-                return finish(
-                    cli.Put(parts.target, headers, body, content_type));
+                s.raised = true;
+                return false;
             }
-            if (method == "PATCH")
+            bool stop = lua_isboolean(L, -1) && !lua_toboolean(L, -1);
+            lua_pop(L, 1);
+            if (stop)
             {
-                return finish(
-                    cli.Patch(parts.target, headers, body, content_type));
+                s.err = "http: sink aborted";
+                return false;
             }
-            // DELETE (seule restante : déjà filtrée plus haut)
-            return finish(
-                cli.Delete(parts.target, headers, body, content_type));
+            return true;
         }
-        catch (const std::exception &e)
+        s.body.append(data, len);
+        return true;
+    }
+
+    // Ferme le fichier cible. Un échec (de la requête ou de close)
+    // supprime le fichier partiel : pas de téléchargement tronqué
+    // laissé en silence à la place du bon.
+    void sink_finish(BodySink &s, bool ok)
+    {
+        if (s.fd < 0)
         {
-            return push_fail(L, std::string("http: ") + e.what());
+            return;
         }
-        catch (...)
+        int rc = ::close(s.fd);
+        s.fd = -1;
+        if (ok && rc != 0 && s.err.empty())
         {
-            return push_fail(L, "http: unknown error");
+            s.err = "http: sink: " + s.path + ": " + std::strerror(errno);
+            ok = false;
         }
-    }
-
-    // Copie superficielle d'une table source (index `src`) dans la
-    // table au sommet de la pile (`dst` absolu). Utilisé par get/post
-    // pour fusionner les opts fournies.
-    void shallow_merge(lua_State *L, int src, int dst)
-    {
-        src = lua_absindex(L, src);
-        lua_pushnil(L);
-        while (lua_next(L, src) != 0)
+        if (!ok)
         {
-            lua_pushvalue(L, -2); // copie de la clé
-            lua_insert(L, -2);    // ... clé, clécopie, valeur
-            lua_settable(L, dst); // dst[clécopie] = valeur
+            ::unlink(s.path.c_str());
         }
     }
 
+    // Corps de requête envoyé par morceaux (body_file, multipart,
+    // body fonction) au lieu d'une string en mémoire. Le corps est
+    // une suite de segments, chacun en mémoire ou dans un fichier
+    // ouvert d'avance : la longueur totale est connue avant l'envoi
+    // (Content-Length), sauf pour la fonction (chunked).
+    constexpr size_t BODY_READ_CHUNK = 64 * 1024;
+
+    struct BodySegment
+    {
+        std::string mem;
+        int fd = -1;
+        std::string path; // pour les messages d'erreur
+        uint64_t size = 0;
+    };
+
+    struct BodySource
+    {
+        lua_State *L = nullptr;
+        int fn_idx = 0; // BODY_FUNCTION : fournisseur Lua, chunked
+        std::vector<BodySegment> segs;
+        uint64_t length = 0;
+        std::string content_type; // multipart : avec la boundary
+        std::vector<char> buf;
+        std::string err;
+        bool raised = false; // erreur du fournisseur au sommet de pile
+
+        ~BodySource()
+        {
+            for (auto &seg : segs)
+            {
+                if (seg.fd >= 0)
+                {
+                    ::close(seg.fd);
+                }
+            }
+        }
+    };
+
+    void body_add_mem(BodySource &src, const std::string &data)
+    {
+        if (src.segs.empty() || src.segs.back().fd >= 0)
+        {
+            src.segs.emplace_back();
+        }
+        src.segs.back().mem += data;
+        src.segs.back().size = src.segs.back().mem.size();
+    }
+
+    bool body_add_file(BodySource &src, const std::string &path,
+                       const std::string &what, std::string &err)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            err = "http: " + what + ": " + path + ": " + std::strerror(errno);
+            return false;
+        }
+        struct stat st{};
+        if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+        {
+            ::close(fd);
+            err = "http: " + what + ": " + path + ": not a regular file";
+            return false;
+        }
+        BodySegment seg;
+        seg.fd = fd;
+        seg.path = path;
+        seg.size = static_cast<uint64_t>(st.st_size);
+        src.segs.push_back(std::move(seg));
+        return true;
+    }
+
+    // Nom de champ / de fichier dans Content-Disposition : guillemets
+    // et fins de ligne percent-encodés, comme le font les navigateurs.
+    std::string disposition_quote(const std::string &in)
+    {
+        std::string out;
+        for (char c : in)
+        {
+            if (c == '"')
+            {
+                out += "%22";
+            }
+            else if (c == '\r')
+            {
+                out += "%0D";
+            }
+            else if (c == '\n')
+            {
+                out += "%0A";
+            }
+            else
+            {
+                out.push_back(c);
+            }
+        }
+        return out;
+    }
+
+    std::string make_boundary()
+    {
+        static const char *hex = "0123456789abcdef";
+        std::random_device rd;
+        std::string b = "----BabetFormBoundary";
+        for (int i = 0; i < 16; ++i)
+        {
+            b.push_back(hex[rd() & 0x0F]);
+        }
+        return b;
+    }
+
+    // Ouvre les fichiers et calcule la longueur AVANT toute connexion :
+    // un body_file absent échoue sans toucher au réseau.
+    bool prepare_body(const HttpRequest &rq, BodySource &src,
+                      std::string &err)
+    {
+        if (rq.body_kind == BODY_FILE)
+        {
+            if (!body_add_file(src, rq.body_file, "body_file", err))
+            {
+                return false;
+            }
+        }
+        else if (rq.body_kind == BODY_MULTIPART)
+        {
+            std::string boundary = make_boundary();
+            src.content_type = "multipart/form-data; boundary=" + boundary;
+            for (const auto &part : rq.form)
+            {
+                std::string head = "--" + boundary + "\r\n" +
+                                   "Content-Disposition: form-data; name=\"" +
+                                   disposition_quote(part.name) + "\"";
+                if (part.has_filename)
+                {
+                    head += "; filename=\"" +
+                            disposition_quote(part.filename) + "\"";
+                }
+                head += "\r\n";
+                if (!part.content_type.empty())
+                {
+                    head += "Content-Type: " + part.content_type + "\r\n";
+                }
+                head += "\r\n";
+                body_add_mem(src, head);
+                if (part.is_file)
+                {
+                    if (!body_add_file(src, part.file, "multipart", err))
+                    {
+                        return false;
+                    }
+                }
+                else
+                {
+                    body_add_mem(src, part.data);
+                }
+                body_add_mem(src, "\r\n");
+            }
+            body_add_mem(src, "--" + boundary + "--\r\n");
+        }
+        for (const auto &seg : src.segs)
+        {
+            src.length += seg.size;
+        }
+        return true;
+    }
+
+    // ContentProvider httplib (longueur connue) : écrit au plus `len`
+    // octets à partir de `offset`. Les segments sont retrouvés par
+    // offset à chaque appel, ce qui reste juste si httplib rejoue le
+    // corps depuis 0 (redirection 307/308).
+    bool body_provide(BodySource &src, size_t offset, size_t len,
+                      httplib::DataSink &ds)
+    {
+        uint64_t start = 0;
+        for (auto &seg : src.segs)
+        {
+            if (offset >= start + seg.size)
+            {
+                start += seg.size;
+                continue;
+            }
+            uint64_t pos = offset - start;
+            size_t n = static_cast<size_t>(
+                std::min<uint64_t>(seg.size - pos, len));
+            if (seg.fd < 0)
+            {
+                return ds.write(seg.mem.data() + pos, n);
+            }
+            n = std::min(n, BODY_READ_CHUNK);
+            src.buf.resize(BODY_READ_CHUNK);
+            ssize_t r;
+            do
+            {
+                r = ::pread(seg.fd, src.buf.data(), n,
+                            static_cast<off_t>(pos));
+            } while (r < 0 && errno == EINTR);
+            if (r <= 0)
+            {
+                // r == 0 : fichier raccourci depuis le fstat, le
+                // Content-Length annoncé ne peut plus être tenu.
+                src.err = "http: " + seg.path + ": " +
+                          (r == 0 ? std::string("file shrank during upload")
+                                  : std::string(std::strerror(errno)));
+                return false;
+            }
+            return ds.write(src.buf.data(), static_cast<size_t>(r));
+        }
+        return true;
+    }
+
+    // ContentProvider chunked : chaque appel demande un morceau au
+    // fournisseur Lua. string -> envoyée (vide : ignorée), nil -> fin.
+    bool body_provide_chunk(BodySource &src, httplib::DataSink &ds)
+    {
+        lua_State *L = src.L;
+        lua_pushvalue(L, src.fn_idx);
+        if (lua_pcall(L, 0, 1, 0) != LUA_OK)
+        {
+            src.raised = true; // erreur laissée au sommet de pile
+            return false;
+        }
+        if (lua_isnil(L, -1))
+        {
+            lua_pop(L, 1);
+            ds.done();
+            return true;
+        }
+        if (lua_type(L, -1) != LUA_TSTRING)
+        {
+            lua_pop(L, 1);
+            src.err = "http: body function must return a string or nil";
+            return false;
+        }
+        size_t len = 0;
+        const char *data = lua_tolstring(L, -1, &len);
+        bool ok = (len == 0) || ds.write(data, len);
+        lua_pop(L, 1);
+        return ok;
+    }
+
+    // Émet la requête sur `cli`. Peut lever (try/catch chez l'appelant).
+    // Avec `sink` ou `src`, la requête passe par un httplib::Request
+    // construit à la main : httplib n'a pas de surcharge Post/Put/...
+    // avec receiver commune à toutes les méthodes, et les champs
+    // content_provider_ sont ceux que remplissent ses propres
+    // surcharges à fournisseur.
+    httplib::Result send_request(httplib::Client &cli, const HttpRequest &rq,
+                                 BodySink *sink, BodySource *src)
+    {
+        httplib::Headers headers;
+        for (const auto &kv : rq.hdrs)
+        {
+            headers.emplace(kv.first, kv.second);
+        }
+
+        const std::string &m = rq.method;
+        const std::string &target = rq.parts.target;
+        if (sink != nullptr || src != nullptr)
+        {
+            httplib::Request req;
+            req.method = m;
+            req.path = target;
+            req.headers = std::move(headers);
+            const std::string &ct =
+                (src != nullptr && !src->content_type.empty())
+                    ? src->content_type
+                    : rq.content_type;
+            if (!ct.empty())
+            {
+                req.headers.emplace("Content-Type", ct);
+            }
+            if (src == nullptr)
+            {
+                req.body = rq.body;
+            }
+            else if (src->fn_idx != 0)
+            {
+                req.content_length_ = 0;
+                req.content_provider_ =
+                    [src](size_t, size_t, httplib::DataSink &ds)
+                { return body_provide_chunk(*src, ds); };
+                req.is_chunked_content_provider_ = true;
+                req.headers.emplace("Transfer-Encoding", "chunked");
+            }
+            else
+            {
+                req.content_length_ = static_cast<size_t>(src->length);
+                req.content_provider_ =
+                    [src](size_t offset, size_t len, httplib::DataSink &ds)
+                { return body_provide(*src, offset, len, ds); };
+                req.is_chunked_content_provider_ = false;
+            }
+            if (sink != nullptr)
+            {
+                req.response_handler = [sink](const httplib::Response &res)
+                { return sink_on_response(*sink, res); };
+                req.content_receiver = [sink](const char *data, size_t len,
+                                              uint64_t, uint64_t)
+                { return sink_on_data(*sink, data, len); };
+            }
+            return cli.send(req);
+        }
+        if (m == "GET")
+        {
+            return cli.Get(target, headers);
+        }
+        if (m == "HEAD")
+        {
+            return cli.Head(target, headers);
+        }
+        if (m == "OPTIONS")
+        {
+            return cli.Options(target, headers);
+        }
+        if (m == "POST")
+        {
+            return cli.Post(target, headers, rq.body, rq.content_type);
+        }
+        if (m == "PUT")
+        {
+            return cli.Put(target, headers, rq.body, rq.content_type);
+        }
+        if (m == "PATCH")
+        {
+            return cli.Patch(target, headers, rq.body, rq.content_type);
+        }
+        // DELETE (seule restante : déjà filtrée par parse_request)
+        return cli.Delete(target, headers, rq.body, rq.content_type);
+    }
+
+    // Tri échec transport vs réponse. Un abandon décidé par le
+    // binding (fichier source, max_body, écriture, callback) prime
+    // sur le "Canceled" de httplib, moins parlant.
+    void collect(httplib::Result &res, BodySink *sink, const BodySource *src,
+                 HttpOutcome &out)
+    {
+        const std::string *abort_err = nullptr;
+        if (src != nullptr && !src->err.empty())
+        {
+            abort_err = &src->err;
+        }
+        if (sink != nullptr)
+        {
+            sink_finish(*sink, res && abort_err == nullptr &&
+                                   sink->err.empty());
+            if (abort_err == nullptr && !sink->err.empty())
+            {
+                abort_err = &sink->err;
+            }
+        }
+        if (abort_err != nullptr)
+        {
+            out.failed = true;
+            out.err = *abort_err;
+            return;
+        }
+        if (!res)
+        {
+            out.failed = true;
+            out.err = std::string("http: ") + httplib::to_string(res.error());
+            return;
+        }
+        out.status = res->status;
+        out.headers = std::move(res->headers);
+        if (sink == nullptr)
+        {
+            out.body = std::move(res->body);
+        }
+        else if (sink->streamed())
+        {
+            out.streamed = true;
+            out.bytes = sink->bytes;
+        }
+        else
+        {
+            out.body = std::move(sink->body);
+        }
+    }
+
+    // =================================================================
+    // Sessions keep-alive (babet.http.session)
+    // =================================================================
+    //
+    // Un Client httplib jetable par requête paie à chaque appel le
+    // connect TCP, et en HTTPS le chargement du bundle CA et un
+    // handshake complet. Une session garde des Client en keep-alive,
+    // rangés par origine : l'emprunt suivant vers la même origine
+    // réutilise la connexion (httplib la rouvre d'elle-même si le
+    // serveur l'a fermée entre-temps) et le SSL_CTX déjà chargé.
+    //
+    // La clé inclut verify et ca_cert : httplib charge le trust store
+    // une seule fois par Client, deux configurations de confiance ne
+    // partagent donc jamais un Client. Les autres options (timeout,
+    // follow_redirects) sont réappliquées à chaque emprunt.
+    //
+    // Le pool est protégé par un mutex : l'emprunt/restitution reste
+    // correct si plusieurs threads natifs se partagent une session.
+
+    constexpr const char *SESSION_META = "LuapilotHttpSession";
+    constexpr lua_Integer SESSION_DEFAULT_MAX_PER_HOST = 4;
+    constexpr double SESSION_DEFAULT_IDLE_TIMEOUT_S = 30.0;
+
+    using SteadyClock = std::chrono::steady_clock;
+
+    struct PooledClient
+    {
+        std::unique_ptr<httplib::Client> cli;
+        SteadyClock::time_point idle_since;
+    };
+
+    struct HttpPool
+    {
+        std::mutex mu;
+        // Par clé, du plus ancien au plus récent (push_back à la
+        // restitution) : les entrées expirées sont toujours en tête.
+        std::unordered_map<std::string, std::vector<PooledClient>> idle;
+        size_t max_per_host = SESSION_DEFAULT_MAX_PER_HOST;
+        SteadyClock::duration idle_timeout =
+            std::chrono::milliseconds(30000);
+        uint64_t hits = 0;    // emprunt servi par un Client existant
+        uint64_t misses = 0;  // emprunt qui a dû créer un Client
+        uint64_t expired = 0; // Client jeté pour inactivité
+        bool closed = false;
+    };
+
+    // Userdata : shared_ptr (placement new) pour qu'un futur
+    // utilisateur natif puisse garder le pool au-delà du __gc.
+    struct HttpSession
+    {
+        std::shared_ptr<HttpPool> pool;
+    };
+
+    std::string pool_key(const HttpRequest &rq)
+    {
+        std::string key = to_lower(rq.parts.origin);
+        key.push_back('\0');
+        key.push_back(rq.verify ? '1' : '0');
+        if (rq.has_ca)
+        {
+            key.push_back('\0');
+            key += rq.ca_cert;
+        }
+        return key;
+    }
+
+    // Emprunte un Client pour `key`, ou en crée un (miss). Les
+    // Client expirés sont détruits HORS verrou : la fermeture TLS
+    // envoie un close_notify, inutile de bloquer les autres threads.
+    std::unique_ptr<httplib::Client> pool_acquire(HttpPool &pool,
+                                                  const std::string &key,
+                                                  const std::string &origin,
+                                                  bool &hit)
+    {
+        std::vector<PooledClient> stale;
+        std::unique_ptr<httplib::Client> cli;
+        {
+            std::lock_guard<std::mutex> lock(pool.mu);
+            auto it = pool.idle.find(key);
+            if (it != pool.idle.end())
+            {
+                auto &bucket = it->second;
+                auto now = SteadyClock::now();
+                size_t n = 0;
+                while (n < bucket.size() &&
+                       now - bucket[n].idle_since >= pool.idle_timeout)
+                {
+                    ++n;
+                }
+                for (size_t i = 0; i < n; ++i)
+                {
+                    stale.push_back(std::move(bucket[i]));
+                }
+                bucket.erase(bucket.begin(),
+                             bucket.begin() + static_cast<std::ptrdiff_t>(n));
+                pool.expired += n;
+                if (!bucket.empty())
+                {
+                    // Le plus récent : le plus susceptible d'avoir
+                    // encore sa connexion ouverte côté serveur.
+                    cli = std::move(bucket.back().cli);
+                    bucket.pop_back();
+                }
+                if (bucket.empty())
+                {
+                    pool.idle.erase(it);
+                }
+            }
+            hit = (cli != nullptr);
+            if (hit)
+            {
+                ++pool.hits;
+            }
+            else
+            {
+                ++pool.misses;
+            }
+        }
+        if (!cli)
+        {
+            cli = std::make_unique<httplib::Client>(origin);
+            cli->set_keep_alive(true);
+        }
+        return cli;
+    }
+
+    // Rend un Client au pool, ou le détruit si la session est fermée
+    // ou si l'origine a déjà max_per_host Client au repos.
+    void pool_release(HttpPool &pool, const std::string &key,
+                      std::unique_ptr<httplib::Client> cli)
+    {
+        std::lock_guard<std::mutex> lock(pool.mu);
+        if (pool.closed)
+        {
+            return;
+        }
+        auto &bucket = pool.idle[key];
+        if (bucket.size() >= pool.max_per_host)
+        {
+            return;
+        }
+        bucket.push_back(PooledClient{std::move(cli), SteadyClock::now()});
+    }
+
+    // Un callback Lua (sink ou fournisseur de corps) a levé : son
+    // erreur est au sommet de pile, http_perform la relève.
+    bool lua_raised(const BodySink *sink, const BodySource *src)
+    {
+        return (sink != nullptr && sink->raised) ||
+               (src != nullptr && src->raised);
+    }
+
+    // Exécute une requête validée : Client jetable si `pool` est nul,
+    // emprunté au pool sinon. Ne touche pas à la pile Lua (hors
+    // callbacks sink/body, absents sur les threads de fetch_all).
+    // Si un callback a levé, `out` n'est pas rempli : l'appelant
+    // teste lua_raised().
+    void perform(const HttpRequest &rq, HttpPool *pool, BodySink *sink,
+                 BodySource *src, HttpOutcome &out)
+    {
+        // try/catch : aucune exception C++ ne doit traverser vers Lua
+        // (invariant de correction). Le ctor Client peut lever, les
+        // appels réseau aussi selon les cas.
+        try
+        {
+            if (pool == nullptr)
+            {
+                httplib::Client cli(rq.parts.origin);
+                configure_client(cli, rq);
+                httplib::Result res = send_request(cli, rq, sink, src);
+                if (lua_raised(sink, src))
+                {
+                    if (sink != nullptr)
+                    {
+                        sink_finish(*sink, false);
+                    }
+                    return;
+                }
+                collect(res, sink, src, out);
+                return;
+            }
+
+            std::string key = pool_key(rq);
+            bool hit = false;
+            auto cli = pool_acquire(*pool, key, rq.parts.origin, hit);
+            configure_client(*cli, rq);
+            httplib::Result res = send_request(*cli, rq, sink, src);
+            if (lua_raised(sink, src))
+            {
+                if (sink != nullptr)
+                {
+                    sink_finish(*sink, false);
+                }
+                return;
+            }
+            collect(res, sink, src, out);
+            // Un Client dont la requête a échoué côté transport (ou a
+            // été annulée par le binding) n'est pas rendu : on ne
+            // garde au repos que des connexions qui viennent de servir
+            // une réponse complète.
+            if (!out.failed)
+            {
+                pool_release(*pool, key, std::move(cli));
+            }
+        }
+        catch (const std::exception &e)
+        {
+            if (sink != nullptr)
+            {
+                sink_finish(*sink, false);
+            }
+            out.failed = true;
+            out.err = std::string("http: ") + e.what();
+        }
+        catch (...)
+        {
+            if (sink != nullptr)
+            {
+                sink_finish(*sink, false);
+            }
+            out.failed = true;
+            out.err = "http: unknown error";
+        }
+    }
+
+    // Prépare sink (opts.sink / max_body) et source de corps
+    // (body_file / multipart) hors callbacks Lua. false + `err` si un
+    // fichier source est inutilisable.
+    bool prepare_io(const HttpRequest &rq, BodySink &sink, BodySource &src,
+                    BodySink *&sink_out, BodySource *&src_out,
+                    std::string &err)
+    {
+        sink_out = nullptr;
+        src_out = nullptr;
+        if (rq.body_kind == BODY_FUNCTION || rq.body_kind == BODY_FILE ||
+            rq.body_kind == BODY_MULTIPART)
+        {
+            src_out = &src;
+            if (rq.body_kind != BODY_FUNCTION)
+            {
+                try
+                {
+                    if (!prepare_body(rq, src, err))
+                    {
+                        return false;
+                    }
+                }
+                catch (const std::exception &e)
+                {
+                    err = std::string("http: ") + e.what();
+                    return false;
+                }
+            }
+        }
+        if (rq.sink != SINK_NONE || rq.max_body != 0)
+        {
+            sink_out = &sink;
+            sink.max_body = rq.max_body;
+            sink.check_length = (rq.method != "HEAD");
+            if (rq.sink == SINK_FILE)
+            {
+                sink.path = rq.sink_path;
+            }
+        }
+        return true;
+    }
+
+    // Exécute la requête décrite par la table à `opts_idx`. Si un
+    // callback Lua (sink, fournisseur de corps) a levé, positionne
+    // `raise` et laisse l'erreur au sommet de pile sans rien empiler
+    // d'autre.
+    int http_execute(lua_State *L, int opts_idx, HttpPool *pool,
+                     bool &raise)
+    {
+        opts_idx = lua_absindex(L, opts_idx);
+        HttpRequest rq;
+        std::string err;
+        if (!parse_request(L, opts_idx, rq, err))
+        {
+            return push_fail(L, err);
+        }
+
+        BodySource body_src;
+        BodySink body_sink;
+        BodySource *src = nullptr;
+        BodySink *sink = nullptr;
+        if (!prepare_io(rq, body_sink, body_src, sink, src, err))
+        {
+            return push_fail(L, err);
+        }
+        if (rq.body_kind == BODY_FUNCTION)
+        {
+            src->L = L;
+            lua_getfield(L, opts_idx, "body");
+            src->fn_idx = lua_gettop(L);
+        }
+        if (rq.sink == SINK_FUNCTION)
+        {
+            sink->L = L;
+            lua_getfield(L, opts_idx, "sink");
+            sink->fn_idx = lua_gettop(L);
+        }
+
+        HttpOutcome out;
+        perform(rq, pool, sink, src, out);
+        if (lua_raised(sink, src))
+        {
+            raise = true;
+            return 0;
+        }
+        return push_outcome(L, out);
+    }
+
+    // Cœur partagé. `opts_idx` = table d'options sur la pile ; `pool`
+    // = pool de la session, ou nullptr pour un Client jetable. Une
+    // erreur du callback sink est capturée par lua_pcall puis relevée
+    // ici, une fois les objets C++ de la requête détruits.
+    int http_perform(lua_State *L, int opts_idx, HttpPool *pool)
+    {
+        bool raise = false;
+        int nret = http_execute(L, opts_idx, pool, raise);
+        if (raise)
+        {
+            return lua_error(L);
+        }
+        return nret;
+    }
+
+    // Copie superficielle d'une table source (index `src`) dans la
+    // table au sommet de la pile (`dst` absolu). Utilisé par get/post
+    // pour fusionner les opts fournies.
+    void shallow_merge(lua_State *L, int src, int dst)
+    {
+        src = lua_absindex(L, src);
+        lua_pushnil(L);
+        while (lua_next(L, src) != 0)
+        {
+            lua_pushvalue(L, -2); // copie de la clé
+            lua_insert(L, -2);    // ... clé, clécopie, valeur
+            lua_settable(L, dst); // dst[clécopie] = valeur
+        }
+    }
+
+    // get(url [, opts]) dont l'url est à l'index `base` (1 pour
+    // babet.http.get, 2 pour sess:get).
+    int http_get_at(lua_State *L, int base, HttpPool *pool)
+    {
+        const char *url = luaL_checkstring(L, base);
+
+        lua_newtable(L);
+        int dst = lua_gettop(L);
+        if (!lua_isnoneornil(L, base + 1))
+        {
+            luaL_checktype(L, base + 1, LUA_TTABLE);
+            shallow_merge(L, base + 1, dst);
+        }
+        lua_pushstring(L, url);
+        lua_setfield(L, dst, "url");
+        lua_pushstring(L, "GET");
+        lua_setfield(L, dst, "method");
+        return http_perform(L, dst, pool);
+    }
+
+    // post(url [, body] [, opts]), même convention d'index que
+    // http_get_at.
+    int http_post_at(lua_State *L, int base, HttpPool *pool)
+    {
+        const char *url = luaL_checkstring(L, base);
+
+        int body_type = lua_type(L, base + 1);
+        int opts_arg = base + 2;
+        bool have_body = false;
+        if (body_type == LUA_TSTRING)
+        {
+            have_body = true;
+        }
+        else if (body_type == LUA_TTABLE)
+        {
+            // forme post(url, opts) : 2e arg = opts, pas de corps
+            opts_arg = base + 1;
+        }
+        else if (body_type != LUA_TNONE && body_type != LUA_TNIL)
+        {
+            return luaL_error(L, "http: post body must be a string");
+        }
+
+        lua_newtable(L);
+        int dst = lua_gettop(L);
+        if (!lua_isnoneornil(L, opts_arg))
+        {
+            luaL_checktype(L, opts_arg, LUA_TTABLE);
+            shallow_merge(L, opts_arg, dst);
+        }
+        lua_pushstring(L, url);
+        lua_setfield(L, dst, "url");
+        lua_pushstring(L, "POST");
+        lua_setfield(L, dst, "method");
+        if (have_body)
+        {
+            size_t blen = 0;
+            const char *bs = lua_tolstring(L, base + 1, &blen);
+            lua_pushlstring(L, bs, blen);
+            lua_setfield(L, dst, "body");
+        }
+        return http_perform(L, dst, pool);
+    }
+
+    HttpSession *check_session(lua_State *L)
+    {
+        return static_cast<HttpSession *>(
+            luaL_checkudata(L, 1, SESSION_META));
+    }
+
+    // Pool d'une session ouverte, ou nullptr après sess:close().
+    HttpPool *session_pool(lua_State *L)
+    {
+        HttpSession *s = check_session(L);
+        std::lock_guard<std::mutex> lock(s->pool->mu);
+        return s->pool->closed ? nullptr : s->pool.get();
+    }
+
+    int session_request(lua_State *L)
+    {
+        HttpPool *pool = session_pool(L);
+        luaL_checktype(L, 2, LUA_TTABLE);
+        if (pool == nullptr)
+        {
+            return push_fail(L, "http: session is closed");
+        }
+        return http_perform(L, 2, pool);
+    }
+
+    int session_get(lua_State *L)
+    {
+        HttpPool *pool = session_pool(L);
+        if (pool == nullptr)
+        {
+            luaL_checkstring(L, 2);
+            return push_fail(L, "http: session is closed");
+        }
+        return http_get_at(L, 2, pool);
+    }
+
+    int session_post(lua_State *L)
+    {
+        HttpPool *pool = session_pool(L);
+        if (pool == nullptr)
+        {
+            luaL_checkstring(L, 2);
+            return push_fail(L, "http: session is closed");
+        }
+        return http_post_at(L, 2, pool);
+    }
+
+    // sess:stats() -> { hits, misses, expired, idle, hosts }
+    int session_stats(lua_State *L)
+    {
+        HttpSession *s = check_session(L);
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t expired = 0;
+        size_t idle = 0;
+        size_t hosts = 0;
+        {
+            std::lock_guard<std::mutex> lock(s->pool->mu);
+            hits = s->pool->hits;
+            misses = s->pool->misses;
+            expired = s->pool->expired;
+            hosts = s->pool->idle.size();
+            for (const auto &kv : s->pool->idle)
+            {
+                idle += kv.second.size();
+            }
+        }
+        lua_createtable(L, 0, 5);
+        lua_pushinteger(L, static_cast<lua_Integer>(hits));
+        lua_setfield(L, -2, "hits");
+        lua_pushinteger(L, static_cast<lua_Integer>(misses));
+        lua_setfield(L, -2, "misses");
+        lua_pushinteger(L, static_cast<lua_Integer>(expired));
+        lua_setfield(L, -2, "expired");
+        lua_pushinteger(L, static_cast<lua_Integer>(idle));
+        lua_setfield(L, -2, "idle");
+        lua_pushinteger(L, static_cast<lua_Integer>(hosts));
+        lua_setfield(L, -2, "hosts");
+        return 1;
+    }
+
+    // Ferme les connexions au repos et marque le pool fermé (un
+    // Client encore emprunté par un autre thread sera détruit à sa
+    // restitution). Idempotent ; les compteurs restent lisibles.
+    void session_shutdown(HttpSession *s)
+    {
+        std::unordered_map<std::string, std::vector<PooledClient>> drop;
+        std::lock_guard<std::mutex> lock(s->pool->mu);
+        s->pool->closed = true;
+        drop.swap(s->pool->idle);
+    }
+
+    int session_close(lua_State *L)
+    {
+        session_shutdown(check_session(L));
+        return 0;
+    }
+
+    int session_gc(lua_State *L)
+    {
+        auto *s = static_cast<HttpSession *>(
+            luaL_testudata(L, 1, SESSION_META));
+        if (s != nullptr)
+        {
+            session_shutdown(s);
+            s->~HttpSession(); // placement new dans lua_http_session
+        }
+        return 0;
+    }
+
+    // =================================================================
+    // Lots concurrents (babet.http.fetch_all)
+    // =================================================================
+    //
+    // Les requêtes sont lues et validées sur le thread Lua, exécutées
+    // par des threads natifs (aucun lua_State : perform() n'en a pas
+    // besoin hors callbacks, refusés ici), puis converties en tables
+    // dans l'ordre d'entrée. Tous les threads empruntent au même pool
+    // (celui de opts.session, ou un pool jetable) : les connexions
+    // sont partagées par origine.
+
+    constexpr lua_Integer FETCH_DEFAULT_CONCURRENCY = 8;
+    constexpr lua_Integer FETCH_MAX_CONCURRENCY = 256;
+
+    struct FetchJob
+    {
+        HttpRequest rq;
+        HttpOutcome out; // out.failed dès le parsing si opts invalides
+    };
+
+    // Boucle d'un thread : prend le prochain indice libre jusqu'à
+    // épuisement. Aucune exception ne sort (std::terminate sinon).
+    void fetch_run(std::vector<FetchJob> &jobs, std::atomic<size_t> &next,
+                   HttpPool *pool)
+    {
+        for (;;)
+        {
+            size_t i = next.fetch_add(1, std::memory_order_relaxed);
+            if (i >= jobs.size())
+            {
+                return;
+            }
+            FetchJob &job = jobs[i];
+            if (job.out.failed)
+            {
+                continue;
+            }
+            try
+            {
+                BodySource body_src;
+                BodySink body_sink;
+                BodySource *src = nullptr;
+                BodySink *sink = nullptr;
+                std::string err;
+                if (!prepare_io(job.rq, body_sink, body_src, sink, src, err))
+                {
+                    job.out.failed = true;
+                    job.out.err = err;
+                    continue;
+                }
+                perform(job.rq, pool, sink, src, job.out);
+            }
+            catch (...)
+            {
+                job.out.failed = true;
+                job.out.err = "http: unknown error";
+            }
+        }
+    }
+
+    // =================================================================
+    // Serveur embarqué (babet.http.server)
+    // =================================================================
+    //
+    // httplib::Server accepte les connexions sur son thread d'écoute et
+    // confie chacune (keep-alive compris) à une TaskQueue. On lui
+    // fournit la nôtre : N threads qui possèdent chacun un lua_State
+    // préchauffé (chunk init exécuté, handlers compilés une fois). Un
+    // handler tourne donc dans l'état du thread qui sert la connexion,
+    // sans verrou ni sérialisation. Une fonction Lua ne passe pas d'un
+    // état à l'autre : un handler est un chunk ou un chemin "mod.fn",
+    // comme pour workers pool:submit.
+
+    constexpr const char *SERVER_META = "LuapilotHttpServer";
+    constexpr const char *SERVER_ROUTES = "babet.http.server.routes";
+    constexpr const char *SERVER_READER = "babet.http.server.reader";
+    constexpr lua_Integer SERVER_DEFAULT_THREADS = 8;
+    constexpr lua_Integer SERVER_MAX_THREADS = 256;
+    // srv:wait se réveille au moins à ce rythme pour dispatcher les
+    // signaux gérés par babet.signal (pas d'EINTR sur une condvar).
+    constexpr auto SERVER_WAIT_SLICE = std::chrono::milliseconds(100);
+
+    struct ServerRoute
+    {
+        std::string method;
+        std::string pattern;
+        std::string code; // chunk, ou chemin si is_function
+        bool is_function = false;
+        bool stream = false; // corps lu par req.read, pas req.body
+    };
+
+    // 0 = valeur par défaut de httplib.
+    struct ServerOptions
+    {
+        size_t threads = SERVER_DEFAULT_THREADS;
+        std::string init_code;
+        size_t keep_alive_max = 0;
+        time_t keep_alive_timeout = 0;
+        double read_timeout = 0.0;
+        double write_timeout = 0.0;
+        size_t max_body = 0;
+    };
+
+    // File des connexions acceptées, vidée par les threads à lua_State.
+    // Vit de srv:start à srv:stop ; httplib n'en voit qu'une vue
+    // (ServerQueueRef) qu'il détruit en fin d'écoute.
+    struct ServerQueue
+    {
+        std::mutex mu;
+        std::condition_variable cv;         // tâche disponible / arrêt
+        std::condition_variable idle_cv;    // file vide, rien en cours
+        std::condition_variable started_cv; // fin de préchauffage
+        std::deque<std::function<void()>> jobs;
+        std::vector<std::thread> threads;
+        size_t running = 0;
+        size_t started = 0;
+        bool stopping = false;
+        std::string init_err;
+    };
+
+    struct HttpServer
+    {
+        ServerOptions opts;
+        std::vector<ServerRoute> routes; // figées pendant l'écoute
+        std::unique_ptr<ServerQueue> queue;
+        std::unique_ptr<httplib::Server> svr;
+        std::thread listener;
+        std::mutex mu;
+        std::condition_variable cv; // fin du thread d'écoute
+        bool listening = false;
+        int port = 0;
+        std::atomic<uint64_t> requests{0};
+        std::atomic<uint64_t> errors{0};
+        std::string last_error; // sous mu
+    };
+
+    // lua_State du thread de file courant (nullptr ailleurs).
+    thread_local lua_State *tl_server_state = nullptr;
+
+    void server_record_error(HttpServer &srv, const char *msg)
+    {
+        srv.errors.fetch_add(1, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(srv.mu);
+        srv.last_error = msg ? msg : "(error object is not a string)";
+    }
+
+    struct ServerQueueRef : httplib::TaskQueue
+    {
+        explicit ServerQueueRef(ServerQueue *queue) : q(queue) {}
+
+        bool enqueue(std::function<void()> fn) override
+        {
+            {
+                std::lock_guard<std::mutex> lock(q->mu);
+                if (q->stopping)
+                {
+                    return false;
+                }
+                q->jobs.push_back(std::move(fn));
+            }
+            q->cv.notify_one();
+            return true;
+        }
+
+        // Fin d'écoute : httplib attend que les connexions en cours
+        // soient servies avant de détruire le Server.
+        void shutdown() override
+        {
+            std::unique_lock<std::mutex> lock(q->mu);
+            q->idle_cv.wait(lock, [this]
+                            { return q->jobs.empty() && q->running == 0; });
+        }
+
+        ServerQueue *q;
+    };
+
+    // Préchauffe l'état d'un thread : chunk init, puis handlers rangés
+    // dans registry[SERVER_ROUTES][i]. Chaîne vide si tout va bien.
+    std::string server_warm_state(lua_State *L, const HttpServer &srv)
+    {
+        lua_pushnil(L);
+        lua_setglobal(L, "arg");
+
+        const std::string &init = srv.opts.init_code;
+        if (!init.empty())
+        {
+            int rc = luaL_loadbuffer(L, init.data(), init.size(),
+                                     "server_init");
+            if (rc == LUA_OK)
+            {
+                rc = lua_pcall(L, 0, 0, 0);
+            }
+            if (rc != LUA_OK)
+            {
+                const char *m = lua_tostring(L, -1);
+                std::string err = std::string("http: server: init failed: ") +
+                                  (m ? m : "(no message)");
+                lua_settop(L, 0);
+                return err;
+            }
+        }
+
+        lua_createtable(L, static_cast<int>(srv.routes.size()), 0);
+        for (size_t i = 0; i < srv.routes.size(); ++i)
+        {
+            const ServerRoute &r = srv.routes[i];
+            if (r.is_function)
+            {
+                workers_push_path_value(L, r.code);
+                if (!lua_isfunction(L, -1))
+                {
+                    lua_settop(L, 0);
+                    return "http: server: '" + r.code +
+                           "' is not a function in the handler state";
+                }
+            }
+            else if (luaL_loadbuffer(L, r.code.data(), r.code.size(),
+                                     "handler") != LUA_OK)
+            {
+                const char *m = lua_tostring(L, -1);
+                std::string err = m ? m : "http: server: failed to load handler";
+                lua_settop(L, 0);
+                return err;
+            }
+            lua_rawseti(L, -2, static_cast<lua_Integer>(i + 1));
+        }
+        lua_setfield(L, LUA_REGISTRYINDEX, SERVER_ROUTES);
+        return std::string();
+    }
+
+    void server_thread_main(ServerQueue *q, const HttpServer *srv)
+    {
+        std::string err;
+        lua_State *L = workers_new_state();
+        if (L == nullptr)
+        {
+            err = "http: server: failed to create lua_State";
+        }
+        else
+        {
+            err = server_warm_state(L, *srv);
+        }
+        {
+            std::lock_guard<std::mutex> lock(q->mu);
+            q->started++;
+            if (!err.empty() && q->init_err.empty())
+            {
+                q->init_err = err;
+            }
+        }
+        q->started_cv.notify_all();
+        if (!err.empty())
+        {
+            if (L != nullptr)
+            {
+                lua_close(L);
+            }
+            return;
+        }
+
+        tl_server_state = L;
+        std::unique_lock<std::mutex> lock(q->mu);
+        for (;;)
+        {
+            q->cv.wait(lock, [q]
+                       { return q->stopping || !q->jobs.empty(); });
+            if (q->jobs.empty())
+            {
+                break; // stopping
+            }
+            std::function<void()> job = std::move(q->jobs.front());
+            q->jobs.pop_front();
+            q->running++;
+            lock.unlock();
+            try
+            {
+                job();
+            }
+            catch (...)
+            {
+                // Connexion perdue ; le thread et son état restent.
+            }
+            job = nullptr; // captures libérées hors verrou
+            lock.lock();
+            q->running--;
+            if (q->running == 0 && q->jobs.empty())
+            {
+                q->idle_cv.notify_all();
+            }
+        }
+        lock.unlock();
+        tl_server_state = nullptr;
+        lua_close(L);
+    }
+
+    // Lance les threads de la file et attend leur préchauffage. Les
+    // signaux sont bloqués dans les threads, comme pour fetch_all.
+    bool server_queue_start(ServerQueue *q, const HttpServer *srv,
+                            std::string &err)
+    {
+        sigset_t all;
+        sigset_t old;
+        sigfillset(&all);
+        pthread_sigmask(SIG_BLOCK, &all, &old);
+        try
+        {
+            for (size_t t = 0; t < srv->opts.threads; ++t)
+            {
+                q->threads.emplace_back(server_thread_main, q, srv);
+            }
+        }
+        catch (const std::system_error &e)
+        {
+            err = std::string("http: server: ") + e.what();
+        }
+        pthread_sigmask(SIG_SETMASK, &old, nullptr);
+
+        std::unique_lock<std::mutex> lock(q->mu);
+        q->started_cv.wait(lock, [q]
+                           { return q->started == q->threads.size(); });
+        if (err.empty())
+        {
+            err = q->init_err;
+        }
+        return err.empty();
+    }
+
+    void server_queue_stop(ServerQueue *q)
+    {
+        {
+            std::lock_guard<std::mutex> lock(q->mu);
+            q->stopping = true;
+        }
+        q->cv.notify_all();
+        for (auto &th : q->threads)
+        {
+            th.join();
+        }
+    }
+
+    // Arrête l'écoute, attend les connexions en cours puis ferme les
+    // états des threads. Idempotent.
+    void server_teardown(HttpServer *s)
+    {
+        if (s->svr)
+        {
+            s->svr->stop();
+        }
+        if (s->listener.joinable())
+        {
+            s->listener.join();
+        }
+        s->svr.reset();
+        if (s->queue)
+        {
+            server_queue_stop(s->queue.get());
+            s->queue.reset();
+        }
+        std::lock_guard<std::mutex> lock(s->mu);
+        s->listening = false;
+        s->port = 0;
+    }
+
+    // ---- Exécution d'un handler -------------------------------------
+
+    // Derrière req.read : le lecteur httplib n'existe que pendant
+    // l'appel du handler, reader repasse à nullptr ensuite.
+    struct ServerBodyReader
+    {
+        const httplib::ContentReader *reader;
+        bool used;
+    };
+
+    struct ServeCall
+    {
+        HttpServer *srv;
+        size_t route;
+        const httplib::Request *req;
+        httplib::Response *res;
+        const httplib::ContentReader *reader; // routes stream
+        ServerBodyReader *body_reader;
+    };
+
+    // req.read(fn) : passe le corps à fn(chunk) au fil de l'arrivée ;
+    // fn renvoie false pour arrêter. Renvoie le nombre d'octets lus ou
+    // (nil, err). Une erreur levée dans fn est relevée après lecture.
+    int server_req_read(lua_State *L)
+    {
+        auto *br = static_cast<ServerBodyReader *>(
+            lua_touserdata(L, lua_upvalueindex(1)));
+        luaL_checktype(L, 1, LUA_TFUNCTION);
+        if (br->reader == nullptr)
+        {
+            return push_fail(L, "http: request body is no longer readable");
+        }
+        if (br->used)
+        {
+            return push_fail(L, "http: request body already read");
+        }
+        br->used = true;
+        lua_settop(L, 1);
+
+        uint64_t bytes = 0;
+        bool raised = false;
+        bool aborted = false;
+        bool ok = (*br->reader)(
+            [L, &bytes, &raised, &aborted](const char *data, size_t len)
+            {
+                // lua_pcall : pas de longjmp à travers httplib.
+                lua_pushvalue(L, 1);
+                lua_pushlstring(L, data, len);
+                if (lua_pcall(L, 1, 1, 0) != LUA_OK)
+                {
+                    raised = true;
+                    return false;
+                }
+                bool stop = lua_isboolean(L, -1) && !lua_toboolean(L, -1);
+                lua_pop(L, 1);
+                bytes += len;
+                aborted = stop;
+                return !stop;
+            });
+        if (raised)
+        {
+            return lua_error(L);
+        }
+        if (aborted)
+        {
+            return push_fail(L, "http: read aborted");
+        }
+        if (!ok)
+        {
+            return push_fail(L, "http: failed to read request body");
+        }
+        lua_pushinteger(L, static_cast<lua_Integer>(bytes));
+        return 1;
+    }
+
+    // Table req passée au handler.
+    void server_push_request(lua_State *L, ServeCall &c)
+    {
+        const httplib::Request &req = *c.req;
+        lua_createtable(L, 0, 10);
+
+        lua_pushlstring(L, req.method.data(), req.method.size());
+        lua_setfield(L, -2, "method");
+        lua_pushlstring(L, req.path.data(), req.path.size());
+        lua_setfield(L, -2, "path");
+
+        lua_newtable(L);
+        for (const auto &kv : req.params) // dernière valeur gagne
+        {
+            lua_pushlstring(L, kv.second.data(), kv.second.size());
+            lua_setfield(L, -2, kv.first.c_str());
+        }
+        lua_setfield(L, -2, "query");
+
+        lua_newtable(L);
+        for (const auto &h : req.headers)
+        {
+            // httplib range aussi l'adresse des pairs dans les
+            // en-têtes : exposée à part (remote_addr / remote_port).
+            if (h.first == "REMOTE_ADDR" || h.first == "REMOTE_PORT" ||
+                h.first == "LOCAL_ADDR" || h.first == "LOCAL_PORT")
+            {
+                continue;
+            }
+            std::string key = to_lower(h.first); // dernière valeur gagne
+            lua_pushlstring(L, h.second.data(), h.second.size());
+            lua_setfield(L, -2, key.c_str());
+        }
+        lua_setfield(L, -2, "headers");
+
+        lua_newtable(L);
+        for (const auto &kv : req.path_params)
+        {
+            lua_pushlstring(L, kv.second.data(), kv.second.size());
+            lua_setfield(L, -2, kv.first.c_str());
+        }
+        lua_setfield(L, -2, "params");
+
+        lua_newtable(L);
+        for (size_t i = 1; i < req.matches.size(); ++i)
+        {
+            std::string m = req.matches[i].str();
+            lua_pushlstring(L, m.data(), m.size());
+            lua_rawseti(L, -2, static_cast<lua_Integer>(i));
+        }
+        lua_setfield(L, -2, "captures");
+
+        lua_pushlstring(L, req.remote_addr.data(), req.remote_addr.size());
+        lua_setfield(L, -2, "remote_addr");
+        lua_pushinteger(L, req.remote_port);
+        lua_setfield(L, -2, "remote_port");
+
+        if (c.reader != nullptr)
+        {
+            auto *br = static_cast<ServerBodyReader *>(
+                lua_newuserdatauv(L, sizeof(ServerBodyReader), 0));
+            br->reader = c.reader;
+            br->used = false;
+            // Ancré dans le registre jusqu'à la requête suivante du
+            // thread : serve_request peut l'invalider après le pcall.
+            lua_pushvalue(L, -1);
+            lua_setfield(L, LUA_REGISTRYINDEX, SERVER_READER);
+            c.body_reader = br;
+            lua_pushcclosure(L, server_req_read, 1);
+            lua_setfield(L, -2, "read");
+        }
+        else
+        {
+            lua_pushlstring(L, req.body.data(), req.body.size());
+            lua_setfield(L, -2, "body");
+        }
+    }
+
+    // Fournisseur chunked d'une réponse body = function, appelé par
+    // httplib sur le thread du handler après son retour.
+    bool server_body_chunk(HttpServer *srv, lua_State *L, int ref,
+                           httplib::DataSink &sink)
+    {
+        lua_rawgeti(L, LUA_REGISTRYINDEX, ref);
+        if (lua_pcall(L, 0, 1, 0) != LUA_OK)
+        {
+            server_record_error(*srv, lua_tostring(L, -1));
+            lua_pop(L, 1);
+            return false;
+        }
+        int t = lua_type(L, -1);
+        if (t == LUA_TNIL)
+        {
+            lua_pop(L, 1);
+            sink.done();
+            return true;
+        }
+        if (t != LUA_TSTRING)
+        {
+            server_record_error(
+                *srv, "http: body function must return a string or nil");
+            lua_pop(L, 1);
+            return false;
+        }
+        size_t len = 0;
+        const char *s = lua_tolstring(L, -1, &len);
+        bool ok = (len == 0) || sink.write(s, len);
+        lua_pop(L, 1);
+        return ok;
+    }
+
+    bool has_crlf(const char *s, size_t len)
+    {
+        return std::memchr(s, '\r', len) != nullptr ||
+               std::memchr(s, '\n', len) != nullptr;
+    }
+
+    // Traduit la valeur renvoyée par le handler (index `idx`) dans
+    // res. Toutes les vérifications Lua passent avant le premier objet
+    // C++ durable (ref du corps, descripteur du fichier).
+    void server_fill_response(lua_State *L, int idx, HttpServer *srv,
+                              httplib::Response &res)
+    {
+        int t = lua_type(L, idx);
+        if (t == LUA_TNIL)
+        {
+            res.status = 204;
+            return;
+        }
+        if (t == LUA_TSTRING)
+        {
+            size_t len = 0;
+            const char *s = lua_tolstring(L, idx, &len);
+            res.status = 200;
+            res.set_content(std::string(s, len), "text/plain; charset=utf-8");
+            return;
+        }
+        if (t != LUA_TTABLE)
+        {
+            luaL_error(L, "http: handler must return a string, a table or nil (got %s)",
+                       luaL_typename(L, idx));
+            return;
+        }
+
+        lua_Integer status = 200;
+        lua_getfield(L, idx, "status");
+        if (!lua_isnil(L, -1))
+        {
+            if (!lua_isinteger(L, -1))
+            {
+                luaL_error(L, "http: 'status' must be an integer");
+                return;
+            }
+            status = lua_tointeger(L, -1);
+            if (status < 100 || status > 599)
+            {
+                luaL_error(L, "http: 'status' out of range (100..599)");
+                return;
+            }
+        }
+        lua_pop(L, 1);
+
+        // Content-Type à part : set_content / les providers le posent.
+        lua_pushnil(L);
+        int ctype_slot = lua_gettop(L);
+        lua_getfield(L, idx, "headers");
+        if (!lua_isnil(L, -1))
+        {
+            if (!lua_istable(L, -1))
+            {
+                luaL_error(L, "http: 'headers' must be a table");
+                return;
+            }
+            lua_pushnil(L);
+            while (lua_next(L, -2) != 0)
+            {
+                int vt = lua_type(L, -1);
+                if (lua_type(L, -2) != LUA_TSTRING ||
+                    (vt != LUA_TSTRING && vt != LUA_TNUMBER))
+                {
+                    luaL_error(L, "http: header names and values must be strings");
+                    return;
+                }
+                size_t klen = 0;
+                size_t vlen = 0;
+                const char *k = lua_tolstring(L, -2, &klen);
+                const char *v = lua_tolstring(L, -1, &vlen);
+                if (klen == 0 || has_crlf(k, klen) || has_crlf(v, vlen))
+                {
+                    luaL_error(L, "http: invalid header '%s'", k);
+                    return;
+                }
+                if (klen == 12 && strncasecmp(k, "content-type", 12) == 0)
+                {
+                    lua_pushvalue(L, -1);
+                    lua_replace(L, ctype_slot);
+                }
+                else
+                {
+                    res.set_header(std::string(k, klen), std::string(v, vlen));
+                }
+                lua_pop(L, 1);
+            }
+        }
+        lua_pop(L, 1);
+
+        lua_getfield(L, idx, "body");
+        int body_t = lua_type(L, -1);
+        lua_getfield(L, idx, "file");
+        int file_t = lua_type(L, -1);
+        if (body_t != LUA_TNIL && file_t != LUA_TNIL)
+        {
+            luaL_error(L, "http: 'body' and 'file' are mutually exclusive");
+            return;
+        }
+        if (body_t != LUA_TNIL && body_t != LUA_TSTRING &&
+            body_t != LUA_TFUNCTION)
+        {
+            luaL_error(L, "http: 'body' must be a string or a function");
+            return;
+        }
+        if (file_t != LUA_TNIL && file_t != LUA_TSTRING)
+        {
+            luaL_error(L, "http: 'file' must be a string");
+            return;
+        }
+
+        res.status = static_cast<int>(status);
+        const char *ctype = lua_tostring(L, ctype_slot); // ancré
+        if (body_t == LUA_TSTRING)
+        {
+            size_t len = 0;
+            const char *s = lua_tolstring(L, -2, &len);
+            res.set_content(std::string(s, len),
+                            ctype ? ctype : "text/plain; charset=utf-8");
+        }
+        else if (body_t == LUA_TFUNCTION)
+        {
+            lua_pushvalue(L, -2);
+            int ref = luaL_ref(L, LUA_REGISTRYINDEX);
+            res.set_chunked_content_provider(
+                ctype ? ctype : "application/octet-stream",
+                [srv, L, ref](size_t, httplib::DataSink &sink)
+                { return server_body_chunk(srv, L, ref, sink); },
+                [L, ref](bool)
+                { luaL_unref(L, LUA_REGISTRYINDEX, ref); });
+        }
+        else if (file_t == LUA_TSTRING)
+        {
+            const char *path = lua_tostring(L, -1);
+            int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+            {
+                luaL_error(L, "http: file: %s: %s", path, std::strerror(errno));
+                return;
+            }
+            struct stat st;
+            if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+            {
+                ::close(fd);
+                luaL_error(L, "http: file: %s: not a regular file", path);
+                return;
+            }
+            res.set_content_provider(
+                static_cast<size_t>(st.st_size),
+                ctype ? ctype : "application/octet-stream",
+                [fd](size_t offset, size_t length, httplib::DataSink &sink)
+                {
+                    char buf[65536];
+                    size_t want = std::min(length, sizeof(buf));
+                    ssize_t n;
+                    do
+                    {
+                        n = ::pread(fd, buf, want, static_cast<off_t>(offset));
+                    } while (n < 0 && errno == EINTR);
+                    return n > 0 && sink.write(buf, static_cast<size_t>(n));
+                },
+                [fd](bool)
+                { ::close(fd); });
+        }
+        else if (ctype != nullptr)
+        {
+            res.set_header("Content-Type", ctype);
+        }
+        lua_pop(L, 2);
+    }
+
+    // Corps protégé d'une requête (sous lua_pcall) : req, appel du
+    // handler, réponse.
+    int server_call(lua_State *L)
+    {
+        auto *c = static_cast<ServeCall *>(lua_touserdata(L, 1));
+        lua_getfield(L, LUA_REGISTRYINDEX, SERVER_ROUTES);
+        lua_rawgeti(L, -1, static_cast<lua_Integer>(c->route + 1));
+        server_push_request(L, *c);
+        lua_call(L, 1, 1);
+        server_fill_response(L, lua_gettop(L), c->srv, *c->res);
+        return 0;
+    }
+
+    // Appelé par httplib sur un thread de la file. Une erreur du
+    // handler donne un 500 et alimente srv:stats().
+    void server_serve(HttpServer *srv, size_t route,
+                      const httplib::Request &req, httplib::Response &res,
+                      const httplib::ContentReader *reader)
+    {
+        srv->requests.fetch_add(1, std::memory_order_relaxed);
+        lua_State *L = tl_server_state;
+        if (L == nullptr)
+        {
+            res.status = 500;
+            return;
+        }
+        ServeCall call{srv, route, &req, &res, reader, nullptr};
+        lua_settop(L, 0);
+        lua_pushcfunction(L, server_call);
+        lua_pushlightuserdata(L, &call);
+        int rc = lua_pcall(L, 1, 0, 0);
+        if (call.body_reader != nullptr)
+        {
+            call.body_reader->reader = nullptr;
+        }
+        if (rc != LUA_OK)
+        {
+            server_record_error(*srv, lua_tostring(L, -1));
+            res.headers.clear();
+            res.status = 500;
+            res.set_content("Internal Server Error\n",
+                            "text/plain; charset=utf-8");
+        }
+        lua_settop(L, 0);
+    }
+
+    void server_register_routes(HttpServer *srv, httplib::Server &svr)
+    {
+        for (size_t i = 0; i < srv->routes.size(); ++i)
+        {
+            const ServerRoute &r = srv->routes[i];
+            httplib::Server::Handler h =
+                [srv, i](const httplib::Request &req, httplib::Response &res)
+            { server_serve(srv, i, req, res, nullptr); };
+            httplib::Server::HandlerWithContentReader hr =
+                [srv, i](const httplib::Request &req, httplib::Response &res,
+                         const httplib::ContentReader &reader)
+            { server_serve(srv, i, req, res, &reader); };
+
+            if (r.method == "GET")
+            {
+                svr.Get(r.pattern, h); // sert aussi HEAD
+            }
+            else if (r.method == "OPTIONS")
+            {
+                svr.Options(r.pattern, h);
+            }
+            else if (r.method == "POST")
+            {
+                r.stream ? svr.Post(r.pattern, hr) : svr.Post(r.pattern, h);
+            }
+            else if (r.method == "PUT")
+            {
+                r.stream ? svr.Put(r.pattern, hr) : svr.Put(r.pattern, h);
+            }
+            else if (r.method == "PATCH")
+            {
+                r.stream ? svr.Patch(r.pattern, hr) : svr.Patch(r.pattern, h);
+            }
+            else
+            {
+                r.stream ? svr.Delete(r.pattern, hr) : svr.Delete(r.pattern, h);
+            }
+        }
+    }
+
+    // Découpe des secondes en (s, µs), plancher 1 ms comme pour le
+    // connection timeout du client.
+    void split_seconds(double secs, time_t &s, time_t &us)
+    {
+        s = static_cast<time_t>(secs);
+        us = static_cast<time_t>((secs - static_cast<double>(s)) * 1e6);
+        if (s == 0 && us < 1000)
+        {
+            us = 1000;
+        }
+    }
+
+    // Démarre la file, le Server et son thread d'écoute. Renvoie le
+    // port lié, ou -1 + err (tout est alors démonté).
+    int server_launch(HttpServer *s, const std::string &host, int port,
+                      std::string &err)
+    {
+        int bound = -1;
+        try
+        {
+            s->queue = std::make_unique<ServerQueue>();
+            if (!server_queue_start(s->queue.get(), s, err))
+            {
+                server_teardown(s);
+                return -1;
+            }
+
+            auto svr = std::make_unique<httplib::Server>();
+            ServerQueue *q = s->queue.get();
+            svr->new_task_queue = [q]
+            { return new ServerQueueRef(q); };
+            const ServerOptions &o = s->opts;
+            if (o.keep_alive_max > 0)
+            {
+                svr->set_keep_alive_max_count(o.keep_alive_max);
+            }
+            if (o.keep_alive_timeout > 0)
+            {
+                svr->set_keep_alive_timeout(o.keep_alive_timeout);
+            }
+            time_t sec = 0;
+            time_t usec = 0;
+            if (o.read_timeout > 0.0)
+            {
+                split_seconds(o.read_timeout, sec, usec);
+                svr->set_read_timeout(sec, usec);
+            }
+            if (o.write_timeout > 0.0)
+            {
+                split_seconds(o.write_timeout, sec, usec);
+                svr->set_write_timeout(sec, usec);
+            }
+            if (o.max_body > 0)
+            {
+                svr->set_payload_max_length(o.max_body);
+            }
+            server_register_routes(s, *svr);
+
+            if (port == 0)
+            {
+                bound = svr->bind_to_any_port(host);
+            }
+            else if (svr->bind_to_port(host, port))
+            {
+                bound = port;
+            }
+            if (bound < 0)
+            {
+                err = "http: server: cannot listen on " + host + ":" +
+                      std::to_string(port);
+                server_teardown(s);
+                return -1;
+            }
+            httplib::Server *raw = svr.get();
+            s->svr = std::move(svr);
+
+            {
+                std::lock_guard<std::mutex> lock(s->mu);
+                s->listening = true;
+                s->port = bound;
+            }
+            sigset_t all;
+            sigset_t old;
+            sigfillset(&all);
+            pthread_sigmask(SIG_BLOCK, &all, &old);
+            try
+            {
+                s->listener = std::thread([s, raw]
+                                          {
+                    raw->listen_after_bind();
+                    {
+                        std::lock_guard<std::mutex> lock(s->mu);
+                        s->listening = false;
+                    }
+                    s->cv.notify_all(); });
+            }
+            catch (const std::system_error &e)
+            {
+                err = std::string("http: server: ") + e.what();
+            }
+            pthread_sigmask(SIG_SETMASK, &old, nullptr);
+            if (!err.empty())
+            {
+                server_teardown(s);
+                return -1;
+            }
+        }
+        catch (const std::exception &e)
+        {
+            err = std::string("http: server: ") + e.what();
+            server_teardown(s);
+            return -1;
+        }
+
+        // srv:stop() juste après start() ne doit pas précéder la mise
+        // en écoute (stop() serait sans effet et join bloquerait).
+        for (;;)
+        {
+            if (s->svr->is_running())
+            {
+                break;
+            }
+            {
+                std::lock_guard<std::mutex> lock(s->mu);
+                if (!s->listening)
+                {
+                    break;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return bound;
+    }
+
+    HttpServer *check_server(lua_State *L)
+    {
+        return static_cast<HttpServer *>(luaL_checkudata(L, 1, SERVER_META));
+    }
+
+    // srv:route(method, pattern, handler [, { stream = bool }]) -> srv
+    int server_route(lua_State *L)
+    {
+        HttpServer *s = check_server(L);
+        size_t mlen = 0;
+        const char *m = luaL_checklstring(L, 2, &mlen);
+        size_t plen = 0;
+        const char *pattern = luaL_checklstring(L, 3, &plen);
+        size_t clen = 0;
+        const char *code = luaL_checklstring(L, 4, &clen);
+        bool stream = false;
+        if (!lua_isnoneornil(L, 5))
+        {
+            luaL_checktype(L, 5, LUA_TTABLE);
+            lua_getfield(L, 5, "stream");
+            if (!lua_isnil(L, -1))
+            {
+                if (!lua_isboolean(L, -1))
+                {
+                    return luaL_error(L, "http: 'stream' must be a boolean");
+                }
+                stream = lua_toboolean(L, -1) != 0;
+            }
+            lua_pop(L, 1);
+        }
+        if (s->svr)
+        {
+            return luaL_error(L, "http: server: add routes before start()");
+        }
+
+        char method[8] = {0};
+        if (mlen >= sizeof(method))
+        {
+            return luaL_error(L, "http: server: unsupported method '%s'", m);
+        }
+        for (size_t i = 0; i < mlen; ++i)
+        {
+            method[i] = static_cast<char>(
+                std::toupper(static_cast<unsigned char>(m[i])));
+        }
+        bool body_method = std::strcmp(method, "POST") == 0 ||
+                           std::strcmp(method, "PUT") == 0 ||
+                           std::strcmp(method, "PATCH") == 0 ||
+                           std::strcmp(method, "DELETE") == 0;
+        if (!body_method && std::strcmp(method, "GET") != 0 &&
+            std::strcmp(method, "OPTIONS") != 0)
+        {
+            return luaL_error(L, "http: server: unsupported method '%s'", m);
+        }
+        if (stream && !body_method)
+        {
+            return luaL_error(L, "http: server: stream needs POST, PUT, PATCH or DELETE");
+        }
+        if (plen == 0 || pattern[0] != '/')
+        {
+            return luaL_error(L, "http: server: pattern must start with '/'");
+        }
+
+        // Un chunk invalide est refusé tout de suite (même chunkname
+        // que dans les threads) ; un chemin est résolu au start().
+        bool is_fn = workers_is_function_path(code, clen);
+        if (!is_fn)
+        {
+            if (luaL_loadbuffer(L, code, clen, "handler") != LUA_OK)
+            {
+                return lua_error(L);
+            }
+            lua_pop(L, 1);
+        }
+
+        bool oom = false;
+        try
+        {
+            ServerRoute r;
+            r.method = method;
+            r.pattern.assign(pattern, plen);
+            r.code.assign(code, clen);
+            r.is_function = is_fn;
+            r.stream = stream;
+            s->routes.push_back(std::move(r));
+        }
+        catch (const std::bad_alloc &)
+        {
+            oom = true;
+        }
+        if (oom)
+        {
+            return luaL_error(L, "http: server: out of memory");
+        }
+        lua_settop(L, 1);
+        return 1;
+    }
+
+    // srv:start([host [, port]]) -> port | (nil, err)
+    int server_start(lua_State *L)
+    {
+        HttpServer *s = check_server(L);
+        const char *host = luaL_optstring(L, 2, "127.0.0.1");
+        lua_Integer port = luaL_optinteger(L, 3, 0);
+        if (port < 0 || port > 65535)
+        {
+            return push_fail(L, "http: server: port must be in 0..65535");
+        }
+        if (s->svr)
+        {
+            return push_fail(L, "http: server: already running");
+        }
+        std::string err;
+        int bound = server_launch(s, host, static_cast<int>(port), err);
+        if (bound < 0)
+        {
+            return push_fail(L, err);
+        }
+        lua_pushinteger(L, bound);
+        return 1;
+    }
+
+    int server_stop(lua_State *L)
+    {
+        server_teardown(check_server(L));
+        return 0;
+    }
+
+    // srv:wait([timeout]) -> true si l'écoute est terminée, false si
+    // le délai expire. Les signaux gérés sont dispatchés pendant
+    // l'attente : un handler babet.signal peut appeler srv:stop().
+    int server_wait(lua_State *L)
+    {
+        HttpServer *s = check_server(L);
+        double timeout = -1.0;
+        if (!lua_isnoneornil(L, 2))
+        {
+            timeout = luaL_checknumber(L, 2);
+            luaL_argcheck(L, timeout >= 0.0, 2, "timeout must be >= 0");
+        }
+        const auto deadline =
+            SteadyClock::now() +
+            std::chrono::duration_cast<SteadyClock::duration>(
+                std::chrono::duration<double>(timeout < 0.0 ? 0.0 : timeout));
+        for (;;)
+        {
+            bool done = false;
+            {
+                std::unique_lock<std::mutex> lock(s->mu);
+                auto until = SteadyClock::now() + SERVER_WAIT_SLICE;
+                if (timeout >= 0.0 && deadline < until)
+                {
+                    until = deadline;
+                }
+                s->cv.wait_until(lock, until, [s]
+                                 { return !s->listening; });
+                done = !s->listening;
+            }
+            if (done)
+            {
+                lua_pushboolean(L, 1);
+                return 1;
+            }
+            if (signal_any_handled_pending())
+            {
+                signal_dispatch_pending(L);
+                continue;
+            }
+            if (timeout >= 0.0 && SteadyClock::now() >= deadline)
+            {
+                lua_pushboolean(L, 0);
+                return 1;
+            }
+        }
+    }
+
+    // srv:stats() -> { requests, errors, last_error, threads, port, running }
+    int server_stats(lua_State *L)
+    {
+        HttpServer *s = check_server(L);
+        std::string last_error;
+        bool running = false;
+        int port = 0;
+        {
+            std::lock_guard<std::mutex> lock(s->mu);
+            last_error = s->last_error;
+            running = s->listening;
+            port = s->port;
+        }
+        lua_createtable(L, 0, 6);
+        lua_pushinteger(L, static_cast<lua_Integer>(
+                               s->requests.load(std::memory_order_relaxed)));
+        lua_setfield(L, -2, "requests");
+        lua_pushinteger(L, static_cast<lua_Integer>(
+                               s->errors.load(std::memory_order_relaxed)));
+        lua_setfield(L, -2, "errors");
+        if (!last_error.empty())
+        {
+            lua_pushlstring(L, last_error.data(), last_error.size());
+            lua_setfield(L, -2, "last_error");
+        }
+        lua_pushinteger(L, static_cast<lua_Integer>(s->opts.threads));
+        lua_setfield(L, -2, "threads");
+        lua_pushinteger(L, port);
+        lua_setfield(L, -2, "port");
+        lua_pushboolean(L, running ? 1 : 0);
+        lua_setfield(L, -2, "running");
+        return 1;
+    }
+
+    int server_gc(lua_State *L)
+    {
+        auto *s = static_cast<HttpServer *>(luaL_testudata(L, 1, SERVER_META));
+        if (s != nullptr)
+        {
+            server_teardown(s);
+            s->~HttpServer(); // placement new dans lua_http_server
+        }
+        return 0;
+    }
+
 } // namespace
 
 int lua_http_request(lua_State *L)
 {
     luaL_checktype(L, 1, LUA_TTABLE);
-    return http_perform(L, 1);
+    return http_perform(L, 1, nullptr);
 }
 
 int lua_http_get(lua_State *L)
 {
-    const char *url = luaL_checkstring(L, 1);
+    return http_get_at(L, 1, nullptr);
+}
 
-    lua_newtable(L);
-    int dst = lua_gettop(L);
-    if (!lua_isnoneornil(L, 2))
+int lua_http_post(lua_State *L)
+{
+    return http_post_at(L, 1, nullptr);
+}
+
+int lua_http_session(lua_State *L)
+{
+    lua_Integer max_per_host = SESSION_DEFAULT_MAX_PER_HOST;
+    double idle_timeout_s = SESSION_DEFAULT_IDLE_TIMEOUT_S;
+    if (!lua_isnoneornil(L, 1))
     {
-        luaL_checktype(L, 2, LUA_TTABLE);
-        shallow_merge(L, 2, dst);
+        luaL_checktype(L, 1, LUA_TTABLE);
+        lua_getfield(L, 1, "max_per_host");
+        if (!lua_isnil(L, -1))
+        {
+            if (!lua_isinteger(L, -1))
+            {
+                return luaL_error(L,
+                                  "http: 'max_per_host' must be an integer");
+            }
+            max_per_host = lua_tointeger(L, -1);
+        }
+        lua_pop(L, 1);
+        lua_getfield(L, 1, "idle_timeout");
+        if (!lua_isnil(L, -1))
+        {
+            if (lua_type(L, -1) != LUA_TNUMBER)
+            {
+                return luaL_error(L, "http: 'idle_timeout' must be a number");
+            }
+            idle_timeout_s = lua_tonumber(L, -1);
+        }
+        lua_pop(L, 1);
     }
-    lua_pushstring(L, url);
-    lua_setfield(L, dst, "url");
-    lua_pushstring(L, "GET");
-    lua_setfield(L, dst, "method");
-    return http_perform(L, dst);
+    if (max_per_host < 1)
+    {
+        return push_fail(L, "http: max_per_host must be >= 1");
+    }
+    if (!(idle_timeout_s > 0.0))
+    {
+        return push_fail(L, "http: idle_timeout must be > 0");
+    }
+
+    std::shared_ptr<HttpPool> pool;
+    try
+    {
+        pool = std::make_shared<HttpPool>();
+    }
+    catch (const std::exception &e)
+    {
+        return push_fail(L, std::string("http: ") + e.what());
+    }
+    pool->max_per_host = static_cast<size_t>(max_per_host);
+    pool->idle_timeout = std::chrono::duration_cast<SteadyClock::duration>(
+        std::chrono::duration<double>(idle_timeout_s));
+
+    void *raw = lua_newuserdatauv(L, sizeof(HttpSession), 0);
+    auto *s = new (raw) HttpSession(); // placement new : shared_ptr
+    s->pool = std::move(pool);
+    luaL_getmetatable(L, SESSION_META);
+    lua_setmetatable(L, -2);
+    return 1;
 }
 
-int lua_http_post(lua_State *L)
+int lua_http_fetch_all(lua_State *L)
 {
-    const char *url = luaL_checkstring(L, 1);
+    luaL_checktype(L, 1, LUA_TTABLE);
+    lua_Integer concurrency = FETCH_DEFAULT_CONCURRENCY;
+    HttpPool *pool = nullptr;
+    if (!lua_isnoneornil(L, 2))
+    {
+        luaL_checktype(L, 2, LUA_TTABLE);
+        lua_getfield(L, 2, "concurrency");
+        if (!lua_isnil(L, -1))
+        {
+            if (!lua_isinteger(L, -1))
+            {
+                return luaL_error(L, "http: 'concurrency' must be an integer");
+            }
+            concurrency = lua_tointeger(L, -1);
+        }
+        lua_pop(L, 1);
+        // La session reste ancrée par opts (argument 2) pendant l'appel.
+        lua_getfield(L, 2, "session");
+        if (!lua_isnil(L, -1))
+        {
+            auto *sess = static_cast<HttpSession *>(
+                luaL_testudata(L, -1, SESSION_META));
+            if (sess == nullptr)
+            {
+                return luaL_error(L, "http: 'session' must be a session");
+            }
+            pool = sess->pool.get();
+        }
+        lua_pop(L, 1);
+    }
+    if (concurrency < 1 || concurrency > FETCH_MAX_CONCURRENCY)
+    {
+        return push_fail(L, "http: concurrency must be in [1, 256]");
+    }
+    if (pool != nullptr)
+    {
+        std::lock_guard<std::mutex> lock(pool->mu);
+        if (pool->closed)
+        {
+            return push_fail(L, "http: session is closed");
+        }
+    }
+
+    // Types vérifiés AVANT tout objet C++ : luaL_error longjmp.
+    lua_Integer n = luaL_len(L, 1);
+    for (lua_Integer i = 1; i <= n; ++i)
+    {
+        int t = lua_geti(L, 1, i);
+        lua_pop(L, 1);
+        if (t != LUA_TTABLE && t != LUA_TSTRING)
+        {
+            return luaL_error(
+                L, "http: fetch_all: request %d must be a table or a string",
+                static_cast<int>(i));
+        }
+    }
+
+    std::vector<FetchJob> jobs(static_cast<size_t>(n));
+    size_t pending = 0;
+    for (lua_Integer i = 1; i <= n; ++i)
+    {
+        FetchJob &job = jobs[static_cast<size_t>(i - 1)];
+        if (lua_geti(L, 1, i) == LUA_TSTRING)
+        {
+            // Forme courte : une URL seule = GET.
+            lua_createtable(L, 0, 1);
+            lua_insert(L, -2);
+            lua_setfield(L, -2, "url");
+        }
+        std::string err;
+        if (!parse_request(L, -1, job.rq, err))
+        {
+            job.out.failed = true;
+            job.out.err = err;
+        }
+        else if (job.rq.sink == SINK_FUNCTION ||
+                 job.rq.body_kind == BODY_FUNCTION)
+        {
+            // Les threads du lot n'ont pas de lua_State.
+            job.out.failed = true;
+            job.out.err = "http: fetch_all: sink/body functions are not "
+                          "supported";
+        }
+        else
+        {
+            ++pending;
+        }
+        lua_pop(L, 1);
+    }
 
-    int body_type = lua_type(L, 2);
-    int opts_arg = 3;
-    bool have_body = false;
-    if (body_type == LUA_TSTRING)
+    HttpPool local_pool;
+    if (pool == nullptr)
     {
-        have_body = true;
+        local_pool.max_per_host = static_cast<size_t>(concurrency);
+        pool = &local_pool;
     }
-    else if (body_type == LUA_TTABLE)
+
+    // Le thread appelant travaille aussi : concurrency - 1 threads
+    // en plus, et un échec de création ne bloque pas le lot. Signaux
+    // bloqués dans les threads (comme le pool DNS de socket) : les
+    // handlers babet.signal restent sur le thread principal.
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> threads;
+    size_t extra = std::min(static_cast<size_t>(concurrency), pending);
+    extra = (extra > 0) ? extra - 1 : 0;
+    if (extra > 0)
     {
-        // forme post(url, opts) : 2e arg = opts, pas de corps
-        opts_arg = 2;
+        sigset_t all;
+        sigset_t old;
+        sigfillset(&all);
+        pthread_sigmask(SIG_BLOCK, &all, &old);
+        try
+        {
+            for (size_t t = 0; t < extra; ++t)
+            {
+                threads.emplace_back(fetch_run, std::ref(jobs),
+                                     std::ref(next), pool);
+            }
+        }
+        catch (const std::system_error &)
+        {
+            // Moins de threads que demandé : le lot passe quand même.
+        }
+        pthread_sigmask(SIG_SETMASK, &old, nullptr);
     }
-    else if (body_type != LUA_TNONE && body_type != LUA_TNIL)
+    fetch_run(jobs, next, pool);
+    for (auto &th : threads)
     {
-        return luaL_error(L, "http: post body must be a string");
+        th.join();
     }
 
-    lua_newtable(L);
-    int dst = lua_gettop(L);
-    if (!lua_isnoneornil(L, opts_arg))
+    lua_createtable(L, static_cast<int>(n), 0); // results
+    lua_newtable(L);                            // errors
+    for (lua_Integer i = 1; i <= n; ++i)
+    {
+        const HttpOutcome &out = jobs[static_cast<size_t>(i - 1)].out;
+        if (out.failed)
+        {
+            lua_pushboolean(L, 0);
+            lua_rawseti(L, -3, i);
+            lua_pushlstring(L, out.err.data(), out.err.size());
+            lua_rawseti(L, -2, i);
+        }
+        else
+        {
+            push_result_table(L, out);
+            lua_rawseti(L, -3, i);
+        }
+    }
+    return 2;
+}
+
+int lua_http_server(lua_State *L)
+{
+    lua_Integer threads = SERVER_DEFAULT_THREADS;
+    lua_Integer keep_alive_max = 0;
+    lua_Integer max_body = 0;
+    double keep_alive_timeout = 0.0;
+    double read_timeout = 0.0;
+    double write_timeout = 0.0;
+    size_t init_len = 0;
+    const char *init = nullptr;
+    if (!lua_isnoneornil(L, 1))
+    {
+        luaL_checktype(L, 1, LUA_TTABLE);
+        const char *int_fields[] = {"threads", "keep_alive_max", "max_body"};
+        lua_Integer *int_out[] = {&threads, &keep_alive_max, &max_body};
+        for (size_t i = 0; i < 3; ++i)
+        {
+            lua_getfield(L, 1, int_fields[i]);
+            if (!lua_isnil(L, -1))
+            {
+                if (!lua_isinteger(L, -1))
+                {
+                    return luaL_error(L, "http: '%s' must be an integer",
+                                      int_fields[i]);
+                }
+                *int_out[i] = lua_tointeger(L, -1);
+            }
+            lua_pop(L, 1);
+        }
+        const char *num_fields[] = {"keep_alive_timeout", "read_timeout",
+                                    "write_timeout"};
+        double *num_out[] = {&keep_alive_timeout, &read_timeout,
+                             &write_timeout};
+        for (size_t i = 0; i < 3; ++i)
+        {
+            lua_getfield(L, 1, num_fields[i]);
+            if (!lua_isnil(L, -1))
+            {
+                if (lua_type(L, -1) != LUA_TNUMBER)
+                {
+                    return luaL_error(L, "http: '%s' must be a number",
+                                      num_fields[i]);
+                }
+                *num_out[i] = lua_tonumber(L, -1);
+                if (!(*num_out[i] > 0.0))
+                {
+                    return push_fail(L, std::string("http: ") +
+                                            num_fields[i] + " must be > 0");
+                }
+            }
+            lua_pop(L, 1);
+        }
+        lua_getfield(L, 1, "init");
+        if (!lua_isnil(L, -1))
+        {
+            if (lua_type(L, -1) != LUA_TSTRING)
+            {
+                return luaL_error(L, "http: 'init' must be a string");
+            }
+            init = lua_tolstring(L, -1, &init_len);
+        }
+        lua_pop(L, 1); // init reste ancré par la table opts
+    }
+    if (threads < 1 || threads > SERVER_MAX_THREADS)
     {
-        luaL_checktype(L, opts_arg, LUA_TTABLE);
-        shallow_merge(L, opts_arg, dst);
+        return push_fail(L, "http: threads must be in 1..256");
     }
-    lua_pushstring(L, url);
-    lua_setfield(L, dst, "url");
-    lua_pushstring(L, "POST");
-    lua_setfield(L, dst, "method");
-    if (have_body)
+    if (keep_alive_max < 0)
     {
-        size_t blen = 0;
-        const char *bs = lua_tolstring(L, 2, &blen);
-        lua_pushlstring(L, bs, blen);
-        lua_setfield(L, dst, "body");
+        return push_fail(L, "http: keep_alive_max must be >= 0");
     }
-    return http_perform(L, dst);
+    if (max_body < 0)
+    {
+        return push_fail(L, "http: max_body must be >= 0");
+    }
+
+    void *raw = lua_newuserdatauv(L, sizeof(HttpServer), 0);
+    auto *s = new (raw) HttpServer(); // placement new : threads, mutex
+    luaL_getmetatable(L, SERVER_META);
+    lua_setmetatable(L, -2);
+    ServerOptions &o = s->opts;
+    o.threads = static_cast<size_t>(threads);
+    o.keep_alive_max = static_cast<size_t>(keep_alive_max);
+    // httplib compte le keep-alive en secondes entières.
+    o.keep_alive_timeout = static_cast<time_t>(std::ceil(keep_alive_timeout));
+    o.read_timeout = read_timeout;
+    o.write_timeout = write_timeout;
+    o.max_body = static_cast<size_t>(max_body);
+    if (init != nullptr)
+    {
+        o.init_code.assign(init, init_len);
+    }
+    return 1;
 }
 
 void register_http(lua_State *L)
 {
     // Précondition : table babet au sommet (-1), comme register_json.
+    if (luaL_newmetatable(L, SESSION_META))
+    {
+        // Méthodes via __index = la métatable elle-même.
+        lua_pushvalue(L, -1);
+        lua_setfield(L, -2, "__index");
+        lua_pushcfunction(L, session_gc);
+        lua_setfield(L, -2, "__gc");
+
+        lua_pushcfunction(L, session_request);
+        lua_setfield(L, -2, "request");
+        lua_pushcfunction(L, session_get);
+        lua_setfield(L, -2, "get");
+        lua_pushcfunction(L, session_post);
+        lua_setfield(L, -2, "post");
+        lua_pushcfunction(L, session_stats);
+        lua_setfield(L, -2, "stats");
+        lua_pushcfunction(L, session_close);
+        lua_setfield(L, -2, "close");
+    }
+    lua_pop(L, 1); // la table babet redevient au sommet
+
+    if (luaL_newmetatable(L, SERVER_META))
+    {
+        lua_pushvalue(L, -1);
+        lua_setfield(L, -2, "__index");
+        lua_pushcfunction(L, server_gc);
+        lua_setfield(L, -2, "__gc");
+
+        lua_pushcfunction(L, server_route);
+        lua_setfield(L, -2, "route");
+        lua_pushcfunction(L, server_start);
+        lua_setfield(L, -2, "start");
+        lua_pushcfunction(L, server_wait);
+        lua_setfield(L, -2, "wait");
+        lua_pushcfunction(L, server_stop);
+        lua_setfield(L, -2, "stop");
+        lua_pushcfunction(L, server_stats);
+        lua_setfield(L, -2, "stats");
+    }
+    lua_pop(L, 1);
+
     lua_newtable(L);
 
     lua_pushcfunction(L, lua_http_request);
@@ -664,5 +3416,14 @@ void register_http(lua_State *L)
     lua_pushcfunction(L, lua_http_post);
     lua_setfield(L, -2, "post");
 
+    lua_pushcfunction(L, lua_http_session);
+    lua_setfield(L, -2, "session");
+
+    lua_pushcfunction(L, lua_http_fetch_all);
+    lua_setfield(L, -2, "fetch_all");
+
+    lua_pushcfunction(L, lua_http_server);
+    lua_setfield(L, -2, "server");
+
     lua_setfield(L, -2, "http");
 }
@@ -39,9 +39,20 @@
  *   url              string  (requis) — http:// ou https://
  *   method           string  (défaut "GET")
  *   headers          table   { ["Name"] = "value", ... }
- *   body             string  (méthodes à corps uniquement ; un body
- *                            sur GET/HEAD/OPTIONS renvoie (nil, err)
- *                            — pas de comportement muet)
+ *   body             string|function (méthodes à corps uniquement ;
+ *                            un corps sur GET/HEAD/OPTIONS renvoie
+ *                            (nil, err) — pas de comportement muet).
+ *                            Fonction : fournisseur appelé sans
+ *                            argument jusqu'à ce qu'il rende nil,
+ *                            chaque string est un morceau envoyé en
+ *                            Transfer-Encoding: chunked.
+ *   body_file        string  chemin d'un fichier régulier envoyé par
+ *                            tranches (Content-Length = sa taille).
+ *   multipart        table   { { name=, data= | file=, filename=?,
+ *                            content_type=? }, ... } -> corps
+ *                            multipart/form-data, parties fichier
+ *                            lues à l'envoi. body, body_file et
+ *                            multipart sont mutuellement exclusifs.
  *   query            table   { k = v, ... } -> ?k=v&... (percent-encodé)
  *   timeout          number  secondes > 0, plafond GLOBAL bout-en-bout
  *                            (équivalent --max-time de curl) appliqué
@@ -49,9 +60,22 @@
  *   verify           bool    (défaut true) — vérif. cert. serveur TLS
  *   ca_cert          string  chemin d'un bundle CA (optionnel)
  *   follow_redirects bool    (défaut false) — pas de magie silencieuse
+ *   sink             string|function — corps livré hors mémoire :
+ *                            chemin (fichier tronqué/créé à la
+ *                            réception des en-têtes, supprimé si la
+ *                            requête échoue) ou fn(chunk) appelée
+ *                            par morceau (renvoyer false annule ;
+ *                            une erreur levée dans fn est relevée).
+ *                            result.body est alors absent,
+ *                            result.bytes donne les octets reçus.
+ *   max_body         integer octets > 0 — plafond du corps reçu
+ *                            (Content-Length puis compte réel) ;
+ *                            dépassement -> (nil, "http: body
+ *                            exceeds max_body (N bytes)").
  *
- * Périmètre v1 : pas de streaming, multipart, cookies, session,
- * keep-alive exposé. Ajoutable plus tard sous SemVer sans casse.
+ * Périmètre v1 : pas de cookies. Ajoutable
+ * plus tard sous SemVer sans casse. Le keep-alive passe par les
+ * sessions (lua_http_session).
  *
  * get(url [, opts])            -> request{ url=url, method="GET",  ...opts }
  * post(url [, body] [, opts])  -> request{ url=url, method="POST", ... }
@@ -61,6 +85,97 @@ int lua_http_request(lua_State *L);
 int lua_http_get(lua_State *L);
 int lua_http_post(lua_State *L);
 
+/**
+ * @brief babet.http.session([opts]) -> session | (nil, err)
+ *
+ * Pool de Client httplib en keep-alive, rangés par origine
+ * (scheme://host:port) ET configuration de confiance (verify,
+ * ca_cert). Une requête de session emprunte un Client au repos pour
+ * son origine (hit) ou en crée un (miss), puis le rend au pool si
+ * une réponse a été reçue. Évite connect + handshake TLS + chargement
+ * du bundle CA à chaque appel vers la même origine.
+ *
+ * opts (table, optionnelle) :
+ *   max_per_host  integer >= 1  (défaut 4) — Client gardés au repos
+ *                               par origine ; l'excédent est fermé.
+ *   idle_timeout  number  > 0   (défaut 30, secondes) — un Client
+ *                               au repos depuis plus longtemps est
+ *                               fermé au lieu d'être réutilisé.
+ *
+ * Mauvais TYPE -> luaL_error ; mauvaise VALEUR -> (nil, err).
+ *
+ * Méthodes : mêmes contrats que les fonctions du module.
+ *   sess:request(opts), sess:get(url [, opts]),
+ *   sess:post(url [, body] [, opts])
+ *   sess:stats()  -> { hits, misses, expired, idle, hosts }
+ *   sess:close()  -> ferme les connexions au repos ; les requêtes
+ *                    suivantes renvoient (nil, "http: session is
+ *                    closed"). Idempotent, aussi fait par __gc.
+ */
+int lua_http_session(lua_State *L);
+
+/**
+ * @brief babet.http.fetch_all(requests [, opts]) -> results, errors
+ *
+ * Exécute un lot de requêtes sur des threads natifs (pas de
+ * lua_State par requête) et rend les résultats dans l'ordre.
+ *
+ * requests : liste d'URL (GET) ou de tables d'opts (même format que
+ *            request). Les callbacks (sink / body fonctions) sont
+ *            refusés : les threads n'ont pas de lua_State.
+ * opts :
+ *   concurrency  integer [1, 256] (défaut 8) — threads, le thread
+ *                appelant compris.
+ *   session      session — pool à utiliser (sinon pool jetable,
+ *                max_per_host = concurrency).
+ *
+ * results[i] = table result (comme request), ou false en cas
+ * d'échec ; errors[i] = "http: ..." pour ces échecs. Une requête
+ * invalide n'arrête pas le lot. Mauvais TYPE (requests, élément,
+ * opts) -> luaL_error ; concurrency hors bornes ou session fermée ->
+ * (nil, err).
+ */
+int lua_http_fetch_all(lua_State *L);
+
+/**
+ * @brief babet.http.server([opts]) -> srv
+ *
+ * Serveur HTTP embarqué (httplib::Server). Chaque thread du serveur
+ * possède un lua_State préchauffé (stdlib, babet.*, require comme un
+ * worker) ; une connexion, keep-alive compris, est servie de bout en
+ * bout par un seul thread. Les handlers sont des chunks de code ou
+ * des chemins "mod.fn" (une fonction Lua ne change pas d'état).
+ *
+ * opts (table, optionnelle) :
+ *   threads             integer [1, 256] (défaut 8)
+ *   init                string — chunk exécuté une fois par thread
+ *                       avant les handlers (require, globals).
+ *   keep_alive_max      integer >= 0 — requêtes par connexion
+ *   keep_alive_timeout  number > 0 (secondes, arrondi au-dessus)
+ *   read_timeout        number > 0 (secondes)
+ *   write_timeout       number > 0 (secondes)
+ *   max_body            integer >= 0 — plafond du corps de requête
+ *   (0 ou absent = défaut de cpp-httplib)
+ *
+ * Méthodes :
+ *   srv:route(method, pattern, handler [, { stream = bool }]) -> srv
+ *       GET (sert aussi HEAD), POST, PUT, PATCH, DELETE, OPTIONS.
+ *       Le handler reçoit req via `...` : method, path, query,
+ *       headers, params, captures, remote_addr, remote_port, et body
+ *       (ou read(fn) si stream). Il renvoie une string (200), nil
+ *       (204) ou { status, headers, body = string|function, file }.
+ *       Erreur du handler -> 500.
+ *   srv:start([host [, port]]) -> port | (nil, err)  (non bloquant,
+ *       défaut 127.0.0.1, port 0 = choisi par le noyau)
+ *   srv:wait([timeout]) -> true (écoute terminée) | false (délai)
+ *   srv:stop()  — attend les requêtes en cours ; idempotent, __gc.
+ *   srv:stats() -> { requests, errors, last_error, threads, port,
+ *                    running }
+ *
+ * Mauvais TYPE -> luaL_error ; mauvaise VALEUR -> (nil, err).
+ */
+int lua_http_server(lua_State *L);
+
 /**
  * @brief Construit la sous-table `http` et l'attache à babet.
  *
@@ -575,6 +575,16 @@ namespace
 
 } // namespace
 
+int inotify_watcher_fd(lua_State *L, int idx)
+{
+    Watcher *w = static_cast<Watcher *>(luaL_testudata(L, idx, INOT_META));
+    if (w == nullptr)
+    {
+        return -2;
+    }
+    return w->fd;
+}
+
 void register_inotify(lua_State *L)
 {
     // 1. Métatable LuapilotInotify dans le registry (une fois).
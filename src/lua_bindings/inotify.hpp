@@ -116,4 +116,9 @@ struct lua_State;
 // comme champ "inotify" de babet).
 void register_inotify(lua_State *L);
 
+// FD noyau du watcher à l'index idx, pour les modules qui veulent
+// l'attendre avec d'autres FD (babet.socket.poller). Renvoie -1 si
+// le watcher est fermé, -2 si la valeur n'est pas un watcher.
+int inotify_watcher_fd(lua_State *L, int idx);
+
 #endif // LUA_BINDINGS_INOTIFY_HPP
@@ -1,14 +1,25 @@
 #include "socket.hpp"
+#include "inotify.hpp"
 #include "lua_utils.hpp"
 #include "signal.hpp"
 
+#include <algorithm>
+#include <cctype>
 #include <cerrno>
+#include <cstddef>
 #include <chrono>
 #include <climits>
 #include <cmath>
+#include <condition_variable>
+#include <csignal>
 #include <cstring>
+#include <deque>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include <arpa/inet.h>
@@ -17,9 +28,14 @@
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/un.h>
 #include <unistd.h>
 
 // OpenSSL : sous-étape 1 du Chantier 7 (TLS sockets). Les libs sont
@@ -35,46 +51,57 @@ namespace
 
     constexpr const char *SOCK_META = "LuapilotSocket";
 
-    // État porté par l'userdata. Tenu minimal : fd, mode listen,
-    // timeout en ms. Le buffer de readline est externalisé hors
-    // userdata pour ne pas alourdir la structure (chaque appel
-    // recv_line alloue son propre std::string temporaire).
+    // État porté par l'userdata : fd, mode listen, timeout en ms,
+    // session TLS éventuelle et tampon de lecture.
     //
     // Champ ssl (sous-étape 1 du Chantier 7) :
     //   nullptr  = socket TCP brut (cas par défaut).
     //   non-null = socket TLS connecté. Toutes les méthodes send/recv/
-    //              recv_line/recv_all/close/... testeront ce champ et
-    //              utiliseront SSL_read/SSL_write au lieu de recv/send
-    //              (sous-étape 3). Pour l'instant, le champ existe
-    //              mais aucune fonction ne le branche encore.
+    //              recv_line/recv_all/close/... testent ce champ et
+    //              utilisent SSL_read/SSL_write au lieu de recv/send.
+    //
+    // Tampon de lecture (remplace recv_line_pending) : les octets
+    // utiles sont rbuf[rpos, rend). rbuf.size() est la capacité ;
+    // elle est allouée au premier remplissage (RBUF_SIZE), grandit
+    // pour une ligne plus longue que le tampon, et est rendue quand
+    // le tampon se vide après avoir grossi. recv, recv_line,
+    // recv_until et recv_all consomment tous ce tampon AVANT de lire
+    // le socket : un recv(n) après un recv_line rend les octets déjà
+    // tirés du noyau, rien n'est perdu ni réordonné.
+    //
+    // Il reprend aussi la garantie du CORRECTIF post-bug bot IRC :
+    // si recv_line a lu N octets puis tombe en timeout (pas de \n
+    // vu), ces octets restent dans le tampon pour le prochain appel,
+    // de façon transparente côté script.
+    struct Poller;
     struct Sock
     {
         int fd;         // -1 si fermé
         bool listening; // true si listen(), false si connect()/accept()
         int timeout_ms; // 0 = pas de timeout (bloquant infini)
         SSL *ssl;       // nullptr en TCP brut, non-null après TLS handshake
-
-        // CORRECTIF (post-bug bot IRC) : buffer persistant pour recv_line.
-        // Si recv_line a lu N octets puis tombe en timeout (pas de \n vu),
-        // les octets DOIVENT être conservés pour le prochain appel —
-        // sinon ils sont perdus (déjà consommés du socket par recv()).
-        // Bug reproductible : mettre set_timeout(1) sur un flux IRC et
-        // les premiers octets de certaines lignes étaient mangés. Le
-        // contrat (nil, "closed", partial) sur EOF documentait déjà
-        // l'intention de "ne pas perdre les octets déjà lus" ; on
-        // étend cette garantie au timeout, de façon TRANSPARENTE
-        // côté script (le buffer est interne, pas un partial à gérer).
-        std::string recv_line_pending;
+        SSL_CTX *server_ctx; // listen_tls : context serveur (référence tenue), nullptr sinon
+        int handshake_ms;    // listen_tls : délai max du handshake d'un client
+        int type;       // SOCK_STREAM (TCP, unix) ou SOCK_DGRAM (UDP, unix)
+        int family;     // AF_INET / AF_INET6 / AF_UNIX, AF_UNSPEC si inconnu
+
+        std::string rbuf; // tampon de lecture (capacité = size())
+        size_t rpos;      // début des octets non consommés
+        size_t rend;      // fin des octets valides
+
+        // Pollers où le socket est inscrit : leur ensemble `buffered`
+        // suit le remplissage / vidage du tampon (cf.
+        // poller_sync_buffered).
+        std::vector<Poller *> pollers;
     };
-
     Sock *check_sock(lua_State *L, int idx)
     {
         return static_cast<Sock *>(luaL_checkudata(L, idx, SOCK_META));
     }
 
     // Pousse un nouveau userdata Sock initialisé, métatable posée.
-    // CORRECTIF (placement new) : Sock contient maintenant un
-    // std::string (recv_line_pending) dont le constructeur doit être
+    // CORRECTIF (placement new) : Sock contient un std::string
+    // (rbuf, tampon de lecture) dont le constructeur doit être
     // appelé explicitement, lua_newuserdata ne faisant qu'un malloc.
     // Le destructeur est appelé symétriquement dans sock_gc.
     Sock *push_new_sock(lua_State *L, int fd, bool listening)
@@ -85,7 +112,13 @@ namespace
         s->listening = listening;
         s->timeout_ms = 0;
         s->ssl = nullptr; // TCP brut par défaut, TLS posé après par connect_tls/starttls
-        // recv_line_pending : déjà initialisé à "" par le constructeur par défaut.
+        s->server_ctx = nullptr;
+        s->handshake_ms = 0;
+        s->type = SOCK_STREAM; // datagramme : posé par udp() / unix_dgram()
+        s->family = AF_UNSPEC;
+        // rbuf : vide, alloué au premier remplissage (cf. fill_rbuf).
+        s->rpos = 0;
+        s->rend = 0;
         luaL_getmetatable(L, SOCK_META);
         lua_setmetatable(L, -2);
         return s;
@@ -296,11 +329,12 @@ namespace
     // (premier appel suffit, idempotent). Pas de SSL_library_init()
     // explicite (déprécié). Pas de SSL_load_error_strings() (idem).
     //
-    // SSL_CTX global créé en lazy au premier connect_tls/starttls. Un
-    // seul context partagé pour toutes les connexions client : pas de
-    // raison d'en avoir plusieurs, OpenSSL est thread-safe sur SSL_CTX
-    // partagé. Le SSL_CTX est protégé par la durée de vie du processus
-    // (jamais détruit explicitement : libéré à l'exit, négligeable).
+    // SSL_CTX client créés en lazy au premier connect_tls/starttls,
+    // un par configuration de confiance (cf. tls_client_ctx) : les
+    // connexions qui partagent verify / ca_cert / ca_path partagent
+    // le context, OpenSSL est thread-safe sur SSL_CTX partagé. Les
+    // SSL_CTX sont protégés par la durée de vie du processus (jamais
+    // détruits explicitement : libérés à l'exit, négligeable).
     //
     // Versions : TLS_client_method() est la méthode "any version"
     // moderne (OpenSSL >= 1.1.0). On force TLS 1.2 minimum via
@@ -308,15 +342,13 @@ namespace
     //
     // Verify paths : SSL_CTX_set_default_verify_paths() + probing
     // runtime des emplacements connus de CA bundles. Le détail est
-    // documenté dans init_openssl_ctx() ci-dessous. Cohérent avec
+    // documenté dans configure_client_ctx() ci-dessous. Cohérent avec
     // TLS-5 (CA système par défaut).
     //
     // Politique d'erreur : aucune exception ne traverse vers Lua
     // (invariant codebase). En cas d'échec d'init, on retourne nullptr
     // et on remplit un message d'erreur lisible.
 
-    SSL_CTX *g_tls_ctx = nullptr;
-
     // Construit un message d'erreur lisible à partir de la pile
     // d'erreurs OpenSSL. Vide la pile après lecture.
     // Préfixe "tls: " toujours présent (cohérence avec "socket: ",
@@ -368,12 +400,10 @@ namespace
         return msg;
     }
 
-    // Initialise le SSL_CTX global (lazy, idempotent). Renvoie true
-    // si OK, false avec err rempli sinon.
+    // Configure un SSL_CTX client neuf. Renvoie true si OK, false
+    // avec err rempli sinon (l'appelant libère le ctx).
     //
     // Configuration appliquée :
-    //   - TLS_client_method() (any version, négocie vers la plus haute
-    //     supportée mutuellement)
     //   - TLS 1.2 minimum (TLS-D)
     //   - SSL_VERIFY_PEER + verify_cb par défaut (rejet sur cert invalide
     //     côté OpenSSL ; le hostname check est posé par SSL session, pas
@@ -383,158 +413,119 @@ namespace
     //     mêmes les renégociations transparentes sans retourner
     //     SSL_ERROR_WANT_READ/WRITE en pleine opération applicative
     //
-    // NB : aucune exception, aucun goto. Politique RAII manuelle sur
-    // SSL_CTX (libéré seulement si erreur de config en cours d'init).
-    // CORRECTIF (post-revue Gemini) : init thread-safe.
-    // Avant les workers, l'init était lazy ("if (g_tls_ctx) return")
-    // mais ce pattern est cassé en multi-thread : deux workers qui
-    // appellent connect_tls() exactement en même temps peuvent
-    // tomber dans la branche d'allocation tous les deux, leaker
-    // un SSL_CTX, et provoquer une race sur la configuration.
-    //
-    // std::call_once garantit que la fermeture passée est exécutée
-    // exactement une fois, peu importe le nombre de threads
-    // concurrents. Les autres threads bloquent jusqu'à la fin de
-    // l'init, puis voient le résultat.
-    std::once_flag g_tls_init_flag;
-    bool g_tls_init_success = false;
-    std::string g_tls_init_err;
-
-    bool init_openssl_ctx(std::string &err)
-    {
-        std::call_once(g_tls_init_flag, []()
-                       {
-            // Premier appel idempotent depuis OpenSSL 1.1.0.
-            OPENSSL_init_ssl(OPENSSL_INIT_LOAD_SSL_STRINGS |
-                                 OPENSSL_INIT_LOAD_CRYPTO_STRINGS,
-                             nullptr);
-
-            SSL_CTX *ctx = SSL_CTX_new(TLS_client_method());
-            if (ctx == nullptr)
-            {
-                g_tls_init_err = format_tls_error("SSL_CTX_new failed");
-                g_tls_init_success = false;
-                return;
-            }
+    // NB : aucune exception, aucun goto. L'init thread-safe (CORRECTIF
+    // post-revue Gemini, autrefois un std::call_once sur le CTX
+    // global) est assurée par le mutex du cache, cf. tls_client_ctx.
+    bool configure_client_ctx(SSL_CTX *ctx, std::string &err)
+    {
+        // TLS 1.2 minimum (TLS-D). TLS 1.3 sera négocié
+        // automatiquement si dispo des deux côtés.
+        if (SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION) != 1)
+        {
+            err = format_tls_error(
+                "set_min_proto_version(TLS1_2) failed");
+            return false;
+        }
 
-            // TLS 1.2 minimum (TLS-D). TLS 1.3 sera négocié
-            // automatiquement si dispo des deux côtés.
-            if (SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION) != 1)
-            {
-                g_tls_init_err = format_tls_error(
-                    "set_min_proto_version(TLS1_2) failed");
-                SSL_CTX_free(ctx);
-                g_tls_init_success = false;
-                return;
-            }
+        // ====== Verify paths : CA bundle system =================
+        // Le bundle CA n'a pas un emplacement standard unique sur
+        // Linux/BSD ; chaque distro choisit son chemin. Comme
+        // notre OpenSSL est vendored et statiquement linké, on ne
+        // peut pas se reposer sur la config système du paquet
+        // openssl de la distro.
+        //
+        // Stratégie en deux passes :
+        //   1) SSL_CTX_set_default_verify_paths() : utilise les
+        //      chemins compile-time d'OpenSSL (configurés via
+        //      --openssldir=/etc/ssl dans build_local.sh) ET les
+        //      variables d'env SSL_CERT_FILE / SSL_CERT_DIR si
+        //      définies. Couvre Arch/Debian/Ubuntu/Alpine.
+        //   2) Probing d'une liste de chemins connus pour les
+        //      autres distros (Fedora/RHEL, OpenSUSE, *BSD).
+        //      On charge via SSL_CTX_load_verify_locations() qui
+        //      est additif (peut être appelé plusieurs fois).
+        //
+        // Politique : aucune des deux passes n'est obligatoire.
+        // Si rien n'est chargé, on continue quand même — le user
+        // peut toujours passer ca_cert explicitement, ou faire
+        // verify=false. Un fail dur ici casserait des usages
+        // légitimes (TLS sans verify, ou serveur interne avec
+        // ca_cert fourni).
+        //
+        // Passe 1 : chemins compile-time + env vars
+        if (SSL_CTX_set_default_verify_paths(ctx) != 1)
+        {
+            // Pas fatal. On vide la pile d'erreur pour que les
+            // prochains appels OpenSSL ne ramassent pas cette
+            // erreur résiduelle.
+            ERR_clear_error();
+        }
 
-            // ====== Verify paths : CA bundle system =================
-            // Le bundle CA n'a pas un emplacement standard unique sur
-            // Linux/BSD ; chaque distro choisit son chemin. Comme
-            // notre OpenSSL est vendored et statiquement linké, on ne
-            // peut pas se reposer sur la config système du paquet
-            // openssl de la distro.
-            //
-            // Stratégie en deux passes :
-            //   1) SSL_CTX_set_default_verify_paths() : utilise les
-            //      chemins compile-time d'OpenSSL (configurés via
-            //      --openssldir=/etc/ssl dans build_local.sh) ET les
-            //      variables d'env SSL_CERT_FILE / SSL_CERT_DIR si
-            //      définies. Couvre Arch/Debian/Ubuntu/Alpine.
-            //   2) Probing d'une liste de chemins connus pour les
-            //      autres distros (Fedora/RHEL, OpenSUSE, *BSD).
-            //      On charge via SSL_CTX_load_verify_locations() qui
-            //      est additif (peut être appelé plusieurs fois).
-            //
-            // Politique : aucune des deux passes n'est obligatoire.
-            // Si rien n'est chargé, on continue quand même — le user
-            // peut toujours passer ca_cert explicitement, ou faire
-            // verify=false. Un fail dur ici casserait des usages
-            // légitimes (TLS sans verify, ou serveur interne avec
-            // ca_cert fourni).
-            //
-            // Passe 1 : chemins compile-time + env vars
-            if (SSL_CTX_set_default_verify_paths(ctx) != 1)
+        // Passe 2 : probing des emplacements connus.
+        // Le premier qui marche s'arrête (les CA system sont
+        // typiquement le même contenu partout, pas besoin de
+        // charger plusieurs sources).
+        struct CABundleCandidate
+        {
+            const char *file;
+            const char *dir;
+        };
+        static const CABundleCandidate candidates[] = {
+            // Debian / Ubuntu / Arch / Alpine / Gentoo
+            {"/etc/ssl/certs/ca-certificates.crt", "/etc/ssl/certs"},
+            // Fedora / RHEL / CentOS / Rocky / Alma
+            {"/etc/pki/tls/certs/ca-bundle.crt", "/etc/pki/tls/certs"},
+            // OpenSUSE
+            {"/etc/ssl/ca-bundle.pem", nullptr},
+            {"/var/lib/ca-certificates/ca-bundle.pem", nullptr},
+            // FreeBSD (security/ca_root_nss)
+            {"/usr/local/etc/ssl/cert.pem", "/usr/local/etc/ssl/certs"},
+            // NetBSD
+            {"/etc/openssl/certs/ca-certificates.crt",
+             "/etc/openssl/certs"},
+        };
+
+        for (const auto &c : candidates)
+        {
+            const char *use_file = nullptr;
+            const char *use_dir = nullptr;
+            if (c.file && ::access(c.file, R_OK) == 0)
             {
-                // Pas fatal. On vide la pile d'erreur pour que les
-                // prochains appels OpenSSL ne ramassent pas cette
-                // erreur résiduelle.
-                ERR_clear_error();
+                use_file = c.file;
             }
-
-            // Passe 2 : probing des emplacements connus.
-            // Le premier qui marche s'arrête (les CA system sont
-            // typiquement le même contenu partout, pas besoin de
-            // charger plusieurs sources).
-            struct CABundleCandidate
-            {
-                const char *file;
-                const char *dir;
-            };
-            static const CABundleCandidate candidates[] = {
-                // Debian / Ubuntu / Arch / Alpine / Gentoo
-                {"/etc/ssl/certs/ca-certificates.crt", "/etc/ssl/certs"},
-                // Fedora / RHEL / CentOS / Rocky / Alma
-                {"/etc/pki/tls/certs/ca-bundle.crt", "/etc/pki/tls/certs"},
-                // OpenSUSE
-                {"/etc/ssl/ca-bundle.pem", nullptr},
-                {"/var/lib/ca-certificates/ca-bundle.pem", nullptr},
-                // FreeBSD (security/ca_root_nss)
-                {"/usr/local/etc/ssl/cert.pem", "/usr/local/etc/ssl/certs"},
-                // NetBSD
-                {"/etc/openssl/certs/ca-certificates.crt",
-                 "/etc/openssl/certs"},
-            };
-
-            for (const auto &c : candidates)
-            {
-                const char *use_file = nullptr;
-                const char *use_dir = nullptr;
-                if (c.file && ::access(c.file, R_OK) == 0)
-                {
-                    use_file = c.file;
-                }
-                if (c.dir)
-                {
-                    struct stat st;
-                    if (::stat(c.dir, &st) == 0 && S_ISDIR(st.st_mode))
-                    {
-                        use_dir = c.dir;
-                    }
-                }
-                if (use_file == nullptr && use_dir == nullptr)
-                {
-                    continue;
-                }
-                if (SSL_CTX_load_verify_locations(ctx, use_file, use_dir)
-                    == 1)
+            if (c.dir)
+            {
+                struct stat st;
+                if (::stat(c.dir, &st) == 0 && S_ISDIR(st.st_mode))
                 {
-                    break; // CA chargé, stop le probing
+                    use_dir = c.dir;
                 }
-                // Échec sur ce chemin (rare : fichier illisible,
-                // format inconnu) : vider l'erreur et essayer le
-                // suivant.
-                ERR_clear_error();
             }
+            if (use_file == nullptr && use_dir == nullptr)
+            {
+                continue;
+            }
+            if (SSL_CTX_load_verify_locations(ctx, use_file, use_dir)
+                == 1)
+            {
+                break; // CA chargé, stop le probing
+            }
+            // Échec sur ce chemin (rare : fichier illisible,
+            // format inconnu) : vider l'erreur et essayer le
+            // suivant.
+            ERR_clear_error();
+        }
 
-            // Vérification activée par défaut (TLS-C : verify=true).
-            // verify_cb = nullptr : comportement OpenSSL par défaut
-            // (rejette si verify_result != X509_V_OK).
-            SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, nullptr);
-
-            // AUTO_RETRY : SSL_read/SSL_write gèrent les
-            // renégociations transparentes sans renvoyer WANT_READ/
-            // WANT_WRITE à l'appli.
-            SSL_CTX_set_mode(ctx, SSL_MODE_AUTO_RETRY);
+        // Vérification activée par défaut (TLS-C : verify=true).
+        // verify_cb = nullptr : comportement OpenSSL par défaut
+        // (rejette si verify_result != X509_V_OK).
+        SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, nullptr);
 
-            g_tls_ctx = ctx;
-            g_tls_init_success = true; });
+        // AUTO_RETRY : SSL_read/SSL_write gèrent les
+        // renégociations transparentes sans renvoyer WANT_READ/
+        // WANT_WRITE à l'appli.
+        SSL_CTX_set_mode(ctx, SSL_MODE_AUTO_RETRY);
 
-        if (!g_tls_init_success)
-        {
-            err = g_tls_init_err;
-            return false;
-        }
         return true;
     }
 
@@ -546,9 +537,93 @@ namespace
         std::string ca_path;     // chemin dossier (optionnel)
         std::string hostname;    // override (vide = utiliser host)
         std::string min_version; // "1.2" (défaut) ou "1.3"
+        std::string alpn;        // protocoles ALPN proposés, format fil (vide = aucun)
         int timeout_ms = 0;      // 0 = bloquant infini
     };
 
+    // opts.alpn : liste de noms de protocole ({ "h2", "http/1.1" }),
+    // par ordre de préférence, convertie au format fil d'OpenSSL
+    // (un octet de longueur puis le nom, bout à bout).
+    bool parse_alpn(lua_State *L, int idx, std::string &wire,
+                    std::string &err)
+    {
+        lua_getfield(L, idx, "alpn");
+        if (lua_isnil(L, -1))
+        {
+            lua_pop(L, 1);
+            return true;
+        }
+        if (!lua_istable(L, -1))
+        {
+            err = "tls: opts.alpn must be a table of strings";
+            lua_pop(L, 1);
+            return false;
+        }
+        lua_Integer n = static_cast<lua_Integer>(lua_rawlen(L, -1));
+        for (lua_Integer i = 1; i <= n; ++i)
+        {
+            lua_rawgeti(L, -1, i);
+            size_t len = 0;
+            const char *proto = lua_type(L, -1) == LUA_TSTRING
+                                    ? lua_tolstring(L, -1, &len)
+                                    : nullptr;
+            if (proto == nullptr || len == 0 || len > 255)
+            {
+                err = "tls: opts.alpn entries must be strings of 1 to 255 bytes";
+                lua_pop(L, 2);
+                return false;
+            }
+            wire += static_cast<char>(len);
+            wire.append(proto, len);
+            lua_pop(L, 1);
+        }
+        lua_pop(L, 1);
+        return true;
+    }
+
+    // opts.timeout (number en secondes, même convention que partout).
+    // Absent : out inchangé.
+    bool parse_tls_timeout(lua_State *L, int idx, int &out,
+                           std::string &err)
+    {
+        lua_getfield(L, idx, "timeout");
+        if (lua_isnil(L, -1))
+        {
+            lua_pop(L, 1);
+            return true;
+        }
+        if (lua_type(L, -1) != LUA_TNUMBER)
+        {
+            err = "tls: opts.timeout must be a number";
+            lua_pop(L, 1);
+            return false;
+        }
+        lua_Number t = lua_tonumber(L, -1);
+        lua_pop(L, 1);
+        if (std::isnan(t) || !std::isfinite(t))
+        {
+            err = "tls: opts.timeout must be finite (not NaN or inf)";
+            return false;
+        }
+        if (t < 0.0)
+        {
+            err = "tls: opts.timeout must be >= 0";
+            return false;
+        }
+        out = 0;
+        if (t > 0.0)
+        {
+            double ms = t * 1000.0;
+            if (ms > static_cast<double>(INT_MAX))
+            {
+                err = "tls: opts.timeout too large";
+                return false;
+            }
+            out = (ms < 1.0) ? 1 : static_cast<int>(ms);
+        }
+        return true;
+    }
+
     // Lit les opts depuis une table Lua à l'index donné (ou nil/absent).
     // Renvoie true en succès, false avec err rempli sur type invalide.
     // Politique stricte : types attendus (boolean/string/number), refuse
@@ -644,44 +719,11 @@ namespace
         }
         lua_pop(L, 1);
 
-        // opts.timeout (number en secondes, même convention que partout)
-        lua_getfield(L, idx, "timeout");
-        if (!lua_isnil(L, -1))
+        if (!parse_alpn(L, idx, opts.alpn, err))
         {
-            if (lua_type(L, -1) != LUA_TNUMBER)
-            {
-                err = "tls: opts.timeout must be a number";
-                lua_pop(L, 1);
-                return false;
-            }
-            lua_Number t = lua_tonumber(L, -1);
-            if (std::isnan(t) || !std::isfinite(t))
-            {
-                err = "tls: opts.timeout must be finite (not NaN or inf)";
-                lua_pop(L, 1);
-                return false;
-            }
-            if (t < 0.0)
-            {
-                err = "tls: opts.timeout must be >= 0";
-                lua_pop(L, 1);
-                return false;
-            }
-            if (t > 0.0)
-            {
-                double ms = t * 1000.0;
-                if (ms > static_cast<double>(INT_MAX))
-                {
-                    err = "tls: opts.timeout too large";
-                    lua_pop(L, 1);
-                    return false;
-                }
-                opts.timeout_ms = (ms < 1.0) ? 1 : static_cast<int>(ms);
-            }
+            return false;
         }
-        lua_pop(L, 1);
-
-        return true;
+        return parse_tls_timeout(L, idx, opts.timeout_ms, err);
     }
 
     // Applique les options à un SSL* avant le handshake.
@@ -691,11 +733,8 @@ namespace
     // opts.hostname (le check serait sinon basé sur "127.0.0.1" ou
     // l'adresse IP, donc échouerait pour un vrai cert).
     //
-    // ATTENTION : les options ca_cert / ca_path modifient le SSL_CTX
-    // GLOBAL en v1 (pas par-connexion). C'est une limite acceptée :
-    // pour des cas multi-CA strictement isolés, attendre une v2 qui
-    // créerait un CTX par-connexion. Pour 99% des cas (bot IRC, SMTP,
-    // etc.), les CA système suffisent et ca_cert n'est même pas utilisé.
+    // ca_cert / ca_path ne passent pas par ici : ils choisissent le
+    // SSL_CTX lui-même (cf. tls_client_ctx).
     bool apply_tls_options(SSL *ssl, const TlsOptions &opts,
                            const char *host_default, std::string &err)
     {
@@ -727,62 +766,477 @@ namespace
             SSL_set_verify(ssl, SSL_VERIFY_NONE, nullptr);
         }
 
-        // CA cert / CA path : load via SSL_CTX_load_verify_locations
-        // (cf. note sur le CTX global ci-dessus).
+        // min_version : "1.2" déjà posé sur le CTX (configure_client_ctx).
+        // "1.3" surcharge par-connexion.
+        if (opts.min_version == "1.3")
+        {
+            if (SSL_set_min_proto_version(ssl, TLS1_3_VERSION) != 1)
+            {
+                err = format_tls_error("set_min_proto_version(TLS1_3) failed");
+                return false;
+            }
+        }
+
+        // ALPN : SSL_set_alpn_protos renvoie 0 en succès (à l'inverse
+        // du reste de l'API).
+        if (!opts.alpn.empty() &&
+            SSL_set_alpn_protos(ssl,
+                                reinterpret_cast<const unsigned char *>(opts.alpn.data()),
+                                static_cast<unsigned int>(opts.alpn.size())) != 0)
+        {
+            err = format_tls_error("SSL_set_alpn_protos failed");
+            return false;
+        }
+
+        return true;
+    }
+
+    // -----------------------------------------------------------------
+    // Cache de SSL_CTX client et reprise de session
+    // -----------------------------------------------------------------
+    //
+    // Un SSL_CTX par configuration de confiance, clé (verify, ca_cert,
+    // ca_path). Remplace le SSL_CTX global unique, où ca_cert / ca_path
+    // étaient chargés par SSL_CTX_load_verify_locations sur le context
+    // partagé : deux workers avec des CA différents se marchaient
+    // dessus (cf. notes.md §2). Ici un ca_cert ne touche que SON
+    // context, construit une fois puis réutilisé.
+    //
+    // Chaque context garde aussi les sessions TLS reçues, clé
+    // "host:port" + SNI : une reconnexion au même serveur reprend la
+    // session (ticket TLS 1.3 ou session TLS 1.2) et saute la
+    // vérification de certificat et l'échange de clés complet.
+    // verify fait partie de la clé du context : une session ouverte
+    // sans vérification ne peut jamais servir à une connexion
+    // verify=true.
+    //
+    // TLS 1.3 : le serveur envoie ses tickets APRÈS le handshake ;
+    // OpenSSL les traite à la première lecture (SSL_read), d'où le
+    // callback new_session plutôt qu'un SSL_get1_session juste après
+    // SSL_connect. Un ticket TLS 1.3 est à usage unique (RFC 8446
+    // §C.4) : retiré du cache quand il est repris, le serveur en
+    // renvoie un neuf.
+
+    constexpr size_t TLS_CTX_CACHE_MAX = 64;
+    constexpr size_t TLS_SESSION_CACHE_MAX = 1024;
+
+    struct TlsCtxEntry
+    {
+        SSL_CTX *ctx = nullptr;
+        std::mutex mu; // protège sessions (callback depuis n'importe quel thread)
+        std::unordered_map<std::string, SSL_SESSION *> sessions;
+    };
+
+    std::mutex g_tls_ctx_mu;
+    std::unordered_map<std::string, TlsCtxEntry *> g_tls_ctxs;
+    int g_tls_session_key_idx = -1; // ex_data SSL : clé de session (std::string *)
+
+    // free_func des ex_data qui portent une std::string * (clé de
+    // session d'un SSL, protocoles ALPN d'un SSL_CTX serveur).
+    void free_ex_string(void *, void *ptr, CRYPTO_EX_DATA *, int, long,
+                        void *)
+    {
+        delete static_cast<std::string *>(ptr);
+    }
+
+    // Appelé par OpenSSL pour chaque session / ticket reçu. Renvoie 1 :
+    // on garde la référence sur sess.
+    int tls_new_session_cb(SSL *ssl, SSL_SESSION *sess)
+    {
+        TlsCtxEntry *entry = static_cast<TlsCtxEntry *>(
+            SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+        const std::string *key = static_cast<const std::string *>(
+            SSL_get_ex_data(ssl, g_tls_session_key_idx));
+        if (entry == nullptr || key == nullptr ||
+            !SSL_SESSION_is_resumable(sess))
+        {
+            return 0;
+        }
+        std::lock_guard<std::mutex> lock(entry->mu);
+        auto it = entry->sessions.find(*key);
+        if (it != entry->sessions.end())
+        {
+            SSL_SESSION_free(it->second);
+            it->second = sess;
+            return 1;
+        }
+        if (entry->sessions.size() >= TLS_SESSION_CACHE_MAX)
+        {
+            // Plein : on sacrifie une entrée quelconque, le pire cas
+            // est un handshake complet de plus.
+            auto victim = entry->sessions.begin();
+            SSL_SESSION_free(victim->second);
+            entry->sessions.erase(victim);
+        }
+        entry->sessions.emplace(*key, sess);
+        return 1;
+    }
+
+    // SSL_CTX client pour cette configuration de confiance, créé au
+    // premier usage. owned = true : context hors cache (plus de
+    // TLS_CTX_CACHE_MAX configurations distinctes), sans reprise de
+    // session ; l'appelant le libère après SSL_new (le SSL garde sa
+    // propre référence).
+    SSL_CTX *tls_client_ctx(const TlsOptions &opts, bool &owned,
+                            std::string &err)
+    {
+        owned = false;
+        std::string key = opts.verify ? "1" : "0";
+        key += '\0';
+        key += opts.ca_cert;
+        key += '\0';
+        key += opts.ca_path;
+
+        std::lock_guard<std::mutex> lock(g_tls_ctx_mu);
+        auto it = g_tls_ctxs.find(key);
+        if (it != g_tls_ctxs.end())
+        {
+            return it->second->ctx;
+        }
+
+        // Premier appel idempotent depuis OpenSSL 1.1.0.
+        OPENSSL_init_ssl(OPENSSL_INIT_LOAD_SSL_STRINGS |
+                             OPENSSL_INIT_LOAD_CRYPTO_STRINGS,
+                         nullptr);
+        if (g_tls_session_key_idx < 0)
+        {
+            g_tls_session_key_idx = SSL_get_ex_new_index(
+                0, nullptr, nullptr, nullptr, free_ex_string);
+        }
+
+        SSL_CTX *ctx = SSL_CTX_new(TLS_client_method());
+        if (ctx == nullptr)
+        {
+            err = format_tls_error("SSL_CTX_new failed");
+            return nullptr;
+        }
+        if (!configure_client_ctx(ctx, err))
+        {
+            SSL_CTX_free(ctx);
+            return nullptr;
+        }
         if (!opts.ca_cert.empty() || !opts.ca_path.empty())
         {
+            // Additif : le store système reste chargé.
             const char *cf = opts.ca_cert.empty()
                                  ? nullptr
                                  : opts.ca_cert.c_str();
             const char *cp = opts.ca_path.empty()
                                  ? nullptr
                                  : opts.ca_path.c_str();
-            if (SSL_CTX_load_verify_locations(g_tls_ctx, cf, cp) != 1)
+            if (SSL_CTX_load_verify_locations(ctx, cf, cp) != 1)
             {
                 err = format_tls_error("load_verify_locations failed");
-                return false;
+                SSL_CTX_free(ctx);
+                return nullptr;
             }
         }
 
-        // min_version : "1.2" déjà posé sur le CTX (init_openssl_ctx).
-        // "1.3" surcharge par-connexion.
-        if (opts.min_version == "1.3")
+        if (g_tls_ctxs.size() >= TLS_CTX_CACHE_MAX)
         {
-            if (SSL_set_min_proto_version(ssl, TLS1_3_VERSION) != 1)
+            owned = true;
+            return ctx;
+        }
+        TlsCtxEntry *entry = new TlsCtxEntry();
+        entry->ctx = ctx;
+        SSL_CTX_set_app_data(ctx, entry);
+        // Cache interne d'OpenSSL coupé : c'est le nôtre, par
+        // host:port, qui choisit la session à reprendre.
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT |
+                                                SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(ctx, tls_new_session_cb);
+        g_tls_ctxs.emplace(std::move(key), entry);
+        return ctx;
+    }
+
+    // SSL_new sur le context de cette configuration. nullptr + err
+    // si échec.
+    SSL *tls_new_client(const TlsOptions &opts, std::string &err)
+    {
+        bool owned = false;
+        SSL_CTX *ctx = tls_client_ctx(opts, owned, err);
+        if (ctx == nullptr)
+        {
+            return nullptr;
+        }
+        SSL *ssl = SSL_new(ctx);
+        if (owned)
+        {
+            SSL_CTX_free(ctx); // le SSL garde sa référence
+        }
+        if (ssl == nullptr)
+        {
+            err = format_tls_error("SSL_new failed");
+        }
+        return ssl;
+    }
+
+    // Avant le handshake : mémorise la clé de session du SSL (pour le
+    // callback) et pose la session du cache s'il y en a une.
+    void tls_resume_session(SSL *ssl, const char *host, const char *port,
+                            const TlsOptions &opts)
+    {
+        TlsCtxEntry *entry = static_cast<TlsCtxEntry *>(
+            SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+        if (entry == nullptr)
+        {
+            return; // context hors cache : pas de reprise
+        }
+        std::string key = host;
+        key += ':';
+        key += port;
+        key += '\0';
+        key += opts.hostname;
+        key += '\0';
+        key += opts.min_version;
+
+        std::lock_guard<std::mutex> lock(entry->mu);
+        auto it = entry->sessions.find(key);
+        if (it != entry->sessions.end())
+        {
+            SSL_set_session(ssl, it->second); // prend sa référence
+            if (SSL_SESSION_get_protocol_version(it->second) == TLS1_3_VERSION)
             {
-                err = format_tls_error("set_min_proto_version(TLS1_3) failed");
-                return false;
+                SSL_SESSION_free(it->second);
+                entry->sessions.erase(it);
             }
         }
-
-        return true;
+        SSL_set_ex_data(ssl, g_tls_session_key_idx,
+                        new std::string(std::move(key)));
     }
 
-    // Pilote SSL_connect() avec poll + deadline globale. Boucle sur
-    // SSL_ERROR_WANT_READ / WANT_WRITE en utilisant wait_ready_deadline.
-    // Si le handshake échoue à cause d'une vérif cert, le message
-    // d'erreur est explicite via format_verify_error().
+    // -----------------------------------------------------------------
+    // SSL_CTX serveur (listen_tls)
+    // -----------------------------------------------------------------
     //
-    // Précondition : le fd doit être en mode non-bloquant (sinon
-    // SSL_connect bloquerait dans le noyau sans qu'on puisse respecter
-    // la deadline). L'appelant GARDE le fd en non-bloquant après
-    // succès — c'est ce qui permet aux SSL_read/SSL_write ultérieurs
-    // de respecter à leur tour la deadline globale via la boucle
-    // WANT_READ/WANT_WRITE de tls_send_some / tls_recv_some.
-    // En cas d'échec handshake, l'appelant remet bloquant avant de
-    // fermer le fd (cohérence d'état avant cleanup).
-    bool tls_handshake(SSL *ssl, int fd, int timeout_ms, std::string &err)
+    // Un context par (cert, key, alpn), partagé par tous les sockets
+    // d'écoute du processus qui les utilisent : N workers qui ouvrent
+    // chacun leur listen_tls en reuseport (cf. listen_workers) chargent
+    // le certificat une fois, et partagent le cache de sessions et la
+    // clé des tickets. Un client qui reprend sa session tombe donc sur
+    // n'importe quel worker.
+    //
+    // La date de modification des deux fichiers fait partie de la
+    // clé : un certificat renouvelé sur disque est relu par le
+    // prochain listen_tls, les listeners déjà ouverts gardent l'ancien
+    // context (référence tenue par le Sock).
+
+    // Configuration serveur (mappe les opts Lua de listen_tls).
+    struct TlsServerOptions
     {
-        Deadline deadline = make_deadline(timeout_ms);
-        for (;;)
+        std::string cert;          // chemin PEM, chaîne complète
+        std::string key;           // chemin PEM, clé privée
+        std::string alpn;          // protocoles acceptés, ordre de préférence, format fil
+        int timeout_ms = 10000;    // délai max du handshake d'un client
+    };
+
+    std::unordered_map<std::string, SSL_CTX *> g_tls_server_ctxs;
+    int g_tls_alpn_idx = -1; // ex_data SSL_CTX : protocoles ALPN (std::string *)
+
+    bool parse_tls_server_options(lua_State *L, int idx,
+                                  TlsServerOptions &opts, std::string &err)
+    {
+        lua_getfield(L, idx, "cert");
+        if (lua_type(L, -1) != LUA_TSTRING)
         {
-            ERR_clear_error();
-            int rc = SSL_connect(ssl);
-            if (rc == 1)
+            err = "tls: opts.cert must be a string (PEM file path)";
+            lua_pop(L, 1);
+            return false;
+        }
+        opts.cert = lua_tostring(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, idx, "key");
+        if (lua_type(L, -1) != LUA_TSTRING)
+        {
+            err = "tls: opts.key must be a string (PEM file path)";
+            lua_pop(L, 1);
+            return false;
+        }
+        opts.key = lua_tostring(L, -1);
+        lua_pop(L, 1);
+
+        if (!parse_alpn(L, idx, opts.alpn, err))
+        {
+            return false;
+        }
+        return parse_tls_timeout(L, idx, opts.timeout_ms, err);
+    }
+
+    // Choix du protocole ALPN : le premier de la liste du serveur que
+    // le client propose aussi. Pas de protocole commun : on continue
+    // sans ALPN plutôt que de couper le handshake.
+    int tls_alpn_select_cb(SSL *ssl, const unsigned char **out,
+                           unsigned char *outlen, const unsigned char *in,
+                           unsigned int inlen, void *)
+    {
+        const std::string *prefs = static_cast<const std::string *>(
+            SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), g_tls_alpn_idx));
+        if (prefs == nullptr)
+        {
+            return SSL_TLSEXT_ERR_NOACK;
+        }
+        unsigned char *sel = nullptr;
+        unsigned char sel_len = 0;
+        if (SSL_select_next_proto(&sel, &sel_len,
+                                  reinterpret_cast<const unsigned char *>(prefs->data()),
+                                  static_cast<unsigned int>(prefs->size()),
+                                  in, inlen) != OPENSSL_NPN_NEGOTIATED)
+        {
+            return SSL_TLSEXT_ERR_NOACK;
+        }
+        *out = sel;
+        *outlen = sel_len;
+        return SSL_TLSEXT_ERR_OK;
+    }
+
+    // Date de modification pour la clé du cache (0 si stat échoue :
+    // le chargement qui suit donnera l'erreur lisible).
+    std::string file_stamp(const std::string &path)
+    {
+        struct stat st;
+        if (::stat(path.c_str(), &st) != 0)
+        {
+            return "0";
+        }
+        return std::to_string(st.st_mtim.tv_sec) + "." +
+               std::to_string(st.st_mtim.tv_nsec);
+    }
+
+    // SSL_CTX serveur pour cette configuration, créé au premier usage.
+    // Renvoie une référence à libérer par l'appelant (SSL_CTX_free à
+    // la fermeture du socket d'écoute), nullptr + err si le
+    // certificat ou la clé ne se chargent pas.
+    SSL_CTX *tls_server_ctx(const TlsServerOptions &opts, std::string &err)
+    {
+        std::string base = opts.cert;
+        base += '\0';
+        base += opts.key;
+        base += '\0';
+        base += opts.alpn;
+        base += '\0';
+        std::string key = base + file_stamp(opts.cert) + '\0' +
+                          file_stamp(opts.key);
+
+        std::lock_guard<std::mutex> lock(g_tls_ctx_mu);
+        auto it = g_tls_server_ctxs.find(key);
+        if (it != g_tls_server_ctxs.end())
+        {
+            SSL_CTX_up_ref(it->second);
+            return it->second;
+        }
+        // Fichiers modifiés depuis : l'ancien context sort du cache
+        // (les listeners qui le tiennent le gardent jusqu'à close).
+        for (auto old = g_tls_server_ctxs.begin();
+             old != g_tls_server_ctxs.end();)
+        {
+            if (old->first.compare(0, base.size(), base) == 0)
             {
-                return true; // handshake OK
+                SSL_CTX_free(old->second);
+                old = g_tls_server_ctxs.erase(old);
             }
-            int e = SSL_get_error(ssl, rc);
+            else
+            {
+                ++old;
+            }
+        }
+
+        OPENSSL_init_ssl(OPENSSL_INIT_LOAD_SSL_STRINGS |
+                             OPENSSL_INIT_LOAD_CRYPTO_STRINGS,
+                         nullptr);
+        if (g_tls_alpn_idx < 0)
+        {
+            g_tls_alpn_idx = SSL_CTX_get_ex_new_index(
+                0, nullptr, nullptr, nullptr, free_ex_string);
+        }
+
+        SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+        if (ctx == nullptr)
+        {
+            err = format_tls_error("SSL_CTX_new failed");
+            return nullptr;
+        }
+        // Mêmes planchers que côté client (TLS-D), pas de
+        // renégociation initiée par le client (coût CPU gratuit
+        // pour lui, jamais utile à un script).
+        if (SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION) != 1)
+        {
+            err = format_tls_error("set_min_proto_version(TLS1_2) failed");
+            SSL_CTX_free(ctx);
+            return nullptr;
+        }
+        SSL_CTX_set_options(ctx, SSL_OP_NO_RENEGOTIATION |
+                                     SSL_OP_CIPHER_SERVER_PREFERENCE);
+        SSL_CTX_set_mode(ctx, SSL_MODE_AUTO_RETRY);
+
+        if (SSL_CTX_use_certificate_chain_file(ctx, opts.cert.c_str()) != 1)
+        {
+            err = format_tls_error("cannot load opts.cert");
+            SSL_CTX_free(ctx);
+            return nullptr;
+        }
+        if (SSL_CTX_use_PrivateKey_file(ctx, opts.key.c_str(),
+                                        SSL_FILETYPE_PEM) != 1)
+        {
+            err = format_tls_error("cannot load opts.key");
+            SSL_CTX_free(ctx);
+            return nullptr;
+        }
+        if (SSL_CTX_check_private_key(ctx) != 1)
+        {
+            err = format_tls_error("opts.key does not match opts.cert");
+            SSL_CTX_free(ctx);
+            return nullptr;
+        }
+
+        // Reprise de session : cache d'ID (TLS 1.2) dans le context,
+        // tickets (TLS 1.2 et 1.3) chiffrés par une clé propre au
+        // context, donc valables sur tous les listeners qui le
+        // partagent.
+        static const unsigned char sid_ctx[] = "babet";
+        SSL_CTX_set_session_id_context(ctx, sid_ctx, sizeof(sid_ctx) - 1);
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+        SSL_CTX_sess_set_cache_size(ctx, TLS_SESSION_CACHE_MAX);
+
+        if (!opts.alpn.empty())
+        {
+            SSL_CTX_set_ex_data(ctx, g_tls_alpn_idx, new std::string(opts.alpn));
+            SSL_CTX_set_alpn_select_cb(ctx, tls_alpn_select_cb, nullptr);
+        }
+
+        if (g_tls_server_ctxs.size() < TLS_CTX_CACHE_MAX)
+        {
+            SSL_CTX_up_ref(ctx); // référence du cache
+            g_tls_server_ctxs.emplace(std::move(key), ctx);
+        }
+        return ctx;
+    }
+
+    // Pilote SSL_connect() avec poll + deadline globale. Boucle sur
+    // SSL_ERROR_WANT_READ / WANT_WRITE en utilisant wait_ready_deadline.
+    // Si le handshake échoue à cause d'une vérif cert, le message
+    // d'erreur est explicite via format_verify_error().
+    //
+    // Précondition : le fd doit être en mode non-bloquant (sinon
+    // SSL_connect bloquerait dans le noyau sans qu'on puisse respecter
+    // la deadline). L'appelant GARDE le fd en non-bloquant après
+    // succès — c'est ce qui permet aux SSL_read/SSL_write ultérieurs
+    // de respecter à leur tour la deadline globale via la boucle
+    // WANT_READ/WANT_WRITE de tls_send_some / tls_recv_some.
+    // En cas d'échec handshake, l'appelant remet bloquant avant de
+    // fermer le fd (cohérence d'état avant cleanup).
+    bool tls_handshake(SSL *ssl, int fd, int timeout_ms, std::string &err)
+    {
+        Deadline deadline = make_deadline(timeout_ms);
+        for (;;)
+        {
+            ERR_clear_error();
+            int rc = SSL_connect(ssl);
+            if (rc == 1)
+            {
+                return true; // handshake OK
+            }
+            int e = SSL_get_error(ssl, rc);
             if (e == SSL_ERROR_WANT_READ)
             {
                 int wr = wait_ready_deadline(fd, POLLIN, deadline);
@@ -989,13 +1443,15 @@ namespace
     // être libéré avec freeaddrinfo, ou nullptr + remplit `err`.
     // `passive` = true pour bind/listen (utilise AI_PASSIVE + host
     // optionnel), false pour connect.
+    // socktype : SOCK_STREAM (TCP, défaut) ou SOCK_DGRAM (UDP).
     struct addrinfo *resolve(const char *host, const char *port,
-                             bool passive, std::string &err)
+                             bool passive, std::string &err,
+                             int socktype = SOCK_STREAM)
     {
         struct addrinfo hints;
         std::memset(&hints, 0, sizeof(hints));
-        hints.ai_family = AF_UNSPEC;     // IPv4 ou IPv6
-        hints.ai_socktype = SOCK_STREAM; // TCP
+        hints.ai_family = AF_UNSPEC; // IPv4 ou IPv6
+        hints.ai_socktype = socktype;
         if (passive)
         {
             hints.ai_flags = AI_PASSIVE;
@@ -1013,1391 +1469,5877 @@ namespace
     }
 
     // -----------------------------------------------------------------
-    // Méthodes du userdata socket
+    // Résolution DNS : cache + pool de résolveurs
     // -----------------------------------------------------------------
+    //
+    // getaddrinfo bloque sans borne (timeouts de resolv.conf, serveur
+    // muet) et refait la requête à chaque connect. Ici les noms passent
+    // par un cache process-wide, et les échecs de cache par un petit
+    // pool de threads qui appellent getaddrinfo : l'appelant attend le
+    // résultat sur un eventfd avec SA deadline (poll, donc
+    // interruptible par les signaux gérés comme le reste du module).
+    // Une deadline dépassée rend "timeout" tout de suite ; la requête
+    // continue en fond et remplit le cache pour l'appel suivant.
+    //
+    // getaddrinfo reste le moteur (nsswitch, /etc/hosts, resolv.conf,
+    // tri RFC 6724) mais ne donne pas le TTL des enregistrements : la
+    // durée de vie est une politique (dns_config{ ttl = }), pas celle
+    // de la zone. Échecs définitifs (EAI_NONAME) gardés negative_ttl,
+    // échecs temporaires jamais.
+    //
+    // Les entrées "hosts" de dns_config sont épinglées : jamais
+    // expirées, jamais résolues, l'équivalent d'un /etc/hosts propre
+    // au processus (tests, services internes).
+    //
+    // Les adresses littérales ne passent ni par le cache ni par le
+    // pool (AI_NUMERICHOST, pas de requête réseau).
 
-    int sock_send(lua_State *L)
+    constexpr int DNS_THREADS = 4;
+    constexpr size_t DNS_CACHE_MAX = 4096;
+
+    // Codes retour de dns_lookup.
+    constexpr int DNS_OK = 0;
+    constexpr int DNS_FAIL = -1; // err rempli
+    constexpr int DNS_TIMEOUT = -2;
+    constexpr int DNS_INTERRUPTED = -3;
+
+    struct DnsAddr
     {
-        Sock *s = check_sock(L, 1);
-        size_t len = 0;
-        const char *data = luaL_checklstring(L, 2, &len);
-        if (s->fd < 0)
+        struct sockaddr_storage addr; // port à 0 dans le cache
+        socklen_t len;
+    };
+
+    // Une requête en cours, partagée par tous ceux qui attendent le
+    // même nom. efd devient lisible à la fin (jamais vidé : chaque
+    // attente le voit).
+    struct DnsLookup
+    {
+        std::string host;
+        int efd = -1;
+        std::vector<DnsAddr> addrs; // sous DnsState::mu
+        std::string err;
+
+        ~DnsLookup()
         {
-            return push_fail(L, "socket: send: socket is closed");
+            if (efd >= 0)
+            {
+                ::close(efd);
+            }
         }
-        if (s->listening)
+    };
+
+    struct DnsEntry
+    {
+        std::vector<DnsAddr> addrs; // vide = échec (err)
+        std::string err;
+        Deadline expires;
+        bool pinned = false;
+    };
+
+    struct DnsState
+    {
+        std::mutex mu;
+        std::condition_variable cv; // réveille les threads du pool
+        std::unordered_map<std::string, DnsEntry> cache;
+        std::unordered_map<std::string, std::shared_ptr<DnsLookup>> inflight;
+        std::deque<std::shared_ptr<DnsLookup>> queue;
+        int threads = 0;
+        int idle = 0;
+        int ttl_ms = 60000;
+        int negative_ttl_ms = 5000;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+
+    // Jamais détruit : les threads du pool sont détachés et attendent
+    // sur mu / cv jusqu'à la fin du processus.
+    DnsState &dns_state()
+    {
+        static DnsState *state = new DnsState();
+        return *state;
+    }
+
+    // Clé du cache : les noms DNS ne distinguent pas la casse.
+    std::string dns_key(const char *host)
+    {
+        std::string key = host;
+        for (char &c : key)
         {
-            return push_fail(L,
-                             "socket: send: cannot send on a listening socket");
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
         }
+        return key;
+    }
 
-        // Boucle d'écriture : send() peut écrire partiellement, on
-        // continue jusqu'à tout envoyer ou timeout. MSG_NOSIGNAL :
-        // pas de SIGPIPE sur peer fermé (on reçoit EPIPE).
-        //
-        // CORRECTIF (post-revue ChatGPT) : si un timeout est actif,
-        // on force MSG_DONTWAIT pour que send() lui-même ne bloque
-        // PAS dans le noyau quand le peer lit lentement. Sans ça,
-        // poll() nous disait "prêt pour au moins 1 octet" mais
-        // send() pouvait quand même bloquer pour écrire un gros
-        // buffer entier. EAGAIN/EWOULDBLOCK -> on reboucle sur
-        // poll() avec le timeout restant. Si pas de timeout
-        // (s->timeout_ms == 0), comportement bloquant pur conservé,
-        // pas de MSG_DONTWAIT (sinon send() retournerait
-        // immédiatement EAGAIN au lieu de bloquer comme attendu).
-        //
-        // DEADLINE GLOBALE (post-revue 2) : on calcule la deadline
-        // UNE FOIS au début ; chaque tour de boucle utilise le temps
-        // restant. timeout = durée max de l'APPEL complet (cohérent
-        // avec http set_max_timeout, sémantique unifiée Babet).
-        //
-        // TLS (Chantier 7, sous-étape 1.3) : si s->ssl est non-null,
-        // le socket est en mode TLS. Le FD est en O_NONBLOCK depuis
-        // connect_tls/starttls (corrigé post-revue) : SSL_write ne
-        // peut PAS bloquer dans le noyau au-delà de la deadline. Si
-        // le buffer noyau est plein, SSL_write retourne WANT_WRITE ;
-        // si une renégociation TLS interne demande des bytes du peer,
-        // SSL_write retourne WANT_READ. tls_send_some traduit ces
-        // cas en codes TLS_IO_WANT_* qu'on gère ci-dessous avec
-        // wait_ready_deadline + retry. Garantie : deadline globale
-        // respectée comme pour TCP brut.
-        size_t total = 0;
-        const bool is_tls = (s->ssl != nullptr);
-        const bool use_nonblock = (!is_tls) && (s->timeout_ms > 0);
-        const int send_flags = MSG_NOSIGNAL |
-                               (use_nonblock ? MSG_DONTWAIT : 0);
-        Deadline deadline = make_deadline(s->timeout_ms);
-        std::string tls_err;
-        while (total < len)
+    void dns_copy_addrs(const struct addrinfo *res, std::vector<DnsAddr> &out)
+    {
+        for (const struct addrinfo *ai = res; ai != nullptr; ai = ai->ai_next)
         {
-            // Direction du poll : POLLOUT par défaut. En TLS, un
-            // SSL_write peut demander POLLIN (renégociation), géré
-            // dans la branche TLS via le code retour WANT_READ.
-            short poll_events = POLLOUT;
-            int r = wait_ready_deadline(s->fd, poll_events, deadline);
-            if (r == WAIT_INTERRUPTED)
-            {
-                signal_dispatch_pending(L);
-                return push_fail(L, "interrupted");
-            }
-            if (r < 0)
+            if (ai->ai_addrlen > sizeof(struct sockaddr_storage))
             {
-                return push_errno_fail(L, "send");
-            }
-            if (r == 0)
-            {
-                return push_fail(L, "timeout");
+                continue;
             }
+            DnsAddr a;
+            std::memset(&a.addr, 0, sizeof(a.addr));
+            std::memcpy(&a.addr, ai->ai_addr, ai->ai_addrlen);
+            a.len = ai->ai_addrlen;
+            out.push_back(a);
+        }
+    }
 
-            if (is_tls)
+    // Range une entrée ; plein : on retire les expirées, puis une
+    // quelconque non épinglée (le pire cas est une requête de plus).
+    void dns_store(DnsState &d, const std::string &key, DnsEntry entry)
+    {
+        if (d.cache.size() >= DNS_CACHE_MAX && d.cache.find(key) == d.cache.end())
+        {
+            Deadline now = Clock::now();
+            for (auto it = d.cache.begin(); it != d.cache.end();)
             {
-                int rc = tls_send_some(s->ssl, data + total,
-                                       len - total, tls_err);
-                if (rc > 0)
-                {
-                    total += static_cast<size_t>(rc);
-                    continue;
-                }
-                if (rc == TLS_IO_EOF)
-                {
-                    return push_fail(L, "closed");
-                }
-                if (rc == TLS_IO_WANT_READ)
+                if (!it->second.pinned && it->second.expires <= now)
                 {
-                    int wr = wait_ready_deadline(s->fd, POLLIN, deadline);
-                    if (wr == WAIT_INTERRUPTED)
-                    {
-                        signal_dispatch_pending(L);
-                        return push_fail(L, "interrupted");
-                    }
-                    if (wr == 0)
-                        return push_fail(L, "timeout");
-                    if (wr < 0)
-                        return push_errno_fail(L, "send");
-                    continue;
+                    it = d.cache.erase(it);
                 }
-                if (rc == TLS_IO_WANT_WRITE)
+                else
                 {
-                    continue; // déjà attendu POLLOUT, reboucle
+                    ++it;
                 }
-                return push_fail(L, tls_err); // FATAL
             }
+            for (auto it = d.cache.begin();
+                 d.cache.size() >= DNS_CACHE_MAX && it != d.cache.end();)
+            {
+                it = it->second.pinned ? std::next(it) : d.cache.erase(it);
+            }
+        }
+        d.cache[key] = std::move(entry);
+    }
 
-            // Branche TCP brut (inchangée).
-            ssize_t n = ::send(s->fd, data + total, len - total,
-                               send_flags);
-            if (n < 0)
+    void dns_worker()
+    {
+        DnsState &d = dns_state();
+        for (;;)
+        {
+            std::shared_ptr<DnsLookup> job;
             {
-                if (errno == EINTR)
-                {
-                    continue;
-                }
-                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                std::unique_lock<std::mutex> lock(d.mu);
+                ++d.idle;
+                while (d.queue.empty())
                 {
-                    // Le buffer noyau s'est rempli juste après poll
-                    // (race normale). On reboucle, poll() bloquera
-                    // jusqu'à ce que de la place se libère, dans la
-                    // limite du temps restant sur la deadline.
-                    continue;
+                    d.cv.wait(lock);
                 }
-                if (errno == EPIPE || errno == ECONNRESET)
+                --d.idle;
+                job = std::move(d.queue.front());
+                d.queue.pop_front();
+            }
+
+            struct addrinfo hints;
+            std::memset(&hints, 0, sizeof(hints));
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM; // une entrée par adresse
+            struct addrinfo *res = nullptr;
+            int rc = ::getaddrinfo(job->host.c_str(), nullptr, &hints, &res);
+            std::vector<DnsAddr> addrs;
+            std::string err;
+            if (rc == 0)
+            {
+                dns_copy_addrs(res, addrs);
+                ::freeaddrinfo(res);
+            }
+            else
+            {
+                err = "socket: getaddrinfo: ";
+                err += ::gai_strerror(rc);
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(d.mu);
+                int ttl = (rc == 0) ? d.ttl_ms
+                          : (rc == EAI_NONAME) ? d.negative_ttl_ms
+                                               : 0;
+                if (ttl > 0 && (rc != 0 || !addrs.empty()))
                 {
-                    return push_fail(L, "closed");
+                    DnsEntry entry;
+                    entry.addrs = addrs;
+                    entry.err = err;
+                    entry.expires = Clock::now() + std::chrono::milliseconds(ttl);
+                    dns_store(d, job->host, std::move(entry));
                 }
-                return push_errno_fail(L, "send");
+                job->addrs = std::move(addrs);
+                job->err = std::move(err);
+                d.inflight.erase(job->host);
             }
-            total += static_cast<size_t>(n);
+            uint64_t one = 1;
+            ssize_t w = ::write(job->efd, &one, sizeof(one));
+            (void)w; // compteur eventfd : ne peut pas déborder ici
         }
-        lua_pushinteger(L, static_cast<lua_Integer>(total));
-        return 1;
     }
 
-    // Plafond raisonnable sur recv(n) pour éviter qu'une faute de
-    // frappe (un *1024 accidentel) ne provoque une allocation OOM.
-    // 16 MB est largement au-dessus du buffer noyau par défaut sous
-    // Linux (~128 KB-2 MB selon tuning), donc aucun cas légitime
-    // n'est restreint. Au-delà -> (nil, err) (décision post-revue).
-    constexpr lua_Integer MAX_RECV_SIZE = 16 * 1024 * 1024;
-
-    // recv(n) "au plus n octets" (sémantique read()). EOF -> (nil,
-    // "closed"). Timeout -> (nil, "timeout").
-    int sock_recv(lua_State *L)
+    // Lance un thread du pool si les libres ne suffisent pas pour la
+    // file. Sous d.mu. Les signaux sont bloqués avant la création (le
+    // masque est hérité) : ils restent délivrés aux threads Lua, cf.
+    // workers.cpp.
+    void dns_spawn_locked(DnsState &d)
     {
-        Sock *s = check_sock(L, 1);
-        lua_Integer n = luaL_checkinteger(L, 2);
-        if (n <= 0)
+        if (d.idle >= static_cast<int>(d.queue.size()) ||
+            d.threads >= DNS_THREADS)
         {
-            return push_fail(L, "socket: recv: count must be > 0");
+            return;
         }
-        if (n > MAX_RECV_SIZE)
+        sigset_t all;
+        sigset_t old;
+        sigfillset(&all);
+        pthread_sigmask(SIG_BLOCK, &all, &old);
+        try
         {
-            return push_fail(L,
-                             "socket: recv: count exceeds 16 MB cap");
+            std::thread(dns_worker).detach();
+            ++d.threads;
         }
-        if (s->fd < 0)
+        catch (const std::system_error &)
         {
-            return push_fail(L, "socket: recv: socket is closed");
+            // Pas de thread : les requêtes attendent un thread déjà
+            // lancé ; sans aucun, dns_lookup résout sur place.
         }
-        if (s->listening)
+        pthread_sigmask(SIG_SETMASK, &old, nullptr);
+    }
+
+    // Pose le port dans une adresse du cache.
+    void dns_set_port(DnsAddr &a, int port)
+    {
+        if (a.addr.ss_family == AF_INET)
         {
-            return push_fail(L,
-                             "socket: recv: cannot recv on a listening socket");
+            reinterpret_cast<struct sockaddr_in *>(&a.addr)->sin_port =
+                htons(static_cast<uint16_t>(port));
         }
+        else if (a.addr.ss_family == AF_INET6)
+        {
+            reinterpret_cast<struct sockaddr_in6 *>(&a.addr)->sin6_port =
+                htons(static_cast<uint16_t>(port));
+        }
+    }
 
-        // CORRECTIF (post-revue ChatGPT) : symétrie avec send(),
-        // MSG_DONTWAIT quand un timeout est actif. Le cas est moins
-        // fréquent côté recv (poll(POLLIN) garantit qu'il y a déjà
-        // des données), mais une race est possible entre poll() et
-        // recv() ; on la traite proprement par reboucle.
-        //
-        // DEADLINE GLOBALE (post-revue 2) : une seule deadline pour
-        // tout l'appel, même si on reboucle sur EAGAIN/EINTR.
-        //
-        // TLS (sous-étape 1.3) : si s->ssl non-null, route via
-        // SSL_read avec gestion WANT_READ/WANT_WRITE.
-        const bool is_tls = (s->ssl != nullptr);
-        const bool use_nonblock = (!is_tls) && (s->timeout_ms > 0);
-        const int recv_flags = use_nonblock ? MSG_DONTWAIT : 0;
-        Deadline deadline = make_deadline(s->timeout_ms);
-
-        std::vector<char> buf(static_cast<size_t>(n));
-        std::string tls_err;
-        for (;;)
+    // Résout host (port posé dans chaque adresse) avant la deadline.
+    // DNS_OK + out rempli, ou DNS_FAIL (err), DNS_TIMEOUT,
+    // DNS_INTERRUPTED.
+    int dns_lookup(const char *host, int port, Deadline deadline,
+                   std::vector<DnsAddr> &out, std::string &err)
+    {
+        out.clear();
+        struct addrinfo hints;
+        std::memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_NUMERICHOST;
+        struct addrinfo *res = nullptr;
+        if (::getaddrinfo(host, nullptr, &hints, &res) == 0)
         {
-            // CORRECTIF (post-bug IRC TLS) : voir explication détaillée
-            // dans sock_recv_line. Si OpenSSL a déjà déchiffré des octets
-            // dans son buffer interne, le FD socket est vide alors qu'il
-            // y a des données à lire. Il faut sauter wait_ready_deadline
-            // dans ce cas.
-            const bool ssl_has_data =
-                is_tls && (SSL_pending(s->ssl) > 0);
+            dns_copy_addrs(res, out);
+            ::freeaddrinfo(res);
+            for (DnsAddr &a : out)
+            {
+                dns_set_port(a, port);
+            }
+            return DNS_OK;
+        }
 
-            if (!ssl_has_data)
+        DnsState &d = dns_state();
+        std::string key = dns_key(host);
+        std::shared_ptr<DnsLookup> job;
+        bool pooled = true;
+        {
+            std::lock_guard<std::mutex> lock(d.mu);
+            auto hit = d.cache.find(key);
+            if (hit != d.cache.end() &&
+                (hit->second.pinned || hit->second.expires > Clock::now()))
             {
-                int r = wait_ready_deadline(s->fd, POLLIN, deadline);
-                if (r == WAIT_INTERRUPTED)
-                {
-                    signal_dispatch_pending(L);
-                    return push_fail(L, "interrupted");
-                }
-                if (r < 0)
+                ++d.hits;
+                if (hit->second.addrs.empty())
                 {
-                    return push_errno_fail(L, "recv");
+                    err = hit->second.err;
+                    return DNS_FAIL;
                 }
-                if (r == 0)
+                out = hit->second.addrs;
+                for (DnsAddr &a : out)
                 {
-                    return push_fail(L, "timeout");
+                    dns_set_port(a, port);
                 }
+                return DNS_OK;
             }
-
-            if (is_tls)
+            ++d.misses;
+            auto pending = d.inflight.find(key);
+            if (pending != d.inflight.end())
             {
-                int rc = tls_recv_some(s->ssl, buf.data(), buf.size(),
-                                       tls_err);
-                if (rc > 0)
+                job = pending->second;
+            }
+            else
+            {
+                job = std::make_shared<DnsLookup>();
+                job->host = key;
+                job->efd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+                if (job->efd < 0)
                 {
-                    lua_pushlstring(L, buf.data(),
-                                    static_cast<size_t>(rc));
-                    return 1;
+                    err = "socket: resolve: eventfd: ";
+                    err += std::strerror(errno);
+                    return DNS_FAIL;
                 }
-                if (rc == TLS_IO_EOF)
+                d.inflight.emplace(key, job);
+                d.queue.push_back(job);
+                dns_spawn_locked(d);
+                if (d.threads == 0)
                 {
-                    return push_fail(L, "closed");
-                }
-                if (rc == TLS_IO_WANT_READ)
-                {
-                    continue; // déjà attendu POLLIN, reboucle
+                    d.queue.pop_back();
+                    d.inflight.erase(key);
+                    pooled = false;
                 }
-                if (rc == TLS_IO_WANT_WRITE)
+                else
                 {
-                    int wr = wait_ready_deadline(s->fd, POLLOUT, deadline);
-                    if (wr == WAIT_INTERRUPTED)
-                    {
-                        signal_dispatch_pending(L);
-                        return push_fail(L, "interrupted");
-                    }
-                    if (wr == 0)
-                        return push_fail(L, "timeout");
-                    if (wr < 0)
-                        return push_errno_fail(L, "recv");
-                    continue;
+                    d.cv.notify_one();
                 }
-                return push_fail(L, tls_err); // FATAL
             }
+        }
 
-            // Branche TCP brut (inchangée).
-            ssize_t got = ::recv(s->fd, buf.data(), buf.size(),
-                                 recv_flags);
-            if (got >= 0)
+        if (!pooled)
+        {
+            // Aucun thread n'a pu démarrer : résolution bloquante sur
+            // place, comme avant le pool.
+            hints.ai_flags = 0;
+            int rc = ::getaddrinfo(host, nullptr, &hints, &res);
+            if (rc != 0)
             {
-                if (got == 0)
-                {
-                    return push_fail(L, "closed");
-                }
-                lua_pushlstring(L, buf.data(),
-                                static_cast<size_t>(got));
-                return 1;
+                err = "socket: getaddrinfo: ";
+                err += ::gai_strerror(rc);
+                return DNS_FAIL;
             }
-            if (errno == EINTR)
+            dns_copy_addrs(res, out);
+            ::freeaddrinfo(res);
+        }
+        else
+        {
+            int r = wait_ready_deadline(job->efd, POLLIN, deadline);
+            if (r == WAIT_INTERRUPTED)
             {
-                continue;
+                return DNS_INTERRUPTED;
             }
-            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            if (r < 0)
             {
-                continue;
+                err = "socket: resolve: ";
+                err += std::strerror(errno);
+                return DNS_FAIL;
+            }
+            if (r == 0)
+            {
+                return DNS_TIMEOUT;
+            }
+            std::lock_guard<std::mutex> lock(d.mu);
+            out = job->addrs;
+            err = job->err;
+        }
+        if (out.empty())
+        {
+            if (err.empty())
+            {
+                err = "socket: getaddrinfo: no address";
             }
-            return push_errno_fail(L, "recv");
+            return DNS_FAIL;
+        }
+        for (DnsAddr &a : out)
+        {
+            dns_set_port(a, port);
         }
+        return DNS_OK;
     }
 
-    // recv_line() : lit jusqu'à '\n' inclus dans le flux ; renvoie la
-    // ligne SANS le '\n' final (et sans un éventuel '\r' juste avant,
-    // pour gérer CRLF transparent côté script).
+    // -----------------------------------------------------------------
+    // Tâches coopératives (babet.socket.scheduler)
+    // -----------------------------------------------------------------
     //
-    // EOF en plein milieu : (nil, "closed", partial). 3 valeurs
-    // assumées ici (cf. SOCK-5) -- ne pas perdre les octets déjà lus.
-    int sock_recv_line(lua_State *L)
+    // Dans une tâche lancée par sched:spawn, recv / recv_line /
+    // recv_until / recv_all / send / accept ne bloquent plus le thread
+    // quand le socket n'est pas prêt : ils suspendent la coroutine
+    // (lua_yieldk) et le scheduler la reprend quand epoll signale le
+    // FD, ou quand la deadline de l'appel tombe. Hors tâche (script
+    // principal, coroutine ordinaire), rien ne change : poll bloquant.
+    //
+    // La deadline de l'appel voyage dans le lua_KContext de la
+    // continuation : une opération reprise ne repart pas de zéro, le
+    // timeout reste la durée max de l'APPEL, comme en bloquant.
+    //
+    // lua_yieldk sort par longjmp : entre co_wait et la lua_CFunction
+    // appelée par Lua, aucun objet C++ ne doit être vivant. Chaque
+    // opération est donc coupée en deux : *_impl possède les
+    // std::string & co et rend IO_YIELD, la continuation *_k ne fait
+    // que l'appeler puis céder.
+
+    // Ce qu'une opération attend avant de pouvoir continuer.
+    struct IoWait
+    {
+        int fd = -1;
+        uint32_t events = 0; // EPOLLIN ou EPOLLOUT
+    };
+
+    // Retour d'un *_impl : céder sur l'IoWait rempli (les retours
+    // normaux sont des nombres de valeurs Lua, >= 0).
+    constexpr int IO_YIELD = -1;
+
+    struct SchedTask
+    {
+        lua_State *co = nullptr; // ancrée dans la uservalue du scheduler
+        int nargs = 0;           // arguments du premier resume
+        int wait_fd = -1;        // FD attendu, -1 si aucun
+        uint64_t wait_seq = 0;   // invalide les échéances périmées
+    };
+
+    // Tâches suspendues sur un FD : un lecteur et un écrivain au plus,
+    // pour qu'une tâche puisse lire pendant qu'une autre écrit sur le
+    // même socket (epoll n'accepte qu'une entrée par FD).
+    struct FdWaiters
+    {
+        lua_Integer reader = 0; // id de tâche, 0 = aucune
+        lua_Integer writer = 0;
+        uint32_t registered = 0; // événements posés dans epoll
+    };
+
+    struct SchedDeadline
+    {
+        Deadline due;
+        lua_Integer task;
+        uint64_t seq; // == SchedTask::wait_seq tant que valide
+    };
+
+    // Tas MIN sur due (cf. TimerLater du poller).
+    struct DeadlineLater
+    {
+        bool operator()(const SchedDeadline &a, const SchedDeadline &b) const
+        {
+            return a.due > b.due;
+        }
+    };
+
+    struct Scheduler
+    {
+        int epfd = -1; // -1 si fermé
+        lua_Integer next_id = 1;
+        std::unordered_map<lua_Integer, SchedTask> tasks;
+        std::deque<lua_Integer> runnable;
+        std::vector<FdWaiters> fds;           // indexé par FD
+        std::vector<SchedDeadline> deadlines; // tas min, entrées périmées ignorées
+        std::vector<struct epoll_event> evbuf;
+        lua_State *current = nullptr; // tâche en cours de reprise
+        lua_Integer current_id = 0;
+        bool parked = false; // la tâche courante s'est suspendue (co_wait, sleep)
+    };
+
+    // Scheduler en train de reprendre une tâche sur CE thread OS.
+    // thread_local : chaque worker a son lua_State et ses schedulers.
+    thread_local Scheduler *t_sched = nullptr;
+
+    static_assert(sizeof(lua_KContext) >= sizeof(Clock::rep),
+                  "lua_KContext must hold a steady_clock tick count");
+
+    lua_KContext deadline_to_ctx(Deadline d)
+    {
+        return static_cast<lua_KContext>(d.time_since_epoch().count());
+    }
+
+    Deadline ctx_to_deadline(lua_KContext ctx)
+    {
+        return Deadline(Clock::duration(static_cast<Clock::rep>(ctx)));
+    }
+
+    // &w si l'appel vient d'une tâche du scheduler et peut céder,
+    // nullptr sinon (mode bloquant habituel).
+    IoWait *yield_slot(lua_State *L, IoWait &w)
+    {
+        if (t_sched != nullptr && t_sched->current == L &&
+            lua_isyieldable(L))
+        {
+            return &w;
+        }
+        return nullptr;
+    }
+
+    // Retire la tâche id des attentes sur fd. L'enregistrement epoll
+    // reste en place (réutilisé au prochain recv sur le même socket) ;
+    // un réveil sans attente le rabote (cf. sched_run).
+    void sched_disarm(Scheduler *sc, lua_Integer id, int fd)
+    {
+        if (fd < 0 || static_cast<size_t>(fd) >= sc->fds.size())
+        {
+            return;
+        }
+        FdWaiters &w = sc->fds[fd];
+        if (w.reader == id)
+        {
+            w.reader = 0;
+        }
+        if (w.writer == id)
+        {
+            w.writer = 0;
+        }
+    }
+
+    // Pose epoll sur fd pour les événements attendus par ses tâches.
+    // -1 + errno si epoll_ctl échoue.
+    int sched_update_fd(Scheduler *sc, int fd)
+    {
+        FdWaiters &w = sc->fds[fd];
+        uint32_t want = (w.reader ? EPOLLIN : 0u) | (w.writer ? EPOLLOUT : 0u);
+        if (want == w.registered)
+        {
+            return 0;
+        }
+        if (want == 0)
+        {
+            ::epoll_ctl(sc->epfd, EPOLL_CTL_DEL, fd, nullptr);
+            w.registered = 0;
+            return 0;
+        }
+        struct epoll_event ev;
+        std::memset(&ev, 0, sizeof(ev));
+        ev.events = want;
+        ev.data.fd = fd;
+        // registered peut être périmé : FD fermé (epoll l'a oublié)
+        // puis numéro réutilisé par un nouveau socket.
+        int op = w.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+        int rc = ::epoll_ctl(sc->epfd, op, fd, &ev);
+        if (rc < 0 && op == EPOLL_CTL_MOD && errno == ENOENT)
+        {
+            rc = ::epoll_ctl(sc->epfd, EPOLL_CTL_ADD, fd, &ev);
+        }
+        else if (rc < 0 && op == EPOLL_CTL_ADD && errno == EEXIST)
+        {
+            rc = ::epoll_ctl(sc->epfd, EPOLL_CTL_MOD, fd, &ev);
+        }
+        if (rc < 0)
+        {
+            return -1;
+        }
+        w.registered = want;
+        return 0;
+    }
+
+    // Suspend la tâche courante (attente fd, ou fd = -1 pour une simple
+    // échéance) jusqu'au réveil par sched_run.
+    void park_current(Scheduler *sc, int fd, Deadline deadline)
+    {
+        SchedTask &t = sc->tasks[sc->current_id];
+        t.wait_fd = fd;
+        ++t.wait_seq;
+        if (deadline != NO_DEADLINE)
+        {
+            sc->deadlines.push_back({deadline, sc->current_id, t.wait_seq});
+            std::push_heap(sc->deadlines.begin(), sc->deadlines.end(),
+                           DeadlineLater());
+        }
+        sc->parked = true;
+    }
+
+    // Cède la tâche courante jusqu'à ce que w soit prêt ou que la
+    // deadline tombe, puis reprend dans k (qui retente l'opération).
+    // À appeler en `return co_wait(...)` depuis une continuation, sans
+    // objet C++ vivant (cf. plus haut).
+    int co_wait(lua_State *L, const IoWait &w, Deadline deadline,
+                lua_KFunction k)
+    {
+        Scheduler *sc = t_sched;
+        if (static_cast<size_t>(w.fd) >= sc->fds.size())
+        {
+            sc->fds.resize(static_cast<size_t>(w.fd) + 1);
+        }
+        FdWaiters &fw = sc->fds[w.fd];
+        lua_Integer &slot = (w.events & EPOLLIN) ? fw.reader : fw.writer;
+        if (slot != 0 && slot != sc->current_id)
+        {
+            return push_fail(L,
+                             "socket: another task is already waiting on this socket");
+        }
+        slot = sc->current_id;
+        if (sched_update_fd(sc, w.fd) < 0)
+        {
+            slot = 0;
+            return push_errno_fail(L, "scheduler");
+        }
+        park_current(sc, w.fd, deadline);
+        return lua_yieldk(L, 0, deadline_to_ctx(deadline), k);
+    }
+
+    // -----------------------------------------------------------------
+    // Méthodes du userdata socket
+    // -----------------------------------------------------------------
+
+    // Cœur de send. total : octets déjà envoyés (repris après une
+    // suspension). Rend IO_YIELD si la tâche doit céder (yw rempli).
+    int send_impl(lua_State *L, Sock *s, const char *data, size_t len,
+                  size_t &total, Deadline deadline, IoWait *yw)
     {
-        Sock *s = check_sock(L, 1);
         if (s->fd < 0)
         {
-            return push_fail(L, "socket: recv_line: socket is closed");
+            return push_fail(L, "socket: send: socket is closed");
         }
         if (s->listening)
         {
             return push_fail(L,
-                             "socket: recv_line: cannot recv on a listening socket");
+                             "socket: send: cannot send on a listening socket");
         }
 
-        // DEADLINE GLOBALE : la lecture ligne-par-ligne peut faire
-        // beaucoup d'appels recv(1 byte). La deadline couvre TOUT
-        // l'appel recv_line, pas chaque octet.
+        // Boucle d'écriture : send() peut écrire partiellement, on
+        // continue jusqu'à tout envoyer ou timeout. MSG_NOSIGNAL :
+        // pas de SIGPIPE sur peer fermé (on reçoit EPIPE).
+        //
+        // CORRECTIF (post-revue ChatGPT) : si un timeout est actif,
+        // on force MSG_DONTWAIT pour que send() lui-même ne bloque
+        // PAS dans le noyau quand le peer lit lentement. Sans ça,
+        // poll() nous disait "prêt pour au moins 1 octet" mais
+        // send() pouvait quand même bloquer pour écrire un gros
+        // buffer entier. EAGAIN/EWOULDBLOCK -> on reboucle sur
+        // poll() avec le timeout restant. Si pas de timeout
+        // (s->timeout_ms == 0), comportement bloquant pur conservé,
+        // pas de MSG_DONTWAIT (sinon send() retournerait
+        // immédiatement EAGAIN au lieu de bloquer comme attendu).
+        //
+        // DEADLINE GLOBALE (post-revue 2) : on calcule la deadline
+        // UNE FOIS au début ; chaque tour de boucle utilise le temps
+        // restant. timeout = durée max de l'APPEL complet (cohérent
+        // avec http set_max_timeout, sémantique unifiée Babet).
         //
-        // TLS (sous-étape 1.3) : route via tls_recv_some quand s->ssl
-        // est non-null. NB : SSL_read par-octet est inefficace (chaque
-        // appel peut déchiffrer un nouveau record TLS interne), mais
-        // OpenSSL bufferise en interne -- le surcoût reste raisonnable
-        // pour des protocoles texte légers (IRC, SMTP).
+        // TLS (Chantier 7, sous-étape 1.3) : si s->ssl est non-null,
+        // le socket est en mode TLS. Le FD est en O_NONBLOCK depuis
+        // connect_tls/starttls (corrigé post-revue) : SSL_write ne
+        // peut PAS bloquer dans le noyau au-delà de la deadline. Si
+        // le buffer noyau est plein, SSL_write retourne WANT_WRITE ;
+        // si une renégociation TLS interne demande des bytes du peer,
+        // SSL_write retourne WANT_READ. tls_send_some traduit ces
+        // cas en codes TLS_IO_WANT_* qu'on gère ci-dessous avec
+        // wait_ready_deadline + retry. Garantie : deadline globale
+        // respectée comme pour TCP brut.
         const bool is_tls = (s->ssl != nullptr);
-        Deadline deadline = make_deadline(s->timeout_ms);
-
-        // CORRECTIF (post-bug bot IRC) : reprendre les octets déjà
-        // lus lors d'un timeout précédent. Si recv_line_pending est
-        // vide (cas normal), acc démarre vide ; sinon on reprend
-        // où on s'était arrêté. Le move + clear garantit qu'on ne
-        // double-traite jamais les mêmes octets.
-        std::string acc = std::move(s->recv_line_pending);
-        s->recv_line_pending.clear();
-
+        // En tâche, send() ne doit jamais bloquer dans le noyau :
+        // MSG_DONTWAIT systématique, EAGAIN -> on cède.
+        const bool use_nonblock = (!is_tls) &&
+                                  (s->timeout_ms > 0 || yw != nullptr);
+        const int send_flags = MSG_NOSIGNAL |
+                               (use_nonblock ? MSG_DONTWAIT : 0);
         std::string tls_err;
-        char c;
-        for (;;)
+        while (total < len)
         {
-            // CORRECTIF (post-bug IRC TLS) : en TLS, OpenSSL lit un
-            // record TLS entier depuis le socket d'un coup. Un record
-            // peut contenir plusieurs lignes IRC. Les octets bruts
-            // sont consommés du socket par OpenSSL et stockés dans
-            // son buffer interne déchiffré. À ce moment-là, le FD
-            // socket est VIDE — poll(POLLIN) renvoie 0 — alors qu'il
-            // y a plein de données à lire via SSL_read.
-            //
-            // Sans cette vérification, recv_line() retournait
-            // (nil, "timeout") en boucle pendant que les lignes
-            // IRC dormaient dans le buffer OpenSSL. Symptôme typique :
-            // un bot IRC se fait kicker pour ping timeout côté serveur
-            // (~240 s), puis au moment où le serveur ferme la
-            // connexion, plusieurs lignes en attente sortent d'un
-            // coup au même timestamp.
+            // Direction du poll : POLLOUT par défaut. En TLS, un
+            // SSL_write peut demander POLLIN (renégociation), géré
+            // dans la branche TLS via le code retour WANT_READ.
             //
-            // SSL_pending() retourne le nombre d'octets DÉJÀ déchiffrés
-            // disponibles immédiatement. Si > 0, on saute l'attente
-            // sur le FD et on lit directement.
-            const bool ssl_has_data =
-                is_tls && (SSL_pending(s->ssl) > 0);
-
-            if (!ssl_has_data)
+            // En tâche, pas de poll préalable : on tente l'écriture
+            // et on ne cède que si elle ferait attendre.
+            if (yw == nullptr)
             {
-                int r = wait_ready_deadline(s->fd, POLLIN, deadline);
+                short poll_events = POLLOUT;
+                int r = wait_ready_deadline(s->fd, poll_events, deadline);
                 if (r == WAIT_INTERRUPTED)
                 {
-                    // Phase B signal : un signal géré est arrivé
-                    // pendant l'attente. On conserve les octets
-                    // déjà lus pour ne pas les perdre (même logique
-                    // que timeout), on dispatche le callback Lua
-                    // utilisateur, puis on remonte "interrupted".
-                    s->recv_line_pending = std::move(acc);
                     signal_dispatch_pending(L);
                     return push_fail(L, "interrupted");
                 }
                 if (r < 0)
                 {
-                    // Erreur fatale : on conserve quand même les octets
-                    // au cas où l'utilisateur ferait quelque chose
-                    // d'intelligent ensuite. close() les libère via __gc.
-                    s->recv_line_pending = std::move(acc);
-                    return push_errno_fail(L, "recv_line");
+                    return push_errno_fail(L, "send");
                 }
                 if (r == 0)
                 {
-                    // CORRECTIF (1.3.2) : conserver les octets déjà
-                    // lus pour le prochain recv_line. Sinon, scénario
-                    // typique IRC avec set_timeout(1) : la ligne
-                    // ":server NOTICE ..." commence à arriver, le ':'
-                    // est lu dans acc, puis le réseau tarde quelques
-                    // ms et le timeout se déclenche. SANS ce buffer,
-                    // le ':' est jeté et l'appel suivant récupère
-                    // "server NOTICE ..." sans son ':'.
-                    s->recv_line_pending = std::move(acc);
                     return push_fail(L, "timeout");
                 }
             }
-            // Si ssl_has_data, on saute wait_ready_deadline et on lit
-            // directement le buffer interne d'OpenSSL via SSL_read.
 
-            ssize_t got = 0;
+            uint32_t wait_for = EPOLLOUT;
             if (is_tls)
             {
-                int rc = tls_recv_some(s->ssl, &c, 1, tls_err);
-                if (rc == TLS_IO_WANT_READ)
+                int rc = tls_send_some(s->ssl, data + total,
+                                       len - total, tls_err);
+                if (rc > 0)
                 {
+                    total += static_cast<size_t>(rc);
                     continue;
                 }
-                if (rc == TLS_IO_WANT_WRITE)
+                if (rc == TLS_IO_EOF)
                 {
-                    int wr = wait_ready_deadline(s->fd, POLLOUT, deadline);
-                    if (wr == WAIT_INTERRUPTED)
-                    {
-                        s->recv_line_pending = std::move(acc);
-                        signal_dispatch_pending(L);
-                        return push_fail(L, "interrupted");
-                    }
-                    if (wr == 0)
-                    {
-                        // Idem : conserver acc.
-                        s->recv_line_pending = std::move(acc);
-                        return push_fail(L, "timeout");
-                    }
-                    if (wr < 0)
-                    {
-                        s->recv_line_pending = std::move(acc);
-                        return push_errno_fail(L, "recv_line");
-                    }
-                    continue;
+                    return push_fail(L, "closed");
                 }
                 if (rc == TLS_IO_FATAL)
                 {
-                    // Erreur TLS fatale : on garde quand même.
-                    s->recv_line_pending = std::move(acc);
                     return push_fail(L, tls_err);
                 }
-                got = (rc == TLS_IO_EOF) ? 0 : rc;
-            }
-            else
-            {
-                got = ::recv(s->fd, &c, 1, 0);
-                if (got < 0)
+                if (rc == TLS_IO_WANT_READ)
                 {
-                    if (errno == EINTR)
+                    if (yw == nullptr)
                     {
+                        int wr = wait_ready_deadline(s->fd, POLLIN, deadline);
+                        if (wr == WAIT_INTERRUPTED)
+                        {
+                            signal_dispatch_pending(L);
+                            return push_fail(L, "interrupted");
+                        }
+                        if (wr == 0)
+                            return push_fail(L, "timeout");
+                        if (wr < 0)
+                            return push_errno_fail(L, "send");
                         continue;
                     }
-                    s->recv_line_pending = std::move(acc);
-                    return push_errno_fail(L, "recv_line");
+                    wait_for = EPOLLIN;
+                }
+                else if (yw == nullptr)
+                {
+                    continue; // WANT_WRITE : déjà attendu POLLOUT, reboucle
                 }
             }
-
-            if (got == 0)
-            {
-                // EOF en plein milieu : 3 valeurs (nil, "closed", partial)
-                // Pas de conservation du buffer ici : le contrat est
-                // déjà documenté et le user récupère partial en main.
-                lua_pushnil(L);
-                lua_pushstring(L, "closed");
-                lua_pushlstring(L, acc.data(), acc.size());
-                return 3;
-            }
-            if (c == '\n')
+            else
             {
-                // CRLF transparent : retire un \r final si présent.
-                if (!acc.empty() && acc.back() == '\r')
+                // Branche TCP brut.
+                ssize_t n = ::send(s->fd, data + total, len - total,
+                                   send_flags);
+                if (n >= 0)
                 {
-                    acc.pop_back();
+                    total += static_cast<size_t>(n);
+                    continue;
+                }
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                if (errno == EPIPE || errno == ECONNRESET)
+                {
+                    return push_fail(L, "closed");
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                {
+                    return push_errno_fail(L, "send");
+                }
+                if (yw == nullptr)
+                {
+                    // Le buffer noyau s'est rempli juste après poll
+                    // (race normale). On reboucle, poll() bloquera
+                    // jusqu'à ce que de la place se libère, dans la
+                    // limite du temps restant sur la deadline.
+                    continue;
                 }
-                lua_pushlstring(L, acc.data(), acc.size());
-                return 1;
             }
-            // Garde contre DoS : sans limite, un peer malveillant ou
-            // un serveur buggué qui envoie un flux infini sans '\n'
-            // ferait grossir `acc` jusqu'à OOM (cf. retour audit
-            // sécurité). 8 MiB est large pour du texte (RFC IRC :
-            // 512 octets max ; HTTP : pas de limite hard mais
-            // typique < 8 KB), et donne une marge confortable pour
-            // les usages applicatifs légitimes. Si un cas concret
-            // demande plus, on ajoutera une option recv_line(max)
-            // sous SemVer.
-            //
-            // On vide pending pour qu'un futur appel ne retombe pas
-            // sur la même donnée empoisonnée — le contrat est que
-            // "line too long" jette aussi les octets accumulés.
-            constexpr size_t MAX_LINE_BYTES = 8 * 1024 * 1024;
-            if (acc.size() >= MAX_LINE_BYTES)
+
+            // Tâche du scheduler : le socket ferait attendre.
+            if (remaining_ms(deadline) == 0)
             {
-                s->recv_line_pending.clear();
-                return push_fail(L, "line too long");
+                return push_fail(L, "timeout");
             }
-            acc.push_back(c);
+            yw->fd = s->fd;
+            yw->events = wait_for;
+            return IO_YIELD;
         }
+        lua_pushinteger(L, static_cast<lua_Integer>(total));
+        return 1;
     }
 
-    // recv_all() : lit jusqu'à EOF du peer, accumule tout. Renvoie
-    // (data, nil) -- même chaîne vide est un succès (peer ferme sans
-    // rien envoyer). Timeout sur un read intermédiaire -> (nil,
-    // "timeout"). Si on veut un comportement "lire ce qui est dispo
-    // maintenant", utiliser recv(n) avec timeout court.
-    int sock_recv_all(lua_State *L)
+    // send(data) : la progression (octets déjà envoyés) est gardée en
+    // 3 sur la pile de la coroutine pendant une suspension.
+    int sock_send_k(lua_State *L, int, lua_KContext ctx)
     {
         Sock *s = check_sock(L, 1);
-        if (s->fd < 0)
-        {
-            return push_fail(L, "socket: recv_all: socket is closed");
-        }
-        if (s->listening)
+        size_t len = 0;
+        const char *data = luaL_checklstring(L, 2, &len);
+        size_t total = static_cast<size_t>(lua_tointeger(L, 3));
+        Deadline deadline = ctx_to_deadline(ctx);
+        IoWait w;
+        int n = send_impl(L, s, data, len, total, deadline,
+                          yield_slot(L, w));
+        if (n != IO_YIELD)
         {
-            return push_fail(L,
-                             "socket: recv_all: cannot recv on a listening socket");
+            return n;
         }
+        lua_pushinteger(L, static_cast<lua_Integer>(total));
+        lua_replace(L, 3);
+        return co_wait(L, w, deadline, sock_send_k);
+    }
 
-        // DEADLINE GLOBALE : on lit jusqu'à EOF, donc potentiellement
-        // beaucoup de chunks. La deadline couvre TOUT l'appel.
-        //
-        // TLS (sous-étape 1.3) : tls_recv_some par chunks 4 KB. EOF
-        // est SSL_ERROR_ZERO_RETURN, signe que le serveur a envoyé
-        // close_notify — c'est le succès attendu pour recv_all.
-        const bool is_tls = (s->ssl != nullptr);
-        Deadline deadline = make_deadline(s->timeout_ms);
-
-        std::string acc;
-        std::string tls_err;
-        char buf[4096];
-        for (;;)
-        {
-            // CORRECTIF (post-bug IRC TLS) : voir explication détaillée
-            // dans sock_recv_line. Si OpenSSL a déjà déchiffré des octets
-            // dans son buffer interne, le FD socket est vide alors qu'il
-            // y a des données à lire.
-            const bool ssl_has_data =
-                is_tls && (SSL_pending(s->ssl) > 0);
+    int sock_send(lua_State *L)
+    {
+        Sock *s = check_sock(L, 1);
+        luaL_checklstring(L, 2, nullptr);
+        lua_settop(L, 2);
+        lua_pushinteger(L, 0);
+        return sock_send_k(L, LUA_OK,
+                           deadline_to_ctx(make_deadline(s->timeout_ms)));
+    }
 
-            if (!ssl_has_data)
-            {
-                int r = wait_ready_deadline(s->fd, POLLIN, deadline);
-                if (r == WAIT_INTERRUPTED)
-                {
-                    signal_dispatch_pending(L);
-                    return push_fail(L, "interrupted");
-                }
-                if (r < 0)
-                {
-                    return push_errno_fail(L, "recv_all");
-                }
-                if (r == 0)
-                {
-                    return push_fail(L, "timeout");
-                }
+    // Plafond raisonnable sur recv(n) pour éviter qu'une faute de
+    // frappe (un *1024 accidentel) ne provoque une allocation OOM.
+    // 16 MB est largement au-dessus du buffer noyau par défaut sous
+    // Linux (~128 KB-2 MB selon tuning), donc aucun cas légitime
+    // n'est restreint. Au-delà -> (nil, err) (décision post-revue).
+    constexpr lua_Integer MAX_RECV_SIZE = 16 * 1024 * 1024;
+
+    // -----------------------------------------------------------------
+    // Tampon de lecture
+    // -----------------------------------------------------------------
+    //
+    // Avant : recv_line faisait un ::recv(fd, &c, 1, 0) PAR OCTET
+    // (précédé d'un poll), soit deux syscalls par caractère. Pour
+    // un flux IRC ou Redis, le débit plafonnait à quelques Mo/s.
+    //
+    // Maintenant : chaque lecture remplit le tampon du Sock par
+    // morceaux de RBUF_SIZE et les délimiteurs sont cherchés avec
+    // memchr dans ce qui est déjà là. Une ligne coûte un syscall par
+    // remplissage, pas par octet.
+    //
+    // 16 KiB : un record TLS complet (16 KiB max) tient dedans, et
+    // c'est assez pour amortir le syscall sur des lignes de texte
+    // sans alourdir un serveur qui garde des milliers de sockets.
+    // Au-delà de RBUF_KEEP_MAX (après une très longue ligne), le
+    // tampon est rendu dès qu'il se vide.
+    constexpr size_t RBUF_SIZE = 16 * 1024;
+    constexpr size_t RBUF_KEEP_MAX = 64 * 1024;
+
+    // Garde contre DoS : sans limite, un peer malveillant ou un
+    // serveur buggué qui envoie un flux infini sans '\n' ferait
+    // grossir le tampon jusqu'à OOM (cf. retour audit sécurité).
+    // 8 MiB est large pour du texte (RFC IRC : 512 octets max ;
+    // HTTP : pas de limite hard mais typique < 8 KB). recv_until
+    // accepte un max explicite, plafonné à la même valeur par défaut.
+    constexpr size_t MAX_LINE_BYTES = 8 * 1024 * 1024;
+
+    // Taille des lectures de recv_all, directement dans la chaîne
+    // accumulée (pas de copie intermédiaire).
+    constexpr size_t RECV_ALL_CHUNK = 64 * 1024;
+
+    // Codes retour de read_some / fill_rbuf (> 0 = octets lus).
+    constexpr int READ_EOF = 0;
+    constexpr int READ_TIMEOUT = -1;
+    constexpr int READ_INTERRUPTED = -2;
+    constexpr int READ_ERRNO = -3; // errno positionné
+    constexpr int READ_TLS = -4;   // tls_err rempli
+    constexpr int READ_YIELD = -5; // tâche : céder sur *yw
+
+    // Attend que fd soit prêt pour events (POLLIN / POLLOUT) : 0 =
+    // prêt, retenter l'opération ; sinon READ_TIMEOUT /
+    // READ_INTERRUPTED / READ_ERRNO, ou READ_YIELD (yw rempli) dans
+    // une tâche du scheduler.
+    int await_fd(int fd, short events, Deadline deadline, IoWait *yw)
+    {
+        if (yw != nullptr)
+        {
+            if (remaining_ms(deadline) == 0)
+            {
+                return READ_TIMEOUT;
             }
+            yw->fd = fd;
+            yw->events = (events == POLLOUT) ? EPOLLOUT : EPOLLIN;
+            return READ_YIELD;
+        }
+        int r = wait_ready_deadline(fd, events, deadline);
+        if (r == WAIT_INTERRUPTED)
+        {
+            return READ_INTERRUPTED;
+        }
+        if (r < 0)
+        {
+            return READ_ERRNO;
+        }
+        if (r == 0)
+        {
+            return READ_TIMEOUT;
+        }
+        return 0;
+    }
 
-            ssize_t got = 0;
-            if (is_tls)
+    // Lit AU PLUS cap octets dans dst, en respectant la deadline.
+    //
+    // On tente la lecture AVANT d'attendre (MSG_DONTWAIT en TCP brut,
+    // FD déjà O_NONBLOCK en TLS) : quand des octets sont déjà dans le
+    // noyau — cas courant pour un flux soutenu — un remplissage coûte
+    // un seul syscall au lieu de poll + recv. poll n'est appelé que
+    // sur EAGAIN / WANT_READ / WANT_WRITE.
+    //
+    // Ça couvre aussi le CORRECTIF post-bug IRC TLS (SSL_pending) :
+    // si OpenSSL a déjà déchiffré des octets dans son buffer interne,
+    // le FD est vide mais SSL_read les rend tout de suite, sans
+    // passer par un poll qui dirait "rien à lire".
+    //
+    // Deadline dépassée avec des octets déjà là : ils sont rendus
+    // (même logique que le poll(fd, 1, 0) final de
+    // wait_ready_deadline).
+    //
+    // yw non-null (tâche du scheduler) : au lieu de poll, remplit *yw
+    // et rend READ_YIELD ; l'appelant remonte jusqu'à co_wait.
+    int read_some(Sock *s, char *dst, size_t cap, Deadline deadline,
+                  std::string &tls_err, IoWait *yw)
+    {
+        if (cap > static_cast<size_t>(INT_MAX))
+        {
+            cap = static_cast<size_t>(INT_MAX);
+        }
+        for (;;)
+        {
+            short wait_for = POLLIN;
+            if (s->ssl != nullptr)
             {
-                int rc = tls_recv_some(s->ssl, buf, sizeof(buf), tls_err);
-                if (rc == TLS_IO_WANT_READ)
+                int rc = tls_recv_some(s->ssl, dst, cap, tls_err);
+                if (rc > 0)
                 {
-                    continue;
+                    return rc;
                 }
-                if (rc == TLS_IO_WANT_WRITE)
+                if (rc == TLS_IO_EOF)
                 {
-                    int wr = wait_ready_deadline(s->fd, POLLOUT, deadline);
-                    if (wr == WAIT_INTERRUPTED)
-                    {
-                        signal_dispatch_pending(L);
-                        return push_fail(L, "interrupted");
-                    }
-                    if (wr == 0)
-                        return push_fail(L, "timeout");
-                    if (wr < 0)
-                        return push_errno_fail(L, "recv_all");
-                    continue;
+                    return READ_EOF;
                 }
                 if (rc == TLS_IO_FATAL)
                 {
-                    return push_fail(L, tls_err);
+                    return READ_TLS;
+                }
+                if (rc == TLS_IO_WANT_WRITE)
+                {
+                    wait_for = POLLOUT; // renégociation
                 }
-                got = (rc == TLS_IO_EOF) ? 0 : rc;
             }
             else
             {
-                got = ::recv(s->fd, buf, sizeof(buf), 0);
-                if (got < 0)
+                ssize_t got = ::recv(s->fd, dst, cap, MSG_DONTWAIT);
+                if (got > 0)
                 {
-                    if (errno == EINTR)
-                    {
-                        continue;
-                    }
-                    return push_errno_fail(L, "recv_all");
+                    return static_cast<int>(got);
+                }
+                if (got == 0)
+                {
+                    return READ_EOF;
+                }
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                {
+                    return READ_ERRNO;
                 }
             }
 
-            if (got == 0)
+            int r = await_fd(s->fd, wait_for, deadline, yw);
+            if (r < 0)
             {
-                // EOF normal sur recv_all : c'est le SUCCÈS attendu.
-                lua_pushlstring(L, acc.data(), acc.size());
-                return 1;
+                return r;
             }
-            acc.append(buf, static_cast<size_t>(got));
         }
     }
 
-    // accept() : accepte une connexion entrante sur un socket
-    // d'écoute. Renvoie un userdata socket connecté.
-    int sock_accept(lua_State *L)
+    // Reporte l'état du tampon dans les pollers du socket (défini
+    // avec Poller). À appeler après tout remplissage / vidage.
+    void poller_sync_buffered(Sock *s);
+    // Détache le socket de ses pollers avant sa destruction (__gc).
+    void poller_forget_sock(Sock *s);
+
+    // Ajoute des octets à la fin du tampon (un seul read_some).
+    // Fait de la place si besoin : allocation paresseuse, puis
+    // compactage (memmove vers le début) si des octets ont été
+    // consommés, sinon doublement de la capacité.
+    int fill_rbuf(Sock *s, Deadline deadline, std::string &tls_err,
+                  IoWait *yw)
     {
-        Sock *s = check_sock(L, 1);
-        if (s->fd < 0)
+        if (s->rbuf.empty())
         {
-            return push_fail(L, "socket: accept: socket is closed");
+            s->rbuf.resize(RBUF_SIZE);
         }
-        if (!s->listening)
+        else if (s->rend == s->rbuf.size())
         {
-            return push_fail(L,
-                             "socket: accept: socket is not listening");
+            if (s->rpos > 0)
+            {
+                std::memmove(&s->rbuf[0], s->rbuf.data() + s->rpos,
+                             s->rend - s->rpos);
+                s->rend -= s->rpos;
+                s->rpos = 0;
+            }
+            else
+            {
+                s->rbuf.resize(s->rbuf.size() * 2);
+            }
+        }
+        int rc = read_some(s, &s->rbuf[s->rend],
+                           s->rbuf.size() - s->rend, deadline, tls_err, yw);
+        if (rc > 0)
+        {
+            s->rend += static_cast<size_t>(rc);
+        }
+        poller_sync_buffered(s);
+        return rc;
+    }
+
+    size_t rbuf_avail(const Sock *s)
+    {
+        return s->rend - s->rpos;
+    }
+
+    // Octets déjà lisibles sans toucher au FD (tampon Sock ou OpenSSL).
+    bool sock_has_buffered(const Sock *s)
+    {
+        return rbuf_avail(s) > 0 ||
+               (s->ssl != nullptr && SSL_pending(s->ssl) > 0);
+    }
+
+    // Vide le tampon. Rend la mémoire si la capacité a grossi au-delà
+    // de RBUF_KEEP_MAX (une ligne géante ne doit pas coûter 8 MiB par
+    // socket pour le reste de sa vie).
+    void rbuf_reset(Sock *s)
+    {
+        s->rpos = 0;
+        s->rend = 0;
+        if (s->rbuf.size() > RBUF_KEEP_MAX)
+        {
+            std::string().swap(s->rbuf);
         }
+        poller_sync_buffered(s);
+    }
 
-        // DEADLINE GLOBALE : accept() bloque jusqu'à arrivée d'un
-        // client. Si EINTR au milieu, on reboucle avec le temps
-        // restant, jamais infini.
-        Deadline deadline = make_deadline(s->timeout_ms);
+    // Consomme n octets en tête du tampon.
+    void rbuf_consume(Sock *s, size_t n)
+    {
+        s->rpos += n;
+        if (s->rpos >= s->rend)
+        {
+            rbuf_reset(s);
+        }
+    }
 
-        int r = wait_ready_deadline(s->fd, POLLIN, deadline);
-        if (r == WAIT_INTERRUPTED)
+    // Traduit un code READ_* d'échec en retour Lua (nil, err).
+    int push_read_fail(lua_State *L, int rc, const char *op,
+                       const std::string &tls_err)
+    {
+        switch (rc)
         {
+        case READ_TIMEOUT:
+            return push_fail(L, "timeout");
+        case READ_INTERRUPTED:
             signal_dispatch_pending(L);
             return push_fail(L, "interrupted");
+        case READ_TLS:
+            return push_fail(L, tls_err);
+        default:
+            return push_errno_fail(L, op);
         }
-        if (r < 0)
+    }
+
+    // Vérifications communes à toutes les méthodes de réception.
+    // Renvoie nullptr si OK, sinon le message d'erreur. dgram_msg :
+    // refus sur un socket datagramme (nullptr = accepté), pour les
+    // lectures de flux qui n'ont pas de sens sur des datagrammes.
+    const char *check_readable(const Sock *s, const char *closed_msg,
+                               const char *listening_msg,
+                               const char *dgram_msg = nullptr)
+    {
+        if (s->fd < 0)
         {
-            return push_errno_fail(L, "accept");
+            return closed_msg;
         }
-        if (r == 0)
+        if (s->listening)
         {
-            return push_fail(L, "timeout");
+            return listening_msg;
+        }
+        if (dgram_msg != nullptr && s->type == SOCK_DGRAM)
+        {
+            return dgram_msg;
         }
+        return nullptr;
+    }
 
-        int client_fd;
+    // Reçoit UN datagramme dans dst (recvfrom), en respectant la
+    // deadline. Rend sa taille -- 0 est un datagramme vide, valide en
+    // UDP, pas un EOF -- ou un code READ_* négatif. MSG_TRUNC : le
+    // noyau rend la vraie taille, d'où truncated quand elle dépasse
+    // cap (le reste du datagramme est perdu, comme avec recv(2)).
+    int dgram_recv(Sock *s, char *dst, size_t cap,
+                   struct sockaddr_storage *from, socklen_t *fromlen,
+                   Deadline deadline, IoWait *yw, bool &truncated)
+    {
         for (;;)
         {
-            // accept4 + SOCK_CLOEXEC : atomique, pas de fenêtre où
-            // le FD pourrait fuiter vers un fork+exec concurrent.
-            // Si accept4 n'est pas dispo (système très ancien), un
-            // fallback ::accept + ensure_cloexec serait nécessaire ;
-            // sur Linux moderne et FreeBSD, accept4 est garanti.
-            client_fd = ::accept4(s->fd, nullptr, nullptr,
-                                  SOCK_CLOEXEC);
-            if (client_fd >= 0)
+            if (from != nullptr)
             {
-                ensure_cloexec(client_fd); // ceinture + bretelles
-                break;
+                *fromlen = sizeof(*from);
+            }
+            ssize_t got = ::recvfrom(s->fd, dst, cap,
+                                     MSG_DONTWAIT | MSG_TRUNC,
+                                     reinterpret_cast<struct sockaddr *>(from),
+                                     fromlen);
+            if (got >= 0)
+            {
+                truncated = static_cast<size_t>(got) > cap;
+                return static_cast<int>(truncated ? cap : static_cast<size_t>(got));
             }
             if (errno == EINTR)
             {
-                // Refaire un wait_ready : on a perdu du temps, on
-                // doit re-vérifier que la deadline n'est pas dépassée
-                // ET attendre à nouveau qu'un client se présente
-                // (le précédent connect() peut ne plus être là).
-                int r2 = wait_ready_deadline(s->fd, POLLIN, deadline);
-                if (r2 == WAIT_INTERRUPTED)
-                {
-                    signal_dispatch_pending(L);
-                    return push_fail(L, "interrupted");
-                }
-                if (r2 < 0)
-                {
-                    return push_errno_fail(L, "accept");
-                }
-                if (r2 == 0)
-                {
-                    return push_fail(L, "timeout");
-                }
                 continue;
             }
-            return push_errno_fail(L, "accept");
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                return READ_ERRNO;
+            }
+            int r = await_fd(s->fd, POLLIN, deadline, yw);
+            if (r < 0)
+            {
+                return r;
+            }
         }
-        push_new_sock(L, client_fd, false);
-        return 1;
     }
 
-    int sock_close(lua_State *L)
+    // recv(n) "au plus n octets" (sémantique read()). EOF -> (nil,
+    // "closed"). Timeout -> (nil, "timeout").
+    //
+    // Octets déjà dans le tampon (laissés par un recv_line, par
+    // exemple) : rendus tout de suite, sans syscall. Sinon, un petit
+    // n passe par le tampon (un remplissage sert les recv(n)
+    // suivants), un grand n (>= RBUF_SIZE) lit directement dans sa
+    // propre zone, sans copie de plus.
+    //
+    // Socket datagramme : UN datagramme par appel, tronqué à n, sans
+    // passer par le tampon (qui collerait les datagrammes entre eux).
+    //
+    // DEADLINE GLOBALE (post-revue 2) : une seule deadline pour
+    // tout l'appel, même si on reboucle sur EAGAIN/EINTR.
+    int recv_impl(lua_State *L, Sock *s, Deadline deadline, IoWait *yw)
     {
-        Sock *s = check_sock(L, 1);
-        // TLS d'abord (close_notify best-effort), puis FD sous-jacent.
-        // tls_close gère le cas nullptr et nettoie aussi la pile ERR.
-        if (s->ssl != nullptr)
-        {
-            tls_close(s->ssl);
-            s->ssl = nullptr;
-        }
-        if (s->fd >= 0)
+        lua_Integer n = luaL_checkinteger(L, 2);
+        if (n <= 0)
         {
-            ::close(s->fd);
-            s->fd = -1;
+            return push_fail(L, "socket: recv: count must be > 0");
         }
-        return push_ok(L);
-    }
-
-    int sock_set_timeout(lua_State *L)
-    {
-        Sock *s = check_sock(L, 1);
-        lua_Number t = luaL_checknumber(L, 2);
-        // CORRECTIF (post-revue ChatGPT) : rejeter NaN et inf avant
-        // tout cast vers int (sinon comportement indéfini). std::isnan
-        // détecte NaN, std::isfinite refuse +inf et -inf (et accepte
-        // 0 et toutes les valeurs finies).
-        if (std::isnan(t) || !std::isfinite(t))
+        if (n > MAX_RECV_SIZE)
         {
             return push_fail(L,
-                             "socket: set_timeout: value must be finite "
-                             "(not NaN or inf)");
+                             "socket: recv: count exceeds 16 MB cap");
         }
-        if (t < 0.0)
+        if (const char *bad = check_readable(
+                s, "socket: recv: socket is closed",
+                "socket: recv: cannot recv on a listening socket"))
         {
-            return push_fail(L,
-                             "socket: set_timeout: value must be >= 0 (0 disables)");
+            return push_fail(L, bad);
         }
-        // t = 0 -> timeout_ms = 0 -> bloquant infini (cf. make_deadline).
-        // sinon : conversion secondes -> millisecondes, plancher 1 ms
-        // pour éviter qu'un timeout positif arrondi à 0 ne désactive
-        // silencieusement le timeout (même piège qu'avec set_max_timeout
-        // côté http). Plafond INT_MAX ms (~24 jours) pour éviter le
-        // débordement du cast en int.
-        if (t == 0.0)
+
+        const size_t want = static_cast<size_t>(n);
+        std::string tls_err;
+        if (s->type == SOCK_DGRAM)
         {
-            s->timeout_ms = 0;
+            std::vector<char> buf(want);
+            bool truncated = false;
+            int rc = dgram_recv(s, buf.data(), want, nullptr, nullptr,
+                                deadline, yw, truncated);
+            if (rc == READ_YIELD)
+            {
+                return IO_YIELD;
+            }
+            if (rc < 0)
+            {
+                return push_read_fail(L, rc, "recv", tls_err);
+            }
+            lua_pushlstring(L, buf.data(), static_cast<size_t>(rc));
+            return 1;
         }
-        else
+        if (rbuf_avail(s) == 0)
         {
-            double ms = t * 1000.0;
-            if (ms > static_cast<double>(INT_MAX))
+            if (want >= RBUF_SIZE)
             {
-                return push_fail(L,
-                                 "socket: set_timeout: value too large");
+                std::vector<char> buf(want);
+                int rc = read_some(s, buf.data(), buf.size(), deadline,
+                                   tls_err, yw);
+                poller_sync_buffered(s); // SSL_pending a pu changer
+                if (rc == READ_YIELD)
+                {
+                    return IO_YIELD;
+                }
+                if (rc > 0)
+                {
+                    lua_pushlstring(L, buf.data(),
+                                    static_cast<size_t>(rc));
+                    return 1;
+                }
+                if (rc == READ_EOF)
+                {
+                    return push_fail(L, "closed");
+                }
+                return push_read_fail(L, rc, "recv", tls_err);
+            }
+            int rc = fill_rbuf(s, deadline, tls_err, yw);
+            if (rc == READ_YIELD)
+            {
+                return IO_YIELD;
+            }
+            if (rc == READ_EOF)
+            {
+                return push_fail(L, "closed");
+            }
+            if (rc < 0)
+            {
+                return push_read_fail(L, rc, "recv", tls_err);
             }
-            s->timeout_ms = (ms < 1.0) ? 1 : static_cast<int>(ms);
         }
-        return push_ok(L);
-    }
 
-    // peer() / sockname() : renvoie une table { host, port }.
-    int push_addr_table(lua_State *L, const struct sockaddr *sa,
-                        socklen_t salen)
-    {
-        char host[NI_MAXHOST];
-        char port[NI_MAXSERV];
-        int rc = ::getnameinfo(sa, salen, host, sizeof(host),
-                               port, sizeof(port),
-                               NI_NUMERICHOST | NI_NUMERICSERV);
-        if (rc != 0)
+        size_t take = rbuf_avail(s);
+        if (take > want)
         {
-            std::string msg = "socket: getnameinfo: ";
-            msg += ::gai_strerror(rc);
-            return push_fail(L, msg);
+            take = want;
         }
-        lua_newtable(L);
-        lua_pushstring(L, host);
-        lua_setfield(L, -2, "host");
-        lua_pushinteger(L, static_cast<lua_Integer>(std::atoi(port)));
-        lua_setfield(L, -2, "port");
+        lua_pushlstring(L, s->rbuf.data() + s->rpos, take);
+        rbuf_consume(s, take);
         return 1;
     }
 
-    int sock_peer(lua_State *L)
+    int sock_recv_k(lua_State *L, int, lua_KContext ctx)
     {
         Sock *s = check_sock(L, 1);
-        if (s->fd < 0)
+        Deadline deadline = ctx_to_deadline(ctx);
+        IoWait w;
+        int n = recv_impl(L, s, deadline, yield_slot(L, w));
+        if (n == IO_YIELD)
         {
-            return push_fail(L, "socket: peer: socket is closed");
+            return co_wait(L, w, deadline, sock_recv_k);
         }
-        struct sockaddr_storage ss;
-        socklen_t slen = sizeof(ss);
-        if (::getpeername(s->fd,
-                          reinterpret_cast<struct sockaddr *>(&ss),
-                          &slen) != 0)
-        {
-            return push_errno_fail(L, "peer");
-        }
-        return push_addr_table(L,
-                               reinterpret_cast<struct sockaddr *>(&ss), slen);
+        return n;
     }
 
-    int sock_sockname(lua_State *L)
+    int sock_recv(lua_State *L)
     {
         Sock *s = check_sock(L, 1);
-        if (s->fd < 0)
-        {
-            return push_fail(L, "socket: sockname: socket is closed");
-        }
-        struct sockaddr_storage ss;
-        socklen_t slen = sizeof(ss);
-        if (::getsockname(s->fd,
-                          reinterpret_cast<struct sockaddr *>(&ss),
-                          &slen) != 0)
+        return sock_recv_k(L, LUA_OK,
+                           deadline_to_ctx(make_deadline(s->timeout_ms)));
+    }
+
+    // Cherche delim[0, dlen) dans rbuf[from, rend). memchr sur le
+    // premier octet (vectorisé par la libc), puis memcmp du reste.
+    // Renvoie la position du délimiteur, ou std::string::npos.
+    size_t rbuf_find(const Sock *s, size_t from, const char *delim,
+                     size_t dlen)
+    {
+        const char *base = s->rbuf.data();
+        const char *p = base + from;
+        const char *end = base + s->rend;
+        while (static_cast<size_t>(end - p) >= dlen)
         {
-            return push_errno_fail(L, "sockname");
+            const void *hit = std::memchr(p, delim[0],
+                                          static_cast<size_t>(end - p) - dlen + 1);
+            if (hit == nullptr)
+            {
+                return std::string::npos;
+            }
+            const char *q = static_cast<const char *>(hit);
+            if (dlen == 1 || std::memcmp(q + 1, delim + 1, dlen - 1) == 0)
+            {
+                return static_cast<size_t>(q - base);
+            }
+            p = q + 1;
         }
-        return push_addr_table(L,
-                               reinterpret_cast<struct sockaddr *>(&ss), slen);
+        return std::string::npos;
     }
 
-    // __gc : filet de sécurité. Si l'utilisateur a oublié :close(),
-    // on ferme à la collecte de l'userdata. Pas de fuite de FD ni de SSL.
-    // CORRECTIF (placement new) : on appelle aussi explicitement le
-    // destructeur du Sock, car push_new_sock utilise placement new
-    // pour initialiser le std::string recv_line_pending.
-    int sock_gc(lua_State *L)
+    // Cœur de recv_line / recv_until : lit jusqu'à delim, rend les
+    // octets qui précèdent (sans le délimiteur), consomme le
+    // délimiteur. strip_cr : retire un '\r' final (CRLF transparent
+    // pour recv_line).
+    //
+    // EOF en plein milieu : (nil, "closed", partial). 3 valeurs
+    // assumées ici (cf. SOCK-5) -- ne pas perdre les octets déjà lus.
+    // Timeout / interrupted / erreur : les octets restent dans le
+    // tampon pour l'appel suivant.
+    //
+    // Plus de max octets sans délimiteur : (nil, too_long_msg) et le
+    // tampon est vidé -- le contrat est que "line too long" jette
+    // aussi les octets accumulés, pour qu'un appel suivant ne
+    // retombe pas sur la même donnée empoisonnée.
+    //
+    // DEADLINE GLOBALE : deadline couvre TOUT l'appel (suspensions
+    // comprises), pas chaque remplissage.
+    int recv_delimited(lua_State *L, Sock *s, const char *delim,
+                       size_t dlen, size_t max, bool strip_cr,
+                       const char *op, const char *too_long_msg,
+                       Deadline deadline, IoWait *yw)
     {
-        Sock *s = static_cast<Sock *>(
-            luaL_testudata(L, 1, SOCK_META));
-        if (s)
+        std::string tls_err;
+        // Octets (relatifs à rpos) déjà examinés sans trouver delim :
+        // pas la peine de les rescanner après un remplissage. Relatif
+        // parce que fill_rbuf peut compacter le tampon.
+        size_t scanned = 0;
+        for (;;)
         {
-            if (s->ssl != nullptr)
+            size_t at = rbuf_find(s, s->rpos + scanned, delim, dlen);
+            if (at != std::string::npos && at - s->rpos <= max)
+            {
+                size_t len = at - s->rpos;
+                if (strip_cr && len > 0 && s->rbuf[at - 1] == '\r')
+                {
+                    --len;
+                }
+                lua_pushlstring(L, s->rbuf.data() + s->rpos, len);
+                rbuf_consume(s, at - s->rpos + dlen);
+                return 1;
+            }
+            size_t avail = rbuf_avail(s);
+            if (at != std::string::npos || avail >= max)
+            {
+                rbuf_reset(s);
+                return push_fail(L, too_long_msg);
+            }
+            // Le délimiteur peut chevaucher la fin actuelle : on
+            // rescanne ses dlen - 1 derniers octets au prochain tour.
+            scanned = (avail >= dlen) ? avail - dlen + 1 : 0;
+
+            int rc = fill_rbuf(s, deadline, tls_err, yw);
+            if (rc == READ_YIELD)
+            {
+                return IO_YIELD;
+            }
+            if (rc == READ_EOF)
             {
-                tls_close(s->ssl);
-                s->ssl = nullptr;
+                lua_pushnil(L);
+                lua_pushstring(L, "closed");
+                lua_pushlstring(L, s->rbuf.data() + s->rpos,
+                                rbuf_avail(s));
+                rbuf_reset(s);
+                return 3;
             }
-            if (s->fd >= 0)
+            if (rc < 0)
             {
-                ::close(s->fd);
-                s->fd = -1;
+                return push_read_fail(L, rc, op, tls_err);
             }
-            s->~Sock(); // libère recv_line_pending
         }
-        return 0;
     }
 
-    // __tostring : utile pour debug et inspection.
-    int sock_tostring(lua_State *L)
+    // recv_line() : lit jusqu'à '\n' inclus dans le flux ; renvoie la
+    // ligne SANS le '\n' final (et sans un éventuel '\r' juste avant,
+    // pour gérer CRLF transparent côté script).
+    int sock_recv_line_k(lua_State *L, int, lua_KContext ctx)
     {
         Sock *s = check_sock(L, 1);
-        char buf[64];
-        if (s->fd < 0)
+        if (const char *bad = check_readable(
+                s, "socket: recv_line: socket is closed",
+                "socket: recv_line: cannot recv on a listening socket",
+                "socket: recv_line: not a stream socket"))
         {
-            std::snprintf(buf, sizeof(buf), "socket (closed)");
+            return push_fail(L, bad);
         }
-        else
+        Deadline deadline = ctx_to_deadline(ctx);
+        IoWait w;
+        int n = recv_delimited(L, s, "\n", 1, MAX_LINE_BYTES, true,
+                               "recv_line", "line too long", deadline,
+                               yield_slot(L, w));
+        if (n == IO_YIELD)
         {
-            std::snprintf(buf, sizeof(buf),
-                          "socket (%s, fd=%d)",
-                          s->listening ? "listening" : "stream", s->fd);
+            return co_wait(L, w, deadline, sock_recv_line_k);
         }
-        lua_pushstring(L, buf);
-        return 1;
+        return n;
     }
 
-} // namespace
+    int sock_recv_line(lua_State *L)
+    {
+        Sock *s = check_sock(L, 1);
+        return sock_recv_line_k(L, LUA_OK,
+                                deadline_to_ctx(make_deadline(s->timeout_ms)));
+    }
 
-namespace
-{
-    // Helper interne factorisé (sous-étape 1.2) : effectue un TCP
-    // connect bloquant avec timeout (deadline globale). Renvoie le FD
-    // connecté ou -1. En cas d'erreur :
-    //   - `timed_out` mis à true si la deadline a expiré
-    //   - sinon `err` contient un message lisible
+    // recv_until(delim [, max]) : lit jusqu'à la chaîne delim (1 octet
+    // ou plus, binaire-safe), la consomme et renvoie ce qui précède.
+    // Pas de traitement CR. Cas d'usage : "\r\n\r\n" (fin d'en-têtes
+    // HTTP), "\0" (trames terminées par NUL), "\r\n" strict.
     //
-    // Réutilisé par lua_socket_connect (TCP brut) et
-    // lua_socket_connect_tls (avant le handshake TLS).
-    int tcp_connect_blocking(const char *host, lua_Integer port,
-                             int timeout_ms,
-                             std::string &err, bool &timed_out)
+    // max : nombre d'octets au plus sans délimiteur (défaut 8 MiB,
+    // plafond 16 MB comme recv). Au-delà -> (nil, "too long").
+    int sock_recv_until_k(lua_State *L, int, lua_KContext ctx)
     {
-        timed_out = false;
+        Sock *s = check_sock(L, 1);
+        size_t dlen = 0;
+        const char *delim = luaL_checklstring(L, 2, &dlen);
+        lua_Integer max = luaL_optinteger(L, 3,
+                                          static_cast<lua_Integer>(MAX_LINE_BYTES));
+        if (dlen == 0)
+        {
+            return push_fail(L,
+                             "socket: recv_until: delimiter must not be empty");
+        }
+        if (max <= 0 || max > MAX_RECV_SIZE)
+        {
+            return push_fail(L,
+                             "socket: recv_until: max must be in [1, 16 MB]");
+        }
+        if (const char *bad = check_readable(
+                s, "socket: recv_until: socket is closed",
+                "socket: recv_until: cannot recv on a listening socket",
+                "socket: recv_until: not a stream socket"))
+        {
+            return push_fail(L, bad);
+        }
+        Deadline deadline = ctx_to_deadline(ctx);
+        IoWait w;
+        int n = recv_delimited(L, s, delim, dlen, static_cast<size_t>(max),
+                               false, "recv_until", "too long", deadline,
+                               yield_slot(L, w));
+        if (n == IO_YIELD)
+        {
+            return co_wait(L, w, deadline, sock_recv_until_k);
+        }
+        return n;
+    }
 
-        char port_str[16];
-        std::snprintf(port_str, sizeof(port_str), "%lld",
-                      static_cast<long long>(port));
+    int sock_recv_until(lua_State *L)
+    {
+        Sock *s = check_sock(L, 1);
+        return sock_recv_until_k(L, LUA_OK,
+                                 deadline_to_ctx(make_deadline(s->timeout_ms)));
+    }
 
-        struct addrinfo *res = resolve(host, port_str, false, err);
-        if (!res)
+    // recv_all() : lit jusqu'à EOF du peer, accumule tout. Renvoie
+    // (data, nil) -- même chaîne vide est un succès (peer ferme sans
+    // rien envoyer). Timeout sur un read intermédiaire -> (nil,
+    // "timeout"). Si on veut un comportement "lire ce qui est dispo
+    // maintenant", utiliser recv(n) avec timeout court.
+    //
+    // L'accumulateur démarre avec le contenu du tampon, puis les
+    // lectures se font directement dans sa queue (RECV_ALL_CHUNK).
+    // Sur timeout / interrupted / erreur, tout ce qui a été lu
+    // retourne dans le tampon : un recv_all (ou recv) suivant le
+    // retrouve, comme pour recv_line.
+    //
+    // TLS : EOF est SSL_ERROR_ZERO_RETURN, signe que le serveur a
+    // envoyé close_notify — c'est le succès attendu pour recv_all.
+    //
+    // En tâche, une suspension range aussi l'accumulé dans le tampon.
+    // Le tampon commence alors en 0 : la reprise l'échange avec acc
+    // (swap, pas de copie), un gros corps reçu par petits morceaux
+    // reste linéaire.
+    int recv_all_impl(lua_State *L, Sock *s, Deadline deadline, IoWait *yw)
+    {
+        if (const char *bad = check_readable(
+                s, "socket: recv_all: socket is closed",
+                "socket: recv_all: cannot recv on a listening socket",
+                "socket: recv_all: not a stream socket"))
         {
-            return -1;
+            return push_fail(L, bad);
         }
 
-        // Essaie chaque addrinfo dans l'ordre (IPv4/IPv6 selon DNS).
-        int fd = -1;
-        int last_errno = 0;
-        for (struct addrinfo *ai = res; ai != nullptr; ai = ai->ai_next)
+        std::string acc;
+        if (s->rpos == 0)
         {
-            // SOCK_CLOEXEC dans le type : atomique, jamais hérité par
-            // un fork+exec concurrent (cf. ensure_cloexec).
-            fd = ::socket(ai->ai_family,
-                          ai->ai_socktype | SOCK_CLOEXEC,
-                          ai->ai_protocol);
-            if (fd < 0)
-            {
-                last_errno = errno;
-                continue;
-            }
-            ensure_cloexec(fd); // belt + suspenders
-            // Pour le timeout sur connect : on passe en non-bloquant
-            // le temps du connect, on attend la disponibilité via poll,
-            // on remet bloquant ensuite. Pattern POSIX standard.
-            int flags = ::fcntl(fd, F_GETFL, 0);
-            if (timeout_ms > 0 && flags >= 0)
-            {
-                ::fcntl(fd, F_SETFL, flags | O_NONBLOCK);
-            }
-            int rc = ::connect(fd, ai->ai_addr, ai->ai_addrlen);
-            if (rc == 0)
-            {
-                if (timeout_ms > 0 && flags >= 0)
-                {
-                    ::fcntl(fd, F_SETFL, flags);
-                }
-                break; // connecté direct (loopback typique)
-            }
-            if (errno != EINPROGRESS || timeout_ms == 0)
+            acc.swap(s->rbuf);
+            acc.resize(s->rend);
+        }
+        else
+        {
+            acc.assign(s->rbuf.data() + s->rpos, rbuf_avail(s));
+        }
+        rbuf_reset(s);
+        std::string tls_err;
+        for (;;)
+        {
+            size_t used = acc.size();
+            acc.resize(used + RECV_ALL_CHUNK);
+            int rc = read_some(s, &acc[used], RECV_ALL_CHUNK, deadline,
+                               tls_err, yw);
+            if (rc > 0)
             {
-                last_errno = errno;
-                ::close(fd);
-                fd = -1;
+                acc.resize(used + static_cast<size_t>(rc));
                 continue;
             }
-            // En cours, attendre POLLOUT avec deadline globale.
-            Deadline deadline = make_deadline(timeout_ms);
-            int wr = wait_ready_deadline(fd, POLLOUT, deadline);
-            if (wr == WAIT_INTERRUPTED)
-            {
-                // Phase B signal : on signale via err (le caller
-                // distingue "interrupted" de "timed out"). On ne
-                // tente PAS les autres addrinfo : si l'utilisateur
-                // a demandé l'arrêt, on s'arrête.
-                err = "interrupted";
-                ::close(fd);
-                fd = -1;
-                break;
-            }
-            if (wr == 0)
-            {
-                timed_out = true;
-                ::close(fd);
-                fd = -1;
-                break; // inutile d'essayer les autres addrinfo
-            }
-            if (wr < 0)
+            acc.resize(used);
+            if (rc == READ_YIELD)
             {
-                last_errno = errno;
-                ::close(fd);
-                fd = -1;
-                continue;
+                s->rend = acc.size();
+                s->rbuf = std::move(acc);
+                poller_sync_buffered(s);
+                return IO_YIELD;
             }
-            // Récupérer le statut réel de connect via SO_ERROR
-            int soerr = 0;
-            socklen_t slen = sizeof(soerr);
-            if (::getsockopt(fd, SOL_SOCKET, SO_ERROR, &soerr, &slen) < 0 || soerr != 0)
+            if (rc == READ_EOF)
             {
-                last_errno = (soerr != 0) ? soerr : errno;
-                ::close(fd);
-                fd = -1;
-                continue;
+                // EOF normal sur recv_all : c'est le SUCCÈS attendu.
+                lua_pushlstring(L, acc.data(), acc.size());
+                return 1;
             }
-            // Succès : remettre bloquant
-            ::fcntl(fd, F_SETFL, flags);
-            break;
+            // Pousser le retour AVANT de rendre les octets au tampon :
+            // push_read_fail lit errno.
+            int nret = push_read_fail(L, rc, "recv_all", tls_err);
+            s->rend = acc.size();
+            s->rbuf = std::move(acc);
+            poller_sync_buffered(s);
+            return nret;
         }
-        ::freeaddrinfo(res);
+    }
 
-        if (fd < 0 && !timed_out && err.empty())
+    // DEADLINE GLOBALE : on lit jusqu'à EOF, donc potentiellement
+    // beaucoup de chunks. La deadline couvre TOUT l'appel.
+    int sock_recv_all_k(lua_State *L, int, lua_KContext ctx)
+    {
+        Sock *s = check_sock(L, 1);
+        Deadline deadline = ctx_to_deadline(ctx);
+        IoWait w;
+        int n = recv_all_impl(L, s, deadline, yield_slot(L, w));
+        if (n == IO_YIELD)
         {
-            err = "socket: connect: ";
-            err += std::strerror(last_errno);
+            return co_wait(L, w, deadline, sock_recv_all_k);
         }
-        return fd;
+        return n;
     }
 
-    // Parse + valide timeout en secondes depuis la stack Lua à l'index
-    // donné (pour les fonctions qui prennent un timeout positionnel).
-    // Renvoie true en succès. En cas d'invalidité, remplit err et
-    // renvoie false. Si l'argument est absent/nil, *out reste 0 (=
-    // bloquant infini).
-    bool parse_positional_timeout(lua_State *L, int idx, int *out,
-                                  std::string &err,
-                                  const char *prefix_for_err)
+    int sock_recv_all(lua_State *L)
     {
-        *out = 0;
-        if (lua_isnoneornil(L, idx))
+        Sock *s = check_sock(L, 1);
+        return sock_recv_all_k(L, LUA_OK,
+                               deadline_to_ctx(make_deadline(s->timeout_ms)));
+    }
+
+    // -----------------------------------------------------------------
+    // Datagrammes (UDP, unix SOCK_DGRAM) : sendto / recvfrom et leurs
+    // variantes par lots sendmmsg / recvmmsg (un syscall pour N
+    // datagrammes).
+    // -----------------------------------------------------------------
+
+    constexpr lua_Integer DGRAM_DEFAULT_SIZE = 65536; // recvfrom : max UDP
+    constexpr lua_Integer MMSG_MAX = 1024;            // = UIO_MAXIOV
+    constexpr lua_Integer MMSG_DEFAULT_COUNT = 64;
+    constexpr lua_Integer MMSG_DEFAULT_SIZE = 2048;
+
+    // Adresse AF_UNIX depuis un chemin. "@nom" désigne l'espace de
+    // noms abstrait de Linux (pas de fichier, disparaît avec le
+    // dernier socket). Renvoie false + msg si le chemin est vide,
+    // trop long (sun_path : 108 octets, NUL final compris) ou
+    // contient un NUL.
+    bool make_unix_addr(const char *path, size_t len,
+                        struct sockaddr_storage &ss, socklen_t &slen,
+                        const char *&msg)
+    {
+        struct sockaddr_un *sun = reinterpret_cast<struct sockaddr_un *>(&ss);
+        std::memset(&ss, 0, sizeof(ss));
+        sun->sun_family = AF_UNIX;
+        if (len == 0)
         {
-            return true;
+            msg = "path must not be empty";
+            return false;
         }
-        // CORRECTIF longjmp (post-revue Gemini) : luaL_checknumber
-        // utiliserait longjmp() si l'argument n'est pas un nombre,
-        // ce qui ne déroulerait PAS le std::string err alloué par
-        // l'appelant (lua_socket_connect). On vérifie le type
-        // manuellement et on remonte via la convention (false, err)
-        // que la fonction signe déjà.
-        if (lua_type(L, idx) != LUA_TNUMBER)
+        if (std::memchr(path, '\0', len) != nullptr)
         {
-            err = prefix_for_err;
-            err += ": timeout must be a number";
+            msg = "path must not contain NUL bytes";
             return false;
         }
-        lua_Number t = lua_tonumber(L, idx);
-        if (std::isnan(t) || !std::isfinite(t))
+        if (len > sizeof(sun->sun_path) - 1)
         {
-            err = prefix_for_err;
-            err += ": timeout must be finite (not NaN or inf)";
+            msg = "path too long (max 107 bytes)";
             return false;
         }
-        if (t < 0.0)
+        std::memcpy(sun->sun_path, path, len);
+        slen = static_cast<socklen_t>(offsetof(struct sockaddr_un, sun_path) + len);
+        if (path[0] == '@')
         {
-            err = prefix_for_err;
-            err += ": timeout must be >= 0";
-            return false;
+            sun->sun_path[0] = '\0'; // abstrait : longueur exacte, pas de NUL final
         }
-        if (t > 0.0)
+        else
         {
-            double ms = t * 1000.0;
-            if (ms > static_cast<double>(INT_MAX))
-            {
-                err = prefix_for_err;
-                err += ": timeout too large";
-                return false;
-            }
-            *out = (ms < 1.0) ? 1 : static_cast<int>(ms);
+            slen += 1;
         }
         return true;
     }
-} // namespace
 
-// -----------------------------------------------------------------------
-// Fonctions publiques de babet.socket
-// -----------------------------------------------------------------------
+    // Pousse le chemin d'une adresse AF_UNIX : "@nom" si abstraite,
+    // "" si anonyme (socket non lié).
+    void push_unix_path(lua_State *L, const struct sockaddr *sa,
+                        socklen_t salen)
+    {
+        const struct sockaddr_un *sun =
+            reinterpret_cast<const struct sockaddr_un *>(sa);
+        const size_t off = offsetof(struct sockaddr_un, sun_path);
+        if (salen <= off)
+        {
+            lua_pushliteral(L, "");
+            return;
+        }
+        size_t len = salen - off;
+        if (sun->sun_path[0] == '\0')
+        {
+            lua_pushliteral(L, "@");
+            lua_pushlstring(L, sun->sun_path + 1, len - 1);
+            lua_concat(L, 2);
+            return;
+        }
+        lua_pushstring(L, std::string(sun->sun_path, len).c_str());
+    }
 
-// babet.socket.connect(host, port [, timeout]) -> socket | (nil, err)
-//
-// timeout en SECONDES (float), s'applique à la phase de connexion
-// uniquement ici ; pour les opérations suivantes, l'utilisateur peut
-// appeler s:set_timeout(s) sur le socket retourné.
-int lua_socket_connect(lua_State *L)
-{
-    const char *host = luaL_checkstring(L, 1);
-    lua_Integer port = luaL_checkinteger(L, 2);
-    if (port < 0 || port > 65535)
+    // Pousse l'émetteur d'un datagramme : host, port (2 valeurs) en
+    // IP, path (1 valeur) en unix. Les adresses IPv4 vues par un
+    // socket double pile (::ffff:a.b.c.d) sont rendues en IPv4, pour
+    // que le script puisse répondre avec le même host quel que soit
+    // le socket.
+    int push_sender(lua_State *L, const struct sockaddr_storage &ss,
+                    socklen_t slen)
     {
-        return push_fail(L,
-                         "socket: connect: port must be in [0, 65535]");
+        char host[INET6_ADDRSTRLEN];
+        if (ss.ss_family == AF_INET6)
+        {
+            const struct sockaddr_in6 *a6 =
+                reinterpret_cast<const struct sockaddr_in6 *>(&ss);
+            if (IN6_IS_ADDR_V4MAPPED(&a6->sin6_addr))
+            {
+                ::inet_ntop(AF_INET, a6->sin6_addr.s6_addr + 12, host,
+                            sizeof(host));
+            }
+            else
+            {
+                ::inet_ntop(AF_INET6, &a6->sin6_addr, host, sizeof(host));
+            }
+            lua_pushstring(L, host);
+            lua_pushinteger(L, ntohs(a6->sin6_port));
+            return 2;
+        }
+        if (ss.ss_family == AF_INET)
+        {
+            const struct sockaddr_in *a4 =
+                reinterpret_cast<const struct sockaddr_in *>(&ss);
+            ::inet_ntop(AF_INET, &a4->sin_addr, host, sizeof(host));
+            lua_pushstring(L, host);
+            lua_pushinteger(L, ntohs(a4->sin_port));
+            return 2;
+        }
+        if (ss.ss_family == AF_UNIX)
+        {
+            push_unix_path(L, reinterpret_cast<const struct sockaddr *>(&ss),
+                           slen);
+            return 1;
+        }
+        // Socket connecté : le noyau ne remplit pas toujours l'adresse.
+        lua_pushnil(L);
+        return 1;
     }
 
-    int timeout_ms = 0;
-    std::string err;
-    if (!parse_positional_timeout(L, 3, &timeout_ms, err,
-                                  "socket: connect"))
+    // Résout la destination d'un datagramme : chemin en unix, host +
+    // port en IP. Ne lève jamais : renvoie un code DNS_* (err rempli
+    // sur DNS_FAIL, cf. push_dns_fail), la résolution bornée par
+    // deadline comme dans tcp_connect_blocking. Pas de cache propre
+    // au Sock : celui de dns_lookup respecte ttl / negative_ttl, et
+    // un sendto en boucle vers le même collecteur y trouve déjà
+    // l'adresse sans repasser par getaddrinfo.
+    int dgram_dest(Sock *s, const char *host, size_t host_len,
+                   lua_Integer port, Deadline deadline,
+                   struct sockaddr_storage &out, socklen_t &outlen,
+                   std::string &err)
     {
-        return push_fail(L, err);
+        if (s->family == AF_UNIX)
+        {
+            const char *msg = nullptr;
+            if (!make_unix_addr(host, host_len, out, outlen, msg))
+            {
+                err = "socket: sendto: ";
+                err += msg;
+                return DNS_FAIL;
+            }
+            return DNS_OK;
+        }
+        if (port < 0 || port > 65535)
+        {
+            err = "socket: sendto: port must be in [0, 65535]";
+            return DNS_FAIL;
+        }
+
+        // Cache DNS du processus (cf. dns_lookup), puis la première
+        // adresse de la famille du socket ; un socket IPv6 double pile
+        // prend une IPv4 sous forme ::ffff:a.b.c.d faute d'IPv6.
+        std::vector<DnsAddr> addrs;
+        int dr = dns_lookup(host, static_cast<int>(port), deadline, addrs,
+                            err);
+        if (dr != DNS_OK)
+        {
+            return dr;
+        }
+        const DnsAddr *pick = nullptr;
+        const DnsAddr *v4 = nullptr;
+        for (const DnsAddr &a : addrs)
+        {
+            if (a.addr.ss_family == s->family)
+            {
+                pick = &a;
+                break;
+            }
+            if (v4 == nullptr && a.addr.ss_family == AF_INET)
+            {
+                v4 = &a;
+            }
+        }
+        if (pick != nullptr)
+        {
+            std::memcpy(&out, &pick->addr, pick->len);
+            outlen = pick->len;
+        }
+        else if (v4 != nullptr && s->family == AF_INET6)
+        {
+            const struct sockaddr_in *in =
+                reinterpret_cast<const struct sockaddr_in *>(&v4->addr);
+            struct sockaddr_in6 *in6 = reinterpret_cast<struct sockaddr_in6 *>(&out);
+            std::memset(&out, 0, sizeof(out));
+            in6->sin6_family = AF_INET6;
+            in6->sin6_port = in->sin_port;
+            in6->sin6_addr.s6_addr[10] = 0xff;
+            in6->sin6_addr.s6_addr[11] = 0xff;
+            std::memcpy(&in6->sin6_addr.s6_addr[12], &in->sin_addr, 4);
+            outlen = sizeof(struct sockaddr_in6);
+        }
+        else
+        {
+            err = "socket: sendto: no address of the socket's family for ";
+            err += host;
+            return DNS_FAIL;
+        }
+        return DNS_OK;
     }
 
-    bool timed_out = false;
-    int fd = tcp_connect_blocking(host, port, timeout_ms, err, timed_out);
-    if (fd < 0)
+    // Échec d'une résolution (code DNS_* non OK) -> (nil, err), avec
+    // "timeout" / "interrupted" comme les autres attentes du module.
+    int push_dns_fail(lua_State *L, int rc, const std::string &err)
     {
-        if (timed_out)
+        if (rc == DNS_TIMEOUT)
         {
             return push_fail(L, "timeout");
         }
-        if (err == "interrupted")
+        if (rc == DNS_INTERRUPTED)
         {
-            // Phase B signal : dispatcher le callback Lua ici
-            // (tcp_connect_blocking n'a pas accès à L).
             signal_dispatch_pending(L);
+            return push_fail(L, "interrupted");
         }
         return push_fail(L, err);
     }
-    push_new_sock(L, fd, false);
-    return 1;
-}
 
-// babet.socket.connect_tls(host, port [, opts]) -> socket | (nil, err)
-//
-// Variante TLS de connect. opts table (toutes optionnelles) :
-//   timeout      : secondes (float), bloquant infini si absent ou 0
-//   verify       : boolean, défaut true (vérification stricte chaîne+hostname)
-//   ca_cert      : string, chemin vers un fichier PEM (CA spécifique)
-//   ca_path      : string, chemin vers un dossier de CAs
-//   hostname     : string, override du hostname check + SNI (défaut = host)
-//   min_version  : string, "1.2" (défaut) ou "1.3"
-//
-// Comportement :
-//   1. TCP connect (réutilise tcp_connect_blocking).
-//   2. Création SSL* sur le fd, application des options.
-//   3. SSL_connect() avec poll + deadline globale.
-//   4. Si verify ON, échec cert -> message lisible via SSL_get_verify_result.
-//
-// Le socket retourné est un Sock complet (méthodes send/recv/etc.
-// fonctionneront en TLS après la sous-étape 1.3).
-int lua_socket_connect_tls(lua_State *L)
-{
-    const char *host = luaL_checkstring(L, 1);
-    lua_Integer port = luaL_checkinteger(L, 2);
-    if (port < 0 || port > 65535)
+    // Vérifications communes aux méthodes datagramme.
+    const char *check_dgram(const Sock *s, const char *closed_msg,
+                            const char *stream_msg)
     {
-        return push_fail(L,
-                         "socket: connect_tls: port must be in [0, 65535]");
+        if (s->fd < 0)
+        {
+            return closed_msg;
+        }
+        if (s->type != SOCK_DGRAM)
+        {
+            return stream_msg;
+        }
+        return nullptr;
     }
 
-    std::string err;
-    TlsOptions opts;
-    if (!parse_tls_options(L, 3, opts, err))
+    // Lit l'adresse d'une destination aux index idx (host | path) et
+    // idx + 1 (port, IP seulement). Mauvais TYPE -> luaL_error, AVANT
+    // toute construction d'objet C++ (cf. CORRECTIF longjmp).
+    const char *check_dest_args(lua_State *L, Sock *s, int idx,
+                                size_t *len, lua_Integer *port)
     {
-        return push_fail(L, err);
+        const char *host = luaL_checklstring(L, idx, len);
+        *port = (s->family == AF_UNIX) ? 0 : luaL_checkinteger(L, idx + 1);
+        return host;
     }
 
-    // Init OpenSSL CTX en lazy au premier appel.
-    if (!init_openssl_ctx(err))
+    int sendto_impl(lua_State *L, Sock *s, Deadline deadline, IoWait *yw)
     {
-        return push_fail(L, err);
-    }
+        size_t len = 0;
+        const char *data = lua_tolstring(L, 2, &len);
+        size_t host_len = 0;
+        lua_Integer port = 0;
+        const char *host = check_dest_args(L, s, 3, &host_len, &port);
+        if (const char *bad = check_dgram(
+                s, "socket: sendto: socket is closed",
+                "socket: sendto: not a datagram socket"))
+        {
+            return push_fail(L, bad);
+        }
 
-    // Phase 1 : TCP connect (réutilise le helper).
-    bool timed_out = false;
-    int fd = tcp_connect_blocking(host, port, opts.timeout_ms,
-                                  err, timed_out);
-    if (fd < 0)
-    {
-        if (timed_out)
+        struct sockaddr_storage dest;
+        socklen_t dest_len = 0;
+        std::string err;
+        int dr = dgram_dest(s, host, host_len, port, deadline, dest,
+                            dest_len, err);
+        if (dr != DNS_OK)
         {
-            return push_fail(L, "timeout");
+            return push_dns_fail(L, dr, err);
         }
-        if (err == "interrupted")
+        for (;;)
         {
-            // Phase B signal : voir sock_connect.
-            signal_dispatch_pending(L);
+            ssize_t n = ::sendto(s->fd, data, len,
+                                 MSG_DONTWAIT | MSG_NOSIGNAL,
+                                 reinterpret_cast<struct sockaddr *>(&dest),
+                                 dest_len);
+            if (n >= 0)
+            {
+                lua_pushinteger(L, static_cast<lua_Integer>(n));
+                return 1;
+            }
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                return push_errno_fail(L, "sendto");
+            }
+            int rc = await_fd(s->fd, POLLOUT, deadline, yw);
+            if (rc == READ_YIELD)
+            {
+                return IO_YIELD;
+            }
+            if (rc < 0)
+            {
+                return push_read_fail(L, rc, "sendto", err);
+            }
         }
-        return push_fail(L, err);
     }
 
-    // Phase 2 : créer SSL et l'attacher au fd.
-    SSL *ssl = SSL_new(g_tls_ctx);
-    if (ssl == nullptr)
+    // sendto(data, host, port) / sendto(data, path) : UN datagramme,
+    // jamais découpé -- trop gros -> (nil, "...: Message too long").
+    int sock_sendto_k(lua_State *L, int, lua_KContext ctx)
     {
-        ::close(fd);
-        return push_fail(L, format_tls_error("SSL_new failed"));
+        Sock *s = check_sock(L, 1);
+        Deadline deadline = ctx_to_deadline(ctx);
+        IoWait w;
+        int n = sendto_impl(L, s, deadline, yield_slot(L, w));
+        if (n == IO_YIELD)
+        {
+            return co_wait(L, w, deadline, sock_sendto_k);
+        }
+        return n;
     }
-    if (SSL_set_fd(ssl, fd) != 1)
+
+    int sock_sendto(lua_State *L)
     {
-        SSL_free(ssl);
-        ::close(fd);
-        return push_fail(L, format_tls_error("SSL_set_fd failed"));
+        Sock *s = check_sock(L, 1);
+        luaL_checklstring(L, 2, nullptr);
+        size_t len = 0;
+        lua_Integer port = 0;
+        check_dest_args(L, s, 3, &len, &port);
+        return sock_sendto_k(L, LUA_OK,
+                             deadline_to_ctx(make_deadline(s->timeout_ms)));
     }
 
-    // Phase 3 : appliquer les options (verify, hostname, CA, version).
-    if (!apply_tls_options(ssl, opts, host, err))
+    int recvfrom_impl(lua_State *L, Sock *s, Deadline deadline, IoWait *yw)
     {
-        SSL_free(ssl);
-        ::close(fd);
-        return push_fail(L, err);
+        lua_Integer n = luaL_optinteger(L, 2, DGRAM_DEFAULT_SIZE);
+        if (n <= 0)
+        {
+            return push_fail(L, "socket: recvfrom: count must be > 0");
+        }
+        if (n > MAX_RECV_SIZE)
+        {
+            return push_fail(L,
+                             "socket: recvfrom: count exceeds 16 MB cap");
+        }
+        if (const char *bad = check_dgram(
+                s, "socket: recvfrom: socket is closed",
+                "socket: recvfrom: not a datagram socket"))
+        {
+            return push_fail(L, bad);
+        }
+
+        std::vector<char> buf(static_cast<size_t>(n));
+        struct sockaddr_storage from;
+        socklen_t from_len = sizeof(from);
+        bool truncated = false;
+        std::memset(&from, 0, sizeof(from));
+        int rc = dgram_recv(s, buf.data(), buf.size(), &from, &from_len,
+                            deadline, yw, truncated);
+        if (rc == READ_YIELD)
+        {
+            return IO_YIELD;
+        }
+        if (rc < 0)
+        {
+            return push_read_fail(L, rc, "recvfrom", std::string());
+        }
+        lua_pushlstring(L, buf.data(), static_cast<size_t>(rc));
+        return 1 + push_sender(L, from, from_len);
     }
 
-    // Phase 4 : passer en non-bloquant pour le handshake, et GARDER
-    // le FD en non-bloquant après le succès. C'est crucial pour que
-    // les opérations TLS suivantes (SSL_read/SSL_write via les
-    // méthodes send/recv) respectent réellement la deadline globale :
-    // sans ça, poll() pouvait dire "prêt" puis SSL_read/SSL_write
-    // bloquait dans le noyau au-delà du timeout. Avec O_NONBLOCK
-    // permanent + la boucle WANT_READ/WANT_WRITE dans tls_send_some/
-    // tls_recv_some, la deadline est garantie.
-    //
-    // Pattern standard côté curl/nginx/etc. : une fois en TLS, on
-    // pilote tout via SSL_get_error et poll, le FD ne sert plus
-    // jamais directement à l'utilisateur.
-    //
-    // En cas d'ÉCHEC handshake, on remet bloquant avant de fermer
-    // (cohérence : le FD reste bloquant si jamais quelqu'un le voyait
-    // dans un état intermédiaire avant ::close).
-    int flags = ::fcntl(fd, F_GETFL, 0);
-    if (flags >= 0)
+    // recvfrom([n]) -> data, host, port | data, path. UN datagramme,
+    // tronqué à n octets (défaut 65536, la taille max d'un UDP).
+    int sock_recvfrom_k(lua_State *L, int, lua_KContext ctx)
     {
-        ::fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+        Sock *s = check_sock(L, 1);
+        Deadline deadline = ctx_to_deadline(ctx);
+        IoWait w;
+        int n = recvfrom_impl(L, s, deadline, yield_slot(L, w));
+        if (n == IO_YIELD)
+        {
+            return co_wait(L, w, deadline, sock_recvfrom_k);
+        }
+        return n;
     }
-    bool hs_ok = tls_handshake(ssl, fd, opts.timeout_ms, err);
-    if (!hs_ok)
+
+    int sock_recvfrom(lua_State *L)
     {
-        if (flags >= 0)
+        Sock *s = check_sock(L, 1);
+        return sock_recvfrom_k(L, LUA_OK,
+                               deadline_to_ctx(make_deadline(s->timeout_ms)));
+    }
+
+    // Cœur de recvmmsg : attend le PREMIER datagramme (deadline), puis
+    // ramasse sans attendre tous ceux déjà en file, jusqu'à max.
+    int recvmmsg_impl(lua_State *L, Sock *s, Deadline deadline, IoWait *yw)
+    {
+        lua_Integer count = luaL_optinteger(L, 2, MMSG_DEFAULT_COUNT);
+        lua_Integer size = luaL_optinteger(L, 3, MMSG_DEFAULT_SIZE);
+        if (count <= 0 || count > MMSG_MAX)
         {
-            ::fcntl(fd, F_SETFL, flags); // remettre bloquant avant close
+            return push_fail(L, "socket: recvmmsg: max must be in [1, 1024]");
         }
-        SSL_free(ssl);
-        ::close(fd);
-        if (err == "interrupted")
+        if (size <= 0 || size > DGRAM_DEFAULT_SIZE)
         {
-            signal_dispatch_pending(L);
+            return push_fail(L,
+                             "socket: recvmmsg: size must be in [1, 65536]");
         }
-        return push_fail(L, err);
+        if (const char *bad = check_dgram(
+                s, "socket: recvmmsg: socket is closed",
+                "socket: recvmmsg: not a datagram socket"))
+        {
+            return push_fail(L, bad);
+        }
+
+        const size_t nmsg = static_cast<size_t>(count);
+        const size_t cap = static_cast<size_t>(size);
+        std::vector<char> buf(nmsg * cap);
+        std::vector<struct iovec> iov(nmsg);
+        std::vector<struct sockaddr_storage> from(nmsg);
+        std::vector<struct mmsghdr> hdr(nmsg);
+        int got;
+        for (;;)
+        {
+            for (size_t i = 0; i < nmsg; ++i)
+            {
+                iov[i].iov_base = buf.data() + i * cap;
+                iov[i].iov_len = cap;
+                std::memset(&hdr[i], 0, sizeof(hdr[i]));
+                hdr[i].msg_hdr.msg_name = &from[i];
+                hdr[i].msg_hdr.msg_namelen = sizeof(from[i]);
+                hdr[i].msg_hdr.msg_iov = &iov[i];
+                hdr[i].msg_hdr.msg_iovlen = 1;
+            }
+            got = ::recvmmsg(s->fd, hdr.data(), static_cast<unsigned>(nmsg),
+                             MSG_DONTWAIT, nullptr);
+            if (got >= 0)
+            {
+                break;
+            }
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                return push_errno_fail(L, "recvmmsg");
+            }
+            int rc = await_fd(s->fd, POLLIN, deadline, yw);
+            if (rc == READ_YIELD)
+            {
+                return IO_YIELD;
+            }
+            if (rc < 0)
+            {
+                return push_read_fail(L, rc, "recvmmsg", std::string());
+            }
+        }
+
+        lua_createtable(L, got, 0);
+        for (int i = 0; i < got; ++i)
+        {
+            lua_createtable(L, 0, 4);
+            lua_pushlstring(L, buf.data() + static_cast<size_t>(i) * cap,
+                            hdr[i].msg_len);
+            lua_setfield(L, -2, "data");
+            if (push_sender(L, from[i], hdr[i].msg_hdr.msg_namelen) == 2)
+            {
+                lua_setfield(L, -3, "port");
+                lua_setfield(L, -2, "host");
+            }
+            else
+            {
+                lua_setfield(L, -2, "path");
+            }
+            if (hdr[i].msg_hdr.msg_flags & MSG_TRUNC)
+            {
+                lua_pushboolean(L, 1);
+                lua_setfield(L, -2, "truncated");
+            }
+            lua_rawseti(L, -2, i + 1);
+        }
+        return 1;
     }
-    // Succès : NE PAS remettre bloquant. Le FD reste O_NONBLOCK pour
-    // toute la vie du socket TLS (cf. note ci-dessus).
 
-    // Succès : créer userdata Sock avec ssl attaché.
-    Sock *s = push_new_sock(L, fd, false);
-    s->ssl = ssl;
-    return 1;
-}
+    // recvmmsg([max [, size]]) -> { {data=, host=, port=}, ... }
+    // (path= en unix, truncated = true si le datagramme dépassait
+    // size). Au moins un datagramme, au plus max.
+    int sock_recvmmsg_k(lua_State *L, int, lua_KContext ctx)
+    {
+        Sock *s = check_sock(L, 1);
+        Deadline deadline = ctx_to_deadline(ctx);
+        IoWait w;
+        int n = recvmmsg_impl(L, s, deadline, yield_slot(L, w));
+        if (n == IO_YIELD)
+        {
+            return co_wait(L, w, deadline, sock_recvmmsg_k);
+        }
+        return n;
+    }
 
-// Méthode s:starttls([opts]) -> (true, nil) | (nil, err)
-//
-// Pose une couche TLS sur un socket TCP existant connecté. Cas
-// d'usage : SMTP STARTTLS, IMAP STARTTLS, IRC sur port plaintext avec
-// extension CAP STARTTLS, etc.
-//
+    int sock_recvmmsg(lua_State *L)
+    {
+        Sock *s = check_sock(L, 1);
+        return sock_recvmmsg_k(L, LUA_OK,
+                               deadline_to_ctx(make_deadline(s->timeout_ms)));
+    }
+
+    // Pousse msgs[i] décomposé : data, puis host | path (nil si
+    // absent), puis port. Mauvais TYPE -> luaL_error. Chaînes
+    // strictes (pas de nombre converti) : sendmmsg_impl garde les
+    // pointeurs après avoir dépilé, seule la table les ancre.
+    void push_mmsg_item(lua_State *L, Sock *s, int idx, lua_Integer i)
+    {
+        int t = lua_rawgeti(L, idx, i);
+        if (t == LUA_TSTRING)
+        {
+            lua_pushnil(L);
+            lua_pushnil(L);
+            return;
+        }
+        if (t != LUA_TTABLE)
+        {
+            luaL_error(L, "socket: sendmmsg: msgs[%I] must be a string or a table",
+                       i);
+        }
+        int item = lua_gettop(L);
+        if (lua_getfield(L, item, "data") != LUA_TSTRING)
+        {
+            luaL_error(L, "socket: sendmmsg: msgs[%I].data must be a string", i);
+        }
+        const bool unix_sock = (s->family == AF_UNIX);
+        lua_getfield(L, item, unix_sock ? "path" : "host");
+        if (!lua_isnil(L, -1) && lua_type(L, -1) != LUA_TSTRING)
+        {
+            luaL_error(L, "socket: sendmmsg: msgs[%I].%s must be a string", i,
+                       unix_sock ? "path" : "host");
+        }
+        lua_getfield(L, item, "port");
+        if (!unix_sock && !lua_isnil(L, -2) && !lua_isinteger(L, -1))
+        {
+            luaL_error(L, "socket: sendmmsg: msgs[%I].port must be an integer", i);
+        }
+        lua_remove(L, item);
+    }
+
+    // Cœur de sendmmsg : done = datagrammes déjà partis (repris après
+    // une suspension). Les chaînes restent ancrées par la table msgs
+    // (index 2) pendant l'appel.
+    int sendmmsg_impl(lua_State *L, Sock *s, size_t &done, Deadline deadline,
+                      IoWait *yw)
+    {
+        if (const char *bad = check_dgram(
+                s, "socket: sendmmsg: socket is closed",
+                "socket: sendmmsg: not a datagram socket"))
+        {
+            return push_fail(L, bad);
+        }
+        const size_t total = static_cast<size_t>(lua_rawlen(L, 2));
+        const size_t nmsg = total - done;
+        std::vector<struct iovec> iov(nmsg);
+        std::vector<struct sockaddr_storage> dest(nmsg);
+        std::vector<struct mmsghdr> hdr(nmsg);
+        std::string err;
+        for (size_t i = 0; i < nmsg; ++i)
+        {
+            push_mmsg_item(L, s, 2, static_cast<lua_Integer>(done + i + 1));
+            size_t len = 0;
+            const char *data = lua_tolstring(L, -3, &len);
+            iov[i].iov_base = const_cast<char *>(data);
+            iov[i].iov_len = len;
+            std::memset(&hdr[i], 0, sizeof(hdr[i]));
+            hdr[i].msg_hdr.msg_iov = &iov[i];
+            hdr[i].msg_hdr.msg_iovlen = 1;
+            if (!lua_isnil(L, -2))
+            {
+                size_t host_len = 0;
+                const char *host = lua_tolstring(L, -2, &host_len);
+                socklen_t dlen = 0;
+                int dr = dgram_dest(s, host, host_len, lua_tointeger(L, -1),
+                                    deadline, dest[i], dlen, err);
+                if (dr != DNS_OK)
+                {
+                    lua_pop(L, 3);
+                    return push_dns_fail(L, dr, err);
+                }
+                hdr[i].msg_hdr.msg_name = &dest[i];
+                hdr[i].msg_hdr.msg_namelen = dlen;
+            }
+            lua_pop(L, 3);
+        }
+
+        size_t sent = 0;
+        while (sent < nmsg)
+        {
+            int n = ::sendmmsg(s->fd, hdr.data() + sent,
+                               static_cast<unsigned>(nmsg - sent),
+                               MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (n > 0)
+            {
+                sent += static_cast<size_t>(n);
+                done += static_cast<size_t>(n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                return push_errno_fail(L, "sendmmsg");
+            }
+            int rc = await_fd(s->fd, POLLOUT, deadline, yw);
+            if (rc == READ_YIELD)
+            {
+                return IO_YIELD;
+            }
+            if (rc < 0)
+            {
+                return push_read_fail(L, rc, "sendmmsg", err);
+            }
+        }
+        lua_pushinteger(L, static_cast<lua_Integer>(done));
+        return 1;
+    }
+
+    // sendmmsg(msgs) -> nombre de datagrammes envoyés. La progression
+    // est gardée en 3 sur la pile pendant une suspension, comme send.
+    int sock_sendmmsg_k(lua_State *L, int, lua_KContext ctx)
+    {
+        Sock *s = check_sock(L, 1);
+        size_t done = static_cast<size_t>(lua_tointeger(L, 3));
+        Deadline deadline = ctx_to_deadline(ctx);
+        IoWait w;
+        int n = sendmmsg_impl(L, s, done, deadline, yield_slot(L, w));
+        if (n != IO_YIELD)
+        {
+            return n;
+        }
+        lua_pushinteger(L, static_cast<lua_Integer>(done));
+        lua_replace(L, 3);
+        return co_wait(L, w, deadline, sock_sendmmsg_k);
+    }
+
+    // msgs : chaînes (socket connecté) ou tables { data =, host =,
+    // port = } / { data =, path = } en unix. Tout est vérifié ici,
+    // avant le premier envoi : une entrée invalide n'en laisse pas
+    // partir la moitié.
+    int sock_sendmmsg(lua_State *L)
+    {
+        Sock *s = check_sock(L, 1);
+        luaL_checktype(L, 2, LUA_TTABLE);
+        lua_settop(L, 2);
+        lua_Integer n = static_cast<lua_Integer>(lua_rawlen(L, 2));
+        if (n == 0)
+        {
+            lua_pushinteger(L, 0);
+            return 1;
+        }
+        if (n > MMSG_MAX)
+        {
+            return push_fail(L, "socket: sendmmsg: at most 1024 messages per call");
+        }
+        for (lua_Integer i = 1; i <= n; ++i)
+        {
+            push_mmsg_item(L, s, 2, i);
+            lua_pop(L, 3);
+        }
+        lua_pushinteger(L, 0);
+        return sock_sendmmsg_k(L, LUA_OK,
+                               deadline_to_ctx(make_deadline(s->timeout_ms)));
+    }
+
+    // -----------------------------------------------------------------
+    // sendfile : fichier -> socket sans passer par une chaîne Lua
+    // -----------------------------------------------------------------
+
+    // Morceau du repli pread + send / SSL_write (TLS, ou fichier que
+    // sendfile(2) refuse : /proc, certains FUSE...).
+    constexpr size_t SENDFILE_CHUNK = 64 * 1024;
+    // Plafond par appel sendfile(2) : le noyau s'arrête de lui-même
+    // à ~2 GiB, on reste en dessous pour que le compte tienne en int.
+    constexpr size_t SENDFILE_MAX_STEP = 1u << 30;
+
+    // Cœur de sendfile. Pile : 1 socket, 2 path | fd, 3 offset,
+    // 4 len (nil = jusqu'à EOF). total : octets déjà envoyés (repris
+    // après une suspension).
+    //
+    // TCP brut : sendfile(2), les pages du cache passent directement
+    // au socket, aucune copie en espace utilisateur. Le socket est mis
+    // en O_NONBLOCK le temps de l'appel (sendfile n'a pas de
+    // MSG_DONTWAIT) : un pair lent ne peut pas bloquer le thread
+    // au-delà de la deadline, l'attente passe par await_fd comme
+    // pour recv.
+    //
+    // TLS : le chiffrement se fait en espace utilisateur, donc
+    // pread par morceaux de 64 KiB + SSL_write. Un SSL_write qui
+    // demande à être rejoué (WANT_*) l'est avec les mêmes octets
+    // relus au même offset ; seul le tampon change d'adresse, d'où
+    // SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER.
+    int sendfile_impl(lua_State *L, Sock *s, size_t &total, Deadline deadline,
+                      IoWait *yw)
+    {
+        if (s->fd < 0)
+        {
+            return push_fail(L, "socket: sendfile: socket is closed");
+        }
+        if (s->listening)
+        {
+            return push_fail(L,
+                             "socket: sendfile: cannot send on a listening socket");
+        }
+        if (s->type != SOCK_STREAM)
+        {
+            return push_fail(L, "socket: sendfile: not a stream socket");
+        }
+
+        int file_fd;
+        bool owned = false;
+        if (lua_type(L, 2) == LUA_TSTRING)
+        {
+            file_fd = ::open(lua_tostring(L, 2), O_RDONLY | O_CLOEXEC);
+            if (file_fd < 0)
+            {
+                return push_errno_fail(L, "sendfile");
+            }
+            owned = true;
+        }
+        else
+        {
+            file_fd = static_cast<int>(lua_tointeger(L, 2));
+        }
+        struct FileGuard
+        {
+            int fd;
+            bool owned;
+            int sock;
+            int restore_flags; // -1 = rien à rétablir
+            ~FileGuard()
+            {
+                if (restore_flags >= 0)
+                {
+                    ::fcntl(sock, F_SETFL, restore_flags);
+                }
+                if (owned)
+                {
+                    ::close(fd);
+                }
+            }
+        } guard{file_fd, owned, s->fd, -1};
+
+        struct stat st;
+        if (::fstat(file_fd, &st) != 0)
+        {
+            return push_errno_fail(L, "sendfile");
+        }
+        const lua_Integer offset = lua_tointeger(L, 3); // nil -> 0
+        lua_Integer len;
+        if (lua_isnoneornil(L, 4))
+        {
+            if (!S_ISREG(st.st_mode))
+            {
+                return push_fail(L,
+                                 "socket: sendfile: len is required for a "
+                                 "non-regular file");
+            }
+            if (offset > static_cast<lua_Integer>(st.st_size))
+            {
+                return push_fail(L,
+                                 "socket: sendfile: offset beyond end of file");
+            }
+            len = static_cast<lua_Integer>(st.st_size) - offset;
+        }
+        else
+        {
+            len = lua_tointeger(L, 4);
+        }
+
+        const bool is_tls = (s->ssl != nullptr);
+        if (is_tls)
+        {
+            SSL_set_mode(s->ssl, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+        }
+        else
+        {
+            int flags = ::fcntl(s->fd, F_GETFL, 0);
+            if (flags >= 0 && !(flags & O_NONBLOCK))
+            {
+                ::fcntl(s->fd, F_SETFL, flags | O_NONBLOCK);
+                guard.restore_flags = flags;
+            }
+        }
+
+        const size_t want = static_cast<size_t>(len);
+        bool use_sendfile = !is_tls;
+        std::vector<char> chunk;
+        off_t chunk_at = -1; // chunk = fichier[chunk_at, chunk_at + chunk_len)
+        size_t chunk_len = 0;
+        std::string tls_err;
+        while (total < want)
+        {
+            const off_t at = static_cast<off_t>(offset) +
+                             static_cast<off_t>(total);
+            const size_t left = want - total;
+            ssize_t n;
+            if (use_sendfile)
+            {
+                off_t pos = at;
+                n = ::sendfile(s->fd, file_fd, &pos,
+                               std::min(left, SENDFILE_MAX_STEP));
+                if (n < 0 && (errno == EINVAL || errno == ENOSYS) &&
+                    total == 0)
+                {
+                    use_sendfile = false; // source non mappable : repli
+                    continue;
+                }
+            }
+            else
+            {
+                if (chunk_at < 0 || at < chunk_at ||
+                    at >= chunk_at + static_cast<off_t>(chunk_len))
+                {
+                    chunk.resize(SENDFILE_CHUNK);
+                    ssize_t r = ::pread(file_fd, chunk.data(),
+                                        std::min(left, SENDFILE_CHUNK), at);
+                    if (r < 0)
+                    {
+                        if (errno == EINTR)
+                        {
+                            continue;
+                        }
+                        return push_errno_fail(L, "sendfile");
+                    }
+                    chunk_at = at;
+                    chunk_len = static_cast<size_t>(r);
+                }
+                if (chunk_len == 0)
+                {
+                    break; // EOF avant len : on rend ce qui est parti
+                }
+                const size_t skip = static_cast<size_t>(at - chunk_at);
+                const char *p = chunk.data() + skip;
+                const size_t plen = chunk_len - skip;
+                if (is_tls)
+                {
+                    int rc = tls_send_some(s->ssl, p, plen, tls_err);
+                    if (rc > 0)
+                    {
+                        total += static_cast<size_t>(rc);
+                        continue;
+                    }
+                    if (rc == TLS_IO_EOF)
+                    {
+                        return push_fail(L, "closed");
+                    }
+                    if (rc == TLS_IO_FATAL)
+                    {
+                        return push_fail(L, tls_err);
+                    }
+                    int r = await_fd(s->fd,
+                                     rc == TLS_IO_WANT_READ ? POLLIN : POLLOUT,
+                                     deadline, yw);
+                    if (r == READ_YIELD)
+                    {
+                        return IO_YIELD;
+                    }
+                    if (r < 0)
+                    {
+                        return push_read_fail(L, r, "sendfile", tls_err);
+                    }
+                    continue;
+                }
+                n = ::send(s->fd, p, plen, MSG_NOSIGNAL | MSG_DONTWAIT);
+            }
+
+            if (n > 0)
+            {
+                total += static_cast<size_t>(n);
+                continue;
+            }
+            if (n == 0)
+            {
+                break; // sendfile : EOF du fichier avant len
+            }
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EPIPE || errno == ECONNRESET)
+            {
+                return push_fail(L, "closed");
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                return push_errno_fail(L, "sendfile");
+            }
+            int r = await_fd(s->fd, POLLOUT, deadline, yw);
+            if (r == READ_YIELD)
+            {
+                return IO_YIELD;
+            }
+            if (r < 0)
+            {
+                return push_read_fail(L, r, "sendfile", tls_err);
+            }
+        }
+        lua_pushinteger(L, static_cast<lua_Integer>(total));
+        return 1;
+    }
+
+    // sendfile(path | fd [, offset [, len]]) : progression gardée en 5
+    // sur la pile pendant une suspension, comme send.
+    int sock_sendfile_k(lua_State *L, int, lua_KContext ctx)
+    {
+        Sock *s = check_sock(L, 1);
+        size_t total = static_cast<size_t>(lua_tointeger(L, 5));
+        Deadline deadline = ctx_to_deadline(ctx);
+        IoWait w;
+        int n = sendfile_impl(L, s, total, deadline, yield_slot(L, w));
+        if (n != IO_YIELD)
+        {
+            return n;
+        }
+        lua_pushinteger(L, static_cast<lua_Integer>(total));
+        lua_replace(L, 5);
+        return co_wait(L, w, deadline, sock_sendfile_k);
+    }
+
+    int sock_sendfile(lua_State *L)
+    {
+        Sock *s = check_sock(L, 1);
+        int t = lua_type(L, 2);
+        if (t != LUA_TSTRING && !lua_isinteger(L, 2))
+        {
+            luaL_error(L, "socket: sendfile: source must be a path or a "
+                          "file descriptor");
+        }
+        lua_Integer offset = luaL_optinteger(L, 3, 0);
+        lua_Integer len = luaL_optinteger(L, 4, 0);
+        if (t != LUA_TSTRING && lua_tointeger(L, 2) < 0)
+        {
+            return push_fail(L, "socket: sendfile: fd must be >= 0");
+        }
+        if (offset < 0)
+        {
+            return push_fail(L, "socket: sendfile: offset must be >= 0");
+        }
+        if (len < 0)
+        {
+            return push_fail(L, "socket: sendfile: len must be >= 0");
+        }
+        lua_settop(L, 4);
+        lua_pushinteger(L, 0);
+        return sock_sendfile_k(L, LUA_OK,
+                               deadline_to_ctx(make_deadline(s->timeout_ms)));
+    }
+
+    // -----------------------------------------------------------------
+    // sendv : envoi vectorisé (sendmsg + iovec sur les chaînes Lua)
+    // -----------------------------------------------------------------
+
+    // Morceau coalescé côté TLS : un enregistrement TLS porte au plus
+    // 16 KiB, on en remplit plusieurs par SSL_write.
+    constexpr size_t SENDV_TLS_CHUNK = 64 * 1024;
+    constexpr lua_Integer SENDV_MAX_PARTS = 65536;
+
+    // Cœur de sendv. Pile : 1 socket, 2 parts (table de chaînes, qui
+    // les ancre pendant l'appel). total : octets déjà envoyés, repris
+    // après une suspension ; les iovec sont reconstruits depuis cet
+    // offset à chaque tour, une écriture partielle coupe la première
+    // chaîne au bon octet.
+    //
+    // TCP brut : sendmsg (writev sans SIGPIPE, MSG_NOSIGNAL) sur au
+    // plus IOV_MAX morceaux par appel, aucune concaténation. TLS :
+    // les morceaux sont coalescés par 64 KiB avant SSL_write (un
+    // SSL_write par petite chaîne ferait un enregistrement chacun) ;
+    // un rejeu après WANT_* recopie les mêmes octets, d'où
+    // SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER comme sendfile.
+    int sendv_impl(lua_State *L, Sock *s, size_t &total, Deadline deadline,
+                   IoWait *yw)
+    {
+        if (s->fd < 0)
+        {
+            return push_fail(L, "socket: sendv: socket is closed");
+        }
+        if (s->listening)
+        {
+            return push_fail(L,
+                             "socket: sendv: cannot send on a listening socket");
+        }
+
+        const size_t nparts = static_cast<size_t>(lua_rawlen(L, 2));
+        if (s->type == SOCK_DGRAM && nparts > static_cast<size_t>(IOV_MAX))
+        {
+            return push_fail(L,
+                             "socket: sendv: at most 1024 parts on a "
+                             "datagram socket");
+        }
+        std::vector<struct iovec> parts(nparts);
+        size_t want = 0;
+        for (size_t i = 0; i < nparts; ++i)
+        {
+            lua_rawgeti(L, 2, static_cast<lua_Integer>(i + 1));
+            size_t len = 0;
+            const char *p = lua_tolstring(L, -1, &len);
+            lua_pop(L, 1); // la table garde la chaîne vivante
+            parts[i].iov_base = const_cast<char *>(p);
+            parts[i].iov_len = len;
+            want += len;
+        }
+
+        const bool is_tls = (s->ssl != nullptr);
+        if (is_tls)
+        {
+            SSL_set_mode(s->ssl, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+        }
+        std::vector<struct iovec> iov;
+        std::string chunk;
+        std::string tls_err;
+        while (total < want)
+        {
+            // Premier morceau non envoyé et son décalage.
+            size_t first = 0;
+            size_t skip = total;
+            while (skip >= parts[first].iov_len)
+            {
+                skip -= parts[first].iov_len;
+                ++first;
+            }
+
+            int wait_for = POLLOUT;
+            if (is_tls)
+            {
+                chunk.clear();
+                for (size_t i = first; i < nparts && chunk.size() < SENDV_TLS_CHUNK;
+                     ++i)
+                {
+                    const char *p = static_cast<const char *>(parts[i].iov_base);
+                    size_t len = parts[i].iov_len;
+                    if (i == first)
+                    {
+                        p += skip;
+                        len -= skip;
+                    }
+                    chunk.append(p, std::min(len, SENDV_TLS_CHUNK - chunk.size()));
+                }
+                int rc = tls_send_some(s->ssl, chunk.data(), chunk.size(),
+                                       tls_err);
+                if (rc > 0)
+                {
+                    total += static_cast<size_t>(rc);
+                    continue;
+                }
+                if (rc == TLS_IO_EOF)
+                {
+                    return push_fail(L, "closed");
+                }
+                if (rc == TLS_IO_FATAL)
+                {
+                    return push_fail(L, tls_err);
+                }
+                if (rc == TLS_IO_WANT_READ)
+                {
+                    wait_for = POLLIN;
+                }
+            }
+            else
+            {
+                iov.clear();
+                const size_t iov_max = static_cast<size_t>(IOV_MAX);
+                for (size_t i = first; i < nparts && iov.size() < iov_max; ++i)
+                {
+                    struct iovec v = parts[i];
+                    if (i == first)
+                    {
+                        v.iov_base = static_cast<char *>(v.iov_base) + skip;
+                        v.iov_len -= skip;
+                    }
+                    if (v.iov_len > 0)
+                    {
+                        iov.push_back(v);
+                    }
+                }
+                struct msghdr msg;
+                std::memset(&msg, 0, sizeof(msg));
+                msg.msg_iov = iov.data();
+                msg.msg_iovlen = iov.size();
+                ssize_t n = ::sendmsg(s->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+                if (n >= 0)
+                {
+                    total += static_cast<size_t>(n);
+                    continue;
+                }
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                if (errno == EPIPE || errno == ECONNRESET)
+                {
+                    return push_fail(L, "closed");
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                {
+                    return push_errno_fail(L, "sendv");
+                }
+            }
+            int r = await_fd(s->fd, static_cast<short>(wait_for), deadline, yw);
+            if (r == READ_YIELD)
+            {
+                return IO_YIELD;
+            }
+            if (r < 0)
+            {
+                return push_read_fail(L, r, "sendv", tls_err);
+            }
+        }
+        lua_pushinteger(L, static_cast<lua_Integer>(total));
+        return 1;
+    }
+
+    // sendv({ part, ... }) -> octets envoyés (somme des longueurs).
+    // Progression gardée en 3 sur la pile pendant une suspension.
+    int sock_sendv_k(lua_State *L, int, lua_KContext ctx)
+    {
+        Sock *s = check_sock(L, 1);
+        size_t total = static_cast<size_t>(lua_tointeger(L, 3));
+        Deadline deadline = ctx_to_deadline(ctx);
+        IoWait w;
+        int n = sendv_impl(L, s, total, deadline, yield_slot(L, w));
+        if (n != IO_YIELD)
+        {
+            return n;
+        }
+        lua_pushinteger(L, static_cast<lua_Integer>(total));
+        lua_replace(L, 3);
+        return co_wait(L, w, deadline, sock_sendv_k);
+    }
+
+    // Chaînes strictes : un nombre serait converti dans une copie sur
+    // la pile, pas dans la table, et sendv_impl garde les pointeurs
+    // après avoir dépilé.
+    int sock_sendv(lua_State *L)
+    {
+        Sock *s = check_sock(L, 1);
+        luaL_checktype(L, 2, LUA_TTABLE);
+        lua_settop(L, 2);
+        lua_Integer n = static_cast<lua_Integer>(lua_rawlen(L, 2));
+        if (n > SENDV_MAX_PARTS)
+        {
+            return push_fail(L, "socket: sendv: at most 65536 parts per call");
+        }
+        for (lua_Integer i = 1; i <= n; ++i)
+        {
+            if (lua_rawgeti(L, 2, i) != LUA_TSTRING)
+            {
+                luaL_error(L, "socket: sendv: parts[%I] must be a string", i);
+            }
+            lua_pop(L, 1);
+        }
+        lua_pushinteger(L, 0);
+        return sock_sendv_k(L, LUA_OK,
+                            deadline_to_ctx(make_deadline(s->timeout_ms)));
+    }
+
+    // Libère la session TLS, le context serveur et le FD (commun à
+    // close, __gc et aux échecs de accept_tls).
+    void release_sock(Sock *s)
+    {
+        // TLS d'abord (close_notify best-effort), puis FD sous-jacent.
+        // tls_close gère le cas nullptr et nettoie aussi la pile ERR.
+        if (s->ssl != nullptr)
+        {
+            tls_close(s->ssl);
+            s->ssl = nullptr;
+        }
+        if (s->server_ctx != nullptr)
+        {
+            SSL_CTX_free(s->server_ctx);
+            s->server_ctx = nullptr;
+        }
+        if (s->fd >= 0)
+        {
+            ::close(s->fd);
+            s->fd = -1;
+        }
+    }
+
+    // Attend puis accepte le client suivant sur un socket d'écoute.
+    // Renvoie son FD (flags de accept4 en plus de SOCK_CLOEXEC), ou
+    // READ_TIMEOUT / READ_INTERRUPTED / READ_ERRNO / READ_YIELD (yw
+    // rempli, attente sur le socket d'écoute).
+    int accept_client(Sock *s, Deadline deadline, IoWait *yw, int flags)
+    {
+        for (;;)
+        {
+            // En tâche du scheduler : simple coup d'œil (poll à 0),
+            // on cède si aucun client n'attend.
+            int r = wait_ready_deadline(s->fd, POLLIN,
+                                        yw != nullptr ? Clock::now()
+                                                      : deadline);
+            if (r == WAIT_INTERRUPTED)
+            {
+                return READ_INTERRUPTED;
+            }
+            if (r < 0)
+            {
+                return READ_ERRNO;
+            }
+            if (r == 0)
+            {
+                if (yw != nullptr && remaining_ms(deadline) != 0)
+                {
+                    yw->fd = s->fd;
+                    yw->events = EPOLLIN;
+                    return READ_YIELD;
+                }
+                return READ_TIMEOUT;
+            }
+
+            // accept4 + SOCK_CLOEXEC : atomique, pas de fenêtre où
+            // le FD pourrait fuiter vers un fork+exec concurrent.
+            // Si accept4 n'est pas dispo (système très ancien), un
+            // fallback ::accept + ensure_cloexec serait nécessaire ;
+            // sur Linux moderne et FreeBSD, accept4 est garanti.
+            int client_fd = ::accept4(s->fd, nullptr, nullptr,
+                                      SOCK_CLOEXEC | flags);
+            if (client_fd >= 0)
+            {
+                ensure_cloexec(client_fd); // ceinture + bretelles
+                return client_fd;
+            }
+            if (errno == EINTR)
+            {
+                // Refaire un wait_ready : on a perdu du temps, on
+                // doit re-vérifier que la deadline n'est pas dépassée
+                // ET attendre à nouveau qu'un client se présente
+                // (le précédent connect() peut ne plus être là).
+                continue;
+            }
+            return READ_ERRNO;
+        }
+    }
+
+    // accept() : accepte une connexion entrante sur un socket
+    // d'écoute. Renvoie un userdata socket connecté.
+    int accept_impl(lua_State *L, Sock *s, Deadline deadline, IoWait *yw)
+    {
+        if (s->fd < 0)
+        {
+            return push_fail(L, "socket: accept: socket is closed");
+        }
+        if (!s->listening)
+        {
+            return push_fail(L,
+                             "socket: accept: socket is not listening");
+        }
+
+        int client_fd = accept_client(s, deadline, yw, 0);
+        if (client_fd == READ_YIELD)
+        {
+            return IO_YIELD;
+        }
+        if (client_fd < 0)
+        {
+            return push_read_fail(L, client_fd, "accept", std::string());
+        }
+        push_new_sock(L, client_fd, false);
+        return 1;
+    }
+
+    // DEADLINE GLOBALE : accept() bloque jusqu'à arrivée d'un
+    // client. Si EINTR au milieu, on reboucle avec le temps
+    // restant, jamais infini.
+    int sock_accept_k(lua_State *L, int, lua_KContext ctx)
+    {
+        Sock *s = check_sock(L, 1);
+        Deadline deadline = ctx_to_deadline(ctx);
+        IoWait w;
+        int n = accept_impl(L, s, deadline, yield_slot(L, w));
+        if (n == IO_YIELD)
+        {
+            return co_wait(L, w, deadline, sock_accept_k);
+        }
+        return n;
+    }
+
+    int sock_accept(lua_State *L)
+    {
+        Sock *s = check_sock(L, 1);
+        return sock_accept_k(L, LUA_OK,
+                             deadline_to_ctx(make_deadline(s->timeout_ms)));
+    }
+
+    // accept_tls() : accept puis handshake serveur sur le context du
+    // socket d'écoute (listen_tls). Deux phases, deux deadlines :
+    // l'attente d'un client suit le timeout du socket d'écoute comme
+    // accept(), le handshake a son propre délai (opts.timeout de
+    // listen_tls) pour qu'un client muet ne bloque pas la boucle
+    // d'accept.
+    //
+    // Le socket client est créé dès l'accept et rangé en slot 2 : une
+    // tâche qui cède au milieu du handshake le retrouve à la reprise
+    // (deadline = celle du handshake), et son __gc nettoie si la
+    // tâche est abandonnée. Un handshake raté ferme le client et rend
+    // (nil, err) ; le socket d'écoute reste utilisable.
+    int accept_tls_impl(lua_State *L, Sock *s, Deadline &deadline,
+                        IoWait *yw)
+    {
+        if (lua_isnil(L, 2))
+        {
+            if (s->fd < 0)
+            {
+                return push_fail(L, "socket: accept_tls: socket is closed");
+            }
+            if (!s->listening || s->server_ctx == nullptr)
+            {
+                return push_fail(L,
+                                 "socket: accept_tls: not a TLS listener "
+                                 "(see socket.listen_tls)");
+            }
+            // SOCK_NONBLOCK : un socket TLS reste O_NONBLOCK toute sa
+            // vie (cf. connect_tls).
+            int client_fd = accept_client(s, deadline, yw, SOCK_NONBLOCK);
+            if (client_fd == READ_YIELD)
+            {
+                return IO_YIELD;
+            }
+            if (client_fd < 0)
+            {
+                return push_read_fail(L, client_fd, "accept_tls",
+                                      std::string());
+            }
+            Sock *c = push_new_sock(L, client_fd, false);
+            c->ssl = SSL_new(s->server_ctx);
+            if (c->ssl == nullptr || SSL_set_fd(c->ssl, client_fd) != 1)
+            {
+                std::string err = format_tls_error("SSL_new failed");
+                release_sock(c);
+                return push_fail(L, err);
+            }
+            SSL_set_accept_state(c->ssl);
+            lua_replace(L, 2);
+            deadline = make_deadline(s->handshake_ms);
+        }
+
+        Sock *c = check_sock(L, 2);
+        for (;;)
+        {
+            ERR_clear_error();
+            int rc = SSL_do_handshake(c->ssl);
+            if (rc == 1)
+            {
+                lua_settop(L, 2);
+                return 1;
+            }
+            int e = SSL_get_error(c->ssl, rc);
+            short events = (e == SSL_ERROR_WANT_READ)    ? POLLIN
+                           : (e == SSL_ERROR_WANT_WRITE) ? POLLOUT
+                                                         : 0;
+            if (events == 0)
+            {
+                std::string err = (e == SSL_ERROR_SYSCALL &&
+                                   ERR_peek_error() == 0)
+                                      ? std::string("tls: accept: peer closed during handshake")
+                                      : format_tls_error("SSL_accept failed");
+                release_sock(c);
+                return push_fail(L, err);
+            }
+            int w = await_fd(c->fd, events, deadline, yw);
+            if (w == READ_YIELD)
+            {
+                return IO_YIELD;
+            }
+            if (w < 0)
+            {
+                int saved = errno;
+                release_sock(c);
+                errno = saved;
+                return push_read_fail(L, w, "accept_tls", std::string());
+            }
+        }
+    }
+
+    int sock_accept_tls_k(lua_State *L, int, lua_KContext ctx)
+    {
+        Sock *s = check_sock(L, 1);
+        Deadline deadline = ctx_to_deadline(ctx);
+        IoWait w;
+        int n = accept_tls_impl(L, s, deadline, yield_slot(L, w));
+        if (n == IO_YIELD)
+        {
+            return co_wait(L, w, deadline, sock_accept_tls_k);
+        }
+        return n;
+    }
+
+    int sock_accept_tls(lua_State *L)
+    {
+        Sock *s = check_sock(L, 1);
+        lua_settop(L, 1);
+        lua_pushnil(L); // 2 : socket client, posé par accept_tls_impl
+        return sock_accept_tls_k(L, LUA_OK,
+                                 deadline_to_ctx(make_deadline(s->timeout_ms)));
+    }
+
+    int sock_close(lua_State *L)
+    {
+        Sock *s = check_sock(L, 1);
+        release_sock(s);
+        // Octets non lus : plus accessibles (recv* refuse un socket
+        // fermé), on rend la mémoire tout de suite sans attendre __gc.
+        std::string().swap(s->rbuf);
+        s->rpos = 0;
+        s->rend = 0;
+        poller_sync_buffered(s);
+        return push_ok(L);
+    }
+
+    int sock_set_timeout(lua_State *L)
+    {
+        Sock *s = check_sock(L, 1);
+        lua_Number t = luaL_checknumber(L, 2);
+        // CORRECTIF (post-revue ChatGPT) : rejeter NaN et inf avant
+        // tout cast vers int (sinon comportement indéfini). std::isnan
+        // détecte NaN, std::isfinite refuse +inf et -inf (et accepte
+        // 0 et toutes les valeurs finies).
+        if (std::isnan(t) || !std::isfinite(t))
+        {
+            return push_fail(L,
+                             "socket: set_timeout: value must be finite "
+                             "(not NaN or inf)");
+        }
+        if (t < 0.0)
+        {
+            return push_fail(L,
+                             "socket: set_timeout: value must be >= 0 (0 disables)");
+        }
+        // t = 0 -> timeout_ms = 0 -> bloquant infini (cf. make_deadline).
+        // sinon : conversion secondes -> millisecondes, plancher 1 ms
+        // pour éviter qu'un timeout positif arrondi à 0 ne désactive
+        // silencieusement le timeout (même piège qu'avec set_max_timeout
+        // côté http). Plafond INT_MAX ms (~24 jours) pour éviter le
+        // débordement du cast en int.
+        if (t == 0.0)
+        {
+            s->timeout_ms = 0;
+        }
+        else
+        {
+            double ms = t * 1000.0;
+            if (ms > static_cast<double>(INT_MAX))
+            {
+                return push_fail(L,
+                                 "socket: set_timeout: value too large");
+            }
+            s->timeout_ms = (ms < 1.0) ? 1 : static_cast<int>(ms);
+        }
+        return push_ok(L);
+    }
+
+    // setopt{ nodelay =, cork =, keepalive =, sndbuf =, rcvbuf = } :
+    // options setsockopt usuelles, chacune facultative. Mauvais TYPE
+    // ou clé inconnue -> luaL_error (une faute de frappe ne doit pas
+    // passer en silence) ; refus du noyau -> (nil, err), les options
+    // précédentes de la table restant posées.
+    //
+    // cork = true retient les petits segments (TCP_CORK) jusqu'à
+    // cork = false, qui envoie tout d'un coup : plusieurs send
+    // forment un seul paquet sans concaténer côté Lua.
+    int sock_setopt(lua_State *L)
+    {
+        Sock *s = check_sock(L, 1);
+        luaL_checktype(L, 2, LUA_TTABLE);
+        struct Opt
+        {
+            const char *name;
+            int level;
+            int opt;
+            bool is_bool;
+        };
+        static const Opt opts[] = {
+            {"nodelay", IPPROTO_TCP, TCP_NODELAY, true},
+            {"cork", IPPROTO_TCP, TCP_CORK, true},
+            {"keepalive", SOL_SOCKET, SO_KEEPALIVE, true},
+            {"sndbuf", SOL_SOCKET, SO_SNDBUF, false},
+            {"rcvbuf", SOL_SOCKET, SO_RCVBUF, false},
+        };
+        lua_pushnil(L);
+        while (lua_next(L, 2) != 0)
+        {
+            const char *key = lua_type(L, -2) == LUA_TSTRING
+                                  ? lua_tostring(L, -2)
+                                  : nullptr;
+            const Opt *o = nullptr;
+            for (const Opt &cand : opts)
+            {
+                if (key != nullptr && std::strcmp(key, cand.name) == 0)
+                {
+                    o = &cand;
+                }
+            }
+            if (o == nullptr)
+            {
+                luaL_error(L, "socket: setopt: unknown option '%s'",
+                           key != nullptr ? key : luaL_typename(L, -2));
+            }
+            if (o->is_bool && !lua_isboolean(L, -1))
+            {
+                luaL_error(L, "socket: setopt: %s must be a boolean", o->name);
+            }
+            if (!o->is_bool && !lua_isinteger(L, -1))
+            {
+                luaL_error(L, "socket: setopt: %s must be an integer", o->name);
+            }
+            lua_pop(L, 1);
+        }
+
+        if (s->fd < 0)
+        {
+            return push_fail(L, "socket: setopt: socket is closed");
+        }
+        for (const Opt &o : opts)
+        {
+            lua_getfield(L, 2, o.name);
+            if (lua_isnil(L, -1))
+            {
+                lua_pop(L, 1);
+                continue;
+            }
+            lua_Integer v = o.is_bool ? lua_toboolean(L, -1)
+                                      : lua_tointeger(L, -1);
+            lua_pop(L, 1);
+            if (!o.is_bool && (v <= 0 || v > INT_MAX))
+            {
+                lua_pushfstring(L, "socket: setopt: %s must be > 0", o.name);
+                return push_fail(L, lua_tostring(L, -1));
+            }
+            int iv = static_cast<int>(v);
+            if (::setsockopt(s->fd, o.level, o.opt, &iv, sizeof(iv)) != 0)
+            {
+                int saved = errno;
+                lua_pushfstring(L, "setopt: %s", o.name);
+                errno = saved;
+                return push_errno_fail(L, lua_tostring(L, -1));
+            }
+        }
+        return push_ok(L);
+    }
+
+    // peer() / sockname() : renvoie une table { host, port }, ou
+    // { path } pour un socket unix.
+    int push_addr_table(lua_State *L, const struct sockaddr *sa,
+                        socklen_t salen)
+    {
+        if (sa->sa_family == AF_UNIX)
+        {
+            lua_newtable(L);
+            push_unix_path(L, sa, salen);
+            lua_setfield(L, -2, "path");
+            return 1;
+        }
+        char host[NI_MAXHOST];
+        char port[NI_MAXSERV];
+        int rc = ::getnameinfo(sa, salen, host, sizeof(host),
+                               port, sizeof(port),
+                               NI_NUMERICHOST | NI_NUMERICSERV);
+        if (rc != 0)
+        {
+            std::string msg = "socket: getnameinfo: ";
+            msg += ::gai_strerror(rc);
+            return push_fail(L, msg);
+        }
+        lua_newtable(L);
+        lua_pushstring(L, host);
+        lua_setfield(L, -2, "host");
+        lua_pushinteger(L, static_cast<lua_Integer>(std::atoi(port)));
+        lua_setfield(L, -2, "port");
+        return 1;
+    }
+
+    int sock_peer(lua_State *L)
+    {
+        Sock *s = check_sock(L, 1);
+        if (s->fd < 0)
+        {
+            return push_fail(L, "socket: peer: socket is closed");
+        }
+        struct sockaddr_storage ss;
+        socklen_t slen = sizeof(ss);
+        if (::getpeername(s->fd,
+                          reinterpret_cast<struct sockaddr *>(&ss),
+                          &slen) != 0)
+        {
+            return push_errno_fail(L, "peer");
+        }
+        return push_addr_table(L,
+                               reinterpret_cast<struct sockaddr *>(&ss), slen);
+    }
+
+    int sock_sockname(lua_State *L)
+    {
+        Sock *s = check_sock(L, 1);
+        if (s->fd < 0)
+        {
+            return push_fail(L, "socket: sockname: socket is closed");
+        }
+        struct sockaddr_storage ss;
+        socklen_t slen = sizeof(ss);
+        if (::getsockname(s->fd,
+                          reinterpret_cast<struct sockaddr *>(&ss),
+                          &slen) != 0)
+        {
+            return push_errno_fail(L, "sockname");
+        }
+        return push_addr_table(L,
+                               reinterpret_cast<struct sockaddr *>(&ss), slen);
+    }
+
+    // __gc : filet de sécurité. Si l'utilisateur a oublié :close(),
+    // on ferme à la collecte de l'userdata. Pas de fuite de FD ni de SSL.
+    // CORRECTIF (placement new) : on appelle aussi explicitement le
+    // destructeur du Sock, car push_new_sock utilise placement new
+    // pour initialiser le std::string rbuf.
+    int sock_gc(lua_State *L)
+    {
+        Sock *s = static_cast<Sock *>(
+            luaL_testudata(L, 1, SOCK_META));
+        if (s)
+        {
+            poller_forget_sock(s);
+            release_sock(s);
+            s->~Sock(); // libère rbuf
+        }
+        return 0;
+    }
+
+    // __tostring : utile pour debug et inspection.
+    int sock_tostring(lua_State *L)
+    {
+        Sock *s = check_sock(L, 1);
+        char buf[64];
+        if (s->fd < 0)
+        {
+            std::snprintf(buf, sizeof(buf), "socket (closed)");
+        }
+        else
+        {
+            const char *kind = s->listening             ? "listening"
+                               : (s->type == SOCK_DGRAM) ? "datagram"
+                                                         : "stream";
+            std::snprintf(buf, sizeof(buf), "socket (%s%s, fd=%d)", kind,
+                          s->family == AF_UNIX ? ", unix" : "", s->fd);
+        }
+        lua_pushstring(L, buf);
+        return 1;
+    }
+
+} // namespace
+
+namespace
+{
+    // Helper interne factorisé (sous-étape 1.2) : effectue un TCP
+    // connect bloquant avec timeout (deadline globale). Renvoie le FD
+    // connecté ou -1. En cas d'erreur :
+    //   - `timed_out` mis à true si la deadline a expiré
+    //   - sinon `err` contient un message lisible
+    //
+    // La deadline couvre TOUT l'appel : résolution (cache DNS, cf.
+    // dns_lookup) puis chaque adresse essayée, au lieu d'un timeout
+    // complet par adresse.
+    //
+    // Réutilisé par lua_socket_connect (TCP brut) et
+    // lua_socket_connect_tls (avant le handshake TLS).
+    int tcp_connect_blocking(const char *host, lua_Integer port,
+                             int timeout_ms,
+                             std::string &err, bool &timed_out)
+    {
+        timed_out = false;
+        Deadline deadline = make_deadline(timeout_ms);
+
+        std::vector<DnsAddr> addrs;
+        int dr = dns_lookup(host, static_cast<int>(port), deadline, addrs,
+                            err);
+        if (dr == DNS_TIMEOUT)
+        {
+            timed_out = true;
+            return -1;
+        }
+        if (dr == DNS_INTERRUPTED)
+        {
+            err = "interrupted";
+            return -1;
+        }
+        if (dr != DNS_OK)
+        {
+            return -1;
+        }
+
+        // Essaie chaque adresse dans l'ordre (IPv4/IPv6 selon DNS).
+        int fd = -1;
+        int last_errno = 0;
+        for (const DnsAddr &a : addrs)
+        {
+            // SOCK_CLOEXEC dans le type : atomique, jamais hérité par
+            // un fork+exec concurrent (cf. ensure_cloexec).
+            fd = ::socket(a.addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (fd < 0)
+            {
+                last_errno = errno;
+                continue;
+            }
+            ensure_cloexec(fd); // belt + suspenders
+            // Pour le timeout sur connect : on passe en non-bloquant
+            // le temps du connect, on attend la disponibilité via poll,
+            // on remet bloquant ensuite. Pattern POSIX standard.
+            int flags = ::fcntl(fd, F_GETFL, 0);
+            if (timeout_ms > 0 && flags >= 0)
+            {
+                ::fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+            }
+            int rc = ::connect(fd,
+                               reinterpret_cast<const struct sockaddr *>(&a.addr),
+                               a.len);
+            if (rc == 0)
+            {
+                if (timeout_ms > 0 && flags >= 0)
+                {
+                    ::fcntl(fd, F_SETFL, flags);
+                }
+                break; // connecté direct (loopback typique)
+            }
+            if (errno != EINPROGRESS || timeout_ms == 0)
+            {
+                last_errno = errno;
+                ::close(fd);
+                fd = -1;
+                continue;
+            }
+            // En cours, attendre POLLOUT avec deadline globale.
+            int wr = wait_ready_deadline(fd, POLLOUT, deadline);
+            if (wr == WAIT_INTERRUPTED)
+            {
+                // Phase B signal : on signale via err (le caller
+                // distingue "interrupted" de "timed out"). On ne
+                // tente PAS les autres adresses : si l'utilisateur
+                // a demandé l'arrêt, on s'arrête.
+                err = "interrupted";
+                ::close(fd);
+                fd = -1;
+                break;
+            }
+            if (wr == 0)
+            {
+                timed_out = true;
+                ::close(fd);
+                fd = -1;
+                break; // inutile d'essayer les autres adresses
+            }
+            if (wr < 0)
+            {
+                last_errno = errno;
+                ::close(fd);
+                fd = -1;
+                continue;
+            }
+            // Récupérer le statut réel de connect via SO_ERROR
+            int soerr = 0;
+            socklen_t slen = sizeof(soerr);
+            if (::getsockopt(fd, SOL_SOCKET, SO_ERROR, &soerr, &slen) < 0 || soerr != 0)
+            {
+                last_errno = (soerr != 0) ? soerr : errno;
+                ::close(fd);
+                fd = -1;
+                continue;
+            }
+            // Succès : remettre bloquant
+            ::fcntl(fd, F_SETFL, flags);
+            break;
+        }
+
+        if (fd < 0 && !timed_out && err.empty())
+        {
+            err = "socket: connect: ";
+            err += std::strerror(last_errno);
+        }
+        return fd;
+    }
+
+    // Parse + valide timeout en secondes depuis la stack Lua à l'index
+    // donné (pour les fonctions qui prennent un timeout positionnel).
+    // Renvoie true en succès. En cas d'invalidité, remplit err et
+    // renvoie false. Si l'argument est absent/nil, *out reste 0 (=
+    // bloquant infini).
+    bool parse_positional_timeout(lua_State *L, int idx, int *out,
+                                  std::string &err,
+                                  const char *prefix_for_err)
+    {
+        *out = 0;
+        if (lua_isnoneornil(L, idx))
+        {
+            return true;
+        }
+        // CORRECTIF longjmp (post-revue Gemini) : luaL_checknumber
+        // utiliserait longjmp() si l'argument n'est pas un nombre,
+        // ce qui ne déroulerait PAS le std::string err alloué par
+        // l'appelant (lua_socket_connect). On vérifie le type
+        // manuellement et on remonte via la convention (false, err)
+        // que la fonction signe déjà.
+        if (lua_type(L, idx) != LUA_TNUMBER)
+        {
+            err = prefix_for_err;
+            err += ": timeout must be a number";
+            return false;
+        }
+        lua_Number t = lua_tonumber(L, idx);
+        if (std::isnan(t) || !std::isfinite(t))
+        {
+            err = prefix_for_err;
+            err += ": timeout must be finite (not NaN or inf)";
+            return false;
+        }
+        if (t < 0.0)
+        {
+            err = prefix_for_err;
+            err += ": timeout must be >= 0";
+            return false;
+        }
+        if (t > 0.0)
+        {
+            double ms = t * 1000.0;
+            if (ms > static_cast<double>(INT_MAX))
+            {
+                err = prefix_for_err;
+                err += ": timeout too large";
+                return false;
+            }
+            *out = (ms < 1.0) ? 1 : static_cast<int>(ms);
+        }
+        return true;
+    }
+} // namespace
+
+// -----------------------------------------------------------------------
+// Fonctions publiques de babet.socket
+// -----------------------------------------------------------------------
+
+// babet.socket.connect(host, port [, timeout]) -> socket | (nil, err)
+//
+// timeout en SECONDES (float), s'applique à la phase de connexion
+// uniquement ici ; pour les opérations suivantes, l'utilisateur peut
+// appeler s:set_timeout(s) sur le socket retourné.
+int lua_socket_connect(lua_State *L)
+{
+    const char *host = luaL_checkstring(L, 1);
+    lua_Integer port = luaL_checkinteger(L, 2);
+    if (port < 0 || port > 65535)
+    {
+        return push_fail(L,
+                         "socket: connect: port must be in [0, 65535]");
+    }
+
+    int timeout_ms = 0;
+    std::string err;
+    if (!parse_positional_timeout(L, 3, &timeout_ms, err,
+                                  "socket: connect"))
+    {
+        return push_fail(L, err);
+    }
+
+    bool timed_out = false;
+    int fd = tcp_connect_blocking(host, port, timeout_ms, err, timed_out);
+    if (fd < 0)
+    {
+        if (timed_out)
+        {
+            return push_fail(L, "timeout");
+        }
+        if (err == "interrupted")
+        {
+            // Phase B signal : dispatcher le callback Lua ici
+            // (tcp_connect_blocking n'a pas accès à L).
+            signal_dispatch_pending(L);
+        }
+        return push_fail(L, err);
+    }
+    push_new_sock(L, fd, false);
+    return 1;
+}
+
+// babet.socket.connect_tls(host, port [, opts]) -> socket | (nil, err)
+//
+// Variante TLS de connect. opts table (toutes optionnelles) :
+//   timeout      : secondes (float), bloquant infini si absent ou 0
+//   verify       : boolean, défaut true (vérification stricte chaîne+hostname)
+//   ca_cert      : string, chemin vers un fichier PEM (CA spécifique)
+//   ca_path      : string, chemin vers un dossier de CAs
+//   hostname     : string, override du hostname check + SNI (défaut = host)
+//   min_version  : string, "1.2" (défaut) ou "1.3"
+//
+// Comportement :
+//   1. TCP connect (réutilise tcp_connect_blocking).
+//   2. Création SSL* sur le fd, application des options.
+//   3. SSL_connect() avec poll + deadline globale.
+//   4. Si verify ON, échec cert -> message lisible via SSL_get_verify_result.
+//
+// Le socket retourné est un Sock complet (méthodes send/recv/etc.
+// fonctionneront en TLS après la sous-étape 1.3).
+int lua_socket_connect_tls(lua_State *L)
+{
+    const char *host = luaL_checkstring(L, 1);
+    lua_Integer port = luaL_checkinteger(L, 2);
+    if (port < 0 || port > 65535)
+    {
+        return push_fail(L,
+                         "socket: connect_tls: port must be in [0, 65535]");
+    }
+
+    std::string err;
+    TlsOptions opts;
+    if (!parse_tls_options(L, 3, opts, err))
+    {
+        return push_fail(L, err);
+    }
+
+    // Phase 1 : TCP connect (réutilise le helper).
+    bool timed_out = false;
+    int fd = tcp_connect_blocking(host, port, opts.timeout_ms,
+                                  err, timed_out);
+    if (fd < 0)
+    {
+        if (timed_out)
+        {
+            return push_fail(L, "timeout");
+        }
+        if (err == "interrupted")
+        {
+            // Phase B signal : voir sock_connect.
+            signal_dispatch_pending(L);
+        }
+        return push_fail(L, err);
+    }
+
+    // Phase 2 : créer SSL (context de cette configuration de
+    // confiance, créé en lazy au premier appel) et l'attacher au fd.
+    SSL *ssl = tls_new_client(opts, err);
+    if (ssl == nullptr)
+    {
+        ::close(fd);
+        return push_fail(L, err);
+    }
+    if (SSL_set_fd(ssl, fd) != 1)
+    {
+        SSL_free(ssl);
+        ::close(fd);
+        return push_fail(L, format_tls_error("SSL_set_fd failed"));
+    }
+
+    // Phase 3 : appliquer les options (verify, hostname, version) et
+    // reprendre la session précédente vers host:port s'il y en a une.
+    if (!apply_tls_options(ssl, opts, host, err))
+    {
+        SSL_free(ssl);
+        ::close(fd);
+        return push_fail(L, err);
+    }
+    char port_str[16];
+    std::snprintf(port_str, sizeof(port_str), "%lld",
+                  static_cast<long long>(port));
+    tls_resume_session(ssl, host, port_str, opts);
+
+    // Phase 4 : passer en non-bloquant pour le handshake, et GARDER
+    // le FD en non-bloquant après le succès. C'est crucial pour que
+    // les opérations TLS suivantes (SSL_read/SSL_write via les
+    // méthodes send/recv) respectent réellement la deadline globale :
+    // sans ça, poll() pouvait dire "prêt" puis SSL_read/SSL_write
+    // bloquait dans le noyau au-delà du timeout. Avec O_NONBLOCK
+    // permanent + la boucle WANT_READ/WANT_WRITE dans tls_send_some/
+    // tls_recv_some, la deadline est garantie.
+    //
+    // Pattern standard côté curl/nginx/etc. : une fois en TLS, on
+    // pilote tout via SSL_get_error et poll, le FD ne sert plus
+    // jamais directement à l'utilisateur.
+    //
+    // En cas d'ÉCHEC handshake, on remet bloquant avant de fermer
+    // (cohérence : le FD reste bloquant si jamais quelqu'un le voyait
+    // dans un état intermédiaire avant ::close).
+    int flags = ::fcntl(fd, F_GETFL, 0);
+    if (flags >= 0)
+    {
+        ::fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    }
+    bool hs_ok = tls_handshake(ssl, fd, opts.timeout_ms, err);
+    if (!hs_ok)
+    {
+        if (flags >= 0)
+        {
+            ::fcntl(fd, F_SETFL, flags); // remettre bloquant avant close
+        }
+        SSL_free(ssl);
+        ::close(fd);
+        if (err == "interrupted")
+        {
+            signal_dispatch_pending(L);
+        }
+        return push_fail(L, err);
+    }
+    // Succès : NE PAS remettre bloquant. Le FD reste O_NONBLOCK pour
+    // toute la vie du socket TLS (cf. note ci-dessus).
+
+    // Succès : créer userdata Sock avec ssl attaché.
+    Sock *s = push_new_sock(L, fd, false);
+    s->ssl = ssl;
+    return 1;
+}
+
+// Méthode s:starttls([opts]) -> (true, nil) | (nil, err)
+//
+// Pose une couche TLS sur un socket TCP existant connecté. Cas
+// d'usage : SMTP STARTTLS, IMAP STARTTLS, IRC sur port plaintext avec
+// extension CAP STARTTLS, etc.
+//
 // Préconditions :
 //   - s->fd != -1 (socket ouvert)
 //   - s->listening == false (pas un socket d'écoute)
 //   - s->ssl == nullptr (pas déjà en TLS)
 //
-// Options identiques à connect_tls. ATTENTION sur opts.hostname :
-// comme starttls() n'a pas reçu de `host` (le socket vient d'un
-// connect par IP ou hostname antérieur), il faut le passer explicitement
-// quand verify=true.
+// Options identiques à connect_tls. ATTENTION sur opts.hostname :
+// comme starttls() n'a pas reçu de `host` (le socket vient d'un
+// connect par IP ou hostname antérieur), il faut le passer explicitement
+// quand verify=true.
+//
+// Politique stricte (TLS-C "verify par défaut") : refus dur si
+// verify=true et opts.hostname vide, avec message guidé. Pas de
+// chemin silencieux "chaîne sans hostname check" — c'est une
+// demi-mesure de sécurité qu'on ne propose pas. Si l'utilisateur
+// veut explicitement zapper la vérif (test, peer auto-signé), il
+// passe verify=false.
+int sock_starttls(lua_State *L)
+{
+    Sock *s = check_sock(L, 1);
+    if (s->fd < 0)
+    {
+        return push_fail(L, "socket: starttls: socket is closed");
+    }
+    if (s->listening)
+    {
+        return push_fail(L,
+                         "socket: starttls: cannot start TLS on a listening socket");
+    }
+    if (s->type != SOCK_STREAM)
+    {
+        return push_fail(L, "socket: starttls: not a stream socket");
+    }
+    if (s->ssl != nullptr)
+    {
+        return push_fail(L,
+                         "socket: starttls: TLS already active on this socket");
+    }
+
+    // Octets en clair déjà tirés du noyau par le tampon de lecture et
+    // pas encore lus par le script : ils seraient arrivés AVANT le
+    // handshake, hors de toute protection TLS. Un serveur honnête
+    // n'envoie rien entre sa réponse à STARTTLS et le ClientHello ;
+    // des octets ici sont le signe d'une injection en clair (classe
+    // CVE-2011-0411). Refus plutôt que de les servir comme s'ils
+    // étaient chiffrés.
+    if (rbuf_avail(s) > 0)
+    {
+        return push_fail(L,
+                         "socket: starttls: unread plaintext data "
+                         "buffered before TLS");
+    }
+
+    std::string err;
+    TlsOptions opts;
+    if (!parse_tls_options(L, 2, opts, err))
+    {
+        return push_fail(L, err);
+    }
+
+    // CORRECTIF (post-revue ChatGPT) : "verify strict par défaut"
+    // (TLS-C) signifie chaîne + hostname. starttls n'a pas de host
+    // par défaut comme connect_tls (qui utilise son argument host).
+    // Donc si verify=true et hostname vide, le hostname check serait
+    // SAUTÉ silencieusement — c'est une demi-mesure de sécurité qui
+    // contredit "strict par défaut". On REFUSE explicitement, avec un
+    // message qui guide vers les deux choix corrects : passer hostname,
+    // ou opt-out explicite via verify=false.
+    if (opts.verify && opts.hostname.empty())
+    {
+        return push_fail(L,
+                         "tls: starttls with verify=true requires opts.hostname; "
+                         "pass hostname or set verify=false");
+    }
+
+    SSL *ssl = tls_new_client(opts, err);
+    if (ssl == nullptr)
+    {
+        return push_fail(L, err);
+    }
+    if (SSL_set_fd(ssl, s->fd) != 1)
+    {
+        SSL_free(ssl);
+        return push_fail(L, format_tls_error("SSL_set_fd failed"));
+    }
+
+    // host_default = nullptr ici : starttls n'a pas reçu de host. Si
+    // opts.hostname est vide, on est en mode verify=false (vérifié
+    // au-dessus), donc le hostname check ne s'applique pas. Sinon
+    // opts.hostname est passé à apply_tls_options qui posera
+    // SSL_set1_host + SNI dessus.
+    if (!apply_tls_options(ssl, opts, nullptr, err))
+    {
+        SSL_free(ssl);
+        return push_fail(L, err);
+    }
+
+    // Reprise de session : clé = adresse du pair (starttls n'a pas de
+    // host), plus opts.hostname comme pour connect_tls.
+    struct sockaddr_storage peer;
+    socklen_t peer_len = sizeof(peer);
+    char peer_host[NI_MAXHOST];
+    char peer_port[NI_MAXSERV];
+    if (::getpeername(s->fd, reinterpret_cast<struct sockaddr *>(&peer),
+                      &peer_len) == 0 &&
+        ::getnameinfo(reinterpret_cast<struct sockaddr *>(&peer), peer_len,
+                      peer_host, sizeof(peer_host), peer_port,
+                      sizeof(peer_port), NI_NUMERICHOST | NI_NUMERICSERV) == 0)
+    {
+        tls_resume_session(ssl, peer_host, peer_port, opts);
+    }
+
+    // CORRECTIF (post-revue ChatGPT, parallèle de connect_tls) :
+    // garder le FD en O_NONBLOCK après le handshake pour que les
+    // SSL_read/SSL_write ultérieurs respectent réellement la deadline
+    // globale. cf. note détaillée dans connect_tls.
+    int flags = ::fcntl(s->fd, F_GETFL, 0);
+    if (flags >= 0)
+    {
+        ::fcntl(s->fd, F_SETFL, flags | O_NONBLOCK);
+    }
+    bool hs_ok = tls_handshake(ssl, s->fd, s->timeout_ms, err);
+    if (!hs_ok)
+    {
+        if (flags >= 0)
+        {
+            ::fcntl(s->fd, F_SETFL, flags); // remettre bloquant si échec
+        }
+        SSL_free(ssl);
+        if (err == "interrupted")
+        {
+            signal_dispatch_pending(L);
+        }
+        return push_fail(L, err);
+    }
+    // Succès : NE PAS remettre bloquant. FD reste O_NONBLOCK pour
+    // toute la vie du socket TLS.
+
+    // Succès : attacher le ssl au Sock existant (transformation
+    // en place). À partir de maintenant, send/recv/... iront via
+    // SSL_read/SSL_write (sous-étape 1.3).
+    s->ssl = ssl;
+    poller_sync_buffered(s); // données applicatives du handshake
+    return push_ok(L);
+}
+
+// Méthode s:tls_info() -> { version =, cipher =, resumed =, alpn = } | (nil, err)
+//
+// État de la session TLS négociée. resumed = true quand le handshake
+// a repris une session du cache (pas d'échange de clés complet ni de
+// vérification de certificat). alpn : protocole négocié, absent si
+// aucun.
+int sock_tls_info(lua_State *L)
+{
+    Sock *s = check_sock(L, 1);
+    if (s->fd < 0)
+    {
+        return push_fail(L, "socket: tls_info: socket is closed");
+    }
+    if (s->ssl == nullptr)
+    {
+        return push_fail(L, "socket: tls_info: not a TLS socket");
+    }
+    lua_createtable(L, 0, 4);
+    lua_pushstring(L, SSL_get_version(s->ssl));
+    lua_setfield(L, -2, "version");
+    lua_pushstring(L, SSL_get_cipher_name(s->ssl));
+    lua_setfield(L, -2, "cipher");
+    lua_pushboolean(L, SSL_session_reused(s->ssl));
+    lua_setfield(L, -2, "resumed");
+    const unsigned char *alpn = nullptr;
+    unsigned int alpn_len = 0;
+    SSL_get0_alpn_selected(s->ssl, &alpn, &alpn_len);
+    if (alpn_len > 0)
+    {
+        lua_pushlstring(L, reinterpret_cast<const char *>(alpn), alpn_len);
+        lua_setfield(L, -2, "alpn");
+    }
+    return 1;
+}
+
+namespace
+{
+    // Ouvre un socket d'écoute : socket + SO_REUSEADDR (+ SO_REUSEPORT)
+    // + bind (+ listen si do_listen). Renvoie le FD, ou -1 avec `err`
+    // rempli ("socket: listen: ...").
+    //
+    // do_listen = false sert à listen_workers : le parent réserve le
+    // port (et le découvre si port = 0) sans entrer dans le groupe
+    // REUSEPORT -- seuls les sockets en listen reçoivent des
+    // connexions, le sien n'en volera aucune. udp() s'en sert aussi
+    // (socktype = SOCK_DGRAM, jamais de listen), avec family rempli.
+    int open_listener(const char *host, lua_Integer port, int backlog,
+                      bool reuseport, bool do_listen, std::string &err,
+                      int socktype = SOCK_STREAM, int *family = nullptr)
+    {
+        char port_str[16];
+        std::snprintf(port_str, sizeof(port_str), "%lld",
+                      static_cast<long long>(port));
+
+        struct addrinfo *res = resolve(host, port_str, true, err, socktype);
+        if (!res)
+        {
+            return -1;
+        }
+
+        int fd = -1;
+        int last_errno = 0;
+        for (struct addrinfo *ai = res; ai != nullptr; ai = ai->ai_next)
+        {
+            // SOCK_CLOEXEC : voir note dans lua_socket_connect. C'est
+            // CRITIQUE pour un socket d'écoute : sans ça, un Ctrl+C sur
+            // le parent laisserait le port bloqué si un sous-processus
+            // de babet.exec est encore vivant et a hérité du FD.
+            fd = ::socket(ai->ai_family,
+                          ai->ai_socktype | SOCK_CLOEXEC,
+                          ai->ai_protocol);
+            if (fd < 0)
+            {
+                last_errno = errno;
+                continue;
+            }
+            ensure_cloexec(fd); // belt + suspenders
+            // SO_REUSEADDR : activé en interne, non exposé. Doit être posé
+            // AVANT bind() pour avoir effet. Idem SO_REUSEPORT.
+            int yes = 1;
+            if (!enable_reuseaddr(fd) ||
+                (reuseport &&
+                 ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &yes,
+                              sizeof(yes)) != 0))
+            {
+                last_errno = errno;
+                ::close(fd);
+                fd = -1;
+                continue;
+            }
+            if (::bind(fd, ai->ai_addr, ai->ai_addrlen) != 0)
+            {
+                last_errno = errno;
+                ::close(fd);
+                fd = -1;
+                continue;
+            }
+            if (do_listen && ::listen(fd, backlog) != 0)
+            {
+                last_errno = errno;
+                ::close(fd);
+                fd = -1;
+                continue;
+            }
+            if (family != nullptr)
+            {
+                *family = ai->ai_family;
+            }
+            break;
+        }
+        ::freeaddrinfo(res);
+
+        if (fd < 0)
+        {
+            err = (socktype == SOCK_DGRAM) ? "socket: udp: "
+                                           : "socket: listen: ";
+            err += std::strerror(last_errno);
+        }
+        return fd;
+    }
+
+    // Options de listen : 3e argument nil, entier (backlog, forme
+    // historique) ou table { backlog = N, reuseport = bool }. Mauvais
+    // TYPE -> luaL_error ; mauvaise valeur -> false + msg.
+    bool parse_listen_options(lua_State *L, int idx, int &backlog,
+                              bool &reuseport, const char *&msg)
+    {
+        lua_Integer b = backlog;
+        if (lua_istable(L, idx))
+        {
+            lua_getfield(L, idx, "backlog");
+            if (!lua_isnil(L, -1))
+            {
+                int isnum = 0;
+                b = lua_tointegerx(L, -1, &isnum);
+                if (!isnum)
+                {
+                    luaL_error(L, "socket: listen: opts.backlog must be an integer");
+                }
+            }
+            lua_pop(L, 1);
+            lua_getfield(L, idx, "reuseport");
+            if (!lua_isnil(L, -1))
+            {
+                if (!lua_isboolean(L, -1))
+                {
+                    luaL_error(L, "socket: listen: opts.reuseport must be a boolean");
+                }
+                reuseport = lua_toboolean(L, -1);
+            }
+            lua_pop(L, 1);
+        }
+        else if (!lua_isnoneornil(L, idx))
+        {
+            b = luaL_checkinteger(L, idx);
+        }
+        // Le noyau plafonne silencieusement à net.core.somaxconn ; on
+        // refuse seulement ce qui ne tient pas dans l'int de listen().
+        if (b <= 0 || b > INT_MAX)
+        {
+            msg = "socket: listen: backlog must be > 0";
+            return false;
+        }
+        backlog = static_cast<int>(b);
+        return true;
+    }
+
+    // Littéral de chaîne Lua sûr pour n'importe quel octet ("\ddd"
+    // hors alphanumériques et . : - _).
+    std::string lua_quoted(const char *str)
+    {
+        std::string out = "\"";
+        for (const unsigned char *c = reinterpret_cast<const unsigned char *>(str);
+             *c; ++c)
+        {
+            if (std::isalnum(*c) || *c == '.' || *c == ':' || *c == '-' ||
+                *c == '_')
+            {
+                out += static_cast<char>(*c);
+            }
+            else
+            {
+                char esc[8];
+                std::snprintf(esc, sizeof(esc), "\\%03u", *c);
+                out += esc;
+            }
+        }
+        out += '"';
+        return out;
+    }
+
+    // Pousse babet.workers.<name> (nil si absent).
+    void push_workers_fn(lua_State *L, const char *name)
+    {
+        lua_getglobal(L, "babet");
+        if (lua_istable(L, -1))
+        {
+            lua_getfield(L, -1, "workers");
+            lua_remove(L, -2);
+            if (lua_istable(L, -1))
+            {
+                lua_getfield(L, -1, name);
+                lua_remove(L, -2);
+                return;
+            }
+        }
+        lua_pop(L, 1);
+        lua_pushnil(L);
+    }
+} // namespace
+
+// babet.socket.listen(host, port [, backlog | opts]) -> socket | (nil, err)
+//
+// Fait socket + setsockopt(SO_REUSEADDR) + bind + listen en une
+// opération (API haute, décision SOCK-2). host peut être "" pour
+// "toutes les interfaces" (AI_PASSIVE prend le relais).
+//
+// opts = { backlog = N, reuseport = true } : SO_REUSEPORT permet à
+// plusieurs sockets (un par thread) d'écouter le même port ; le
+// noyau répartit les connexions entrantes entre eux, sans thread
+// d'accept unique qui redistribue (cf. listen_workers).
+int lua_socket_listen(lua_State *L)
+{
+    const char *host = luaL_checkstring(L, 1);
+    lua_Integer port = luaL_checkinteger(L, 2);
+    int backlog = 16;
+    bool reuseport = false;
+    const char *msg = nullptr;
+    if (!parse_listen_options(L, 3, backlog, reuseport, msg))
+    {
+        return push_fail(L, msg);
+    }
+    if (port < 0 || port > 65535)
+    {
+        return push_fail(L,
+                         "socket: listen: port must be in [0, 65535]");
+    }
+
+    std::string err;
+    int fd = open_listener(host, port, backlog, reuseport, true, err);
+    if (fd < 0)
+    {
+        return push_fail(L, err);
+    }
+    push_new_sock(L, fd, true);
+    return 1;
+}
+
+// babet.socket.listen_tls(host, port, opts) -> socket | (nil, err)
+//
+// Comme listen, avec un context TLS serveur attaché au socket
+// d'écoute : s:accept_tls() rend des sockets déjà en TLS, avec les
+// mêmes méthodes que côté client. opts (table obligatoire) :
+//   cert       : string, chemin PEM du certificat (chaîne complète)
+//   key        : string, chemin PEM de la clé privée
+//   alpn       : liste de protocoles acceptés, ordre de préférence
+//   timeout    : délai max du handshake d'un client, secondes
+//                (défaut 10, 0 = sans limite)
+//   backlog, reuseport : comme listen
+//
+// Le context est partagé par tous les listen_tls du processus qui
+// ont les mêmes cert / key / alpn (cf. tls_server_ctx).
+int lua_socket_listen_tls(lua_State *L)
+{
+    const char *host = luaL_checkstring(L, 1);
+    lua_Integer port = luaL_checkinteger(L, 2);
+    luaL_checktype(L, 3, LUA_TTABLE);
+    int backlog = 16;
+    bool reuseport = false;
+    const char *msg = nullptr;
+    if (!parse_listen_options(L, 3, backlog, reuseport, msg))
+    {
+        return push_fail(L, msg);
+    }
+    if (port < 0 || port > 65535)
+    {
+        return push_fail(L,
+                         "socket: listen_tls: port must be in [0, 65535]");
+    }
+
+    std::string err;
+    TlsServerOptions opts;
+    if (!parse_tls_server_options(L, 3, opts, err))
+    {
+        return push_fail(L, err);
+    }
+    SSL_CTX *ctx = tls_server_ctx(opts, err);
+    if (ctx == nullptr)
+    {
+        return push_fail(L, err);
+    }
+    int fd = open_listener(host, port, backlog, reuseport, true, err);
+    if (fd < 0)
+    {
+        SSL_CTX_free(ctx);
+        return push_fail(L, err);
+    }
+    Sock *s = push_new_sock(L, fd, true);
+    s->server_ctx = ctx;
+    s->handshake_ms = opts.timeout_ms;
+    return 1;
+}
+
+// babet.socket.listen_workers(host, port, code [, args [, opts]])
+//   -> { worker, ... } | (nil, err)
+//
+// Un worker par cœur (opts.workers, défaut workers.cpu_count()),
+// chacun avec SON socket d'écoute SO_REUSEPORT sur host:port : le
+// noyau répartit les accept entre les threads. Avant le code de
+// l'utilisateur, chaque worker trouve :
+//   worker.listener  socket d'écoute déjà ouvert (backlog
+//                    opts.backlog, défaut SOMAXCONN)
+//   worker.shard     son rang, 1..N
+// args et les autres champs de opts (cpu, nice, stack_size,
+// capacités, deadline) sont passés tels quels à workers.spawn.
+//
+// Le parent réserve le port d'abord (bind sans listen, cf.
+// open_listener) : port déjà pris -> (nil, err) tout de suite, et
+// port = 0 désigne le MÊME port libre pour tous les workers.
+int lua_socket_listen_workers(lua_State *L)
+{
+    const char *host = luaL_checkstring(L, 1);
+    lua_Integer port = luaL_checkinteger(L, 2);
+    size_t code_len = 0;
+    const char *code = luaL_checklstring(L, 3, &code_len);
+    if (!lua_isnoneornil(L, 4))
+    {
+        luaL_checktype(L, 4, LUA_TTABLE);
+    }
+    if (!lua_isnoneornil(L, 5))
+    {
+        luaL_checktype(L, 5, LUA_TTABLE);
+    }
+    lua_settop(L, 5);
+
+    int backlog = SOMAXCONN;
+    bool reuseport = true;
+    const char *msg = nullptr;
+    lua_Integer count = 0;
+    if (lua_istable(L, 5))
+    {
+        lua_getfield(L, 5, "workers");
+        if (!lua_isnil(L, -1))
+        {
+            int isnum = 0;
+            count = lua_tointegerx(L, -1, &isnum);
+            if (!isnum)
+            {
+                return luaL_error(L,
+                                  "socket: listen_workers: opts.workers must be an integer");
+            }
+            if (count <= 0 || count > 1024)
+            {
+                return push_fail(L,
+                                 "socket: listen_workers: opts.workers must be in [1, 1024]");
+            }
+        }
+        lua_pop(L, 1);
+        if (!parse_listen_options(L, 5, backlog, reuseport, msg))
+        {
+            return push_fail(L, msg);
+        }
+    }
+    if (port < 0 || port > 65535)
+    {
+        return push_fail(L,
+                         "socket: listen: port must be in [0, 65535]");
+    }
+
+    push_workers_fn(L, "spawn"); // 6
+    if (!lua_isfunction(L, 6))
+    {
+        return push_fail(L, "socket: listen_workers: babet.workers is not available");
+    }
+    if (count == 0)
+    {
+        push_workers_fn(L, "cpu_count");
+        if (!lua_isfunction(L, -1))
+        {
+            return push_fail(L, "socket: listen_workers: babet.workers is not available");
+        }
+        lua_call(L, 0, 1);
+        count = lua_tointeger(L, -1);
+        lua_pop(L, 1);
+        if (count <= 0)
+        {
+            count = 1;
+        }
+    }
+
+    std::string err;
+    int fd = open_listener(host, port, backlog, true, false, err);
+    if (fd < 0)
+    {
+        return push_fail(L, err);
+    }
+    struct sockaddr_storage ss;
+    socklen_t sl = sizeof(ss);
+    if (::getsockname(fd, reinterpret_cast<struct sockaddr *>(&ss), &sl) == 0)
+    {
+        port = (ss.ss_family == AF_INET6)
+                   ? ntohs(reinterpret_cast<struct sockaddr_in6 *>(&ss)->sin6_port)
+                   : ntohs(reinterpret_cast<struct sockaddr_in *>(&ss)->sin_port);
+    }
+
+    std::string prologue = "worker.listener = assert(babet.socket.listen(";
+    prologue += lua_quoted(host);
+    prologue += ", " + std::to_string(port) + ", { reuseport = true, backlog = ";
+    prologue += std::to_string(backlog) + " })) worker.shard = ";
+
+    lua_createtable(L, static_cast<int>(count), 0); // 7 : résultat
+    for (lua_Integer i = 1; i <= count; ++i)
+    {
+        // Prologue sur la MÊME ligne que le code : les numéros de
+        // ligne des erreurs du script restent justes.
+        std::string full = prologue + std::to_string(i) + " ";
+        full.append(code, code_len);
+
+        lua_pushvalue(L, 6);
+        lua_pushlstring(L, full.data(), full.size());
+        lua_pushvalue(L, 4);
+        lua_pushvalue(L, 5);
+        int rc = lua_pcall(L, 3, 2, 0);
+        if (rc != LUA_OK || lua_isnil(L, -2))
+        {
+            // Échec au milieu : les workers déjà lancés sont annulés
+            // (sinon leur __gc attendrait des serveurs qui ne
+            // s'arrêtent jamais), puis l'erreur remonte telle quelle.
+            ::close(fd);
+            for (lua_Integer j = 1; j < i; ++j)
+            {
+                lua_rawgeti(L, 7, j);
+                if (luaL_getmetafield(L, -1, "cancel") != LUA_TNIL)
+                {
+                    lua_pushvalue(L, -2);
+                    lua_pcall(L, 1, 0, 0);
+                }
+                lua_pop(L, 1);
+            }
+            if (rc != LUA_OK)
+            {
+                return lua_error(L); // workers.spawn a levé (mauvais opts)
+            }
+            return 2; // (nil, err) de workers.spawn
+        }
+        lua_pop(L, 1);
+        lua_rawseti(L, 7, i);
+    }
+    ::close(fd);
+    return 1;
+}
+
+// babet.socket.udp([host, port [, opts]]) -> socket | (nil, err)
+//
+// Sans argument : socket UDP non lié, IPv6 double pile (IPV6_V6ONLY
+// à 0 : sendto vers une IPv4 passe aussi), repli IPv4 si le noyau
+// n'a pas IPv6 ; le noyau choisit le port source au premier envoi.
+// Avec host/port : lié comme listen (host "" = toutes interfaces,
+// port 0 = port libre, cf. s:sockname()). opts = { reuseport = true }
+// pour partager le port entre plusieurs sockets (un par worker).
+int lua_socket_udp(lua_State *L)
+{
+    const bool bound = !lua_isnoneornil(L, 1);
+    const char *host = bound ? luaL_checkstring(L, 1) : nullptr;
+    lua_Integer port = bound ? luaL_checkinteger(L, 2) : 0;
+    bool reuseport = false;
+    if (!lua_isnoneornil(L, 3))
+    {
+        luaL_checktype(L, 3, LUA_TTABLE);
+        lua_getfield(L, 3, "reuseport");
+        if (!lua_isnil(L, -1))
+        {
+            if (!lua_isboolean(L, -1))
+            {
+                luaL_error(L, "socket: udp: opts.reuseport must be a boolean");
+            }
+            reuseport = lua_toboolean(L, -1);
+        }
+        lua_pop(L, 1);
+    }
+
+    if (!bound)
+    {
+        int family = AF_INET6;
+        int fd = ::socket(AF_INET6, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0)
+        {
+            int no = 0;
+            ::setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &no, sizeof(no));
+        }
+        else if (errno == EAFNOSUPPORT)
+        {
+            family = AF_INET;
+            fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        }
+        if (fd < 0)
+        {
+            return push_errno_fail(L, "udp");
+        }
+        ensure_cloexec(fd); // belt + suspenders
+        Sock *s = push_new_sock(L, fd, false);
+        s->type = SOCK_DGRAM;
+        s->family = family;
+        return 1;
+    }
+
+    if (port < 0 || port > 65535)
+    {
+        return push_fail(L, "socket: udp: port must be in [0, 65535]");
+    }
+    std::string err;
+    int family = AF_UNSPEC;
+    int fd = open_listener(host, port, 0, reuseport, false, err,
+                           SOCK_DGRAM, &family);
+    if (fd < 0)
+    {
+        return push_fail(L, err);
+    }
+    Sock *s = push_new_sock(L, fd, false);
+    s->type = SOCK_DGRAM;
+    s->family = family;
+    return 1;
+}
+
+// babet.socket.udp_connect(host, port [, timeout]) -> socket | (nil, err)
+//
+// Socket UDP "connecté" : le noyau fixe le pair (aucun paquet
+// n'est envoyé), s:send / s:recv marchent comme sur un flux mais
+// par datagramme, et les datagrammes d'autres émetteurs sont
+// filtrés. Le plus rapide pour parler à un seul collecteur.
+// timeout (secondes) borne la résolution du nom -> (nil, "timeout").
+int lua_socket_udp_connect(lua_State *L)
+{
+    const char *host = luaL_checkstring(L, 1);
+    lua_Integer port = luaL_checkinteger(L, 2);
+    if (port < 0 || port > 65535)
+    {
+        return push_fail(L,
+                         "socket: udp_connect: port must be in [0, 65535]");
+    }
+
+    int timeout_ms = 0;
+    std::string err;
+    if (!parse_positional_timeout(L, 3, &timeout_ms, err,
+                                  "socket: udp_connect"))
+    {
+        return push_fail(L, err);
+    }
+    std::vector<DnsAddr> addrs;
+    int dr = dns_lookup(host, static_cast<int>(port),
+                        make_deadline(timeout_ms), addrs, err);
+    if (dr != DNS_OK)
+    {
+        return push_dns_fail(L, dr, err);
+    }
+    int fd = -1;
+    int family = AF_UNSPEC;
+    int last_errno = 0;
+    for (const DnsAddr &a : addrs)
+    {
+        fd = ::socket(a.addr.ss_family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+        {
+            last_errno = errno;
+            continue;
+        }
+        ensure_cloexec(fd); // belt + suspenders
+        if (::connect(fd, reinterpret_cast<const struct sockaddr *>(&a.addr),
+                      a.len) != 0)
+        {
+            last_errno = errno;
+            ::close(fd);
+            fd = -1;
+            continue;
+        }
+        family = a.addr.ss_family;
+        break;
+    }
+    if (fd < 0)
+    {
+        err = "socket: udp_connect: ";
+        err += std::strerror(last_errno);
+        return push_fail(L, err);
+    }
+    Sock *s = push_new_sock(L, fd, false);
+    s->type = SOCK_DGRAM;
+    s->family = family;
+    return 1;
+}
+
+namespace
+{
+    // socket(AF_UNIX) + adresse depuis l'argument 1. Renvoie le FD, ou
+    // -1 avec `err` rempli ("socket: <op>: ...").
+    int open_unix(lua_State *L, int type, const char *op,
+                  struct sockaddr_storage &addr, socklen_t &addr_len,
+                  std::string &err)
+    {
+        size_t len = 0;
+        const char *path = lua_tolstring(L, 1, &len);
+        const char *msg = nullptr;
+        if (!make_unix_addr(path, len, addr, addr_len, msg))
+        {
+            err = "socket: ";
+            err += op;
+            err += ": ";
+            err += msg;
+            return -1;
+        }
+        int fd = ::socket(AF_UNIX, type | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+        {
+            err = "socket: ";
+            err += op;
+            err += ": ";
+            err += std::strerror(errno);
+            return -1;
+        }
+        ensure_cloexec(fd); // belt + suspenders
+        return fd;
+    }
+
+    int fail_unix(lua_State *L, int fd, const char *op)
+    {
+        int saved = errno;
+        ::close(fd);
+        errno = saved;
+        return push_errno_fail(L, op);
+    }
+} // namespace
+
+// babet.socket.unix_connect(path [, timeout]) -> socket | (nil, err)
+//
+// Flux AF_UNIX vers un démon local (path "@nom" : espace abstrait
+// Linux). Le socket rendu a les mêmes méthodes qu'un socket TCP.
+// timeout borne l'attente quand la file d'accept du serveur est
+// pleine (SO_SNDTIMEO le temps du connect) -> (nil, "timeout").
+int lua_socket_unix_connect(lua_State *L)
+{
+    luaL_checklstring(L, 1, nullptr);
+    std::string err;
+    int timeout_ms = 0;
+    if (!parse_positional_timeout(L, 2, &timeout_ms, err,
+                                  "socket: unix_connect"))
+    {
+        return push_fail(L, err);
+    }
+    struct sockaddr_storage addr;
+    socklen_t addr_len = 0;
+    int fd = open_unix(L, SOCK_STREAM, "unix_connect", addr, addr_len, err);
+    if (fd < 0)
+    {
+        return push_fail(L, err);
+    }
+    struct timeval tv;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    if (timeout_ms > 0)
+    {
+        ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    }
+    if (::connect(fd, reinterpret_cast<struct sockaddr *>(&addr),
+                  addr_len) != 0)
+    {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINPROGRESS)
+        {
+            ::close(fd);
+            return push_fail(L, "timeout");
+        }
+        if (errno == EINTR)
+        {
+            ::close(fd);
+            signal_dispatch_pending(L);
+            return push_fail(L, "interrupted");
+        }
+        return fail_unix(L, fd, "unix_connect");
+    }
+    if (timeout_ms > 0)
+    {
+        // Les envois suivants ont leur propre deadline (set_timeout).
+        tv.tv_sec = 0;
+        tv.tv_usec = 0;
+        ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    }
+    Sock *s = push_new_sock(L, fd, false);
+    s->family = AF_UNIX;
+    return 1;
+}
+
+// babet.socket.unix_listen(path [, backlog | opts]) -> socket | (nil, err)
 //
-// Politique stricte (TLS-C "verify par défaut") : refus dur si
-// verify=true et opts.hostname vide, avec message guidé. Pas de
-// chemin silencieux "chaîne sans hostname check" — c'est une
-// demi-mesure de sécurité qu'on ne propose pas. Si l'utilisateur
-// veut explicitement zapper la vérif (test, peer auto-signé), il
-// passe verify=false.
-int sock_starttls(lua_State *L)
+// Socket d'écoute AF_UNIX ; s:accept() rend des flux unix. Un
+// fichier de socket laissé par un processus précédent n'est PAS
+// supprimé d'office (ce pourrait être celui d'un démon vivant) :
+// bind échoue avec "Address already in use", au script de faire
+// os.remove(path) s'il sait le fichier périmé. opts.reuseport n'a
+// pas de sens en unix et est refusé.
+int lua_socket_unix_listen(lua_State *L)
 {
-    Sock *s = check_sock(L, 1);
-    if (s->fd < 0)
+    luaL_checklstring(L, 1, nullptr);
+    int backlog = 16;
+    bool reuseport = false;
+    const char *msg = nullptr;
+    if (!parse_listen_options(L, 2, backlog, reuseport, msg))
+    {
+        return push_fail(L, msg);
+    }
+    if (reuseport)
+    {
+        return push_fail(L,
+                         "socket: unix_listen: reuseport is not supported "
+                         "on unix sockets");
+    }
+    std::string err;
+    struct sockaddr_storage addr;
+    socklen_t addr_len = 0;
+    int fd = open_unix(L, SOCK_STREAM, "unix_listen", addr, addr_len, err);
+    if (fd < 0)
+    {
+        return push_fail(L, err);
+    }
+    if (::bind(fd, reinterpret_cast<struct sockaddr *>(&addr), addr_len) != 0 ||
+        ::listen(fd, backlog) != 0)
+    {
+        return fail_unix(L, fd, "unix_listen");
+    }
+    Sock *s = push_new_sock(L, fd, true);
+    s->family = AF_UNIX;
+    return 1;
+}
+
+// babet.socket.unix_dgram([path]) -> socket | (nil, err)
+//
+// Socket datagramme AF_UNIX, lié à path si donné (nécessaire pour
+// recevoir, et pour que le pair puisse répondre). Mêmes règles de
+// fichier périmé que unix_listen.
+int lua_socket_unix_dgram(lua_State *L)
+{
+    int fd = -1;
+    if (lua_isnoneornil(L, 1))
+    {
+        fd = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+        {
+            return push_errno_fail(L, "unix_dgram");
+        }
+        ensure_cloexec(fd); // belt + suspenders
+    }
+    else
+    {
+        luaL_checklstring(L, 1, nullptr);
+        std::string err;
+        struct sockaddr_storage addr;
+        socklen_t addr_len = 0;
+        fd = open_unix(L, SOCK_DGRAM, "unix_dgram", addr, addr_len, err);
+        if (fd < 0)
+        {
+            return push_fail(L, err);
+        }
+        if (::bind(fd, reinterpret_cast<struct sockaddr *>(&addr),
+                   addr_len) != 0)
+        {
+            return fail_unix(L, fd, "unix_dgram");
+        }
+    }
+    Sock *s = push_new_sock(L, fd, false);
+    s->type = SOCK_DGRAM;
+    s->family = AF_UNIX;
+    return 1;
+}
+
+namespace
+{
+    // Lit opts[field] (secondes) pour dns_config. Absent : out
+    // inchangé. Mauvais TYPE -> luaL_error ; mauvaise valeur -> false.
+    bool dns_parse_ttl(lua_State *L, const char *field, int &out)
+    {
+        lua_getfield(L, 1, field);
+        if (lua_isnil(L, -1))
+        {
+            lua_pop(L, 1);
+            return true;
+        }
+        if (lua_type(L, -1) != LUA_TNUMBER)
+        {
+            luaL_error(L, "socket: dns_config: opts.%s must be a number", field);
+        }
+        lua_Number t = lua_tonumber(L, -1);
+        lua_pop(L, 1);
+        if (!(t >= 0.0) || t * 1000.0 > static_cast<double>(INT_MAX))
+        {
+            return false;
+        }
+        out = static_cast<int>(t * 1000.0);
+        return true;
+    }
+
+    // Adresse littérale -> DnsAddr (port 0). false si ce n'en est pas
+    // une.
+    bool dns_parse_pin(const char *addr, std::vector<DnsAddr> &out)
+    {
+        struct addrinfo hints;
+        std::memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_NUMERICHOST;
+        struct addrinfo *res = nullptr;
+        if (::getaddrinfo(addr, nullptr, &hints, &res) != 0)
+        {
+            return false;
+        }
+        dns_copy_addrs(res, out);
+        ::freeaddrinfo(res);
+        return true;
+    }
+} // namespace
+
+// babet.socket.resolve(host [, timeout]) -> { addr, ... } | (nil, err)
+//
+// Adresses de host, au format numérique, dans l'ordre où connect les
+// essaie. Passe par le cache DNS du processus (cf. dns_lookup) ;
+// timeout en secondes, bloquant infini si absent.
+int lua_socket_resolve(lua_State *L)
+{
+    const char *host = luaL_checkstring(L, 1);
+    int timeout_ms = 0;
+    std::string err;
+    if (!parse_positional_timeout(L, 2, &timeout_ms, err,
+                                  "socket: resolve"))
+    {
+        return push_fail(L, err);
+    }
+    if (*host == '\0')
+    {
+        return push_fail(L, "socket: resolve: host must not be empty");
+    }
+
+    std::vector<DnsAddr> addrs;
+    int rc = dns_lookup(host, 0, make_deadline(timeout_ms), addrs, err);
+    if (rc == DNS_TIMEOUT)
+    {
+        return push_fail(L, "timeout");
+    }
+    if (rc == DNS_INTERRUPTED)
+    {
+        signal_dispatch_pending(L);
+        return push_fail(L, "interrupted");
+    }
+    if (rc != DNS_OK)
+    {
+        return push_fail(L, err);
+    }
+    lua_createtable(L, static_cast<int>(addrs.size()), 0);
+    int i = 0;
+    for (const DnsAddr &a : addrs)
+    {
+        char buf[NI_MAXHOST];
+        if (::getnameinfo(reinterpret_cast<const struct sockaddr *>(&a.addr),
+                          a.len, buf, sizeof(buf), nullptr, 0,
+                          NI_NUMERICHOST) == 0)
+        {
+            lua_pushstring(L, buf);
+            lua_rawseti(L, -2, ++i);
+        }
+    }
+    return 1;
+}
+
+// babet.socket.dns_config(opts) -> (true, nil) | (nil, err)
+//
+// Réglages du cache DNS, pour tout le processus (workers compris) :
+//   ttl          : durée de vie d'une réponse, secondes (défaut 60,
+//                  0 = pas de cache)
+//   negative_ttl : durée de vie d'un "nom inconnu" (défaut 5)
+//   hosts        : { name = "addr" | { "addr", ... } }, entrées
+//                  épinglées, remplacent les précédentes ({} les
+//                  retire toutes)
+//   flush        : true vide le cache (les épinglées restent)
+int lua_socket_dns_config(lua_State *L)
+{
+    luaL_checktype(L, 1, LUA_TTABLE);
+
+    // Types d'abord (luaL_error), avant toute construction d'objet
+    // C++ (cf. CORRECTIF longjmp).
+    lua_getfield(L, 1, "flush");
+    if (!lua_isnil(L, -1) && !lua_isboolean(L, -1))
+    {
+        return luaL_error(L, "socket: dns_config: opts.flush must be a boolean");
+    }
+    const bool flush = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+    lua_settop(L, 1);
+    lua_getfield(L, 1, "hosts"); // reste en 2
+    const bool has_hosts = !lua_isnil(L, 2);
+    if (has_hosts)
+    {
+        luaL_checktype(L, 2, LUA_TTABLE);
+        lua_pushnil(L);
+        while (lua_next(L, 2) != 0)
+        {
+            bool valid = lua_type(L, -2) == LUA_TSTRING &&
+                         (lua_type(L, -1) == LUA_TSTRING ||
+                          lua_type(L, -1) == LUA_TTABLE);
+            if (valid && lua_istable(L, -1))
+            {
+                lua_Integer n = static_cast<lua_Integer>(lua_rawlen(L, -1));
+                for (lua_Integer i = 1; i <= n && valid; ++i)
+                {
+                    valid = lua_rawgeti(L, -1, i) == LUA_TSTRING;
+                    lua_pop(L, 1);
+                }
+            }
+            if (!valid)
+            {
+                return luaL_error(L,
+                                  "socket: dns_config: opts.hosts must map names "
+                                  "to an address or a list of addresses");
+            }
+            lua_pop(L, 1);
+        }
+    }
+    DnsState &d = dns_state();
+    int ttl_ms = -1;
+    int negative_ttl_ms = -1;
+    if (!dns_parse_ttl(L, "ttl", ttl_ms))
+    {
+        return push_fail(L, "socket: dns_config: opts.ttl must be >= 0");
+    }
+    if (!dns_parse_ttl(L, "negative_ttl", negative_ttl_ms))
+    {
+        return push_fail(L, "socket: dns_config: opts.negative_ttl must be >= 0");
+    }
+
+    std::unordered_map<std::string, std::vector<DnsAddr>> pins;
+    if (has_hosts)
+    {
+        lua_pushnil(L);
+        while (lua_next(L, 2) != 0)
+        {
+            std::vector<DnsAddr> &addrs = pins[dns_key(lua_tostring(L, -2))];
+            lua_Integer n = lua_istable(L, -1)
+                                ? static_cast<lua_Integer>(lua_rawlen(L, -1))
+                                : 1;
+            for (lua_Integer i = 1; i <= n; ++i)
+            {
+                if (lua_istable(L, -1))
+                {
+                    lua_rawgeti(L, -1, i);
+                }
+                else
+                {
+                    lua_pushvalue(L, -1);
+                }
+                const char *addr = lua_tostring(L, -1);
+                if (!dns_parse_pin(addr, addrs))
+                {
+                    std::string err = "socket: dns_config: hosts: '";
+                    err += addr;
+                    err += "' is not a numeric address";
+                    return push_fail(L, err);
+                }
+                lua_pop(L, 1);
+            }
+            lua_pop(L, 1);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(d.mu);
+    if (ttl_ms >= 0)
+    {
+        d.ttl_ms = ttl_ms;
+    }
+    if (negative_ttl_ms >= 0)
+    {
+        d.negative_ttl_ms = negative_ttl_ms;
+    }
+    for (auto it = d.cache.begin(); it != d.cache.end();)
+    {
+        bool drop = it->second.pinned ? has_hosts : flush;
+        it = drop ? d.cache.erase(it) : std::next(it);
+    }
+    for (auto &pin : pins)
+    {
+        DnsEntry entry;
+        entry.addrs = std::move(pin.second);
+        entry.pinned = true;
+        d.cache[pin.first] = std::move(entry);
+    }
+    return push_ok(L);
+}
+
+// babet.socket.dns_stats() -> { hits =, misses =, entries =, pending =, threads = }
+//
+// Compteurs du cache DNS depuis le lancement : hits = réponses
+// servies par le cache (épinglées comprises), misses = requêtes
+// envoyées au pool ou jointes à une requête déjà en cours.
+int lua_socket_dns_stats(lua_State *L)
+{
+    DnsState &d = dns_state();
+    lua_Integer hits, misses, entries, pending, threads;
+    {
+        std::lock_guard<std::mutex> lock(d.mu);
+        hits = static_cast<lua_Integer>(d.hits);
+        misses = static_cast<lua_Integer>(d.misses);
+        entries = static_cast<lua_Integer>(d.cache.size());
+        pending = static_cast<lua_Integer>(d.inflight.size());
+        threads = d.threads;
+    }
+    lua_createtable(L, 0, 5);
+    lua_pushinteger(L, hits);
+    lua_setfield(L, -2, "hits");
+    lua_pushinteger(L, misses);
+    lua_setfield(L, -2, "misses");
+    lua_pushinteger(L, entries);
+    lua_setfield(L, -2, "entries");
+    lua_pushinteger(L, pending);
+    lua_setfield(L, -2, "pending");
+    lua_pushinteger(L, threads);
+    lua_setfield(L, -2, "threads");
+    return 1;
+}
+
+namespace
+{
+    // =================================================================
+    // Poller epoll (babet.socket.poller)
+    // =================================================================
+    //
+    // Avant : chaque méthode bloquait sur SON poll() (via
+    // wait_ready_deadline) ; un thread Lua ne servait qu'une connexion
+    // à la fois, un serveur devait prendre un worker par client.
+    //
+    // Le poller attend sur beaucoup de FD à la fois (epoll, level-
+    // triggered) et rend des LOTS d'événements prêts :
+    //   - sockets babet (TCP brut et TLS, client et serveur) ;
+    //   - watchers babet.inotify ;
+    //   - FD entiers quelconques (pipe, eventfd, ... gérés ailleurs) ;
+    //   - timers internes (tas min, pas de timerfd : un timer ne
+    //     coûte aucun FD ni syscall, seulement le calcul du timeout
+    //     passé à epoll_wait).
+    //
+    // Sockets : "readable" est aussi rendu quand des octets attendent
+    // déjà dans le tampon de lecture du Sock ou dans celui d'OpenSSL
+    // (SSL_pending), alors que le FD noyau est vide -- même piège que
+    // le CORRECTIF post-bug IRC TLS, à l'échelle du poller.
+    //
+    // Les objets enregistrés sont ancrés dans la uservalue du poller
+    // (table fd -> objet) : pas collectés tant qu'ils sont dedans, et
+    // rendus tels quels dans les événements.
+
+    constexpr const char *POLLER_META = "LuapilotPoller";
+    constexpr lua_Integer POLLER_DEFAULT_MAX_EVENTS = 256;
+    constexpr lua_Integer POLLER_MAX_EVENTS_CAP = 65536;
+
+    enum PollKind : unsigned char
+    {
+        PK_NONE = 0,
+        PK_SOCK,
+        PK_INOTIFY,
+        PK_FD,
+    };
+
+    // Une entrée par FD enregistré, indexée par le numéro de FD (petits
+    // entiers denses : un vector bat une table de hachage).
+    struct PollEntry
+    {
+        PollKind kind = PK_NONE;
+        uint32_t events = 0;  // EPOLLIN / EPOLLOUT demandés
+        Sock *sock = nullptr; // PK_SOCK uniquement (ancré, cf. plus haut)
+        bool reported = false; // déjà dans le lot en cours de wait()
+    };
+
+    struct PollTimer
+    {
+        Clock::time_point due;
+        lua_Integer id;
+        Clock::duration interval; // zero() = one-shot
+    };
+
+    // Comparateur pour un tas MIN sur due (std::push_heap construit un
+    // tas max par défaut).
+    struct TimerLater
+    {
+        bool operator()(const PollTimer &a, const PollTimer &b) const
+        {
+            return a.due > b.due;
+        }
+    };
+
+    struct Poller
+    {
+        int epfd = -1; // -1 si fermé
+        size_t count = 0;
+        std::vector<PollEntry> entries;
+        std::vector<struct epoll_event> evbuf; // taille = max_events
+        std::vector<PollTimer> timers;         // tas min sur due
+        // Timers encore actifs. cancel() retire l'id d'ici ; l'entrée
+        // reste dans le tas et est ignorée quand elle arrive au sommet
+        // (suppression paresseuse, pas de recherche dans le tas).
+        std::unordered_set<lua_Integer> live_timers;
+        lua_Integer next_timer_id = 1;
+        // Sockets inscrits qui ont déjà des octets lisibles (tampon
+        // Sock ou OpenSSL) : wait() les rend sans attendre le noyau
+        // et sans parcourir toutes les entrées. Tenu à jour par
+        // poller_sync_buffered.
+        std::unordered_set<Sock *> buffered;
+    };
+
+    void poller_sync_buffered(Sock *s)
+    {
+        if (s->pollers.empty())
+        {
+            return;
+        }
+        const bool has = sock_has_buffered(s);
+        for (Poller *p : s->pollers)
+        {
+            if (has)
+            {
+                p->buffered.insert(s);
+            }
+            else
+            {
+                p->buffered.erase(s);
+            }
+        }
+    }
+
+    void poller_link_sock(Poller *p, Sock *s)
+    {
+        s->pollers.push_back(p);
+        if (sock_has_buffered(s))
+        {
+            p->buffered.insert(s);
+        }
+    }
+
+    void poller_unlink_sock(Poller *p, Sock *s)
+    {
+        std::erase(s->pollers, p);
+        p->buffered.erase(s);
+    }
+
+    // Le poller peut être collecté APRÈS le socket dans le même cycle
+    // (ni l'un ni l'autre joignable) : on efface le pointeur de ses
+    // entrées pour que poller_release n'y touche plus.
+    void poller_forget_sock(Sock *s)
+    {
+        for (Poller *p : s->pollers)
+        {
+            p->buffered.erase(s);
+            for (PollEntry &e : p->entries)
+            {
+                if (e.sock == s)
+                {
+                    e.sock = nullptr;
+                }
+            }
+        }
+        s->pollers.clear();
+    }
+
+    Poller *check_poller(lua_State *L, int idx)
+    {
+        return static_cast<Poller *>(luaL_checkudata(L, idx, POLLER_META));
+    }
+
+    // Pousse la table d'ancrage fd -> objet (uservalue 1 du poller en 1).
+    int push_anchor(lua_State *L)
+    {
+        lua_getiuservalue(L, 1, 1);
+        return lua_gettop(L);
+    }
+
+    // Identifie la cible à l'index idx : socket, watcher inotify ou FD
+    // entier. Mauvais TYPE -> luaL_error ; socket / watcher fermé ->
+    // message renvoyé (le caller fait (nil, err)).
+    const char *resolve_poll_target(lua_State *L, int idx, int &fd,
+                                    PollKind &kind, Sock *&sock)
+    {
+        sock = nullptr;
+        if (Sock *s = static_cast<Sock *>(luaL_testudata(L, idx, SOCK_META)))
+        {
+            if (s->fd < 0)
+            {
+                return "socket is closed";
+            }
+            fd = s->fd;
+            kind = PK_SOCK;
+            sock = s;
+            return nullptr;
+        }
+        int wfd = inotify_watcher_fd(L, idx);
+        if (wfd != -2)
+        {
+            if (wfd < 0)
+            {
+                return "inotify watcher is closed";
+            }
+            fd = wfd;
+            kind = PK_INOTIFY;
+            return nullptr;
+        }
+        if (lua_isinteger(L, idx))
+        {
+            lua_Integer v = lua_tointeger(L, idx);
+            if (v < 0 || v > INT_MAX)
+            {
+                return "fd must be >= 0";
+            }
+            fd = static_cast<int>(v);
+            kind = PK_FD;
+            return nullptr;
+        }
+        luaL_error(L, "poller: expected a socket, an inotify watcher "
+                      "or an integer fd, got %s",
+                   luaL_typename(L, idx));
+        return nullptr; // jamais atteint
+    }
+
+    // "r", "w" ou "rw" -> masque epoll. 0 si invalide.
+    uint32_t parse_interest(const char *spec)
+    {
+        uint32_t ev = 0;
+        for (const char *p = spec; *p; ++p)
+        {
+            if (*p == 'r')
+            {
+                ev |= EPOLLIN;
+            }
+            else if (*p == 'w')
+            {
+                ev |= EPOLLOUT;
+            }
+            else
+            {
+                return 0;
+            }
+        }
+        return ev;
+    }
+
+    int poller_fail(lua_State *L, const char *op, const char *what)
+    {
+        std::string msg = "socket: poller: ";
+        msg += op;
+        msg += ": ";
+        msg += what;
+        return push_fail(L, msg);
+    }
+
+    // p:add(target [, events]) -> (true, nil) | (nil, err)
+    int poller_add(lua_State *L)
+    {
+        Poller *p = check_poller(L, 1);
+        int fd = -1;
+        PollKind kind = PK_NONE;
+        Sock *sock = nullptr;
+        const char *bad = resolve_poll_target(L, 2, fd, kind, sock);
+        const char *spec = luaL_optstring(L, 3, "r");
+        if (p->epfd < 0)
+        {
+            return poller_fail(L, "add", "poller is closed");
+        }
+        if (bad)
+        {
+            return poller_fail(L, "add", bad);
+        }
+        uint32_t events = parse_interest(spec);
+        if (events == 0)
+        {
+            return poller_fail(L, "add", "events must be 'r', 'w' or 'rw'");
+        }
+
+        int anchor = push_anchor(L);
+        if (static_cast<size_t>(fd) < p->entries.size() &&
+            p->entries[fd].kind != PK_NONE)
+        {
+            lua_rawgeti(L, anchor, fd);
+            bool same = lua_rawequal(L, -1, 2);
+            lua_pop(L, 1);
+            if (same)
+            {
+                return poller_fail(L, "add", "already registered");
+            }
+            // Autre objet sur le même numéro de FD : l'ancien a été
+            // fermé (le noyau l'a déjà retiré de l'epoll) et le numéro
+            // réutilisé. On remplace l'entrée périmée.
+            if (p->entries[fd].sock != nullptr)
+            {
+                poller_unlink_sock(p, p->entries[fd].sock);
+            }
+            p->entries[fd] = PollEntry();
+            --p->count;
+        }
+
+        struct epoll_event ev;
+        std::memset(&ev, 0, sizeof(ev));
+        ev.events = events;
+        ev.data.fd = fd;
+        if (::epoll_ctl(p->epfd, EPOLL_CTL_ADD, fd, &ev) != 0)
+        {
+            if (errno != EEXIST ||
+                ::epoll_ctl(p->epfd, EPOLL_CTL_MOD, fd, &ev) != 0)
+            {
+                return push_errno_fail(L, "poller: add");
+            }
+        }
+        if (static_cast<size_t>(fd) >= p->entries.size())
+        {
+            p->entries.resize(static_cast<size_t>(fd) + 1);
+        }
+        PollEntry &e = p->entries[fd];
+        e.kind = kind;
+        e.events = events;
+        e.sock = sock;
+        if (sock != nullptr)
+        {
+            poller_link_sock(p, sock);
+        }
+        ++p->count;
+        lua_pushvalue(L, 2);
+        lua_rawseti(L, anchor, fd);
+        return push_ok(L);
+    }
+
+    // Retrouve le FD sous lequel `idx` est ancré (rawequal), ou -1.
+    // Sert à remove() quand l'objet a été fermé entre-temps (son fd
+    // vaut alors -1 et ne permet plus l'indexation directe).
+    int find_anchored_fd(lua_State *L, int anchor, int idx)
+    {
+        lua_pushnil(L);
+        while (lua_next(L, anchor) != 0)
+        {
+            if (lua_rawequal(L, -1, idx))
+            {
+                int fd = static_cast<int>(lua_tointeger(L, -2));
+                lua_pop(L, 2);
+                return fd;
+            }
+            lua_pop(L, 1);
+        }
+        return -1;
+    }
+
+    // FD enregistré pour la cible idx, ou -1 si absente.
+    int registered_fd(lua_State *L, Poller *p, int anchor, int idx)
+    {
+        int fd = -1;
+        if (Sock *s = static_cast<Sock *>(luaL_testudata(L, idx, SOCK_META)))
+        {
+            fd = s->fd;
+        }
+        else if (lua_isinteger(L, idx))
+        {
+            lua_Integer v = lua_tointeger(L, idx);
+            fd = (v >= 0 && v <= INT_MAX) ? static_cast<int>(v) : -1;
+        }
+        else
+        {
+            fd = inotify_watcher_fd(L, idx);
+        }
+        if (fd >= 0 && static_cast<size_t>(fd) < p->entries.size() &&
+            p->entries[fd].kind != PK_NONE)
+        {
+            lua_rawgeti(L, anchor, fd);
+            bool same = lua_rawequal(L, -1, idx);
+            lua_pop(L, 1);
+            if (same)
+            {
+                return fd;
+            }
+        }
+        return find_anchored_fd(L, anchor, idx);
+    }
+
+    // p:modify(target, events) -> (true, nil) | (nil, err)
+    int poller_modify(lua_State *L)
+    {
+        Poller *p = check_poller(L, 1);
+        luaL_checkany(L, 2);
+        const char *spec = luaL_checkstring(L, 3);
+        if (p->epfd < 0)
+        {
+            return poller_fail(L, "modify", "poller is closed");
+        }
+        uint32_t events = parse_interest(spec);
+        if (events == 0)
+        {
+            return poller_fail(L, "modify",
+                               "events must be 'r', 'w' or 'rw'");
+        }
+        int anchor = push_anchor(L);
+        int fd = registered_fd(L, p, anchor, 2);
+        if (fd < 0)
+        {
+            return poller_fail(L, "modify", "not registered");
+        }
+        struct epoll_event ev;
+        std::memset(&ev, 0, sizeof(ev));
+        ev.events = events;
+        ev.data.fd = fd;
+        if (::epoll_ctl(p->epfd, EPOLL_CTL_MOD, fd, &ev) != 0)
+        {
+            return push_errno_fail(L, "poller: modify");
+        }
+        p->entries[fd].events = events;
+        return push_ok(L);
+    }
+
+    // p:remove(target) -> (true, nil) | (nil, err)
+    // Accepte un socket déjà fermé (retrouvé par identité).
+    int poller_remove(lua_State *L)
+    {
+        Poller *p = check_poller(L, 1);
+        luaL_checkany(L, 2);
+        if (p->epfd < 0)
+        {
+            return poller_fail(L, "remove", "poller is closed");
+        }
+        int anchor = push_anchor(L);
+        int fd = registered_fd(L, p, anchor, 2);
+        if (fd < 0)
+        {
+            return poller_fail(L, "remove", "not registered");
+        }
+        // ENOENT / EBADF : FD déjà fermé, le noyau l'a retiré tout seul.
+        ::epoll_ctl(p->epfd, EPOLL_CTL_DEL, fd, nullptr);
+        if (p->entries[fd].sock != nullptr)
+        {
+            poller_unlink_sock(p, p->entries[fd].sock);
+        }
+        p->entries[fd] = PollEntry();
+        --p->count;
+        lua_pushnil(L);
+        lua_rawseti(L, anchor, fd);
+        return push_ok(L);
+    }
+
+    // Convertit des secondes Lua en durée. false + msg si invalide.
+    bool seconds_to_duration(lua_Number t, Clock::duration &out,
+                             const char *&msg)
+    {
+        if (std::isnan(t) || !std::isfinite(t))
+        {
+            msg = "value must be finite (not NaN or inf)";
+            return false;
+        }
+        if (t < 0.0)
+        {
+            msg = "value must be >= 0";
+            return false;
+        }
+        if (t * 1000.0 > static_cast<double>(INT_MAX))
+        {
+            msg = "value too large";
+            return false;
+        }
+        out = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(t));
+        return true;
+    }
+
+    // p:timer(seconds [, repeat]) -> id | (nil, err)
+    // Le timer apparaît dans le lot de wait() sous la forme
+    // { timer = id } une fois échu. repeat = true : réarmé toutes les
+    // `seconds` (sans rattrapage en rafale après un retard).
+    int poller_timer(lua_State *L)
+    {
+        Poller *p = check_poller(L, 1);
+        lua_Number t = luaL_checknumber(L, 2);
+        bool repeat = lua_toboolean(L, 3);
+        if (p->epfd < 0)
+        {
+            return poller_fail(L, "timer", "poller is closed");
+        }
+        Clock::duration d{};
+        const char *msg = nullptr;
+        if (!seconds_to_duration(t, d, msg))
+        {
+            return poller_fail(L, "timer", msg);
+        }
+        if (repeat && d <= Clock::duration::zero())
+        {
+            return poller_fail(L, "timer",
+                               "repeating timer needs an interval > 0");
+        }
+        lua_Integer id = p->next_timer_id++;
+        p->timers.push_back(PollTimer{Clock::now() + d, id,
+                                      repeat ? d : Clock::duration::zero()});
+        std::push_heap(p->timers.begin(), p->timers.end(), TimerLater());
+        p->live_timers.insert(id);
+        lua_pushinteger(L, id);
+        return 1;
+    }
+
+    // p:cancel(id) -> (true, nil) | (nil, err)
+    int poller_cancel(lua_State *L)
+    {
+        Poller *p = check_poller(L, 1);
+        lua_Integer id = luaL_checkinteger(L, 2);
+        if (p->live_timers.erase(id) == 0)
+        {
+            return poller_fail(L, "cancel", "no such timer");
+        }
+        return push_ok(L);
+    }
+
+    // Retire les entrées annulées du sommet du tas. Renvoie le
+    // prochain timer actif, ou nullptr.
+    const PollTimer *next_live_timer(Poller *p)
+    {
+        while (!p->timers.empty() &&
+               p->live_timers.count(p->timers.front().id) == 0)
+        {
+            std::pop_heap(p->timers.begin(), p->timers.end(), TimerLater());
+            p->timers.pop_back();
+        }
+        return p->timers.empty() ? nullptr : &p->timers.front();
+    }
+
+    // Ajoute { obj = ..., readable = ..., writable = ... [, hangup]
+    // [, error] } à la table résultat (sommet - 0 = résultat).
+    void push_fd_event(lua_State *L, int result, int anchor, int fd,
+                       uint32_t revents, lua_Integer &n)
+    {
+        lua_createtable(L, 0, 4);
+        lua_rawgeti(L, anchor, fd);
+        lua_setfield(L, -2, "obj");
+        lua_pushboolean(L, (revents & EPOLLIN) != 0);
+        lua_setfield(L, -2, "readable");
+        lua_pushboolean(L, (revents & EPOLLOUT) != 0);
+        lua_setfield(L, -2, "writable");
+        if (revents & (EPOLLHUP | EPOLLRDHUP))
+        {
+            lua_pushboolean(L, 1);
+            lua_setfield(L, -2, "hangup");
+        }
+        if (revents & EPOLLERR)
+        {
+            lua_pushboolean(L, 1);
+            lua_setfield(L, -2, "error");
+        }
+        lua_rawseti(L, result, ++n);
+    }
+
+    // p:wait([timeout]) -> events | (nil, "timeout")
+    //                             | (nil, "interrupted") | (nil, err)
+    //
+    // timeout en secondes : absent/nil = infini, 0 = non bloquant.
+    // Même sémantique que partout (durée max de l'APPEL) ; un timer
+    // qui échoit avant rend la main plus tôt avec son événement.
+    int poller_wait(lua_State *L)
+    {
+        Poller *p = check_poller(L, 1);
+        Deadline deadline = NO_DEADLINE;
+        if (!lua_isnoneornil(L, 2))
+        {
+            lua_Number t = luaL_checknumber(L, 2);
+            Clock::duration d{};
+            const char *msg = nullptr;
+            if (!seconds_to_duration(t, d, msg))
+            {
+                return poller_fail(L, "wait", msg);
+            }
+            deadline = Clock::now() + d;
+        }
+        if (p->epfd < 0)
+        {
+            return poller_fail(L, "wait", "poller is closed");
+        }
+
+        int anchor = push_anchor(L);
+        std::vector<int> buffered;
+        for (;;)
+        {
+            // 1. Sockets avec des octets déjà bufferisés : prêts sans
+            //    attendre le noyau (seulement ceux de p->buffered).
+            buffered.clear();
+            for (Sock *s : p->buffered)
+            {
+                const int fd = s->fd;
+                if (fd >= 0 && static_cast<size_t>(fd) < p->entries.size() &&
+                    p->entries[fd].sock == s &&
+                    (p->entries[fd].events & EPOLLIN))
+                {
+                    buffered.push_back(fd);
+                }
+            }
+
+            // 2. Timeout effectif : 0 si déjà du prêt, sinon le plus
+            //    proche entre la deadline et le prochain timer
+            //    (arrondi au-dessus : se réveiller une ms trop tôt
+            //    ferait un tour à vide).
+            int t = buffered.empty() ? remaining_ms(deadline) : 0;
+            if (const PollTimer *nt = next_live_timer(p))
+            {
+                auto now = Clock::now();
+                long long ms = (nt->due <= now)
+                                   ? 0
+                                   : std::chrono::ceil<std::chrono::milliseconds>(
+                                         nt->due - now)
+                                         .count();
+                if (ms > INT_MAX)
+                {
+                    ms = INT_MAX;
+                }
+                if (t < 0 || ms < t)
+                {
+                    t = static_cast<int>(ms);
+                }
+            }
+
+            int n = ::epoll_wait(p->epfd, p->evbuf.data(),
+                                 static_cast<int>(p->evbuf.size()), t);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                {
+                    // Même politique que wait_ready_deadline : signal
+                    // géré -> "interrupted", sinon on reboucle.
+                    if (signal_any_handled_pending())
+                    {
+                        signal_dispatch_pending(L);
+                        return push_fail(L, "interrupted");
+                    }
+                    continue;
+                }
+                return push_errno_fail(L, "poller: wait");
+            }
+
+            // 3. Lot d'événements.
+            lua_createtable(L, n + static_cast<int>(buffered.size()), 0);
+            int result = lua_gettop(L);
+            lua_Integer count = 0;
+            for (int i = 0; i < n; ++i)
+            {
+                const struct epoll_event &ev = p->evbuf[i];
+                int fd = ev.data.fd;
+                if (static_cast<size_t>(fd) >= p->entries.size() ||
+                    p->entries[fd].kind == PK_NONE)
+                {
+                    continue;
+                }
+                PollEntry &e = p->entries[fd];
+                uint32_t revents = ev.events;
+                if (e.kind == PK_SOCK && (e.events & EPOLLIN) &&
+                    e.sock != nullptr && p->buffered.contains(e.sock))
+                {
+                    revents |= EPOLLIN;
+                }
+                e.reported = true;
+                push_fd_event(L, result, anchor, fd, revents, count);
+            }
+            for (int fd : buffered)
+            {
+                PollEntry &e = p->entries[fd];
+                if (!e.reported)
+                {
+                    push_fd_event(L, result, anchor, fd, EPOLLIN, count);
+                }
+            }
+            for (int i = 0; i < n; ++i)
+            {
+                int fd = p->evbuf[i].data.fd;
+                if (static_cast<size_t>(fd) < p->entries.size())
+                {
+                    p->entries[fd].reported = false;
+                }
+            }
+
+            // 4. Timers échus, dans l'ordre d'échéance.
+            auto now = Clock::now();
+            while (const PollTimer *nt = next_live_timer(p))
+            {
+                if (nt->due > now)
+                {
+                    break;
+                }
+                PollTimer fired = *nt;
+                std::pop_heap(p->timers.begin(), p->timers.end(),
+                              TimerLater());
+                p->timers.pop_back();
+                lua_createtable(L, 0, 1);
+                lua_pushinteger(L, fired.id);
+                lua_setfield(L, -2, "timer");
+                lua_rawseti(L, result, ++count);
+                if (fired.interval > Clock::duration::zero())
+                {
+                    fired.due += fired.interval;
+                    if (fired.due <= now)
+                    {
+                        fired.due = now + fired.interval;
+                    }
+                    p->timers.push_back(fired);
+                    std::push_heap(p->timers.begin(), p->timers.end(),
+                                   TimerLater());
+                }
+                else
+                {
+                    p->live_timers.erase(fired.id);
+                }
+            }
+
+            if (count > 0)
+            {
+                return 1;
+            }
+            lua_pop(L, 1); // résultat vide
+            if (remaining_ms(deadline) == 0)
+            {
+                return push_fail(L, "timeout");
+            }
+            // Réveil pour un timer annulé entre-temps : on reboucle.
+        }
+    }
+
+    void poller_release(Poller *p)
+    {
+        if (p->epfd >= 0)
+        {
+            ::close(p->epfd);
+            p->epfd = -1;
+        }
+        for (PollEntry &e : p->entries)
+        {
+            if (e.sock != nullptr)
+            {
+                poller_unlink_sock(p, e.sock);
+            }
+        }
+        p->entries.clear();
+        p->timers.clear();
+        p->live_timers.clear();
+        p->count = 0;
+    }
+
+    // p:close() -> (true, nil). Idempotent. Ne ferme PAS les sockets
+    // enregistrés : ils appartiennent au script.
+    int poller_close(lua_State *L)
+    {
+        Poller *p = check_poller(L, 1);
+        poller_release(p);
+        lua_newtable(L);
+        lua_setiuservalue(L, 1, 1); // libère les ancrages
+        return push_ok(L);
+    }
+
+    int poller_gc(lua_State *L)
     {
-        return push_fail(L, "socket: starttls: socket is closed");
+        Poller *p = static_cast<Poller *>(luaL_testudata(L, 1, POLLER_META));
+        if (p)
+        {
+            poller_release(p);
+            p->~Poller();
+        }
+        return 0;
     }
-    if (s->listening)
+
+    int poller_tostring(lua_State *L)
     {
-        return push_fail(L,
-                         "socket: starttls: cannot start TLS on a listening socket");
+        Poller *p = check_poller(L, 1);
+        char buf[64];
+        if (p->epfd < 0)
+        {
+            std::snprintf(buf, sizeof(buf), "poller (closed)");
+        }
+        else
+        {
+            std::snprintf(buf, sizeof(buf), "poller (%zu fds, %zu timers)",
+                          p->count, p->live_timers.size());
+        }
+        lua_pushstring(L, buf);
+        return 1;
     }
-    if (s->ssl != nullptr)
+} // namespace
+
+// babet.socket.poller([max_events]) -> poller | (nil, err)
+//
+// Crée un poller epoll (EPOLL_CLOEXEC, même rationale que les
+// sockets). max_events : taille maximale d'un lot rendu par wait()
+// (défaut 256). Les FD prêts au-delà restent prêts (level-triggered)
+// et sortent au wait() suivant.
+int lua_socket_poller(lua_State *L)
+{
+    lua_Integer max = luaL_optinteger(L, 1, POLLER_DEFAULT_MAX_EVENTS);
+    if (max <= 0 || max > POLLER_MAX_EVENTS_CAP)
     {
         return push_fail(L,
-                         "socket: starttls: TLS already active on this socket");
+                         "socket: poller: max_events must be in [1, 65536]");
     }
-
-    std::string err;
-    TlsOptions opts;
-    if (!parse_tls_options(L, 2, opts, err))
+    // uservalue 1 = table d'ancrage fd -> objet (cf. Poller).
+    void *raw = lua_newuserdatauv(L, sizeof(Poller), 1);
+    Poller *p = new (raw) Poller(); // placement new : vectors, set
+    luaL_getmetatable(L, POLLER_META);
+    lua_setmetatable(L, -2);
+    lua_newtable(L);
+    lua_setiuservalue(L, -2, 1);
+    p->evbuf.resize(static_cast<size_t>(max));
+    p->epfd = ::epoll_create1(EPOLL_CLOEXEC);
+    if (p->epfd < 0)
     {
-        return push_fail(L, err);
+        return push_errno_fail(L, "poller");
     }
+    return 1;
+}
 
-    // CORRECTIF (post-revue ChatGPT) : "verify strict par défaut"
-    // (TLS-C) signifie chaîne + hostname. starttls n'a pas de host
-    // par défaut comme connect_tls (qui utilise son argument host).
-    // Donc si verify=true et hostname vide, le hostname check serait
-    // SAUTÉ silencieusement — c'est une demi-mesure de sécurité qui
-    // contredit "strict par défaut". On REFUSE explicitement, avec un
-    // message qui guide vers les deux choix corrects : passer hostname,
-    // ou opt-out explicite via verify=false.
-    if (opts.verify && opts.hostname.empty())
+namespace
+{
+    // =================================================================
+    // Scheduler de tâches (babet.socket.scheduler)
+    // =================================================================
+    //
+    // Le poller laisse le script écrire sa machine à états : qui est
+    // prêt, où en était-on avec ce client. Le scheduler garde le style
+    // séquentiel -- une coroutine par connexion, recv_line / send
+    // écrits comme en bloquant -- et fait le multiplexage lui-même :
+    // une opération qui ferait attendre suspend sa tâche (co_wait,
+    // plus haut), run() attend sur epoll et reprend les tâches dont
+    // le FD est prêt ou dont la deadline est tombée.
+    //
+    // Les coroutines sont ancrées dans la uservalue du scheduler
+    // (table id -> thread), comme les objets du poller : un scheduler
+    // abandonné avec des tâches en attente est collecté avec elles.
+
+    constexpr const char *SCHED_META = "LuapilotScheduler";
+    constexpr size_t SCHED_MAX_EVENTS = 256;
+
+    Scheduler *check_sched(lua_State *L, int idx)
     {
-        return push_fail(L,
-                         "tls: starttls with verify=true requires opts.hostname; "
-                         "pass hostname or set verify=false");
+        return static_cast<Scheduler *>(luaL_checkudata(L, idx, SCHED_META));
     }
 
-    if (!init_openssl_ctx(err))
+    void sched_wake(Scheduler *sc, lua_Integer id)
     {
-        return push_fail(L, err);
+        auto it = sc->tasks.find(id);
+        if (it == sc->tasks.end())
+        {
+            return;
+        }
+        SchedTask &t = it->second;
+        sched_disarm(sc, id, t.wait_fd);
+        t.wait_fd = -1;
+        ++t.wait_seq; // l'échéance éventuelle devient périmée
+        sc->runnable.push_back(id);
     }
 
-    SSL *ssl = SSL_new(g_tls_ctx);
-    if (ssl == nullptr)
+    // Oublie une tâche terminée (scheduler en 1 sur la pile).
+    void sched_drop(lua_State *L, Scheduler *sc, lua_Integer id)
     {
-        return push_fail(L, format_tls_error("SSL_new failed"));
+        auto it = sc->tasks.find(id);
+        if (it == sc->tasks.end())
+        {
+            return;
+        }
+        sched_disarm(sc, id, it->second.wait_fd);
+        sc->tasks.erase(it);
+        lua_getiuservalue(L, 1, 1);
+        lua_pushnil(L);
+        lua_rawseti(L, -2, id);
+        lua_pop(L, 1);
     }
-    if (SSL_set_fd(ssl, s->fd) != 1)
+
+    // Prochaine échéance encore valide, en purgeant les périmées.
+    const SchedDeadline *next_deadline(Scheduler *sc)
     {
-        SSL_free(ssl);
-        return push_fail(L, format_tls_error("SSL_set_fd failed"));
+        while (!sc->deadlines.empty())
+        {
+            const SchedDeadline &d = sc->deadlines.front();
+            auto it = sc->tasks.find(d.task);
+            if (it != sc->tasks.end() && it->second.wait_seq == d.seq)
+            {
+                return &d;
+            }
+            std::pop_heap(sc->deadlines.begin(), sc->deadlines.end(),
+                          DeadlineLater());
+            sc->deadlines.pop_back();
+        }
+        return nullptr;
     }
 
-    // host_default = nullptr ici : starttls n'a pas reçu de host. Si
-    // opts.hostname est vide, on est en mode verify=false (vérifié
-    // au-dessus), donc le hostname check ne s'applique pas. Sinon
-    // opts.hostname est passé à apply_tls_options qui posera
-    // SSL_set1_host + SNI dessus.
-    if (!apply_tls_options(ssl, opts, nullptr, err))
+    // sched:spawn(fn, ...) -> id
+    // La tâche démarre au prochain tour de run(), avec ... en
+    // arguments. Utilisable depuis une tâche.
+    int sched_spawn(lua_State *L)
     {
-        SSL_free(ssl);
-        return push_fail(L, err);
+        Scheduler *sc = check_sched(L, 1);
+        luaL_checktype(L, 2, LUA_TFUNCTION);
+        if (sc->epfd < 0)
+        {
+            return push_fail(L, "socket: scheduler: spawn: scheduler is closed");
+        }
+        int nargs = lua_gettop(L) - 2;
+        lua_Integer id = sc->next_id++;
+
+        lua_getiuservalue(L, 1, 1);
+        lua_State *co = lua_newthread(L);
+        lua_rawseti(L, -2, id);
+        lua_pop(L, 1);
+        lua_xmove(L, co, nargs + 1); // fn + arguments
+
+        SchedTask t;
+        t.co = co;
+        t.nargs = nargs;
+        sc->tasks.emplace(id, t);
+        sc->runnable.push_back(id);
+        lua_pushinteger(L, id);
+        return 1;
     }
 
-    // CORRECTIF (post-revue ChatGPT, parallèle de connect_tls) :
-    // garder le FD en O_NONBLOCK après le handshake pour que les
-    // SSL_read/SSL_write ultérieurs respectent réellement la deadline
-    // globale. cf. note détaillée dans connect_tls.
-    int flags = ::fcntl(s->fd, F_GETFL, 0);
-    if (flags >= 0)
+    int sched_sleep_k(lua_State *L, int, lua_KContext)
     {
-        ::fcntl(s->fd, F_SETFL, flags | O_NONBLOCK);
+        return push_ok(L);
     }
-    bool hs_ok = tls_handshake(ssl, s->fd, s->timeout_ms, err);
-    if (!hs_ok)
+
+    // sched:sleep(seconds) -> (true, nil)
+    // Suspend la tâche courante sans bloquer les autres. sleep(0) =
+    // passer son tour. Hors d'une tâche de CE scheduler : luaL_error
+    // (babet.sleep reste le sommeil bloquant du thread).
+    int sched_sleep(lua_State *L)
     {
-        if (flags >= 0)
+        Scheduler *sc = check_sched(L, 1);
+        lua_Number t = luaL_checknumber(L, 2);
+        if (t_sched != sc || sc->current != L || !lua_isyieldable(L))
         {
-            ::fcntl(s->fd, F_SETFL, flags); // remettre bloquant si échec
+            return luaL_error(L,
+                              "socket: scheduler: sleep must be called from one of its tasks");
         }
-        SSL_free(ssl);
-        if (err == "interrupted")
+        Clock::duration d{};
+        const char *msg = nullptr;
+        if (!seconds_to_duration(t, d, msg))
         {
-            signal_dispatch_pending(L);
+            return push_fail(L, std::string("socket: scheduler: sleep: ") + msg);
         }
-        return push_fail(L, err);
+        park_current(sc, -1, Clock::now() + d);
+        return lua_yieldk(L, 0, 0, sched_sleep_k);
     }
-    // Succès : NE PAS remettre bloquant. FD reste O_NONBLOCK pour
-    // toute la vie du socket TLS.
 
-    // Succès : attacher le ssl au Sock existant (transformation
-    // en place). À partir de maintenant, send/recv/... iront via
-    // SSL_read/SSL_write (sous-étape 1.3).
-    s->ssl = ssl;
-    return push_ok(L);
-}
-
-// babet.socket.listen(host, port [, backlog]) -> socket | (nil, err)
-//
-// Fait socket + setsockopt(SO_REUSEADDR) + bind + listen en une
-// opération (API haute, décision SOCK-2). host peut être "" pour
-// "toutes les interfaces" (AI_PASSIVE prend le relais).
-int lua_socket_listen(lua_State *L)
-{
-    const char *host = luaL_checkstring(L, 1);
-    lua_Integer port = luaL_checkinteger(L, 2);
-    if (port < 0 || port > 65535)
+    // Reprend la tâche id. Renvoie le statut de lua_resume ; en cas
+    // d'erreur, le message (avec traceback) est poussé sur L.
+    int sched_resume(lua_State *L, Scheduler *sc, lua_Integer id)
     {
-        return push_fail(L,
-                         "socket: listen: port must be in [0, 65535]");
+        auto it = sc->tasks.find(id);
+        if (it == sc->tasks.end())
+        {
+            return LUA_OK;
+        }
+        lua_State *co = it->second.co;
+        int nargs = it->second.nargs;
+        it->second.nargs = 0;
+
+        Scheduler *prev = t_sched;
+        t_sched = sc;
+        sc->current = co;
+        sc->current_id = id;
+        sc->parked = false;
+        int nres = 0;
+        int st = lua_resume(co, L, nargs, &nres);
+        t_sched = prev;
+        sc->current = nullptr;
+        sc->current_id = 0;
+
+        if (st == LUA_YIELD)
+        {
+            lua_pop(co, nres);
+            if (!sc->parked)
+            {
+                // coroutine.yield() nu : la tâche repasse en queue.
+                sc->runnable.push_back(id);
+            }
+            return st;
+        }
+        if (st != LUA_OK)
+        {
+            const char *msg = lua_tostring(co, -1);
+            luaL_traceback(L, co, msg ? msg : "(error object is not a string)",
+                           0);
+        }
+        sched_drop(L, sc, id);
+        return st;
     }
-    int backlog = 16;
-    if (!lua_isnoneornil(L, 3))
+
+    // sched:run([timeout]) -> (true, nil) | (nil, err)
+    // Fait tourner les tâches jusqu'à ce qu'il n'en reste aucune.
+    //   (nil, "timeout")      timeout (secondes) écoulé, tâches en cours
+    //   (nil, "interrupted")  signal géré par babet.signal
+    //   (nil, "socket: scheduler: task N failed: ...")  erreur Lua non
+    //                         rattrapée dans une tâche (traceback inclus)
+    // Dans les trois cas les autres tâches restent suspendues : un
+    // nouveau run() les reprend.
+    int sched_run(lua_State *L)
     {
-        lua_Integer b = luaL_checkinteger(L, 3);
-        if (b <= 0)
+        Scheduler *sc = check_sched(L, 1);
+        Deadline deadline = NO_DEADLINE;
+        if (!lua_isnoneornil(L, 2))
         {
-            return push_fail(L,
-                             "socket: listen: backlog must be > 0");
+            lua_Number t = luaL_checknumber(L, 2);
+            Clock::duration d{};
+            const char *msg = nullptr;
+            if (!seconds_to_duration(t, d, msg))
+            {
+                return push_fail(L, std::string("socket: scheduler: run: ") + msg);
+            }
+            deadline = Clock::now() + d;
         }
-        backlog = static_cast<int>(b);
-    }
+        if (sc->epfd < 0)
+        {
+            return push_fail(L, "socket: scheduler: run: scheduler is closed");
+        }
+        if (t_sched == sc)
+        {
+            return luaL_error(L,
+                              "socket: scheduler: run called from one of its own tasks");
+        }
+        lua_settop(L, 1);
 
-    char port_str[16];
-    std::snprintf(port_str, sizeof(port_str), "%lld",
-                  static_cast<long long>(port));
+        for (;;)
+        {
+            // 1. Tâches prêtes, dans l'ordre. Celles réveillées pendant
+            //    ce tour (spawn, yield nu) passent au tour suivant,
+            //    après l'epoll : pas de famine des FD.
+            size_t batch = sc->runnable.size();
+            for (size_t i = 0; i < batch && !sc->runnable.empty(); ++i)
+            {
+                lua_Integer id = sc->runnable.front();
+                sc->runnable.pop_front();
+                int st = sched_resume(L, sc, id);
+                if (st != LUA_OK && st != LUA_YIELD)
+                {
+                    lua_pushnil(L);
+                    lua_pushfstring(L, "socket: scheduler: task %I failed: %s",
+                                    id,
+                                    lua_tostring(L, -2));
+                    return 2;
+                }
+            }
+            if (sc->tasks.empty())
+            {
+                return push_ok(L);
+            }
 
-    std::string err;
-    struct addrinfo *res = resolve(host, port_str, true, err);
-    if (!res)
+            // 2. Attente : rien si des tâches sont prêtes, sinon
+            //    jusqu'à la plus proche échéance (arrondie au-dessus,
+            //    cf. poller_wait) ou la deadline de run().
+            int t = sc->runnable.empty() ? remaining_ms(deadline) : 0;
+            if (const SchedDeadline *nd = next_deadline(sc))
+            {
+                auto now = Clock::now();
+                long long ms = (nd->due <= now)
+                                   ? 0
+                                   : std::chrono::ceil<std::chrono::milliseconds>(
+                                         nd->due - now)
+                                         .count();
+                if (ms > INT_MAX)
+                {
+                    ms = INT_MAX;
+                }
+                if (t < 0 || ms < t)
+                {
+                    t = static_cast<int>(ms);
+                }
+            }
+            int n = ::epoll_wait(sc->epfd, sc->evbuf.data(),
+                                 static_cast<int>(sc->evbuf.size()), t);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                {
+                    if (signal_any_handled_pending())
+                    {
+                        signal_dispatch_pending(L);
+                        return push_fail(L, "interrupted");
+                    }
+                    continue;
+                }
+                return push_errno_fail(L, "scheduler: run");
+            }
+
+            // 3. FD prêts : réveille lecteur et / ou écrivain. HUP et
+            //    ERR réveillent les deux, l'opération reprise verra
+            //    "closed" ou l'erreur.
+            for (int i = 0; i < n; ++i)
+            {
+                int fd = sc->evbuf[i].data.fd;
+                uint32_t ev = sc->evbuf[i].events;
+                if (static_cast<size_t>(fd) >= sc->fds.size())
+                {
+                    continue;
+                }
+                FdWaiters &w = sc->fds[fd];
+                const uint32_t fail = EPOLLHUP | EPOLLERR;
+                if (w.reader != 0 && (ev & (EPOLLIN | EPOLLRDHUP | fail)))
+                {
+                    sched_wake(sc, w.reader);
+                }
+                if (w.writer != 0 && (ev & (EPOLLOUT | fail)))
+                {
+                    sched_wake(sc, w.writer);
+                }
+                // Plus personne n'attend ce FD (ou plus ces
+                // événements) : on rabote, sinon epoll (level-
+                // triggered) le rendrait à chaque tour.
+                if (w.reader == 0 || w.writer == 0)
+                {
+                    sched_update_fd(sc, fd);
+                }
+            }
+
+            // 4. Échéances tombées : la tâche reprend, son opération
+            //    voit la deadline dépassée et rend "timeout" (ou sleep
+            //    se termine).
+            auto now = Clock::now();
+            while (const SchedDeadline *nd = next_deadline(sc))
+            {
+                if (nd->due > now)
+                {
+                    break;
+                }
+                lua_Integer id = nd->task;
+                std::pop_heap(sc->deadlines.begin(), sc->deadlines.end(),
+                              DeadlineLater());
+                sc->deadlines.pop_back();
+                sched_wake(sc, id);
+            }
+
+            if (sc->runnable.empty() && remaining_ms(deadline) == 0)
+            {
+                return push_fail(L, "timeout");
+            }
+        }
+    }
+
+    void sched_release(Scheduler *sc)
     {
-        return push_fail(L, err);
+        if (sc->epfd >= 0)
+        {
+            ::close(sc->epfd);
+            sc->epfd = -1;
+        }
+        sc->tasks.clear();
+        sc->runnable.clear();
+        sc->fds.clear();
+        sc->deadlines.clear();
     }
 
-    int fd = -1;
-    int last_errno = 0;
-    for (struct addrinfo *ai = res; ai != nullptr; ai = ai->ai_next)
-    {
-        // SOCK_CLOEXEC : voir note dans lua_socket_connect. C'est
-        // CRITIQUE pour un socket d'écoute : sans ça, un Ctrl+C sur
-        // le parent laisserait le port bloqué si un sous-processus
-        // de babet.exec est encore vivant et a hérité du FD.
-        fd = ::socket(ai->ai_family,
-                      ai->ai_socktype | SOCK_CLOEXEC,
-                      ai->ai_protocol);
-        if (fd < 0)
+    // sched:close() -> (true, nil). Idempotent. Abandonne les tâches
+    // suspendues (leurs sockets restent ouverts jusqu'à leur __gc).
+    int sched_close(lua_State *L)
+    {
+        Scheduler *sc = check_sched(L, 1);
+        if (t_sched == sc)
         {
-            last_errno = errno;
-            continue;
+            return luaL_error(L,
+                              "socket: scheduler: close called from one of its own tasks");
         }
-        ensure_cloexec(fd); // belt + suspenders
-        // SO_REUSEADDR : activé en interne, non exposé. Doit être posé
-        // AVANT bind() pour avoir effet.
-        if (!enable_reuseaddr(fd))
+        sched_release(sc);
+        lua_newtable(L);
+        lua_setiuservalue(L, 1, 1); // libère les coroutines
+        return push_ok(L);
+    }
+
+    int sched_gc(lua_State *L)
+    {
+        Scheduler *sc = static_cast<Scheduler *>(luaL_testudata(L, 1, SCHED_META));
+        if (sc)
         {
-            last_errno = errno;
-            ::close(fd);
-            fd = -1;
-            continue;
+            sched_release(sc);
+            sc->~Scheduler();
         }
-        if (::bind(fd, ai->ai_addr, ai->ai_addrlen) != 0)
+        return 0;
+    }
+
+    int sched_tostring(lua_State *L)
+    {
+        Scheduler *sc = check_sched(L, 1);
+        char buf[64];
+        if (sc->epfd < 0)
         {
-            last_errno = errno;
-            ::close(fd);
-            fd = -1;
-            continue;
+            std::snprintf(buf, sizeof(buf), "scheduler (closed)");
         }
-        if (::listen(fd, backlog) != 0)
+        else
         {
-            last_errno = errno;
-            ::close(fd);
-            fd = -1;
-            continue;
+            std::snprintf(buf, sizeof(buf), "scheduler (%zu tasks)",
+                          sc->tasks.size());
         }
-        break;
+        lua_pushstring(L, buf);
+        return 1;
     }
-    ::freeaddrinfo(res);
+} // namespace
 
-    if (fd < 0)
+// babet.socket.scheduler() -> sched | (nil, err)
+int lua_socket_scheduler(lua_State *L)
+{
+    // uservalue 1 = table d'ancrage id -> coroutine (cf. Scheduler).
+    void *raw = lua_newuserdatauv(L, sizeof(Scheduler), 1);
+    Scheduler *sc = new (raw) Scheduler(); // placement new : map, deque
+    luaL_getmetatable(L, SCHED_META);
+    lua_setmetatable(L, -2);
+    lua_newtable(L);
+    lua_setiuservalue(L, -2, 1);
+    sc->evbuf.resize(SCHED_MAX_EVENTS);
+    sc->epfd = ::epoll_create1(EPOLL_CLOEXEC);
+    if (sc->epfd < 0)
     {
-        std::string msg = "socket: listen: ";
-        msg += std::strerror(last_errno);
-        return push_fail(L, msg);
+        return push_errno_fail(L, "scheduler");
     }
-    push_new_sock(L, fd, true);
     return 1;
 }
 
@@ -2420,18 +7362,28 @@ void register_socket(lua_State *L)
 
         lua_pushcfunction(L, sock_send);
         lua_setfield(L, -2, "send");
+        lua_pushcfunction(L, sock_sendfile);
+        lua_setfield(L, -2, "sendfile");
+        lua_pushcfunction(L, sock_sendv);
+        lua_setfield(L, -2, "sendv");
         lua_pushcfunction(L, sock_recv);
         lua_setfield(L, -2, "recv");
         lua_pushcfunction(L, sock_recv_line);
         lua_setfield(L, -2, "recv_line");
+        lua_pushcfunction(L, sock_recv_until);
+        lua_setfield(L, -2, "recv_until");
         lua_pushcfunction(L, sock_recv_all);
         lua_setfield(L, -2, "recv_all");
         lua_pushcfunction(L, sock_accept);
         lua_setfield(L, -2, "accept");
+        lua_pushcfunction(L, sock_accept_tls);
+        lua_setfield(L, -2, "accept_tls");
         lua_pushcfunction(L, sock_close);
         lua_setfield(L, -2, "close");
         lua_pushcfunction(L, sock_set_timeout);
         lua_setfield(L, -2, "set_timeout");
+        lua_pushcfunction(L, sock_setopt);
+        lua_setfield(L, -2, "setopt");
         lua_pushcfunction(L, sock_peer);
         lua_setfield(L, -2, "peer");
         lua_pushcfunction(L, sock_sockname);
@@ -2439,9 +7391,66 @@ void register_socket(lua_State *L)
         // TLS (Chantier 7) : starttls élève un socket TCP en TLS sur place.
         lua_pushcfunction(L, sock_starttls);
         lua_setfield(L, -2, "starttls");
+        lua_pushcfunction(L, sock_tls_info);
+        lua_setfield(L, -2, "tls_info");
+        // Datagrammes (UDP, unix SOCK_DGRAM).
+        lua_pushcfunction(L, sock_sendto);
+        lua_setfield(L, -2, "sendto");
+        lua_pushcfunction(L, sock_recvfrom);
+        lua_setfield(L, -2, "recvfrom");
+        lua_pushcfunction(L, sock_sendmmsg);
+        lua_setfield(L, -2, "sendmmsg");
+        lua_pushcfunction(L, sock_recvmmsg);
+        lua_setfield(L, -2, "recvmmsg");
     }
     lua_pop(L, 1); // dépile la métatable, la table babet redevient au sommet
 
+    if (luaL_newmetatable(L, POLLER_META))
+    {
+        lua_pushvalue(L, -1);
+        lua_setfield(L, -2, "__index");
+        lua_pushcfunction(L, poller_gc);
+        lua_setfield(L, -2, "__gc");
+        lua_pushcfunction(L, poller_tostring);
+        lua_setfield(L, -2, "__tostring");
+
+        lua_pushcfunction(L, poller_add);
+        lua_setfield(L, -2, "add");
+        lua_pushcfunction(L, poller_modify);
+        lua_setfield(L, -2, "modify");
+        lua_pushcfunction(L, poller_remove);
+        lua_setfield(L, -2, "remove");
+        lua_pushcfunction(L, poller_timer);
+        lua_setfield(L, -2, "timer");
+        lua_pushcfunction(L, poller_cancel);
+        lua_setfield(L, -2, "cancel");
+        lua_pushcfunction(L, poller_wait);
+        lua_setfield(L, -2, "wait");
+        lua_pushcfunction(L, poller_close);
+        lua_setfield(L, -2, "close");
+    }
+    lua_pop(L, 1);
+
+    if (luaL_newmetatable(L, SCHED_META))
+    {
+        lua_pushvalue(L, -1);
+        lua_setfield(L, -2, "__index");
+        lua_pushcfunction(L, sched_gc);
+        lua_setfield(L, -2, "__gc");
+        lua_pushcfunction(L, sched_tostring);
+        lua_setfield(L, -2, "__tostring");
+
+        lua_pushcfunction(L, sched_spawn);
+        lua_setfield(L, -2, "spawn");
+        lua_pushcfunction(L, sched_sleep);
+        lua_setfield(L, -2, "sleep");
+        lua_pushcfunction(L, sched_run);
+        lua_setfield(L, -2, "run");
+        lua_pushcfunction(L, sched_close);
+        lua_setfield(L, -2, "close");
+    }
+    lua_pop(L, 1);
+
     // 2. Crée et attache la sous-table babet.socket.
     //    Précondition : table babet au sommet (-1).
     lua_newtable(L);
@@ -2450,10 +7459,34 @@ void register_socket(lua_State *L)
     lua_setfield(L, -2, "connect");
     lua_pushcfunction(L, lua_socket_listen);
     lua_setfield(L, -2, "listen");
+    lua_pushcfunction(L, lua_socket_listen_workers);
+    lua_setfield(L, -2, "listen_workers");
     // TLS (Chantier 7) : connect_tls = variante TLS de connect.
     // Cohérent avec TLS-1 (pas de sous-module séparé).
     lua_pushcfunction(L, lua_socket_connect_tls);
     lua_setfield(L, -2, "connect_tls");
+    lua_pushcfunction(L, lua_socket_listen_tls);
+    lua_setfield(L, -2, "listen_tls");
+    lua_pushcfunction(L, lua_socket_udp);
+    lua_setfield(L, -2, "udp");
+    lua_pushcfunction(L, lua_socket_udp_connect);
+    lua_setfield(L, -2, "udp_connect");
+    lua_pushcfunction(L, lua_socket_unix_connect);
+    lua_setfield(L, -2, "unix_connect");
+    lua_pushcfunction(L, lua_socket_unix_listen);
+    lua_setfield(L, -2, "unix_listen");
+    lua_pushcfunction(L, lua_socket_unix_dgram);
+    lua_setfield(L, -2, "unix_dgram");
+    lua_pushcfunction(L, lua_socket_resolve);
+    lua_setfield(L, -2, "resolve");
+    lua_pushcfunction(L, lua_socket_dns_config);
+    lua_setfield(L, -2, "dns_config");
+    lua_pushcfunction(L, lua_socket_dns_stats);
+    lua_setfield(L, -2, "dns_stats");
+    lua_pushcfunction(L, lua_socket_poller);
+    lua_setfield(L, -2, "poller");
+    lua_pushcfunction(L, lua_socket_scheduler);
+    lua_setfield(L, -2, "scheduler");
 
     lua_setfield(L, -2, "socket");
 }
@@ -9,7 +9,8 @@
  * Décisions actées (toutes observables) :
  *
  *   SOCK-A  Bloquant pur avec timeout (v1). Non-bloquant reporté.
- *   SOCK-B  TCP seul (v1). UDP reporté.
+ *   SOCK-B  TCP seul (v1). UDP et AF_UNIX ajoutés depuis (udp,
+ *           unix_connect, unix_listen, unix_dgram).
  *   SOCK-C  Pas de TLS (v1). Reporté ; OpenSSL déjà lié, ajoutable.
  *   SOCK-D  POSIX direct, zéro dépendance externe.
  *   SOCK-1  Sous-table `babet.socket` (singulier).
@@ -18,8 +19,10 @@
  *   SOCK-3  Userdata avec métatable + __gc -> jamais de fuite de FD
  *           même si le script oublie :close().
  *   SOCK-4  Réception : recv(n) = "au plus n octets", recv_line(),
- *           recv_all(). recv_exact() est trivialement implémentable
- *           par l'utilisateur via boucle, donc non fourni.
+ *           recv_until(delim [, max]), recv_all(). Tous passent par
+ *           un tampon de lecture par socket (16 KiB). recv_exact()
+ *           est trivialement implémentable par l'utilisateur via
+ *           boucle, donc non fourni.
  *   SOCK-5  EOF -> (nil, "closed"). Chaîne typée pour distinguer
  *           EOF / timeout / vraie erreur sans deviner.
  *           recv_line() avec EOF en plein milieu d'une ligne :
@@ -39,14 +42,119 @@
  * Mauvaises VALEURS (port négatif, host vide, etc.) : (nil, err).
  *   -> miroir de http, argparse, toml.
  *
- * Hors v1 (additif plus tard sous SemVer) : UDP, TLS, mode
- * non-bloquant, select/poll multi-sockets, options socket avancées
- * (keepalive, SO_REUSEPORT, etc.).
+ * Hors v1, ajouté depuis : SO_REUSEPORT via listen(host, port,
+ * { reuseport = true }), options usuelles via s:setopt{ nodelay,
+ * cork, keepalive, sndbuf, rcvbuf }, TLS, UDP / AF_UNIX, le
+ * multiplexage (poller) et les tâches non-bloquantes (scheduler).
  */
 
 int lua_socket_connect(lua_State *L);
 int lua_socket_listen(lua_State *L);
 
+/**
+ * @brief babet.socket.listen_tls(host, port, opts) -> socket | (nil, err)
+ *
+ * listen avec un context TLS serveur (opts.cert, opts.key, opts.alpn
+ * optionnel, opts.timeout = délai du handshake) ; s:accept_tls()
+ * rend des sockets clients déjà en TLS. Le context est partagé par
+ * les listen_tls de même configuration (sessions et tickets
+ * reprenables d'un worker à l'autre).
+ */
+int lua_socket_listen_tls(lua_State *L);
+
+/**
+ * @brief babet.socket.listen_workers(host, port, code [, args [, opts]])
+ *        -> { worker, ... } | (nil, err)
+ *
+ * Lance opts.workers workers (défaut : workers.cpu_count()), chacun
+ * avec son propre socket d'écoute SO_REUSEPORT sur host:port, exposé
+ * en worker.listener (et son rang en worker.shard). Le noyau
+ * répartit les connexions entre les threads. Les autres champs de
+ * opts vont à workers.spawn ; opts.backlog (défaut SOMAXCONN) à
+ * chaque listen.
+ */
+int lua_socket_listen_workers(lua_State *L);
+
+/**
+ * @brief Résolution de noms : cache DNS du processus.
+ *
+ *   babet.socket.resolve(host [, timeout]) -> { addr, ... } | (nil, err)
+ *   babet.socket.dns_config{ ttl =, negative_ttl =, hosts =, flush = }
+ *   babet.socket.dns_stats() -> { hits, misses, entries, pending, threads }
+ *
+ * connect, connect_tls, udp_connect et sendto passent par le même
+ * cache ; les requêtes manquantes tournent sur un petit pool de
+ * threads (getaddrinfo), l'appelant attend avec sa deadline. Le
+ * timeout de connect couvre donc résolution + connexion.
+ */
+int lua_socket_resolve(lua_State *L);
+int lua_socket_dns_config(lua_State *L);
+int lua_socket_dns_stats(lua_State *L);
+
+/**
+ * @brief Datagrammes et sockets locaux :
+ *
+ *   babet.socket.udp([host, port [, opts]])   non lié (double pile) ou lié
+ *   babet.socket.udp_connect(host, port)      pair fixé : send / recv
+ *   babet.socket.unix_connect(path [, timeout])
+ *   babet.socket.unix_listen(path [, backlog | opts])
+ *   babet.socket.unix_dgram([path])
+ *
+ * path "@nom" = espace de noms abstrait Linux. Méthodes datagramme :
+ *
+ *   s:sendto(data, host, port | path) -> bytes
+ *   s:recvfrom([n]) -> data, host, port | data, path
+ *   s:sendmmsg(msgs) -> count       (un syscall pour N datagrammes)
+ *   s:recvmmsg([max [, size]]) -> { {data=, host=, port= | path=
+ *                                     [, truncated=true]}, ... }
+ *
+ * Mêmes timeouts, mêmes erreurs typées et même suspension en tâche
+ * (scheduler) que les méthodes de flux.
+ */
+int lua_socket_udp(lua_State *L);
+int lua_socket_udp_connect(lua_State *L);
+int lua_socket_unix_connect(lua_State *L);
+int lua_socket_unix_listen(lua_State *L);
+int lua_socket_unix_dgram(lua_State *L);
+
+/**
+ * @brief babet.socket.poller([max_events]) -> poller | (nil, err)
+ *
+ * Multiplexeur epoll (level-triggered) pour servir beaucoup de
+ * connexions depuis un seul thread Lua :
+ *
+ *   p:add(target [, "r"|"w"|"rw"])  target = socket (brut ou TLS),
+ *                                    watcher inotify ou fd entier
+ *   p:modify(target, events) / p:remove(target)
+ *   p:timer(seconds [, repeat]) -> id   /   p:cancel(id)
+ *   p:wait([timeout]) -> { {obj=, readable=, writable=
+ *                           [, hangup=] [, error=]} | {timer=id}, ... }
+ *                      | (nil, "timeout") | (nil, "interrupted")
+ *   p:close()
+ *
+ * Un socket dont le tampon de lecture (ou celui d'OpenSSL) contient
+ * déjà des octets est rendu readable sans attendre le noyau.
+ */
+int lua_socket_poller(lua_State *L);
+
+/**
+ * @brief babet.socket.scheduler() -> sched | (nil, err)
+ *
+ * Tâches coopératives au-dessus d'epoll :
+ *
+ *   sched:spawn(fn, ...) -> id
+ *   sched:sleep(seconds)            depuis une tâche uniquement
+ *   sched:run([timeout]) -> (true, nil) | (nil, "timeout")
+ *                         | (nil, "interrupted") | (nil, "... task N failed: ...")
+ *   sched:close()
+ *
+ * Dans une tâche, recv / recv_line / recv_until / recv_all / send /
+ * sendfile / accept / accept_tls (et les méthodes datagramme) suspendent la coroutine (lua_yieldk) au lieu de bloquer,
+ * avec la même deadline par appel que le mode bloquant. Hors
+ * tâche, comportement inchangé.
+ */
+int lua_socket_scheduler(lua_State *L);
+
 /**
  * @brief Construit la sous-table `socket` et l'attache à babet.
  *
@@ -3,21 +3,33 @@
 #include "../project_core/bundled_modules.hpp"
 #include "../project_core/embedded_searcher.hpp"
 
+#include <linux/futex.h>
 #include <pthread.h>
+#include <sched.h>
 #include <signal.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 #include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
 #include <cmath>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <ctime>
 #include <deque>
+#include <memory>
 #include <mutex>
+#include <new>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <utility>
-
-#include <nlohmann/json.hpp>
+#include <vector>
 
 // Forward déclaration de register_babet, défini dans main.cpp.
 // Pas d'extern "C" : fonction C++ standard, le linker la résout par
@@ -27,17 +39,120 @@ void register_babet(lua_State *L);
 namespace
 {
 
-    using nlohmann::json;
-
     // Forward declarations (définitions plus bas dans le namespace).
     int64_t parse_timeout_arg(lua_State *L, int idx);
 
+    // =====================================================================
+    // Buffers d'octets partagés (babet.workers.buffer)
+    // =====================================================================
+    //
+    // Un gros contenu (fichier, corps HTTP) envoyé à N workers était
+    // copié à chaque saut par la sérialisation. Un buffer partagé est un
+    // bloc d'octets alloué une fois côté C++ et référencé (shared_ptr)
+    // par autant de userdata que nécessaire, dans autant de lua_State
+    // que nécessaire : l'envoyer à un worker ne transporte qu'une
+    // référence, jamais les octets.
+    //
+    // Concurrence : un buffer est modifiable (buf:write) tant qu'il
+    // n'est pas gelé. Le gel est définitif, et automatique dès qu'un
+    // buffer traverse une frontière de thread (send, spawn, submit,
+    // résultat) : les lecteurs des autres threads ne voient donc jamais
+    // d'écriture concurrente.
+    struct SharedBytes
+    {
+        std::unique_ptr<char[]> data;
+        size_t size;
+        std::atomic<bool> frozen;
+
+        SharedBytes(std::unique_ptr<char[]> d, size_t n)
+            : data(std::move(d)), size(n), frozen(false) {}
+    };
+
+    using SharedBytesPtr = std::shared_ptr<SharedBytes>;
+
+    // Ce que porte un userdata buffer : une vue [offset, offset + len)
+    // sur un bloc partagé. buf:slice() crée une nouvelle vue sur le même
+    // bloc, sans copie.
+    struct BufferView
+    {
+        SharedBytesPtr bytes;
+        size_t offset;
+        size_t len;
+    };
+
+    constexpr const char *BUFFER_META = "LuapilotWorkerBuffer";
+    constexpr const char *CHANNEL_META = "LuapilotWorkerChannel";
+    constexpr const char *SHARED_META = "LuapilotWorkerShared";
+
+    // Channel : défini plus bas (après MessageQueue, qu'il enveloppe).
+    struct Channel;
+    using ChannelPtr = std::shared_ptr<Channel>;
+
+    // Snapshot de workers.share : défini plus bas. Immuable une fois
+    // construit, d'où le const.
+    struct Snapshot;
+    using SnapshotPtr = std::shared_ptr<const Snapshot>;
+    size_t snap_table_count(const Snapshot &s);
+
+    // Ce que porte un userdata de table partagée : le snapshot et la
+    // (sous-)table qu'il désigne.
+    struct SharedRef
+    {
+        SnapshotPtr snap;
+        uint64_t table;
+    };
+
+    // Un message sérialisé : les octets (cf. serialize_value) plus les
+    // objets partagés qu'il référence. Buffers, channels et tables
+    // partagées sont encodés comme un index dans `refs` / `channels` /
+    // `snaps` : tant que le message
+    // existe (en file, en args, en résultat), ces objets restent
+    // vivants, même si plus aucun userdata ne les référence.
+    struct Message
+    {
+        std::string data;
+        std::vector<SharedBytesPtr> refs;
+        std::vector<ChannelPtr> channels;
+        std::vector<SnapshotPtr> snaps;
+    };
+
+    // Attente multi-queues de babet.workers.select : un waiter est
+    // inscrit dans chaque queue surveillée, et réveillé par toute
+    // insertion ou fermeture sur l'une d'elles.
+    struct SelectWaiter
+    {
+        pthread_mutex_t mu;
+        pthread_cond_t cv;
+        bool signaled;
+
+        SelectWaiter() : signaled(false)
+        {
+            pthread_mutex_init(&mu, nullptr);
+            pthread_cond_init(&cv, nullptr);
+        }
+        ~SelectWaiter()
+        {
+            pthread_cond_destroy(&cv);
+            pthread_mutex_destroy(&mu);
+        }
+        SelectWaiter(const SelectWaiter &) = delete;
+        SelectWaiter &operator=(const SelectWaiter &) = delete;
+
+        void notify()
+        {
+            pthread_mutex_lock(&mu);
+            signaled = true;
+            pthread_cond_signal(&cv);
+            pthread_mutex_unlock(&mu);
+        }
+    };
+
     // =====================================================================
     // MessageQueue — primitive de queue thread-safe bornée (Chantier 9-1)
     // =====================================================================
     //
-    // Queue FIFO bornée pour transporter des messages sérialisés (strings
-    // JSON) entre threads. Utilise pthread directement pour cohérence avec
+    // Queue FIFO bornée pour transporter des messages sérialisés (buffers
+    // binaires, cf. serialize_value) entre threads. Utilise pthread directement pour cohérence avec
     // le reste du module workers.
     //
     // Sémantique :
@@ -71,7 +186,7 @@ namespace
     // si la condition d'arrêt s'est imposée pendant qu'il patientait.
     struct MessageQueue
     {
-        std::deque<std::string> q;
+        std::deque<Message> q;
         size_t capacity;
         bool closed;
         pthread_mutex_t mu;
@@ -79,8 +194,44 @@ namespace
         pthread_cond_t not_empty;
         bool initialized;
 
+        // Waiters de select() inscrits sur cette queue (protégé par mu).
+        // Seuls les channels peuvent être surveillés par select() (les
+        // inbox/outbox des workers sont des SpscRing).
+        std::vector<SelectWaiter *> watchers;
+
         MessageQueue() : capacity(0), closed(false), initialized(false) {}
 
+        void add_watcher(SelectWaiter *w)
+        {
+            pthread_mutex_lock(&mu);
+            watchers.push_back(w);
+            pthread_mutex_unlock(&mu);
+        }
+
+        void remove_watcher(SelectWaiter *w)
+        {
+            pthread_mutex_lock(&mu);
+            for (size_t i = 0; i < watchers.size(); ++i)
+            {
+                if (watchers[i] == w)
+                {
+                    watchers[i] = watchers.back();
+                    watchers.pop_back();
+                    break;
+                }
+            }
+            pthread_mutex_unlock(&mu);
+        }
+
+        // À appeler sous mu. L'ordre de verrouillage est toujours
+        // queue.mu puis waiter.mu (select ne prend jamais de mu de
+        // queue en tenant celui du waiter) : pas d'interblocage.
+        void notify_watchers()
+        {
+            for (SelectWaiter *w : watchers)
+                w->notify();
+        }
+
         // Initialisation explicite (pas dans le ctor pour pouvoir gérer
         // l'échec d'allocation des primitives pthread sans exception).
         // Retourne true si OK, false sinon.
@@ -131,7 +282,7 @@ namespace
         }
 
         // push : insère un message. Retourne (true, "") ou (false, reason).
-        std::pair<bool, const char *> push(std::string msg, int64_t timeout_ms)
+        std::pair<bool, const char *> push(Message msg, int64_t timeout_ms)
         {
             pthread_mutex_lock(&mu);
             if (closed)
@@ -192,13 +343,14 @@ namespace
             // Insertion.
             q.push_back(std::move(msg));
             pthread_cond_signal(&not_empty);
+            notify_watchers();
             pthread_mutex_unlock(&mu);
             return {true, ""};
         }
 
         // pop : extrait un message dans out_msg. Retourne (true, "") ou
         // (false, reason). out_msg n'est modifié que si succès.
-        std::pair<bool, const char *> pop(std::string &out_msg, int64_t timeout_ms)
+        std::pair<bool, const char *> pop(Message &out_msg, int64_t timeout_ms)
         {
             pthread_mutex_lock(&mu);
 
@@ -276,13 +428,607 @@ namespace
             closed = true;
             pthread_cond_broadcast(&not_full);
             pthread_cond_broadcast(&not_empty);
+            notify_watchers();
             pthread_mutex_unlock(&mu);
         }
     };
 
-    // État porté par l'userdata Lua. La thread worker écrit result_json
+    uint64_t monotonic_ns()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL +
+               static_cast<uint64_t>(ts.tv_nsec);
+    }
+
+    // Attente futex sur un mot 32 bits : dort tant que *addr == expected,
+    // au plus timeout_ns (< 0 = indéfiniment). Les réveils parasites et
+    // EAGAIN sont normaux : l'appelant re-vérifie toujours sa condition.
+    void futex_wait(std::atomic<uint32_t> *addr, uint32_t expected,
+                    int64_t timeout_ns)
+    {
+        struct timespec ts;
+        struct timespec *pts = nullptr;
+        if (timeout_ns >= 0)
+        {
+            ts.tv_sec = static_cast<time_t>(timeout_ns / 1000000000LL);
+            ts.tv_nsec = static_cast<long>(timeout_ns % 1000000000LL);
+            pts = &ts;
+        }
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr),
+                FUTEX_WAIT_PRIVATE, expected, pts, nullptr, 0);
+    }
+
+    void futex_wake(std::atomic<uint32_t> *addr, int count)
+    {
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr),
+                FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+    }
+
+    // =====================================================================
+    // Anneau SPSC des liens parent <-> worker (inbox / outbox)
+    // =====================================================================
+    //
+    // Un lien parent <-> worker n'a jamais qu'UN producteur et UN
+    // consommateur : l'userdata Worker n'existe que dans le lua_State
+    // parent (il n'est pas sérialisable) et `worker.send/recv` que dans
+    // le lua_State du worker. MessageQueue (mutex + condvar + horloge
+    // à chaque appel) est donc surdimensionnée pour ce cas : un worker
+    // qui émet un million de petits records par seconde passait plus
+    // de temps dans pthread que dans Lua.
+    //
+    // L'anneau est un tableau de slots Message indexé par deux compteurs
+    // 64 bits monotones : `tail` (écrit par le producteur seul) et `head`
+    // (écrit par le consommateur seul). Le chemin rapide n'est fait que
+    // de load/store atomiques, sans verrou ni appel système.
+    //
+    // Blocage : seulement quand l'anneau est vide (consommateur) ou plein
+    // (producteur). Le bloqué lève son drapeau `*_waiting`, re-vérifie,
+    // puis dort sur un futex (`data_seq` / `space_seq`). L'autre côté ne
+    // fait l'appel système FUTEX_WAKE que si le drapeau est levé. La
+    // barrière seq_cst de chaque côté (drapeau puis index, index puis
+    // drapeau) garantit qu'au moins l'un des deux voit l'autre : pas de
+    // réveil perdu. Les deadlines sont en CLOCK_MONOTONIC et l'horloge
+    // n'est lue que si l'on doit effectivement dormir.
+    //
+    // Même contrat que MessageQueue : push/pop rendent (true, "") ou
+    // (false, reason) avec reason ∈ {"full"|"empty", "timeout",
+    // "closed"} ; close() est idempotente, appelable depuis n'importe
+    // quel thread, et les messages déjà en file restent lisibles.
+    struct SpscRing
+    {
+        // Compteurs sur des lignes de cache distinctes : le producteur
+        // écrit tail, le consommateur écrit head, sans faux partage.
+        alignas(64) std::atomic<uint64_t> tail{0};
+        alignas(64) std::atomic<uint64_t> head{0};
+
+        alignas(64) std::atomic<uint32_t> data_seq{0};
+        std::atomic<uint32_t> consumer_waiting{0};
+        alignas(64) std::atomic<uint32_t> space_seq{0};
+        std::atomic<uint32_t> producer_waiting{0};
+
+        std::atomic<bool> closed{false};
+
+        std::unique_ptr<Message[]> slots;
+        size_t capacity = 0; // borne visible (inbox_capacity)
+        uint64_t mask = 0;   // taille physique - 1 (puissance de 2)
+
+        // Même contrat que MessageQueue::init : false si l'allocation
+        // échoue, sans exception.
+        bool init(size_t cap)
+        {
+            size_t n = 1;
+            while (n < cap)
+                n <<= 1;
+            slots.reset(new (std::nothrow) Message[n]);
+            if (!slots)
+                return false;
+            capacity = cap;
+            mask = n - 1;
+            return true;
+        }
+
+        // Libère les messages restants (et donc les références buffers /
+        // channels qu'ils portent). À appeler une fois les deux threads
+        // sortis de l'anneau.
+        void destroy() { slots.reset(); }
+
+        size_t size() const
+        {
+            return static_cast<size_t>(
+                tail.load(std::memory_order_acquire) -
+                head.load(std::memory_order_acquire));
+        }
+
+        void close()
+        {
+            closed.store(true, std::memory_order_seq_cst);
+            data_seq.fetch_add(1, std::memory_order_seq_cst);
+            space_seq.fetch_add(1, std::memory_order_seq_cst);
+            futex_wake(&data_seq, INT_MAX);
+            futex_wake(&space_seq, INT_MAX);
+        }
+
+        // Côté producteur : attend qu'au moins une place se libère.
+        // deadline_ns : 0 = pas d'attente, UINT64_MAX = indéfiniment,
+        // sinon instant absolu CLOCK_MONOTONIC. Retourne nullptr si une
+        // place est libre, sinon la reason.
+        const char *wait_space(uint64_t deadline_ns)
+        {
+            for (;;)
+            {
+                if (closed.load(std::memory_order_acquire))
+                    return "closed";
+                uint64_t t = tail.load(std::memory_order_relaxed);
+                if (t - head.load(std::memory_order_acquire) < capacity)
+                    return nullptr;
+                if (deadline_ns == 0)
+                    return "full";
+
+                uint32_t seq = space_seq.load(std::memory_order_acquire);
+                producer_waiting.store(1, std::memory_order_seq_cst);
+                if (t - head.load(std::memory_order_seq_cst) < capacity ||
+                    closed.load(std::memory_order_seq_cst))
+                {
+                    producer_waiting.store(0, std::memory_order_relaxed);
+                    continue;
+                }
+                int64_t left = -1;
+                if (deadline_ns != UINT64_MAX)
+                {
+                    uint64_t now = monotonic_ns();
+                    if (now >= deadline_ns)
+                    {
+                        producer_waiting.store(0, std::memory_order_relaxed);
+                        return "timeout";
+                    }
+                    left = static_cast<int64_t>(deadline_ns - now);
+                }
+                futex_wait(&space_seq, seq, left);
+                producer_waiting.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        // Côté consommateur : attend qu'au moins un message soit là.
+        // Un anneau fermé mais non vide se vide d'abord.
+        const char *wait_data(uint64_t deadline_ns)
+        {
+            for (;;)
+            {
+                uint64_t h = head.load(std::memory_order_relaxed);
+                if (tail.load(std::memory_order_acquire) != h)
+                    return nullptr;
+                if (closed.load(std::memory_order_acquire))
+                {
+                    // Un push a pu se glisser avant le close.
+                    if (tail.load(std::memory_order_acquire) != h)
+                        return nullptr;
+                    return "closed";
+                }
+                if (deadline_ns == 0)
+                    return "empty";
+
+                uint32_t seq = data_seq.load(std::memory_order_acquire);
+                consumer_waiting.store(1, std::memory_order_seq_cst);
+                if (tail.load(std::memory_order_seq_cst) != h ||
+                    closed.load(std::memory_order_seq_cst))
+                {
+                    consumer_waiting.store(0, std::memory_order_relaxed);
+                    continue;
+                }
+                int64_t left = -1;
+                if (deadline_ns != UINT64_MAX)
+                {
+                    uint64_t now = monotonic_ns();
+                    if (now >= deadline_ns)
+                    {
+                        consumer_waiting.store(0, std::memory_order_relaxed);
+                        return "timeout";
+                    }
+                    left = static_cast<int64_t>(deadline_ns - now);
+                }
+                futex_wait(&data_seq, seq, left);
+                consumer_waiting.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        // Publie les slots écrits jusqu'à new_tail et réveille le
+        // consommateur s'il dort. Une seule barrière par lot.
+        void publish(uint64_t new_tail)
+        {
+            tail.store(new_tail, std::memory_order_release);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (consumer_waiting.load(std::memory_order_relaxed))
+            {
+                data_seq.fetch_add(1, std::memory_order_release);
+                futex_wake(&data_seq, 1);
+            }
+        }
+
+        void release(uint64_t new_head)
+        {
+            head.store(new_head, std::memory_order_release);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (producer_waiting.load(std::memory_order_relaxed))
+            {
+                space_seq.fetch_add(1, std::memory_order_release);
+                futex_wake(&space_seq, 1);
+            }
+        }
+
+        static uint64_t deadline_from_ms(int64_t timeout_ms)
+        {
+            if (timeout_ms < 0)
+                return UINT64_MAX;
+            if (timeout_ms == 0)
+                return 0;
+            return monotonic_ns() +
+                   static_cast<uint64_t>(timeout_ms) * 1000000ULL;
+        }
+
+        // push : insère msg. La deadline n'est calculée que si l'anneau
+        // est plein (le chemin rapide ne lit pas l'horloge).
+        std::pair<bool, const char *> push(Message msg, int64_t timeout_ms)
+        {
+            size_t sent = 0;
+            const char *reason = push_many(&msg, 1, timeout_ms, sent);
+            if (reason)
+                return {false, reason};
+            return {true, ""};
+        }
+
+        // push_many : insère msgs[0..n) dans l'ordre, en une publication
+        // par série de places libres. Bloque (selon timeout_ms, deadline
+        // commune à tout le lot) quand l'anneau est plein. Retourne
+        // nullptr si tout est passé, sinon la reason ; `sent` compte les
+        // messages effectivement insérés dans les deux cas.
+        const char *push_many(Message *msgs, size_t n, int64_t timeout_ms,
+                              size_t &sent)
+        {
+            sent = 0;
+            uint64_t deadline = 0;
+            bool have_deadline = false;
+            while (sent < n)
+            {
+                if (closed.load(std::memory_order_acquire))
+                    return "closed";
+                uint64_t t = tail.load(std::memory_order_relaxed);
+                uint64_t room =
+                    capacity - (t - head.load(std::memory_order_acquire));
+                if (room == 0)
+                {
+                    if (!have_deadline)
+                    {
+                        deadline = deadline_from_ms(timeout_ms);
+                        have_deadline = true;
+                    }
+                    const char *reason = wait_space(deadline);
+                    if (reason)
+                        return reason;
+                    continue;
+                }
+                size_t k = n - sent;
+                if (k > room)
+                    k = static_cast<size_t>(room);
+                for (size_t i = 0; i < k; ++i)
+                    slots[(t + i) & mask] = std::move(msgs[sent + i]);
+                publish(t + k);
+                sent += k;
+            }
+            return nullptr;
+        }
+
+        // Attente côté consommateur avec deadline paresseuse : l'horloge
+        // n'est lue que si l'anneau est vide et qu'on doit dormir.
+        const char *await_data(int64_t timeout_ms)
+        {
+            const char *reason = wait_data(0);
+            if (reason && timeout_ms != 0 && std::strcmp(reason, "empty") == 0)
+                reason = wait_data(deadline_from_ms(timeout_ms));
+            return reason;
+        }
+
+        std::pair<bool, const char *> pop(Message &out_msg,
+                                          int64_t timeout_ms)
+        {
+            const char *reason = await_data(timeout_ms);
+            if (reason)
+                return {false, reason};
+            uint64_t h = head.load(std::memory_order_relaxed);
+            out_msg = std::move(slots[h & mask]);
+            slots[h & mask] = Message();
+            release(h + 1);
+            return {true, ""};
+        }
+
+        // pop_many : attend (selon timeout_ms) au moins un message, puis
+        // prend sans attendre tout ce qui est disponible, au plus max.
+        // Une seule libération de places pour le lot.
+        const char *pop_many(std::vector<Message> &out, size_t max,
+                             int64_t timeout_ms)
+        {
+            const char *reason = await_data(timeout_ms);
+            if (reason)
+                return reason;
+            uint64_t h = head.load(std::memory_order_relaxed);
+            uint64_t avail = tail.load(std::memory_order_acquire) - h;
+            size_t k = avail < max ? static_cast<size_t>(avail) : max;
+            out.reserve(out.size() + k);
+            for (size_t i = 0; i < k; ++i)
+            {
+                out.push_back(std::move(slots[(h + i) & mask]));
+                slots[(h + i) & mask] = Message();
+            }
+            release(h + k);
+            return nullptr;
+        }
+    };
+
+    // Channel autonome (babet.workers.channel) : une MessageQueue qui
+    // n'appartient à aucun Worker. Partagée par shared_ptr entre tous
+    // les userdata qui la référencent (un par lua_State qui l'a reçue)
+    // et les messages en transit : multi-producteurs, multi-
+    // consommateurs, sans relais par le thread parent.
+    //
+    // Attention : un channel envoyé dans lui-même (directement ou via
+    // un autre channel) se maintient en vie tant que le message n'est
+    // pas consommé — c'est un cycle de références, comme en Go.
+    struct Channel
+    {
+        MessageQueue q;
+
+        ~Channel() { q.destroy(); }
+    };
+
+    // =================================================================
+    // Placement des threads : CPU, priorité, pile (opts de spawn/pool)
+    // =================================================================
+    //
+    // Dans un conteneur limité à 4 CPU sur un hôte à 64 coeurs, le
+    // nombre de CPU "en ligne" ment : un pool dimensionné dessus se
+    // retrouve à 16 threads par CPU réellement disponible. cpu_count()
+    // tient compte du masque d'affinité du process et du quota cgroup
+    // v2 (cpu.max) ; les opts cpu= / nice= / stack_size= permettent
+    // d'épingler et de déprioriser les threads de calcul.
+    //
+    //   cpu        = n | { n1, n2, ... }  CPU autorisés (affinité)
+    //   nice       = -20..19              niceness du thread (Linux :
+    //                                     par thread, via setpriority
+    //                                     sur le tid)
+    //   stack_size = octets               pile du thread (>= 64 KiB)
+    //
+    // Affinité et pile passent par les attributs pthread au moment du
+    // pthread_create ; la niceness n'a pas d'attribut pthread pour
+    // SCHED_OTHER et est appliquée par le thread lui-même, en tout
+    // début de worker_thread_main / pool_thread_main. Un échec (nice
+    // négatif sans CAP_SYS_NICE) fait échouer le worker / le pool avec
+    // un message explicite plutôt que de tourner à une priorité non
+    // demandée.
+
+    constexpr size_t MIN_STACK_SIZE = 64 * 1024;
+    constexpr size_t MAX_STACK_SIZE = size_t(1) << 30;
+
+    struct ThreadOpts
+    {
+        bool has_cpus = false;
+        cpu_set_t cpus;
+        bool has_nice = false;
+        int nice = 0;
+        size_t stack_size = 0; // 0 = défaut de la libc
+    };
+
+    void add_cpu_opt(lua_State *L, int idx, const char *fname, ThreadOpts &o)
+    {
+        int isnum = 0;
+        lua_Integer c = lua_tointegerx(L, idx, &isnum);
+        if (!isnum || c < 0 || c >= CPU_SETSIZE)
+        {
+            luaL_error(L, "%s: opts.cpu must be a CPU index in 0..%d "
+                          "or a list of them",
+                       fname, CPU_SETSIZE - 1);
+        }
+        CPU_SET(static_cast<int>(c), &o.cpus);
+    }
+
+    // Lit cpu / nice / stack_size dans la table opts à `idx` (absolu).
+    // Lève luaL_error sur une valeur invalide : à appeler avant toute
+    // allocation C++.
+    void parse_thread_opts(lua_State *L, int idx, const char *fname,
+                           ThreadOpts &o)
+    {
+        lua_getfield(L, idx, "cpu");
+        if (!lua_isnil(L, -1))
+        {
+            CPU_ZERO(&o.cpus);
+            o.has_cpus = true;
+            if (lua_istable(L, -1))
+            {
+                lua_Integer n = static_cast<lua_Integer>(lua_rawlen(L, -1));
+                if (n == 0)
+                    luaL_error(L, "%s: opts.cpu list is empty", fname);
+                for (lua_Integer i = 1; i <= n; ++i)
+                {
+                    lua_rawgeti(L, -1, i);
+                    add_cpu_opt(L, -1, fname, o);
+                    lua_pop(L, 1);
+                }
+            }
+            else
+            {
+                add_cpu_opt(L, -1, fname, o);
+            }
+        }
+        lua_pop(L, 1);
+
+        lua_getfield(L, idx, "nice");
+        if (!lua_isnil(L, -1))
+        {
+            int isnum = 0;
+            lua_Integer n = lua_tointegerx(L, -1, &isnum);
+            if (!isnum || n < -20 || n > 19)
+                luaL_error(L, "%s: opts.nice must be an integer in -20..19",
+                           fname);
+            o.has_nice = true;
+            o.nice = static_cast<int>(n);
+        }
+        lua_pop(L, 1);
+
+        lua_getfield(L, idx, "stack_size");
+        if (!lua_isnil(L, -1))
+        {
+            int isnum = 0;
+            lua_Integer n = lua_tointegerx(L, -1, &isnum);
+            if (!isnum || n < static_cast<lua_Integer>(MIN_STACK_SIZE) ||
+                n > static_cast<lua_Integer>(MAX_STACK_SIZE))
+                luaL_error(L, "%s: opts.stack_size must be an integer in "
+                              "%I..%I (bytes)",
+                           fname, static_cast<lua_Integer>(MIN_STACK_SIZE),
+                           static_cast<lua_Integer>(MAX_STACK_SIZE));
+            // Arrondi à la page : pthread_attr_setstacksize peut refuser
+            // une taille non alignée.
+            size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            size_t sz = static_cast<size_t>(n);
+            o.stack_size = (sz + page - 1) / page * page;
+        }
+        lua_pop(L, 1);
+    }
+
+    // Prépare les attributs pthread (pile, affinité). L'appelant fait
+    // pthread_attr_destroy après pthread_create, même en cas d'échec
+    // de ce dernier. Rend un code errno (0 = OK).
+    int init_thread_attr(const ThreadOpts &o, pthread_attr_t &attr)
+    {
+        int rc = pthread_attr_init(&attr);
+        if (rc != 0)
+            return rc;
+        if (o.stack_size)
+            rc = pthread_attr_setstacksize(&attr, o.stack_size);
+        if (rc == 0 && o.has_cpus)
+            rc = pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &o.cpus);
+        if (rc != 0)
+            pthread_attr_destroy(&attr);
+        return rc;
+    }
+
+    // Crée un thread avec les opts. Même contrat que pthread_create.
+    int create_thread(pthread_t *tid, const ThreadOpts &o,
+                      void *(*fn)(void *), void *arg)
+    {
+        pthread_attr_t attr;
+        int rc = init_thread_attr(o, attr);
+        if (rc != 0)
+            return rc;
+        rc = pthread_create(tid, &attr, fn, arg);
+        pthread_attr_destroy(&attr);
+        return rc;
+    }
+
+    // À appeler DANS le thread créé. false + err si la niceness
+    // demandée ne peut pas être appliquée.
+    bool apply_thread_nice(const ThreadOpts &o, std::string &err)
+    {
+        if (!o.has_nice)
+            return true;
+        pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+        if (setpriority(PRIO_PROCESS, static_cast<id_t>(tid), o.nice) != 0)
+        {
+            err = "workers: cannot set nice=" + std::to_string(o.nice) +
+                  ": " + std::strerror(errno);
+            return false;
+        }
+        return true;
+    }
+
+    // Quota cgroup v2 du process, en CPU (arrondi au supérieur), ou 0
+    // si aucun quota. Le quota effectif est le plus petit de ceux de la
+    // cgroup et de ses ancêtres : on remonte jusqu'à la racine.
+    lua_Integer cgroup_cpu_quota()
+    {
+        FILE *f = std::fopen("/proc/self/cgroup", "r");
+        if (!f)
+            return 0;
+        char line[4096];
+        std::string path;
+        while (std::fgets(line, sizeof(line), f))
+        {
+            // Ligne unifiée (v2) : "0::/chemin"
+            if (std::strncmp(line, "0::", 3) == 0)
+            {
+                path = line + 3;
+                while (!path.empty() &&
+                       (path.back() == '\n' || path.back() == '\r'))
+                    path.pop_back();
+                break;
+            }
+        }
+        std::fclose(f);
+        if (path.empty() || path[0] != '/')
+            return 0;
+
+        lua_Integer best = 0;
+        for (;;)
+        {
+            std::string file = "/sys/fs/cgroup" +
+                               (path == "/" ? std::string() : path) +
+                               "/cpu.max";
+            FILE *m = std::fopen(file.c_str(), "r");
+            if (m)
+            {
+                char quota[32] = {0};
+                unsigned long long period = 0;
+                // "max 100000" (pas de limite) ou "400000 100000".
+                if (std::fscanf(m, "%31s %llu", quota, &period) == 2 &&
+                    std::strcmp(quota, "max") != 0 && period > 0)
+                {
+                    unsigned long long q = std::strtoull(quota, nullptr, 10);
+                    lua_Integer cpus = static_cast<lua_Integer>(
+                        (q + period - 1) / period);
+                    if (cpus < 1)
+                        cpus = 1;
+                    if (best == 0 || cpus < best)
+                        best = cpus;
+                }
+                std::fclose(m);
+            }
+            if (path == "/")
+                break;
+            size_t slash = path.find_last_of('/');
+            path = (slash == 0) ? "/" : path.substr(0, slash);
+        }
+        return best;
+    }
+
+    // CPU réellement utilisables : masque d'affinité du thread appelant
+    // (hérité du process : taskset, cpuset du conteneur), borné par le
+    // quota cgroup v2. Toujours >= 1.
+    lua_Integer cpu_count()
+    {
+        lua_Integer n = 0;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0)
+            n = CPU_COUNT(&set);
+        if (n <= 0)
+        {
+            long online = sysconf(_SC_NPROCESSORS_ONLN);
+            n = online > 0 ? static_cast<lua_Integer>(online) : 1;
+        }
+        lua_Integer quota = cgroup_cpu_quota();
+        if (quota > 0 && quota < n)
+            n = quota;
+        return n;
+    }
+
+    // workers.cpu_count() -> integer
+    int lua_workers_cpu_count(lua_State *L)
+    {
+        lua_pushinteger(L, cpu_count());
+        return 1;
+    }
+
+    // État porté par l'userdata Lua. La thread worker écrit result_buf
     // ou err_msg PUIS publie status atomiquement ; le parent lit status
-    // atomiquement puis result_json / err_msg sous garantie de visibilité
+    // atomiquement puis result_buf / err_msg sous garantie de visibilité
     // via la release/acquire de l'atomic.
     struct Worker
     {
@@ -291,7 +1037,7 @@ namespace
 
         // Statut atomique :
         //   0 = running
-        //   1 = done (succès, result_json prêt)
+        //   1 = done (succès, result_buf prêt)
         //   2 = error (échec, err_msg prêt)
         std::atomic<int> status;
 
@@ -301,21 +1047,33 @@ namespace
         std::atomic<bool> joined;
 
         // Sérialisé en sortie de la thread, lu par join()/poll().
-        std::string result_json;
+        Message result_buf;
         std::string err_msg;
 
         // Lecture seule pour la thread après spawn. Mémoire stable
         // pendant toute la durée de vie de la thread.
         std::string code;
-        std::string args_json;
+        Message args_buf;
 
         // Chantier 9-2 : queues bidirectionnelles parent <-> worker.
         // inbox : parent push, worker pop (en 9-3).
         // outbox : worker push (en 9-3), parent pop.
         // Initialisées au spawn(), fermées au __gc avant pthread_join
         // pour que les recv() côté worker se débloquent proprement.
-        MessageQueue inbox;
-        MessageQueue outbox;
+        // Anneaux SPSC : un seul producteur et un seul consommateur
+        // par sens (cf. SpscRing).
+        SpscRing inbox;
+        SpscRing outbox;
+
+        // opts cpu / nice / stack_size (la niceness est appliquée par
+        // la thread elle-même au démarrage).
+        ThreadOpts topts;
+
+        // Annulation coopérative : CANCEL_NONE tant que ni w:cancel()
+        // ni la deadline (opts.deadline, instant CLOCK_MONOTONIC, 0 =
+        // aucune) ne sont passés. Le premier motif posé gagne (CAS).
+        std::atomic<int> cancel{0};
+        uint64_t deadline_ns = 0;
     };
 
     constexpr const char *WORKER_META = "LuapilotWorker";
@@ -343,7 +1101,7 @@ namespace
 
     // Profondeur max pour les arborescences LÉGITIMES (sans cycle).
     // Les cycles sont détectés séparément via un set des tables déjà
-    // visitées (cf. visited dans lua_table_to_json) — refus immédiat
+    // visitées (cf. visited dans encode_table) — refus immédiat
     // dès la 2ème rencontre, pas attendre 32 niveaux. La limite ci-
     // dessous protège uniquement contre les arborescences pathologiques
     // très profondes mais sans cycle réel. 32 est très défensif :
@@ -358,384 +1116,485 @@ namespace
     }
 
     // ==================================================================
-    // Sérialisation Lua -> JSON
+    // Sérialisation binaire Lua <-> buffer (transport inter-threads)
     // ==================================================================
     //
-    // Conventions (alignées avec babet.json mais implémentation
-    // indépendante — décision Option 2) :
-    //   nil           -> null
-    //   boolean       -> true/false
-    //   integer       -> nombre JSON (mais perte de distinction au reload)
-    //   float         -> nombre JSON (NaN/Inf -> refus dur)
-    //   string        -> string JSON (UTF-8 requis, sinon refus)
-    //   table séq 1..n -> array
-    //   table clés str -> object
-    //   table mixte / à trous -> refus dur (cohérent avec babet.json)
-    //   function / userdata / thread -> refus dur
-    //   cycle -> refus IMMÉDIAT via set des pointeurs de tables visitées
+    // Format interne au process (jamais écrit sur disque ni envoyé sur
+    // le réseau) : entiers et doubles sont copiés dans l'ordre d'octets
+    // natif. Chaque valeur commence par un tag d'un octet :
     //
-    // La fonction renvoie true en succès, false avec err rempli.
-    // La pile Lua reste exactement comme à l'entrée.
+    //   TAG_NIL                           nil
+    //   TAG_FALSE / TAG_TRUE              booléens
+    //   TAG_INT    + 8 octets             lua_Integer
+    //   TAG_FLOAT  + 8 octets             lua_Number (NaN/Inf acceptés)
+    //   TAG_STRING + varint len + octets  string quelconque (binaire OK)
+    //   TAG_TABLE  + varint narr          table :
+    //              + narr valeurs           t[1..narr]
+    //              + (clé, valeur)*         toutes les autres paires
+    //              + TAG_END
+    //   TAG_BUFFER + varint ref           buffer partagé : index dans
+    //              + varint offset          Message::refs, puis la vue
+    //              + varint len             sur le bloc (pas d'octets)
+    //   TAG_CHANNEL + varint ref          channel : index dans
+    //                                       Message::channels
+    //   TAG_SHARED + varint ref           table partagée : index dans
+    //              + varint table           Message::snaps, puis la
+    //                                       sous-table du snapshot
     //
-    // `visited` est un set des pointeurs de tables actuellement en cours
-    // de traversée. Une table est insérée à l'entrée de
-    // lua_table_to_json et retirée à la sortie. Si une table dont le
-    // pointeur est déjà dedans est rencontrée, c'est un cycle -> refus.
-
-    bool lua_to_json(lua_State *L, int idx, json &out,
-                     std::string &err, int depth,
-                     std::unordered_set<const void *> &visited);
-
-    // Vérifie qu'une string Lua est UTF-8 valide (au moins acceptable
-    // pour nlohmann::json). On utilise la fonction utilitaire de
-    // nlohmann elle-même via un cast après accept : on tente le dump
-    // d'une string-only et on regarde si ça réussit. Implémentation
-    // directe plus rapide pour les chaînes : on accepte tout ce qui
-    // n'a pas d'octet NUL ET respecte les règles UTF-8 basiques.
+    // Les varints sont des LEB128 non signés (7 bits par octet).
     //
-    // CORRECTIF (post-revue ChatGPT) : on refuse explicitement '\0'.
-    // Techniquement '\0' est UTF-8 valide (un seul octet < 0x80), mais
-    // sémantiquement c'est du binaire ; et côté désérialisation, les
-    // clés d'objet JSON qu'on pousse via lua_setfield seraient tronquées
-    // au NUL. Pour cohérence "pas de strings binaires", refus dur.
-    bool is_valid_utf8(const char *s, size_t len)
-    {
-        size_t i = 0;
-        while (i < len)
-        {
-            unsigned char c = static_cast<unsigned char>(s[i]);
-            if (c == 0)
-                return false;
-            if (c < 0x80)
-            {
-                i += 1;
-                continue;
-            }
-            size_t cont = 0;
-            if ((c & 0xE0) == 0xC0)
-                cont = 1;
-            else if ((c & 0xF0) == 0xE0)
-                cont = 2;
-            else if ((c & 0xF8) == 0xF0)
-                cont = 3;
-            else
-                return false;
-            if (i + cont >= len)
-                return false;
-            for (size_t k = 1; k <= cont; ++k)
-            {
-                unsigned char cc = static_cast<unsigned char>(s[i + k]);
-                if ((cc & 0xC0) != 0x80)
-                    return false;
-            }
-            i += cont + 1;
+    // Par rapport à l'ancien transport JSON (arbre nlohmann::json puis
+    // dump()/parse()) :
+    //   - int et float restent distincts (3 ne revient pas en 3.0) ;
+    //   - les strings binaires (NUL, octets non UTF-8) passent ;
+    //   - les tables mixtes (séquence + clés) et les clés non-string
+    //     (entiers épars, booléens, flottants) passent ;
+    //   - un seul buffer écrit directement depuis la pile source, relu
+    //     directement sur la pile cible : pas d'arbre intermédiaire,
+    //     pas d'échappement, une seule copie des strings par sens.
+    //
+    // Refus dur : function, userdata (hors buffer, channel et table
+    // partagée), coroutine,
+    // cycle, profondeur >
+    // MAX_SERIALIZATION_DEPTH, clé de table non scalaire.
+    //
+    // Tous les accès aux tables sont RAW (lua_rawlen, lua_rawgeti,
+    // lua_next, lua_rawset) : aucune métaméthode utilisateur n'est
+    // déclenchée, donc aucune erreur Lua (longjmp) possible pendant la
+    // (dé)sérialisation — important côté worker, où l'on n'est pas
+    // sous pcall. Les métatables ne traversent pas.
+
+    enum : unsigned char
+    {
+        TAG_NIL = 0,
+        TAG_FALSE = 1,
+        TAG_TRUE = 2,
+        TAG_INT = 3,
+        TAG_FLOAT = 4,
+        TAG_STRING = 5,
+        TAG_TABLE = 6,
+        TAG_END = 7,
+        TAG_BUFFER = 8,
+        TAG_CHANNEL = 9,
+        TAG_SHARED = 10,
+    };
+
+    void put_varint(std::string &out, uint64_t v)
+    {
+        while (v >= 0x80)
+        {
+            out.push_back(static_cast<char>((v & 0x7F) | 0x80));
+            v >>= 7;
         }
-        return true;
+        out.push_back(static_cast<char>(v));
+    }
+
+    template <typename T>
+    void put_raw(std::string &out, T v)
+    {
+        char b[sizeof(T)];
+        std::memcpy(b, &v, sizeof(T));
+        out.append(b, sizeof(T));
     }
 
-    // Sérialise une table Lua à l'index `idx` (absolu attendu).
-    // Détermine array vs object selon les clés. Détecte les cycles via
+    bool encode_value(lua_State *L, int idx, Message &out,
+                      std::string &err, int depth,
+                      std::unordered_set<const void *> &visited);
+
+    // Encode la table à l'index absolu `idx`. Détecte les cycles via
     // `visited` : si la table est déjà en cours de traversée, refus
     // immédiat. Sinon on l'enregistre, on traverse, et on la retire en
-    // fin de fonction (RAII garantirait ça mieux mais on a plusieurs
-    // chemins de sortie ; on utilise un guard manuel discipliné).
-    bool lua_table_to_json(lua_State *L, int idx, json &out,
-                           std::string &err, int depth,
-                           std::unordered_set<const void *> &visited)
+    // fin de fonction (guard RAII : plusieurs chemins de sortie).
+    bool encode_table(lua_State *L, int idx, Message &out,
+                      std::string &err, int depth,
+                      std::unordered_set<const void *> &visited)
     {
-        // Détection de cycle : si on revoit la même table, c'est circulaire.
         const void *table_id = lua_topointer(L, idx);
-        if (table_id != nullptr)
+        if (visited.find(table_id) != visited.end())
         {
-            if (visited.find(table_id) != visited.end())
-            {
-                err = "workers: spawn: table contains a cycle "
-                      "(not serializable)";
-                return false;
-            }
-            visited.insert(table_id);
+            err = "workers: table contains a cycle (not serializable)";
+            return false;
         }
-
-        // Helper pour garantir le retrait de la table de visited sur
-        // tous les chemins de sortie (success ET failure).
+        visited.insert(table_id);
         struct VisitedGuard
         {
             std::unordered_set<const void *> &set;
             const void *key;
-            bool inserted;
-            ~VisitedGuard()
-            {
-                if (inserted && key != nullptr)
-                    set.erase(key);
-            }
-        } guard{visited, table_id, table_id != nullptr};
-
-        // Compter les clés et déterminer si c'est une séquence 1..n.
-        lua_Integer n = luaL_len(L, idx);
-        bool is_array = (n > 0);
-        if (is_array)
-        {
-            // Vérifier qu'on a bien 1..n sans trou ni clé non-int.
-            // Stratégie : itérer tout, et vérifier que toutes les clés
-            // entières sont dans [1, n] et qu'il n'y a aucune clé non
-            // entière. (lua's `#` n'est pas fiable pour les tables à
-            // trous.)
-            bool has_non_int_key = false;
-            lua_Integer max_int_key = 0;
-            lua_Integer int_count = 0;
-            lua_pushnil(L);
-            while (lua_next(L, idx) != 0)
-            {
-                if (lua_type(L, -2) == LUA_TNUMBER &&
-                    lua_isinteger(L, -2))
-                {
-                    lua_Integer k = lua_tointeger(L, -2);
-                    if (k < 1)
-                    {
-                        has_non_int_key = true;
-                    }
-                    else
-                    {
-                        if (k > max_int_key)
-                            max_int_key = k;
-                        ++int_count;
-                    }
-                }
-                else
-                {
-                    has_non_int_key = true;
-                }
-                lua_pop(L, 1);
-                if (has_non_int_key)
-                {
-                    lua_pop(L, 1);
-                    break;
-                }
-            }
-            if (has_non_int_key || int_count != max_int_key)
-            {
-                is_array = false;
-            }
-            else
-            {
-                n = max_int_key;
-            }
+            ~VisitedGuard() { set.erase(key); }
+        } guard{visited, table_id};
+
+        // clé + valeur + marge pour la récursion.
+        if (!lua_checkstack(L, 4))
+        {
+            err = "workers: value too deeply nested";
+            return false;
         }
 
-        if (is_array)
+        // Partie séquence : 1..#t (longueur raw). Un éventuel trou
+        // sous la bordure est encodé TAG_NIL, sans conséquence au
+        // décodage.
+        lua_Unsigned narr = lua_rawlen(L, idx);
+        out.data.push_back(static_cast<char>(TAG_TABLE));
+        put_varint(out.data, static_cast<uint64_t>(narr));
+        for (lua_Unsigned i = 1; i <= narr; ++i)
         {
-            out = json::array();
-            for (lua_Integer i = 1; i <= n; ++i)
-            {
-                lua_geti(L, idx, i);
-                json elem;
-                if (!lua_to_json(L, lua_gettop(L), elem, err, depth + 1,
-                                 visited))
-                {
-                    lua_pop(L, 1);
-                    return false;
-                }
-                out.push_back(std::move(elem));
-                lua_pop(L, 1);
-            }
-            return true;
+            lua_rawgeti(L, idx, static_cast<lua_Integer>(i));
+            bool ok = encode_value(L, lua_gettop(L), out, err, depth + 1,
+                                   visited);
+            lua_pop(L, 1);
+            if (!ok)
+                return false;
         }
 
-        // Object : toutes les clés doivent être strings.
-        out = json::object();
+        // Autres paires (clés hors 1..narr).
         lua_pushnil(L);
         while (lua_next(L, idx) != 0)
         {
-            if (lua_type(L, -2) != LUA_TSTRING)
+            if (lua_isinteger(L, -2))
             {
-                err = "workers: spawn: table key must be a string "
-                      "(non-array table)";
-                lua_pop(L, 2);
-                return false;
+                lua_Integer k = lua_tointeger(L, -2);
+                if (k >= 1 && static_cast<lua_Unsigned>(k) <= narr)
+                {
+                    lua_pop(L, 1);
+                    continue;
+                }
             }
-            size_t klen = 0;
-            const char *kp = lua_tolstring(L, -2, &klen);
-            if (!is_valid_utf8(kp, klen))
+            int kt = lua_type(L, -2);
+            if (kt != LUA_TBOOLEAN && kt != LUA_TNUMBER && kt != LUA_TSTRING)
             {
-                err = "workers: spawn: table key contains "
-                      "non-UTF-8 bytes";
+                err = std::string("workers: table key must be a boolean, "
+                                  "number or string (got ") +
+                      lua_typename(L, kt) + ")";
                 lua_pop(L, 2);
                 return false;
             }
-            std::string key(kp, klen);
-            json val;
-            if (!lua_to_json(L, lua_gettop(L), val, err, depth + 1,
-                             visited))
+            int top = lua_gettop(L);
+            if (!encode_value(L, top - 1, out, err, depth + 1, visited) ||
+                !encode_value(L, top, out, err, depth + 1, visited))
             {
                 lua_pop(L, 2);
                 return false;
             }
-            out[key] = std::move(val);
             lua_pop(L, 1);
         }
+        out.data.push_back(static_cast<char>(TAG_END));
         return true;
     }
 
-    bool lua_to_json(lua_State *L, int idx, json &out,
-                     std::string &err, int depth,
-                     std::unordered_set<const void *> &visited)
+    bool encode_value(lua_State *L, int idx, Message &out,
+                      std::string &err, int depth,
+                      std::unordered_set<const void *> &visited)
     {
         if (depth > MAX_SERIALIZATION_DEPTH)
         {
-            err = "workers: spawn: value too deeply nested";
+            err = "workers: value too deeply nested";
             return false;
         }
-        idx = lua_absindex(L, idx);
-        int t = lua_type(L, idx);
-        switch (t)
+        switch (lua_type(L, idx))
         {
+        case LUA_TNONE:
         case LUA_TNIL:
-            out = nullptr;
+            out.data.push_back(static_cast<char>(TAG_NIL));
             return true;
         case LUA_TBOOLEAN:
-            out = static_cast<bool>(lua_toboolean(L, idx));
+            out.data.push_back(static_cast<char>(lua_toboolean(L, idx) ? TAG_TRUE
+                                                                  : TAG_FALSE));
             return true;
         case LUA_TNUMBER:
             if (lua_isinteger(L, idx))
             {
-                out = static_cast<int64_t>(lua_tointeger(L, idx));
-                return true;
+                out.data.push_back(static_cast<char>(TAG_INT));
+                put_raw<lua_Integer>(out.data, lua_tointeger(L, idx));
             }
             else
             {
-                double d = lua_tonumber(L, idx);
-                if (std::isnan(d) || std::isinf(d))
-                {
-                    err = "workers: spawn: number is NaN or Inf "
-                          "(not representable in JSON)";
-                    return false;
-                }
-                out = d;
-                return true;
+                out.data.push_back(static_cast<char>(TAG_FLOAT));
+                put_raw<lua_Number>(out.data, lua_tonumber(L, idx));
             }
+            return true;
         case LUA_TSTRING:
         {
             size_t len = 0;
             const char *s = lua_tolstring(L, idx, &len);
-            if (!is_valid_utf8(s, len))
-            {
-                err = "workers: spawn: string contains non-UTF-8 "
-                      "bytes (not transferable to worker)";
-                return false;
-            }
-            out = std::string(s, len);
+            out.data.push_back(static_cast<char>(TAG_STRING));
+            put_varint(out.data, len);
+            out.data.append(s, len);
             return true;
         }
         case LUA_TTABLE:
-            return lua_table_to_json(L, idx, out, err, depth, visited);
+            return encode_table(L, lua_absindex(L, idx), out, err, depth,
+                                visited);
         case LUA_TFUNCTION:
-            err = "workers: spawn: cannot transfer a function "
+            err = "workers: cannot transfer a function "
                   "(use spawn(string_code) only)";
             return false;
         case LUA_TUSERDATA:
-            err = "workers: spawn: cannot transfer a userdata "
+        {
+            // Seuls les buffers partagés traversent, par référence.
+            // luaL_testudata ne lit que le registre : pas d'erreur Lua.
+            BufferView *b = static_cast<BufferView *>(
+                luaL_testudata(L, idx, BUFFER_META));
+            if (b)
+            {
+                b->bytes->frozen.store(true, std::memory_order_release);
+                out.data.push_back(static_cast<char>(TAG_BUFFER));
+                put_varint(out.data, out.refs.size());
+                put_varint(out.data, b->offset);
+                put_varint(out.data, b->len);
+                out.refs.push_back(b->bytes);
+                return true;
+            }
+            ChannelPtr *c = static_cast<ChannelPtr *>(
+                luaL_testudata(L, idx, CHANNEL_META));
+            if (c)
+            {
+                out.data.push_back(static_cast<char>(TAG_CHANNEL));
+                put_varint(out.data, out.channels.size());
+                out.channels.push_back(*c);
+                return true;
+            }
+            SharedRef *sr = static_cast<SharedRef *>(
+                luaL_testudata(L, idx, SHARED_META));
+            if (sr)
+            {
+                out.data.push_back(static_cast<char>(TAG_SHARED));
+                put_varint(out.data, out.snaps.size());
+                put_varint(out.data, sr->table);
+                out.snaps.push_back(sr->snap);
+                return true;
+            }
+        }
+            [[fallthrough]];
+        case LUA_TLIGHTUSERDATA:
+            err = "workers: cannot transfer a userdata "
                   "(e.g. socket, file handle) to a worker";
             return false;
         case LUA_TTHREAD:
-            err = "workers: spawn: cannot transfer a coroutine "
-                  "to a worker";
+            err = "workers: cannot transfer a coroutine to a worker";
             return false;
         default:
-            err = "workers: spawn: unsupported Lua type for transfer";
+            err = "workers: unsupported Lua type for transfer";
             return false;
         }
     }
 
-    // ==================================================================
-    // Désérialisation JSON -> Lua
-    // ==================================================================
-    //
-    // Empile la valeur sur la pile Lua. Renvoie true en succès, false
-    // avec err rempli en cas de structure invalide (ne devrait pas
-    // arriver en pratique car le JSON vient de notre propre serialize,
-    // mais on garde un filet).
+    // Curseur de lecture sur un buffer sérialisé.
+    struct Reader
+    {
+        const unsigned char *p;
+        const unsigned char *end;
+        const std::vector<SharedBytesPtr> *refs;
+        const std::vector<ChannelPtr> *channels;
+        const std::vector<SnapshotPtr> *snaps;
+    };
+
+    // Définie avec l'API Lua des channels (plus bas).
+    void push_channel(lua_State *L, ChannelPtr ch);
 
-    bool json_to_lua(lua_State *L, const json &j,
-                     std::string &err, int depth)
+    // Définie avec l'API Lua des tables partagées (plus bas).
+    void push_shared(lua_State *L, SnapshotPtr snap, uint64_t table);
+
+    // Définie avec l'API Lua des buffers (plus bas).
+    void push_buffer_view(lua_State *L, SharedBytesPtr bytes, size_t offset,
+                          size_t len);
+
+    bool get_varint(Reader &r, uint64_t &v)
     {
-        if (depth > MAX_SERIALIZATION_DEPTH)
+        v = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (r.p >= r.end)
+                return false;
+            unsigned char b = *r.p++;
+            v |= static_cast<uint64_t>(b & 0x7F) << shift;
+            if ((b & 0x80) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    template <typename T>
+    bool get_raw(Reader &r, T &v)
+    {
+        if (static_cast<size_t>(r.end - r.p) < sizeof(T))
+            return false;
+        std::memcpy(&v, r.p, sizeof(T));
+        r.p += sizeof(T);
+        return true;
+    }
+
+    // Empile une valeur décodée. En cas d'échec, la pile peut contenir
+    // des résidus : l'appelant (deserialize_value) la restaure.
+    bool decode_value(lua_State *L, Reader &r, std::string &err, int depth)
+    {
+        if (depth > MAX_SERIALIZATION_DEPTH || !lua_checkstack(L, 3))
         {
-            err = "workers: result too deeply nested";
+            err = "workers: message too deeply nested";
             return false;
         }
-        if (j.is_null())
+        if (r.p >= r.end)
         {
+            err = "workers: internal: truncated message";
+            return false;
+        }
+        unsigned char tag = *r.p++;
+        switch (tag)
+        {
+        case TAG_NIL:
             lua_pushnil(L);
             return true;
+        case TAG_FALSE:
+        case TAG_TRUE:
+            lua_pushboolean(L, tag == TAG_TRUE);
+            return true;
+        case TAG_INT:
+        {
+            lua_Integer v;
+            if (!get_raw(r, v))
+                break;
+            lua_pushinteger(L, v);
+            return true;
         }
-        if (j.is_boolean())
+        case TAG_FLOAT:
         {
-            lua_pushboolean(L, j.get<bool>() ? 1 : 0);
+            lua_Number v;
+            if (!get_raw(r, v))
+                break;
+            lua_pushnumber(L, v);
             return true;
         }
-        if (j.is_number_integer())
+        case TAG_STRING:
         {
-            lua_pushinteger(L,
-                            static_cast<lua_Integer>(j.get<int64_t>()));
+            uint64_t len;
+            if (!get_varint(r, len) ||
+                len > static_cast<uint64_t>(r.end - r.p))
+                break;
+            lua_pushlstring(L, reinterpret_cast<const char *>(r.p),
+                            static_cast<size_t>(len));
+            r.p += len;
             return true;
         }
-        if (j.is_number_unsigned())
+        case TAG_BUFFER:
         {
-            uint64_t v = j.get<uint64_t>();
-            if (v <= static_cast<uint64_t>(LUA_MAXINTEGER))
-            {
-                lua_pushinteger(L, static_cast<lua_Integer>(v));
-            }
-            else
-            {
-                lua_pushnumber(L, static_cast<lua_Number>(v));
-            }
+            uint64_t ref, offset, len;
+            if (!get_varint(r, ref) || !get_varint(r, offset) ||
+                !get_varint(r, len) || ref >= r.refs->size())
+                break;
+            const SharedBytesPtr &bytes = (*r.refs)[ref];
+            if (offset > bytes->size || len > bytes->size - offset)
+                break;
+            push_buffer_view(L, bytes, static_cast<size_t>(offset),
+                             static_cast<size_t>(len));
             return true;
         }
-        if (j.is_number_float())
+        case TAG_CHANNEL:
         {
-            lua_pushnumber(L, j.get<double>());
+            uint64_t ref;
+            if (!get_varint(r, ref) || ref >= r.channels->size())
+                break;
+            push_channel(L, (*r.channels)[ref]);
             return true;
         }
-        if (j.is_string())
+        case TAG_SHARED:
         {
-            const std::string &s = j.get_ref<const std::string &>();
-            lua_pushlstring(L, s.data(), s.size());
+            uint64_t ref, table;
+            if (!get_varint(r, ref) || ref >= r.snaps->size() ||
+                !get_varint(r, table) ||
+                table >= snap_table_count(*(*r.snaps)[ref]))
+                break;
+            push_shared(L, (*r.snaps)[ref], table);
             return true;
         }
-        if (j.is_array())
+        case TAG_TABLE:
         {
-            lua_createtable(L, static_cast<int>(j.size()), 0);
-            lua_Integer idx = 1;
-            for (const auto &elem : j)
+            // Chaque élément occupe au moins un octet : une taille
+            // annoncée au-delà du reste du buffer est forcément fausse
+            // (et ne doit pas déclencher une allocation géante).
+            uint64_t narr;
+            if (!get_varint(r, narr) ||
+                narr > static_cast<uint64_t>(r.end - r.p))
+                break;
+            lua_createtable(L, narr > INT32_MAX ? INT32_MAX : static_cast<int>(narr), 0);
+            for (uint64_t i = 1; i <= narr; ++i)
             {
-                if (!json_to_lua(L, elem, err, depth + 1))
-                {
-                    lua_pop(L, 1);
+                if (!decode_value(L, r, err, depth + 1))
                     return false;
-                }
-                lua_seti(L, -2, idx++);
+                lua_rawseti(L, -2, static_cast<lua_Integer>(i));
             }
-            return true;
-        }
-        if (j.is_object())
-        {
-            lua_createtable(L, 0, static_cast<int>(j.size()));
-            for (auto it = j.begin(); it != j.end(); ++it)
+            for (;;)
             {
-                if (!json_to_lua(L, it.value(), err, depth + 1))
+                if (r.p >= r.end)
                 {
-                    lua_pop(L, 1);
+                    err = "workers: internal: truncated message";
                     return false;
                 }
-                lua_setfield(L, -2, it.key().c_str());
+                if (*r.p == TAG_END)
+                {
+                    ++r.p;
+                    return true;
+                }
+                if (*r.p == TAG_NIL)
+                    break; // clé nil : impossible depuis encode_table
+                if (!decode_value(L, r, err, depth + 1) ||
+                    !decode_value(L, r, err, depth + 1))
+                    return false;
+                lua_rawset(L, -3);
             }
-            return true;
+            break;
+        }
+        default:
+            break;
         }
-        err = "workers: unsupported JSON type in result";
+        err = "workers: internal: malformed message";
         return false;
     }
 
+    // Sérialise la valeur à `idx` dans `out` (contenu remplacé). Rend
+    // false avec err rempli si la valeur n'est pas transférable. La
+    // pile reste exactement comme à l'entrée.
+    bool serialize_value(lua_State *L, int idx, Message &out,
+                         std::string &err)
+    {
+        out.data.clear();
+        out.refs.clear();
+        out.channels.clear();
+        out.snaps.clear();
+        std::unordered_set<const void *> visited;
+        return encode_value(L, lua_absindex(L, idx), out, err, 0, visited);
+    }
+
+    // Empile la valeur décodée depuis `buf` (buffer vide = nil : args
+    // absents). Rend false avec err rempli, sans rien empiler, si le
+    // buffer est invalide — ne devrait pas arriver puisqu'il vient de
+    // serialize_value, mais on garde un filet.
+    bool deserialize_value(lua_State *L, const Message &msg,
+                           std::string &err)
+    {
+        const std::string &buf = msg.data;
+        if (buf.empty())
+        {
+            lua_pushnil(L);
+            return true;
+        }
+        int top = lua_gettop(L);
+        Reader r{reinterpret_cast<const unsigned char *>(buf.data()),
+                 reinterpret_cast<const unsigned char *>(buf.data()) +
+                     buf.size(),
+                 &msg.refs, &msg.channels, &msg.snaps};
+        if (!decode_value(L, r, err, 0))
+        {
+            lua_settop(L, top);
+            return false;
+        }
+        if (r.p != r.end)
+        {
+            lua_settop(L, top);
+            err = "workers: internal: trailing bytes in message";
+            return false;
+        }
+        return true;
+    }
+
     // ==================================================================
     // Thread worker
     // ==================================================================
@@ -750,6 +1609,240 @@ namespace
     // pcall en place), c'est la thread qui meurt et on remontera "error"
     // avec un message générique.
 
+    // ==================================================================
+    // Annulation et deadline (w:cancel, opts.deadline)
+    // ==================================================================
+    //
+    // Un worker parti en boucle ne pouvait qu'être abandonné : sa
+    // pthread continuait de brûler du CPU. Chaque lua_State de worker
+    // porte un hook "count" (même mécanique que babet.signal, cf.
+    // signal.cpp) qui vérifie le drapeau d'annulation et la deadline
+    // toutes les CANCEL_HOOK_COUNT instructions, et lève une erreur Lua
+    // quand l'un des deux est posé : une boucle Lua pure est donc
+    // interrompue sans coopération du code utilisateur.
+    //
+    // Un pcall du code utilisateur peut rattraper cette erreur : le
+    // hook se réarme alors à chaque instruction et relève l'erreur
+    // jusqu'à ce que le chunk sorte. Les appels C bloquants ne sont pas
+    // interrompus par le hook ; mais w:cancel() ferme les deux anneaux
+    // (worker.recv/send rendent "closed") et leurs timeouts sont bornés
+    // par la deadline.
+    //
+    // join() rend alors (false, "cancelled") ou (false, "deadline") au
+    // lieu du message d'erreur Lua. Un worker qui termine normalement
+    // malgré une annulation tardive garde son résultat.
+
+    constexpr int CANCEL_NONE = 0;
+    constexpr int CANCEL_REQUESTED = 1;
+    constexpr int CANCEL_DEADLINE = 2;
+
+    // ~10 ms de latence max pour ~1% d'overhead (cf. signal.cpp).
+    constexpr int CANCEL_HOOK_COUNT = 10000;
+
+    // Clé registry (adresse unique) du Worker* de ce lua_State.
+    char g_worker_self_key = 0;
+
+    const char *cancel_reason(int r)
+    {
+        return r == CANCEL_DEADLINE ? "deadline" : "cancelled";
+    }
+
+    // Motif d'annulation courant ; passe à CANCEL_DEADLINE si la
+    // deadline est dépassée et que rien d'autre n'a été posé avant.
+    int check_cancel(Worker *w)
+    {
+        int r = w->cancel.load(std::memory_order_acquire);
+        if (r == CANCEL_NONE && w->deadline_ns != 0 &&
+            monotonic_ns() >= w->deadline_ns)
+        {
+            int expected = CANCEL_NONE;
+            w->cancel.compare_exchange_strong(expected, CANCEL_DEADLINE,
+                                              std::memory_order_acq_rel);
+            r = w->cancel.load(std::memory_order_acquire);
+        }
+        return r;
+    }
+
+    void cancel_hook(lua_State *L, lua_Debug *)
+    {
+        lua_pushlightuserdata(L, &g_worker_self_key);
+        lua_rawget(L, LUA_REGISTRYINDEX);
+        Worker *w = static_cast<Worker *>(lua_touserdata(L, -1));
+        lua_pop(L, 1);
+        if (!w)
+            return;
+        int r = check_cancel(w);
+        if (r == CANCEL_NONE)
+            return;
+        // Réarmement serré : si un pcall utilisateur rattrape l'erreur,
+        // elle est relevée dès l'instruction suivante.
+        lua_sethook(L, cancel_hook, LUA_MASKCOUNT, 1);
+        luaL_error(L, "workers: %s", cancel_reason(r));
+    }
+
+    void install_cancel_hook(lua_State *L, Worker *w)
+    {
+        lua_pushlightuserdata(L, &g_worker_self_key);
+        lua_pushlightuserdata(L, w);
+        lua_rawset(L, LUA_REGISTRYINDEX);
+        lua_sethook(L, cancel_hook, LUA_MASKCOUNT, CANCEL_HOOK_COUNT);
+    }
+
+    // Borne un timeout (ms, -1 = infini) d'un appel bloquant du worker
+    // par ce qui reste avant la deadline.
+    int64_t clamp_to_deadline(const Worker *w, int64_t timeout_ms)
+    {
+        if (w->deadline_ns == 0 || timeout_ms == 0)
+            return timeout_ms;
+        uint64_t now = monotonic_ns();
+        int64_t left = now >= w->deadline_ns
+                           ? 0
+                           : static_cast<int64_t>((w->deadline_ns - now) /
+                                                  1000000ULL) +
+                                 1;
+        if (timeout_ms < 0 || left < timeout_ms)
+            return left;
+        return timeout_ms;
+    }
+
+    // worker.cancelled() -> boolean
+    int worker_side_cancelled(lua_State *L)
+    {
+        Worker *w = static_cast<Worker *>(
+            lua_touserdata(L, lua_upvalueindex(1)));
+        lua_pushboolean(L, check_cancel(w) != CANCEL_NONE);
+        return 1;
+    }
+
+    // ============================================================
+    // Envois / réceptions par lots (send_many / recv_many)
+    // ============================================================
+    //
+    // Partagés par le parent (w:send_many / w:recv_many) et le worker
+    // (worker.send_many / worker.recv_many). Un lot ne coûte qu'une
+    // publication dans l'anneau (une barrière, au plus un FUTEX_WAKE)
+    // au lieu d'une par message.
+    //
+    //   send_many(list [, timeout]) -> (true, n) | (false, reason, sent)
+    //       Envoie list[1..#list] dans l'ordre. La deadline couvre tout
+    //       le lot ; `sent` compte les messages passés avant l'échec.
+    //       Tout est sérialisé avant le premier envoi : une valeur non
+    //       sérialisable n'envoie rien.
+    //   recv_many([max [, timeout]]) -> (true, {values} [, err])
+    //                                   | (false, reason)
+    //       Attend au plus timeout qu'un message arrive, puis prend sans
+    //       attendre tout ce qui est disponible, au plus max (défaut 64).
+    //       Un message indécodable est perdu, pas le reste du lot.
+
+    constexpr lua_Integer RECV_MANY_DEFAULT = 64;
+    constexpr lua_Integer RECV_MANY_MAX = 1000000;
+
+    // ser_fail_nil : true côté parent (erreur de sérialisation en
+    // (nil, err), comme w:send), false côté worker ((false, err)).
+    //
+    // self : le Worker courant côté worker (timeout borné par sa
+    // deadline), nullptr côté parent.
+    int ring_send_many(lua_State *L, SpscRing &ring, int list_idx,
+                       bool ser_fail_nil, const Worker *self)
+    {
+        luaL_checktype(L, list_idx, LUA_TTABLE);
+        int64_t timeout_ms = parse_timeout_arg(L, list_idx + 1);
+        if (self)
+            timeout_ms = clamp_to_deadline(self, timeout_ms);
+        lua_Integer n = static_cast<lua_Integer>(lua_rawlen(L, list_idx));
+
+        std::vector<Message> msgs;
+        std::string err;
+        msgs.resize(static_cast<size_t>(n));
+        for (lua_Integer i = 0; i < n; ++i)
+        {
+            lua_rawgeti(L, list_idx, i + 1);
+            bool ok = serialize_value(L, -1, msgs[static_cast<size_t>(i)], err);
+            lua_pop(L, 1);
+            if (!ok)
+            {
+                err = "workers: send_many item " + std::to_string(i + 1) +
+                      ": " + err;
+                if (ser_fail_nil)
+                    return push_fail(L, err);
+                lua_pushboolean(L, 0);
+                lua_pushstring(L, err.c_str());
+                return 2;
+            }
+        }
+
+        size_t sent = 0;
+        const char *reason = ring.push_many(msgs.data(), msgs.size(),
+                                            timeout_ms, sent);
+        if (!reason)
+        {
+            lua_pushboolean(L, 1);
+            lua_pushinteger(L, n);
+            return 2;
+        }
+        lua_pushboolean(L, 0);
+        lua_pushstring(L, reason);
+        lua_pushinteger(L, static_cast<lua_Integer>(sent));
+        return 3;
+    }
+
+    int ring_recv_many(lua_State *L, SpscRing &ring, int max_idx,
+                       const Worker *self)
+    {
+        lua_Integer max = luaL_optinteger(L, max_idx, RECV_MANY_DEFAULT);
+        if (max < 1 || max > RECV_MANY_MAX)
+        {
+            return luaL_error(L,
+                              "workers: recv_many max must be between 1 and "
+                              "%I (got %I)",
+                              RECV_MANY_MAX, max);
+        }
+        int64_t timeout_ms = parse_timeout_arg(L, max_idx + 1);
+        if (self)
+            timeout_ms = clamp_to_deadline(self, timeout_ms);
+
+        std::vector<Message> msgs;
+        const char *reason =
+            ring.pop_many(msgs, static_cast<size_t>(max), timeout_ms);
+        if (reason)
+        {
+            lua_pushboolean(L, 0);
+            lua_pushstring(L, reason);
+            return 2;
+        }
+
+        // Les messages sont déjà sortis de l'anneau : un message
+        // indécodable est sauté, les autres sont rendus, et la
+        // première erreur part en 3e valeur (false seulement si aucun
+        // message du lot n'a pu être décodé).
+        lua_pushboolean(L, 1);
+        lua_createtable(L, static_cast<int>(msgs.size()), 0);
+        std::string err;
+        std::string first_err;
+        lua_Integer n = 0;
+        for (size_t i = 0; i < msgs.size(); ++i)
+        {
+            if (!deserialize_value(L, msgs[i], err))
+            {
+                if (first_err.empty())
+                    first_err = err;
+                continue;
+            }
+            lua_rawseti(L, -2, ++n);
+        }
+        if (first_err.empty())
+            return 2;
+        if (n == 0)
+        {
+            lua_pop(L, 2);
+            lua_pushboolean(L, 0);
+            lua_pushstring(L, first_err.c_str());
+            return 2;
+        }
+        lua_pushstring(L, first_err.c_str());
+        return 3;
+    }
+
     // ============================================================
     // Chantier 9-3 : worker.send / worker.recv côté worker
     // ============================================================
@@ -780,35 +1873,23 @@ namespace
         // CORRECTIF Gemini : parse_timeout_arg peut faire un longjmp via
         // luaL_error si l'utilisateur passe un timeout invalide. Or
         // longjmp ne déroule PAS les destructeurs C++. Donc on parse
-        // le timeout AVANT toute allocation C++ (json, std::string, set).
+        // le timeout AVANT toute allocation C++ (std::string, set).
         int64_t timeout_ms = parse_timeout_arg(L, 2);
 
-        // Sérialiser la valeur (arg 1) -> JSON string.
-        json msg_j;
+        // Sérialiser la valeur (arg 1) -> buffer binaire.
+        Message msg;
         std::string err;
-        std::unordered_set<const void *> visited;
-        if (!lua_to_json(L, 1, msg_j, err, 0, visited))
+        if (!serialize_value(L, 1, msg, err))
         {
             // Convention pcall-style côté worker : (false, err).
             lua_pushboolean(L, 0);
             lua_pushstring(L, err.c_str());
             return 2;
         }
-        std::string msg_str;
-        try
-        {
-            msg_str = msg_j.dump();
-        }
-        catch (const std::exception &e)
-        {
-            lua_pushboolean(L, 0);
-            lua_pushstring(L,
-                           (std::string("workers: failed to serialize message: ") + e.what()).c_str());
-            return 2;
-        }
 
         // Push dans l'OUTBOX (worker -> parent).
-        auto r = w->outbox.push(std::move(msg_str), timeout_ms);
+        auto r = w->outbox.push(std::move(msg),
+                                clamp_to_deadline(w, timeout_ms));
         if (r.first)
         {
             lua_pushboolean(L, 1);
@@ -820,6 +1901,20 @@ namespace
         return 2;
     }
 
+    int worker_side_send_many(lua_State *L)
+    {
+        Worker *w = static_cast<Worker *>(
+            lua_touserdata(L, lua_upvalueindex(1)));
+        return ring_send_many(L, w->outbox, 1, false, w);
+    }
+
+    int worker_side_recv_many(lua_State *L)
+    {
+        Worker *w = static_cast<Worker *>(
+            lua_touserdata(L, lua_upvalueindex(1)));
+        return ring_recv_many(L, w->inbox, 1, w);
+    }
+
     int worker_side_recv(lua_State *L)
     {
         Worker *w = static_cast<Worker *>(
@@ -829,8 +1924,8 @@ namespace
         int64_t timeout_ms = parse_timeout_arg(L, 1);
 
         // Pop depuis l'INBOX (parent -> worker).
-        std::string msg_str;
-        auto r = w->inbox.pop(msg_str, timeout_ms);
+        Message msg;
+        auto r = w->inbox.pop(msg, clamp_to_deadline(w, timeout_ms));
         if (!r.first)
         {
             lua_pushboolean(L, 0);
@@ -838,22 +1933,12 @@ namespace
             return 2;
         }
 
-        // Déserialiser le JSON -> valeur Lua.
-        try
-        {
-            json j = json::parse(msg_str);
-            std::string err;
-            if (!json_to_lua(L, j, err, 0))
-            {
-                lua_pushboolean(L, 0);
-                lua_pushstring(L, err.c_str());
-                return 2;
-            }
-        }
-        catch (const std::exception &e)
+        // Désérialiser le buffer -> valeur Lua.
+        std::string err;
+        if (!deserialize_value(L, msg, err))
         {
             lua_pushboolean(L, 0);
-            lua_pushstring(L, e.what());
+            lua_pushstring(L, err.c_str());
             return 2;
         }
 
@@ -864,22 +1949,22 @@ namespace
         return 2;
     }
 
-    void *worker_thread_main(void *arg)
-    {
-        Worker *w = static_cast<Worker *>(arg);
+    // ==================================================================
+    // Préparation d'un lua_State enfant (partagée spawn / pool)
+    // ==================================================================
 
-        // ==========================================================
-        // Bloquer les signaux gérables par babet.signal dans ce
-        // worker. Sans cela, le kernel pourrait délivrer un SIGTERM
-        // (ou autre) à ce thread plutôt qu'au thread principal, et le
-        // callback Lua serait invoqué dans un mauvais lua_State —
-        // ou pire, dans aucun.
-        //
-        // Cette liste DOIT rester synchronisée avec SUPPORTED_SIGNALS
-        // dans signal.cpp. Les signaux non listés ici garderont leur
-        // comportement par défaut dans le worker (typiquement : tuer
-        // le process, ce qui est OK puisqu'on ne prétend pas les
-        // gérer en v1).
+    // Bloque dans le thread courant les signaux gérables par
+    // babet.signal. Sans cela, le kernel pourrait délivrer un SIGTERM
+    // (ou autre) à ce thread plutôt qu'au thread principal, et le
+    // callback Lua serait invoqué dans un mauvais lua_State — ou pire,
+    // dans aucun.
+    //
+    // Cette liste DOIT rester synchronisée avec SUPPORTED_SIGNALS dans
+    // signal.cpp. Les signaux non listés ici garderont leur
+    // comportement par défaut dans le worker (typiquement : tuer le
+    // process, ce qui est OK puisqu'on ne prétend pas les gérer en v1).
+    void block_worker_signals()
+    {
         sigset_t mask;
         sigemptyset(&mask);
         sigaddset(&mask, SIGTERM);
@@ -889,18 +1974,20 @@ namespace
         sigaddset(&mask, SIGUSR2);
         sigaddset(&mask, SIGPIPE);
         pthread_sigmask(SIG_BLOCK, &mask, nullptr);
-        // ==========================================================
+    }
 
+    // Crée un lua_State neuf configuré exactement comme celui du
+    // parent : stdlib, modules bundlés, babet.*, et résolution
+    // require() des modules utilisateur. Renvoie nullptr si
+    // l'allocation échoue.
+    //
+    // Utilisé par worker_thread_main (un état par spawn) et par les
+    // threads du pool (un état chaud réutilisé pour N tâches).
+    lua_State *new_worker_state()
+    {
         lua_State *L = luaL_newstate();
         if (!L)
         {
-            w->err_msg = "workers: failed to create lua_State for worker";
-            w->status.store(WORKER_ERROR, std::memory_order_release);
-            // Chantier 9-3 : ferme les queues même sur échec précoce,
-            // pour que les recv/send bloquants côté parent ne restent
-            // pas en attente indéfinie.
-            w->inbox.close();
-            w->outbox.close();
             return nullptr;
         }
         luaL_openlibs(L);
@@ -943,47 +2030,47 @@ namespace
                 lua_pop(L, 1);                      // pile: <vide>
             }
         }
+        return L;
+    }
+
+    void *worker_thread_main(void *arg)
+    {
+        Worker *w = static_cast<Worker *>(arg);
+
+        block_worker_signals();
+
+        std::string nice_err;
+        lua_State *L = apply_thread_nice(w->topts, nice_err)
+                           ? new_worker_state()
+                           : nullptr;
+        if (!L)
+        {
+            w->err_msg = !nice_err.empty()
+                             ? nice_err
+                             : "workers: failed to create lua_State for worker";
+            w->status.store(WORKER_ERROR, std::memory_order_release);
+            // Chantier 9-3 : ferme les queues même sur échec précoce,
+            // pour que les recv/send bloquants côté parent ne restent
+            // pas en attente indéfinie.
+            w->inbox.close();
+            w->outbox.close();
+            return nullptr;
+        }
 
         // Préparer worker.args via le namespace "worker" (décision W-7).
-        // worker = { args = <args_json désérialisé> }
+        // worker = { args = <args_buf désérialisé> }
         lua_newtable(L); // worker = {}
         std::string err;
-        if (w->args_json.empty() || w->args_json == "null")
-        {
-            lua_pushnil(L);
-        }
-        else
+        if (!deserialize_value(L, w->args_buf, err))
         {
-            try
-            {
-                json args_j = json::parse(w->args_json);
-                if (!json_to_lua(L, args_j, err, 0))
-                {
-                    w->err_msg = err;
-                    w->status.store(WORKER_ERROR,
-                                    std::memory_order_release);
-                    // Chantier 9-3 : ferme les queues pour que les recv/send
-                    // futurs côté parent voient 'closed' au lieu d'attendre.
-                    w->inbox.close();
-                    w->outbox.close();
-                    lua_close(L);
-                    return nullptr;
-                }
-            }
-            catch (const std::exception &e)
-            {
-                w->err_msg = std::string(
-                                 "workers: internal: failed to parse args_json: ") +
-                             e.what();
-                w->status.store(WORKER_ERROR,
-                                std::memory_order_release);
-                // Chantier 9-3 : ferme les queues pour que les recv/send
-                // futurs côté parent voient 'closed' au lieu d'attendre.
-                w->inbox.close();
-                w->outbox.close();
-                lua_close(L);
-                return nullptr;
-            }
+            w->err_msg = err;
+            w->status.store(WORKER_ERROR, std::memory_order_release);
+            // Chantier 9-3 : ferme les queues pour que les recv/send
+            // futurs côté parent voient 'closed' au lieu d'attendre.
+            w->inbox.close();
+            w->outbox.close();
+            lua_close(L);
+            return nullptr;
         }
         lua_setfield(L, -2, "args"); // worker.args = ...
 
@@ -997,6 +2084,18 @@ namespace
         lua_pushcclosure(L, worker_side_recv, 1);
         lua_setfield(L, -2, "recv");
 
+        lua_pushlightuserdata(L, w);
+        lua_pushcclosure(L, worker_side_send_many, 1);
+        lua_setfield(L, -2, "send_many");
+
+        lua_pushlightuserdata(L, w);
+        lua_pushcclosure(L, worker_side_recv_many, 1);
+        lua_setfield(L, -2, "recv_many");
+
+        lua_pushlightuserdata(L, w);
+        lua_pushcclosure(L, worker_side_cancelled, 1);
+        lua_setfield(L, -2, "cancelled");
+
         lua_setglobal(L, "worker"); // _G.worker = ...
 
         // arg = nil dans le worker (décision W-7).
@@ -1033,12 +2132,18 @@ namespace
         //   local ok, t = w:join()  -- t = { a, b, c } côté parent
         // C'est la convention la plus simple, cohérente avec le modèle
         // "un worker calcule UNE chose et la rend".
+        install_cancel_hook(L, w);
         rc = lua_pcall(L, 0, 1, 0);
         if (rc != LUA_OK)
         {
+            // Annulé ou deadline dépassée : le motif remplace l'erreur
+            // Lua (levée par cancel_hook, ou conséquence d'un recv
+            // "closed" après w:cancel()).
+            int cr = w->cancel.load(std::memory_order_acquire);
             const char *m = lua_tostring(L, -1);
-            w->err_msg = m ? std::string(m)
-                           : "workers: worker raised error (no message)";
+            w->err_msg = cr != CANCEL_NONE ? std::string(cancel_reason(cr))
+                         : m              ? std::string(m)
+                                          : "workers: worker raised error (no message)";
             w->status.store(WORKER_ERROR, std::memory_order_release);
             // Chantier 9-3 : ferme les queues pour que les recv/send
             // futurs côté parent voient 'closed' au lieu d'attendre.
@@ -1049,9 +2154,7 @@ namespace
         }
 
         // Sérialiser le résultat.
-        json result_j;
-        std::unordered_set<const void *> result_visited;
-        if (!lua_to_json(L, -1, result_j, err, 0, result_visited))
+        if (!serialize_value(L, -1, w->result_buf, err))
         {
             // L'utilisateur a retourné un truc non sérialisable.
             w->err_msg = std::string(
@@ -1065,23 +2168,6 @@ namespace
             lua_close(L);
             return nullptr;
         }
-        try
-        {
-            w->result_json = result_j.dump();
-        }
-        catch (const std::exception &e)
-        {
-            w->err_msg = std::string(
-                             "workers: internal: result_json dump failed: ") +
-                         e.what();
-            w->status.store(WORKER_ERROR, std::memory_order_release);
-            // Chantier 9-3 : ferme les queues pour que les recv/send
-            // futurs côté parent voient 'closed' au lieu d'attendre.
-            w->inbox.close();
-            w->outbox.close();
-            lua_close(L);
-            return nullptr;
-        }
 
         // Chantier 9-3 : ferme les queues au succès.
         w->inbox.close();
@@ -1119,6 +2205,8 @@ namespace
         // (faute de programmeur, pas runtime).
         int inbox_cap = 64;
         int outbox_cap = 64;
+        ThreadOpts topts;
+        uint64_t deadline_ns = 0;
         if (lua_istable(L, 3))
         {
             lua_getfield(L, 3, "inbox_capacity");
@@ -1160,28 +2248,44 @@ namespace
                 outbox_cap = (int)n;
             }
             lua_pop(L, 1);
+
+            parse_thread_opts(L, 3, "workers.spawn", topts);
+
+            // opts.deadline : secondes à partir du spawn (> 0).
+            lua_getfield(L, 3, "deadline");
+            if (!lua_isnil(L, -1))
+            {
+                lua_Number d = lua_tonumber(L, -1);
+                if (!lua_isnumber(L, -1) || !(d > 0) || std::isinf(d))
+                {
+                    return luaL_error(L,
+                                      "workers.spawn: opts.deadline must be a "
+                                      "positive number of seconds");
+                }
+                // Au-delà de l'horizon de l'horloge : pas de deadline.
+                // Le cast d'un double hors uint64 est indéfini, et la
+                // somme repliée donnerait une deadline déjà passée.
+                const uint64_t now = monotonic_ns();
+                const double ns = d * 1e9;
+                if (ns < static_cast<double>(UINT64_MAX - now))
+                {
+                    const uint64_t add = static_cast<uint64_t>(ns);
+                    if (add <= UINT64_MAX - now)
+                        deadline_ns = now + add;
+                }
+            }
+            lua_pop(L, 1);
         }
 
-        // Sérialiser args -> JSON.
-        std::string args_json_str = "null";
+        // Sérialiser args -> buffer binaire (vide = pas d'args).
+        Message args_buf;
         if (lua_istable(L, 2))
         {
-            json args_j;
             std::string err;
-            std::unordered_set<const void *> args_visited;
-            if (!lua_to_json(L, 2, args_j, err, 0, args_visited))
+            if (!serialize_value(L, 2, args_buf, err))
             {
                 return push_fail(L, err);
             }
-            try
-            {
-                args_json_str = args_j.dump();
-            }
-            catch (const std::exception &e)
-            {
-                return push_fail(L,
-                                 std::string("workers: failed to dump args: ") + e.what());
-            }
         }
 
         // Créer le userdata Worker AVANT pthread_create : si pthread
@@ -1193,15 +2297,14 @@ namespace
         w->status.store(WORKER_RUNNING, std::memory_order_relaxed);
         w->joined.store(false, std::memory_order_relaxed);
         w->code.assign(code, code_len);
-        w->args_json = std::move(args_json_str);
+        w->args_buf = std::move(args_buf);
         luaL_getmetatable(L, WORKER_META);
         lua_setmetatable(L, -2);
 
         // Chantier 9-2 : init des queues. Si l'init échoue (allocation
-        // pthread), on remonte une erreur runtime. Le __gc libérera la
-        // queue éventuellement à demi initialisée (init() retournant
-        // false laisse initialized=false, donc destroy() ne touchera
-        // pas aux primitives non créées).
+        // des slots de l'anneau), on remonte une erreur runtime. Le
+        // __gc reste sûr : destroy() sur un anneau sans slots ne fait
+        // rien, close() n'utilise que des atomics.
         if (!w->inbox.init((size_t)inbox_cap))
         {
             lua_pop(L, 1);
@@ -1215,7 +2318,9 @@ namespace
                              "workers: failed to initialize outbox queue");
         }
 
-        int rc = pthread_create(&w->tid, nullptr, worker_thread_main, w);
+        w->topts = topts;
+        w->deadline_ns = deadline_ns;
+        int rc = create_thread(&w->tid, topts, worker_thread_main, w);
         if (rc != 0)
         {
             // userdata sera __gc'd par Lua (rien à joindre puisque
@@ -1253,22 +2358,13 @@ namespace
         if (st == WORKER_DONE)
         {
             lua_pushboolean(L, 1);
-            // Désérialiser le résultat. json_to_lua laisse la pile
-            // propre en cas d'échec (nettoyage interne). On rend
-            // (true, nil) si la désérialisation échoue : politique
-            // "on a annoncé success, on ne recule pas" — un échec
-            // ici serait un bug de notre sérialisation, pas de
-            // l'utilisateur.
-            try
-            {
-                json r = json::parse(w->result_json);
-                std::string err;
-                if (!json_to_lua(L, r, err, 0))
-                {
-                    lua_pushnil(L);
-                }
-            }
-            catch (...)
+            // Désérialiser le résultat. deserialize_value laisse la
+            // pile propre en cas d'échec. On rend (true, nil) si la
+            // désérialisation échoue : politique "on a annoncé
+            // success, on ne recule pas" — un échec ici serait un bug
+            // de notre sérialisation, pas de l'utilisateur.
+            std::string err;
+            if (!deserialize_value(L, w->result_buf, err))
             {
                 lua_pushnil(L);
             }
@@ -1316,16 +2412,8 @@ namespace
         if (st == WORKER_DONE)
         {
             lua_pushstring(L, "done");
-            try
-            {
-                json r = json::parse(w->result_json);
-                std::string err;
-                if (!json_to_lua(L, r, err, 0))
-                {
-                    lua_pushnil(L);
-                }
-            }
-            catch (...)
+            std::string err;
+            if (!deserialize_value(L, w->result_buf, err))
             {
                 lua_pushnil(L);
             }
@@ -1412,32 +2500,21 @@ namespace
         // CORRECTIF Gemini : parse_timeout_arg peut faire un longjmp via
         // luaL_error si l'utilisateur passe un timeout invalide. Or
         // longjmp ne déroule PAS les destructeurs C++. Donc on parse
-        // le timeout AVANT toute allocation C++ (json, std::string, set).
+        // le timeout AVANT toute allocation C++ (std::string, set).
         int64_t timeout_ms = parse_timeout_arg(L, 3);
 
-        // Sérialiser la valeur (arg 2) -> JSON string.
+        // Sérialiser la valeur (arg 2) -> buffer binaire.
         // Toute valeur Lua passe : nil, boolean, number, string,
         // table sérialisable. Refus si function/userdata/coroutine/cycle.
-        json msg_j;
+        Message msg;
         std::string err;
-        std::unordered_set<const void *> visited;
-        if (!lua_to_json(L, 2, msg_j, err, 0, visited))
+        if (!serialize_value(L, 2, msg, err))
         {
             return push_fail(L, err);
         }
-        std::string msg_str;
-        try
-        {
-            msg_str = msg_j.dump();
-        }
-        catch (const std::exception &e)
-        {
-            return push_fail(L,
-                             std::string("workers: failed to serialize message: ") + e.what());
-        }
 
         // Push dans l'inbox.
-        auto r = w->inbox.push(std::move(msg_str), timeout_ms);
+        auto r = w->inbox.push(std::move(msg), timeout_ms);
         if (r.first)
         {
             lua_pushboolean(L, 1);
@@ -1457,8 +2534,8 @@ namespace
         int64_t timeout_ms = parse_timeout_arg(L, 2);
 
         // Pop depuis l'outbox.
-        std::string msg_str;
-        auto r = w->outbox.pop(msg_str, timeout_ms);
+        Message msg;
+        auto r = w->outbox.pop(msg, timeout_ms);
         if (!r.first)
         {
             lua_pushboolean(L, 0);
@@ -1466,24 +2543,14 @@ namespace
             return 2;
         }
 
-        // Déserialiser le JSON -> valeur Lua.
-        try
-        {
-            json j = json::parse(msg_str);
-            std::string err;
-            if (!json_to_lua(L, j, err, 0))
-            {
-                // Cas extrêmement rare : message qui a été sérialisé mais
-                // ne se deserialise pas. Remontée propre.
-                lua_pushboolean(L, 0);
-                lua_pushstring(L, err.c_str());
-                return 2;
-            }
-        }
-        catch (const std::exception &e)
+        // Désérialiser le buffer -> valeur Lua.
+        std::string err;
+        if (!deserialize_value(L, msg, err))
         {
+            // Cas extrêmement rare : message qui a été sérialisé mais
+            // ne se désérialise pas. Remontée propre.
             lua_pushboolean(L, 0);
-            lua_pushstring(L, e.what());
+            lua_pushstring(L, err.c_str());
             return 2;
         }
 
@@ -1494,10 +2561,38 @@ namespace
         return 2;
     }
 
+    int worker_send_many(lua_State *L)
+    {
+        Worker *w = check_worker(L, 1);
+        return ring_send_many(L, w->inbox, 2, true, nullptr);
+    }
+
+    int worker_recv_many(lua_State *L)
+    {
+        Worker *w = check_worker(L, 1);
+        return ring_recv_many(L, w->outbox, 2, nullptr);
+    }
+
+    // w:cancel() -> (true, nil). Pose le drapeau (sans effet si le
+    // worker a déjà fini ou si la deadline est déjà passée) et ferme
+    // les deux anneaux pour débloquer worker.recv / worker.send. Le
+    // worker s'arrête au prochain passage du hook ; join() attend cet
+    // arrêt et rend (false, "cancelled").
+    int worker_cancel(lua_State *L)
+    {
+        Worker *w = check_worker(L, 1);
+        int expected = CANCEL_NONE;
+        w->cancel.compare_exchange_strong(expected, CANCEL_REQUESTED,
+                                          std::memory_order_acq_rel);
+        w->inbox.close();
+        w->outbox.close();
+        return push_ok(L);
+    }
+
     int worker_close(lua_State *L)
     {
         Worker *w = check_worker(L, 1);
-        // Idempotent : appeler plusieurs fois est OK (MessageQueue::close
+        // Idempotent : appeler plusieurs fois est OK (SpscRing::close
         // est lui-même idempotent).
         // Sémantique : ferme l'INBOX du worker. Tout send ultérieur
         // depuis le parent rendra (false, "closed"). Côté worker (9-3),
@@ -1536,8 +2631,8 @@ namespace
             w->tid_valid = false;
         }
 
-        // Libération des primitives pthread des queues (init/destroy
-        // symétriques). Safe si init() n'avait pas réussi.
+        // Libération des slots des anneaux (et des messages jamais lus).
+        // Safe si init() n'avait pas réussi.
         w->inbox.destroy();
         w->outbox.destroy();
 
@@ -1559,44 +2654,2768 @@ namespace
         return 1;
     }
 
-} // namespace
+    // =================================================================
+    // Buffers partagés : API Lua
+    // =================================================================
+    //
+    // babet.workers.buffer(size_or_string) -> buffer | (nil, err)
+    //   buf:size() / #buf            taille de la vue en octets
+    //   buf:tostring([i [, j]])      copie des octets en string Lua
+    //   buf:slice([i [, j]])         nouvelle vue, sans copie
+    //   buf:write(pos, str)          écrit str à la position pos
+    //   buf:freeze()                 gel définitif -> (true, nil)
+    //   buf:frozen()                 boolean
+    //
+    // Les indices i, j suivent string.sub : base 1, bornes incluses,
+    // négatifs comptés depuis la fin, bornés silencieusement.
 
-void register_workers(lua_State *L)
-{
-    luaL_newmetatable(L, WORKER_META);
+    // Taille max d'un buffer : 1 Tio, garde-fou contre une taille
+    // aberrante (faute de frappe) plutôt que limite réelle.
+    constexpr lua_Integer MAX_BUFFER_SIZE = lua_Integer(1) << 40;
+
+    BufferView *check_buffer(lua_State *L, int idx)
     {
-        lua_pushvalue(L, -1);
-        lua_setfield(L, -2, "__index");
-        lua_pushcfunction(L, worker_gc);
-        lua_setfield(L, -2, "__gc");
-        lua_pushcfunction(L, worker_tostring);
-        lua_setfield(L, -2, "__tostring");
-        lua_pushcfunction(L, worker_join);
-        lua_setfield(L, -2, "join");
-        lua_pushcfunction(L, worker_poll);
-        lua_setfield(L, -2, "poll");
-        // Chantier 9-2 : send / recv / close
-        lua_pushcfunction(L, worker_send);
-        lua_setfield(L, -2, "send");
-        lua_pushcfunction(L, worker_recv);
-        lua_setfield(L, -2, "recv");
-        lua_pushcfunction(L, worker_close);
-        lua_setfield(L, -2, "close");
+        return static_cast<BufferView *>(luaL_checkudata(L, idx, BUFFER_META));
     }
-    lua_pop(L, 1);
 
-    lua_newtable(L);
-    lua_pushcfunction(L, lua_workers_spawn);
-    lua_setfield(L, -2, "spawn");
-    lua_setfield(L, -2, "workers");
-}
+    void push_buffer_view(lua_State *L, SharedBytesPtr bytes, size_t offset,
+                          size_t len)
+    {
+        BufferView *b = static_cast<BufferView *>(
+            lua_newuserdata(L, sizeof(BufferView)));
+        new (b) BufferView{std::move(bytes), offset, len};
+        luaL_getmetatable(L, BUFFER_META);
+        lua_setmetatable(L, -2);
+    }
 
-void set_workers_init_context(const std::string &projectDir,
-                              const std::string &exePath,
-                              bool embedded)
-{
-    g_init_ctx.projectDir = projectDir;
-    g_init_ctx.exePath = exePath;
-    g_init_ctx.embedded = embedded;
-    g_init_ctx.initialized = true;
+    // Convertit (i, j) façon string.sub en intervalle [start, stop)
+    // borné à [0, len].
+    void sub_range(lua_Integer i, lua_Integer j, size_t len,
+                   size_t &start, size_t &stop)
+    {
+        lua_Integer n = static_cast<lua_Integer>(len);
+        if (i < 0)
+            i = (i < -n) ? 1 : n + i + 1;
+        else if (i == 0)
+            i = 1;
+        if (j < 0)
+            j = (j < -n) ? 0 : n + j + 1;
+        else if (j > n)
+            j = n;
+        if (i > j)
+        {
+            start = stop = 0;
+            return;
+        }
+        start = static_cast<size_t>(i - 1);
+        stop = static_cast<size_t>(j);
+    }
+
+    int lua_workers_buffer(lua_State *L)
+    {
+        if (lua_type(L, 1) == LUA_TNUMBER)
+        {
+            lua_Integer n = luaL_checkinteger(L, 1);
+            if (n < 0 || n > MAX_BUFFER_SIZE)
+            {
+                return luaL_error(L,
+                                  "workers.buffer: size must be in 0..%I (got %I)",
+                                  MAX_BUFFER_SIZE, n);
+            }
+            size_t size = static_cast<size_t>(n);
+            std::unique_ptr<char[]> data(new (std::nothrow) char[size]());
+            if (!data)
+            {
+                return push_fail(L, "workers: buffer: out of memory");
+            }
+            push_buffer_view(L,
+                             std::make_shared<SharedBytes>(std::move(data), size),
+                             0, size);
+            return 1;
+        }
+        if (lua_type(L, 1) == LUA_TSTRING)
+        {
+            size_t size = 0;
+            const char *s = lua_tolstring(L, 1, &size);
+            std::unique_ptr<char[]> data(new (std::nothrow) char[size]);
+            if (!data)
+            {
+                return push_fail(L, "workers: buffer: out of memory");
+            }
+            std::memcpy(data.get(), s, size);
+            push_buffer_view(L,
+                             std::make_shared<SharedBytes>(std::move(data), size),
+                             0, size);
+            return 1;
+        }
+        return luaL_error(L,
+                          "workers.buffer: expected a size (integer) or a string");
+    }
+
+    int buffer_size(lua_State *L)
+    {
+        BufferView *b = check_buffer(L, 1);
+        lua_pushinteger(L, static_cast<lua_Integer>(b->len));
+        return 1;
+    }
+
+    int buffer_tostring_bytes(lua_State *L)
+    {
+        BufferView *b = check_buffer(L, 1);
+        lua_Integer i = luaL_optinteger(L, 2, 1);
+        lua_Integer j = luaL_optinteger(L, 3, -1);
+        size_t start, stop;
+        sub_range(i, j, b->len, start, stop);
+        lua_pushlstring(L, b->bytes->data.get() + b->offset + start,
+                        stop - start);
+        return 1;
+    }
+
+    int buffer_slice(lua_State *L)
+    {
+        BufferView *b = check_buffer(L, 1);
+        lua_Integer i = luaL_optinteger(L, 2, 1);
+        lua_Integer j = luaL_optinteger(L, 3, -1);
+        size_t start, stop;
+        sub_range(i, j, b->len, start, stop);
+        push_buffer_view(L, b->bytes, b->offset + start, stop - start);
+        return 1;
+    }
+
+    // buf:write(pos, str) -> (true, nil). Écrire dans un buffer gelé ou
+    // hors de la vue est une faute de programmeur : luaL_error.
+    int buffer_write(lua_State *L)
+    {
+        BufferView *b = check_buffer(L, 1);
+        lua_Integer pos = luaL_checkinteger(L, 2);
+        size_t len = 0;
+        const char *s = luaL_checklstring(L, 3, &len);
+        if (b->bytes->frozen.load(std::memory_order_acquire))
+        {
+            return luaL_error(L, "workers: buffer: buffer is frozen");
+        }
+        if (pos < 1 || static_cast<lua_Unsigned>(pos - 1) > b->len ||
+            len > b->len - static_cast<size_t>(pos - 1))
+        {
+            return luaL_error(L,
+                              "workers: buffer: write out of bounds "
+                              "(pos %I, %I bytes, size %I)",
+                              pos, static_cast<lua_Integer>(len),
+                              static_cast<lua_Integer>(b->len));
+        }
+        std::memcpy(b->bytes->data.get() + b->offset + (pos - 1), s, len);
+        return push_ok(L);
+    }
+
+    int buffer_freeze(lua_State *L)
+    {
+        BufferView *b = check_buffer(L, 1);
+        b->bytes->frozen.store(true, std::memory_order_release);
+        return push_ok(L);
+    }
+
+    int buffer_frozen(lua_State *L)
+    {
+        BufferView *b = check_buffer(L, 1);
+        lua_pushboolean(L, b->bytes->frozen.load(std::memory_order_acquire));
+        return 1;
+    }
+
+    int buffer_gc(lua_State *L)
+    {
+        BufferView *b = static_cast<BufferView *>(
+            luaL_testudata(L, 1, BUFFER_META));
+        if (!b)
+            return 0;
+        // Relâche la référence : le bloc est libéré avec la dernière
+        // vue ou le dernier message qui le référence.
+        b->~BufferView();
+        return 0;
+    }
+
+    int buffer_tostring(lua_State *L)
+    {
+        BufferView *b = check_buffer(L, 1);
+        char buf[80];
+        std::snprintf(buf, sizeof(buf), "WorkerBuffer(%zu bytes%s)", b->len,
+                      b->bytes->frozen.load(std::memory_order_acquire)
+                          ? ", frozen"
+                          : "");
+        lua_pushstring(L, buf);
+        return 1;
+    }
+
+    // =================================================================
+    // Channels autonomes : API Lua
+    // =================================================================
+    //
+    // babet.workers.channel([capacity]) -> channel | (nil, err)
+    //   ch:send(value [, timeout])  -> (true, nil) | (false, reason)
+    //   ch:recv([timeout])          -> (true, value) | (false, reason)
+    //   ch:try_recv()               -> ch:recv(0)
+    //   ch:close()                  -> (true, nil)
+    // babet.workers.select({ch1, ch2, ...} [, timeout])
+    //   -> (true, index, value) | (false, reason)
+    //
+    // Mêmes conventions que w:send / w:recv (pcall-style, reasons
+    // "full"/"empty"/"timeout"/"closed"). Un channel se transmet par
+    // référence comme un buffer : dans args, send/recv, submit ou un
+    // résultat, chaque lua_State reçoit un userdata pointant sur la
+    // MÊME file.
+
+    ChannelPtr *check_channel(lua_State *L, int idx)
+    {
+        return static_cast<ChannelPtr *>(luaL_checkudata(L, idx, CHANNEL_META));
+    }
+
+    void push_channel(lua_State *L, ChannelPtr ch)
+    {
+        ChannelPtr *c = static_cast<ChannelPtr *>(
+            lua_newuserdata(L, sizeof(ChannelPtr)));
+        new (c) ChannelPtr(std::move(ch));
+        luaL_getmetatable(L, CHANNEL_META);
+        lua_setmetatable(L, -2);
+    }
+
+    int lua_workers_channel(lua_State *L)
+    {
+        lua_Integer cap = luaL_optinteger(L, 1, 64);
+        if (cap < 1 || cap > 1000000)
+        {
+            return luaL_error(L,
+                              "workers.channel: capacity must be in 1..1000000 (got %I)",
+                              cap);
+        }
+        auto ch = std::make_shared<Channel>();
+        if (!ch->q.init(static_cast<size_t>(cap)))
+        {
+            return push_fail(L, "workers: failed to initialize channel queue");
+        }
+        push_channel(L, std::move(ch));
+        return 1;
+    }
+
+    int channel_send(lua_State *L)
+    {
+        ChannelPtr &ch = *check_channel(L, 1);
+        // Timeout parsé AVANT toute allocation C++ (cf. worker_send).
+        int64_t timeout_ms = parse_timeout_arg(L, 3);
+
+        Message msg;
+        std::string err;
+        if (!serialize_value(L, 2, msg, err))
+        {
+            return push_fail(L, err);
+        }
+        auto r = ch->q.push(std::move(msg), timeout_ms);
+        lua_pushboolean(L, r.first);
+        if (r.first)
+            lua_pushnil(L);
+        else
+            lua_pushstring(L, r.second);
+        return 2;
+    }
+
+    // Dépile un message de `q` et pousse (true, value) ou (false, reason).
+    int channel_pop(lua_State *L, MessageQueue &q, int64_t timeout_ms)
+    {
+        Message msg;
+        auto r = q.pop(msg, timeout_ms);
+        if (!r.first)
+        {
+            lua_pushboolean(L, 0);
+            lua_pushstring(L, r.second);
+            return 2;
+        }
+        std::string err;
+        if (!deserialize_value(L, msg, err))
+        {
+            lua_pushboolean(L, 0);
+            lua_pushstring(L, err.c_str());
+            return 2;
+        }
+        lua_pushboolean(L, 1);
+        lua_insert(L, -2);
+        return 2;
+    }
+
+    int channel_recv(lua_State *L)
+    {
+        ChannelPtr &ch = *check_channel(L, 1);
+        int64_t timeout_ms = parse_timeout_arg(L, 2);
+        return channel_pop(L, ch->q, timeout_ms);
+    }
+
+    int channel_try_recv(lua_State *L)
+    {
+        ChannelPtr &ch = *check_channel(L, 1);
+        return channel_pop(L, ch->q, 0);
+    }
+
+    int channel_close(lua_State *L)
+    {
+        ChannelPtr &ch = *check_channel(L, 1);
+        // Idempotent. Les messages déjà en file restent lisibles ; une
+        // fois drainée, recv() rend (false, "closed") partout.
+        ch->q.close();
+        return push_ok(L);
+    }
+
+    int channel_gc(lua_State *L)
+    {
+        ChannelPtr *c = static_cast<ChannelPtr *>(
+            luaL_testudata(L, 1, CHANNEL_META));
+        if (!c)
+            return 0;
+        // Relâche la référence ; la file est détruite avec la dernière.
+        c->~ChannelPtr();
+        return 0;
+    }
+
+    int channel_tostring(lua_State *L)
+    {
+        ChannelPtr &ch = *check_channel(L, 1);
+        pthread_mutex_lock(&ch->q.mu);
+        size_t queued = ch->q.q.size();
+        bool closed = ch->q.closed;
+        pthread_mutex_unlock(&ch->q.mu);
+        char buf[80];
+        std::snprintf(buf, sizeof(buf), "WorkerChannel(%zu/%zu%s)", queued,
+                      ch->q.capacity, closed ? ", closed" : "");
+        lua_pushstring(L, buf);
+        return 1;
+    }
+
+    // Point de départ tournant du balayage de select() : sans lui, le
+    // premier channel de la liste affamerait les suivants dès qu'il
+    // reçoit en continu.
+    std::atomic<size_t> g_select_rr{0};
+
+    // babet.workers.select(channels [, timeout])
+    //
+    // Balaye les channels sans bloquer ; si aucun n'a de message, le
+    // thread s'inscrit comme waiter sur tous et dort jusqu'à une
+    // insertion ou une fermeture, puis recommence. L'inscription se
+    // fait AVANT le premier balayage : un send qui arrive entre le
+    // balayage et le sommeil positionne `signaled`, pas de réveil perdu.
+    //
+    // Rend (false, "closed") quand tous les channels sont fermés ET
+    // vides, (false, "empty") si timeout == 0 sans message,
+    // (false, "timeout") si la deadline expire.
+    int lua_workers_select(lua_State *L)
+    {
+        luaL_checktype(L, 1, LUA_TTABLE);
+        int64_t timeout_ms = parse_timeout_arg(L, 2);
+
+        // Validation complète AVANT toute allocation C++ (luaL_error).
+        lua_Integer n = static_cast<lua_Integer>(lua_rawlen(L, 1));
+        if (n < 1)
+        {
+            return luaL_error(L, "workers.select: expected a non-empty array of channels");
+        }
+        for (lua_Integer i = 1; i <= n; ++i)
+        {
+            lua_rawgeti(L, 1, i);
+            if (!luaL_testudata(L, -1, CHANNEL_META))
+            {
+                return luaL_error(L, "workers.select: element #%I is not a channel", i);
+            }
+            lua_pop(L, 1);
+        }
+
+        std::vector<ChannelPtr> chans;
+        chans.reserve(static_cast<size_t>(n));
+        for (lua_Integer i = 1; i <= n; ++i)
+        {
+            lua_rawgeti(L, 1, i);
+            chans.push_back(*static_cast<ChannelPtr *>(lua_touserdata(L, -1)));
+            lua_pop(L, 1);
+        }
+
+        SelectWaiter waiter;
+        for (ChannelPtr &c : chans)
+            c->q.add_watcher(&waiter);
+        struct WatchGuard
+        {
+            std::vector<ChannelPtr> &chans;
+            SelectWaiter &waiter;
+            ~WatchGuard()
+            {
+                for (ChannelPtr &c : chans)
+                    c->q.remove_watcher(&waiter);
+            }
+        } guard{chans, waiter};
+
+        struct timespec deadline;
+        if (timeout_ms > 0)
+            MessageQueue::compute_deadline(timeout_ms, deadline);
+
+        const size_t count = chans.size();
+        const size_t start = g_select_rr.fetch_add(1, std::memory_order_relaxed) % count;
+        for (;;)
+        {
+            size_t closed_count = 0;
+            for (size_t k = 0; k < count; ++k)
+            {
+                size_t i = (start + k) % count;
+                Message msg;
+                auto r = chans[i]->q.pop(msg, 0);
+                if (r.first)
+                {
+                    std::string err;
+                    if (!deserialize_value(L, msg, err))
+                    {
+                        lua_pushboolean(L, 0);
+                        lua_pushstring(L, err.c_str());
+                        return 2;
+                    }
+                    lua_pushboolean(L, 1);
+                    lua_pushinteger(L, static_cast<lua_Integer>(i + 1));
+                    lua_rotate(L, -3, 2); // true, index, value
+                    return 3;
+                }
+                if (std::strcmp(r.second, "closed") == 0)
+                    ++closed_count;
+            }
+            if (closed_count == count)
+            {
+                lua_pushboolean(L, 0);
+                lua_pushstring(L, "closed");
+                return 2;
+            }
+            if (timeout_ms == 0)
+            {
+                lua_pushboolean(L, 0);
+                lua_pushstring(L, "empty");
+                return 2;
+            }
+
+            pthread_mutex_lock(&waiter.mu);
+            while (!waiter.signaled)
+            {
+                if (timeout_ms < 0)
+                {
+                    pthread_cond_wait(&waiter.cv, &waiter.mu);
+                }
+                else if (pthread_cond_timedwait(&waiter.cv, &waiter.mu,
+                                                &deadline) == ETIMEDOUT)
+                {
+                    break;
+                }
+            }
+            bool woke = waiter.signaled;
+            waiter.signaled = false;
+            pthread_mutex_unlock(&waiter.mu);
+            if (!woke)
+            {
+                lua_pushboolean(L, 0);
+                lua_pushstring(L, "timeout");
+                return 2;
+            }
+        }
+    }
+
+    // =================================================================
+    // Tables partagées en lecture seule (babet.workers.share)
+    // =================================================================
+    //
+    // Une grosse table de référence (config + données) envoyée à N
+    // workers était sérialisée puis reconstruite N fois : N copies
+    // complètes en RSS. share(tbl) la fige UNE fois dans une structure
+    // C++ compacte et immuable, référencée (shared_ptr) par autant de
+    // proxys que nécessaire, dans autant de lua_State que nécessaire.
+    // Comme les buffers et les channels, un snapshot traverse les
+    // messages par référence : aucun octet n'est copié.
+    //
+    // Représentation (Snapshot) :
+    //   - `tables` : une entrée SnapTable par table Lua atteinte. Une
+    //     sous-table référencée deux fois (ou un cycle) n'est figée
+    //     qu'une fois : les références deviennent des indices.
+    //   - partie séquence : t[1..#t] dans `array` (accès direct) ;
+    //   - partie hash : table d'adressage ouvert (sondage linéaire,
+    //     taille puissance de 2, charge <= 1/2) dans `slots` ;
+    //   - `arena` : toutes les strings (clés et valeurs) bout à bout,
+    //     dédoublonnées à la construction.
+    // Lookup O(1) sans allocation ; seule la string rendue à Lua est
+    // créée (et internée par Lua si elle est courte).
+    //
+    // Le proxy (userdata SHARED_META) rend t[k], #t, pairs(t), ipairs(t)
+    // comme une table ordinaire ; toute écriture lève une erreur. Les
+    // sous-tables sont rendues comme de nouveaux proxys sur le même
+    // snapshot.
+
+    enum : uint8_t
+    {
+        SV_NIL = 0,
+        SV_FALSE,
+        SV_TRUE,
+        SV_INT,
+        SV_FLOAT,
+        SV_STRING,
+        SV_TABLE,
+    };
+
+    struct SnapVal
+    {
+        uint8_t type = SV_NIL;
+        uint32_t len = 0; // SV_STRING : longueur dans l'arène
+        union
+        {
+            int64_t i;
+            double n;
+            uint64_t off; // SV_STRING : offset dans l'arène
+            uint64_t tbl; // SV_TABLE : index dans Snapshot::tables
+        };
+        SnapVal() : i(0) {}
+    };
+
+    struct SnapSlot
+    {
+        SnapVal key; // SV_NIL = slot libre
+        SnapVal val;
+    };
+
+    struct SnapTable
+    {
+        uint64_t array_first = 0;
+        uint64_t array_len = 0;
+        uint64_t slots_first = 0;
+        uint64_t slots_len = 0; // 0 ou puissance de 2
+        uint64_t hash_count = 0;
+    };
+
+    struct Snapshot
+    {
+        std::vector<SnapTable> tables;
+        std::vector<SnapVal> array;
+        std::vector<SnapSlot> slots;
+        std::string arena;
+
+        size_t bytes() const
+        {
+            return sizeof(Snapshot) + tables.capacity() * sizeof(SnapTable) +
+                   array.capacity() * sizeof(SnapVal) +
+                   slots.capacity() * sizeof(SnapSlot) + arena.capacity();
+        }
+    };
+
+    size_t snap_table_count(const Snapshot &s) { return s.tables.size(); }
+
+    uint64_t mix64(uint64_t x)
+    {
+        // splitmix64 : disperse les entiers consécutifs.
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    uint64_t hash_bytes(const char *s, size_t len)
+    {
+        // FNV-1a 64 bits.
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for (size_t i = 0; i < len; ++i)
+        {
+            h ^= static_cast<unsigned char>(s[i]);
+            h *= 0x100000001b3ULL;
+        }
+        return h;
+    }
+
+    // Clé de recherche, indépendante de l'endroit où vivent les octets
+    // (pile Lua à la recherche, arène à la construction).
+    struct SnapKey
+    {
+        uint8_t type;
+        int64_t i;
+        double n;
+        const char *s;
+        size_t len;
+    };
+
+    uint64_t hash_key(const SnapKey &k)
+    {
+        switch (k.type)
+        {
+        case SV_STRING:
+            return hash_bytes(k.s, k.len);
+        case SV_INT:
+            return mix64(static_cast<uint64_t>(k.i));
+        case SV_FLOAT:
+        {
+            uint64_t bits;
+            std::memcpy(&bits, &k.n, sizeof(bits));
+            return mix64(bits ^ 0x5bd1e995ULL);
+        }
+        default:
+            return mix64(k.type);
+        }
+    }
+
+    bool key_equals(const Snapshot &s, const SnapVal &v, const SnapKey &k)
+    {
+        if (v.type != k.type)
+            return false;
+        switch (k.type)
+        {
+        case SV_STRING:
+            return v.len == k.len &&
+                   std::memcmp(s.arena.data() + v.off, k.s, k.len) == 0;
+        case SV_INT:
+            return v.i == k.i;
+        case SV_FLOAT:
+            return v.n == k.n;
+        default:
+            return true; // SV_FALSE / SV_TRUE
+        }
+    }
+
+    SnapKey key_of(const Snapshot &s, const SnapVal &v)
+    {
+        SnapKey k{v.type, 0, 0.0, nullptr, 0};
+        if (v.type == SV_STRING)
+        {
+            k.s = s.arena.data() + v.off;
+            k.len = v.len;
+        }
+        else if (v.type == SV_INT)
+            k.i = v.i;
+        else if (v.type == SV_FLOAT)
+            k.n = v.n;
+        return k;
+    }
+
+    // Position du slot de `k` dans la partie hash de `t` (relative à
+    // slots_first), ou -1 si absente.
+    int64_t find_slot(const Snapshot &s, const SnapTable &t, const SnapKey &k)
+    {
+        if (t.slots_len == 0)
+            return -1;
+        uint64_t mask = t.slots_len - 1;
+        for (uint64_t pos = hash_key(k) & mask;; pos = (pos + 1) & mask)
+        {
+            const SnapVal &sk = s.slots[t.slots_first + pos].key;
+            if (sk.type == SV_NIL)
+                return -1;
+            if (key_equals(s, sk, k))
+                return static_cast<int64_t>(pos);
+        }
+    }
+
+    // Lit la clé Lua à `idx` (sans la modifier : lua_tolstring n'est
+    // appelé que sur de vraies strings). false si ce type ne peut pas
+    // être une clé de snapshot (la recherche rend alors nil).
+    bool to_snap_key(lua_State *L, int idx, SnapKey &k)
+    {
+        k = SnapKey{SV_NIL, 0, 0.0, nullptr, 0};
+        switch (lua_type(L, idx))
+        {
+        case LUA_TSTRING:
+            k.type = SV_STRING;
+            k.s = lua_tolstring(L, idx, &k.len);
+            return true;
+        case LUA_TNUMBER:
+            if (lua_isinteger(L, idx))
+            {
+                k.type = SV_INT;
+                k.i = lua_tointeger(L, idx);
+                return true;
+            }
+            else
+            {
+                // Comme Lua : 2.0 et 2 sont la même clé.
+                lua_Number n = lua_tonumber(L, idx);
+                if (n == std::floor(n) && n >= -9223372036854775808.0 &&
+                    n < 9223372036854775808.0)
+                {
+                    k.type = SV_INT;
+                    k.i = static_cast<int64_t>(n);
+                }
+                else
+                {
+                    k.type = SV_FLOAT;
+                    k.n = n;
+                }
+                return true;
+            }
+        case LUA_TBOOLEAN:
+            k.type = lua_toboolean(L, idx) ? SV_TRUE : SV_FALSE;
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // ----- Construction ----------------------------------------------
+
+    struct SnapBuilder
+    {
+        Snapshot &s;
+        std::unordered_map<const void *, uint64_t> seen; // table Lua -> index
+        std::unordered_map<std::string, uint64_t> strings; // dédoublonnage
+        std::string err;
+
+        bool intern(lua_State *L, int idx, SnapVal &out)
+        {
+            size_t len = 0;
+            const char *p = lua_tolstring(L, idx, &len);
+            if (len > UINT32_MAX)
+            {
+                err = "workers.share: string too large";
+                return false;
+            }
+            std::string key(p, len);
+            auto it = strings.find(key);
+            if (it == strings.end())
+            {
+                it = strings.emplace(std::move(key), s.arena.size()).first;
+                s.arena.append(p, len);
+            }
+            out.type = SV_STRING;
+            out.len = static_cast<uint32_t>(len);
+            out.off = it->second;
+            return true;
+        }
+
+        // Valeur Lua (non nil) à `idx` -> SnapVal. Les tables sont
+        // figées récursivement.
+        bool value(lua_State *L, int idx, SnapVal &out, int depth)
+        {
+            switch (lua_type(L, idx))
+            {
+            case LUA_TBOOLEAN:
+                out.type = lua_toboolean(L, idx) ? SV_TRUE : SV_FALSE;
+                return true;
+            case LUA_TNUMBER:
+                if (lua_isinteger(L, idx))
+                {
+                    out.type = SV_INT;
+                    out.i = lua_tointeger(L, idx);
+                }
+                else
+                {
+                    out.type = SV_FLOAT;
+                    out.n = lua_tonumber(L, idx);
+                }
+                return true;
+            case LUA_TSTRING:
+                return intern(L, idx, out);
+            case LUA_TTABLE:
+            {
+                uint64_t ti;
+                if (!table(L, lua_absindex(L, idx), ti, depth + 1))
+                    return false;
+                out.type = SV_TABLE;
+                out.tbl = ti;
+                return true;
+            }
+            default:
+                err = std::string("workers.share: cannot share a ") +
+                      lua_typename(L, lua_type(L, idx)) +
+                      " (only booleans, numbers, strings and tables)";
+                return false;
+            }
+        }
+
+        bool table(lua_State *L, int idx, uint64_t &out, int depth)
+        {
+            if (depth > MAX_SERIALIZATION_DEPTH || !lua_checkstack(L, 4))
+            {
+                err = "workers.share: table too deeply nested";
+                return false;
+            }
+            const void *ptr = lua_topointer(L, idx);
+            auto it = seen.find(ptr);
+            if (it != seen.end())
+            {
+                out = it->second;
+                return true;
+            }
+            out = s.tables.size();
+            seen.emplace(ptr, out);
+            s.tables.emplace_back();
+
+            // Partie séquence : t[1..#t] (trous éventuels sous la
+            // bordure stockés nil, comme t le rendrait).
+            uint64_t n = lua_rawlen(L, idx);
+            std::vector<SnapVal> arr(n);
+            for (uint64_t i = 0; i < n; ++i)
+            {
+                lua_rawgeti(L, idx, static_cast<lua_Integer>(i + 1));
+                bool ok = lua_isnil(L, -1) ||
+                          value(L, -1, arr[i], depth);
+                lua_pop(L, 1);
+                if (!ok)
+                    return false;
+            }
+
+            // Partie hash : tout le reste.
+            std::vector<SnapSlot> entries;
+            lua_pushnil(L);
+            while (lua_next(L, idx) != 0)
+            {
+                if (lua_isinteger(L, -2))
+                {
+                    lua_Integer k = lua_tointeger(L, -2);
+                    if (k >= 1 && static_cast<uint64_t>(k) <= n)
+                    {
+                        lua_pop(L, 1);
+                        continue;
+                    }
+                }
+                SnapSlot e;
+                int kt = lua_type(L, -2);
+                if (kt != LUA_TSTRING && kt != LUA_TNUMBER &&
+                    kt != LUA_TBOOLEAN)
+                {
+                    lua_pop(L, 2);
+                    err = std::string("workers.share: unsupported key type ") +
+                          lua_typename(L, kt);
+                    return false;
+                }
+                // Clé string : intern() ne touche pas la pile (pas de
+                // lua_tolstring sur un nombre, qui casserait lua_next).
+                if (!value(L, -2, e.key, depth) ||
+                    !value(L, -1, e.val, depth))
+                {
+                    lua_pop(L, 2);
+                    return false;
+                }
+                entries.push_back(e);
+                lua_pop(L, 1);
+            }
+
+            SnapTable t;
+            t.array_first = s.array.size();
+            t.array_len = n;
+            s.array.insert(s.array.end(), arr.begin(), arr.end());
+
+            t.hash_count = entries.size();
+            if (!entries.empty())
+            {
+                uint64_t cap = 2;
+                while (cap < entries.size() * 2)
+                    cap <<= 1;
+                t.slots_first = s.slots.size();
+                t.slots_len = cap;
+                s.slots.resize(s.slots.size() + cap);
+                for (const SnapSlot &e : entries)
+                {
+                    SnapKey k = key_of(s, e.key);
+                    uint64_t pos = hash_key(k) & (cap - 1);
+                    while (s.slots[t.slots_first + pos].key.type != SV_NIL)
+                        pos = (pos + 1) & (cap - 1);
+                    s.slots[t.slots_first + pos] = e;
+                }
+            }
+            s.tables[out] = t;
+            return true;
+        }
+    };
+
+    // ----- Proxy Lua ---------------------------------------------------
+
+    SharedRef *check_shared(lua_State *L, int idx)
+    {
+        return static_cast<SharedRef *>(luaL_checkudata(L, idx, SHARED_META));
+    }
+
+    void push_shared(lua_State *L, SnapshotPtr snap, uint64_t table)
+    {
+        SharedRef *r = static_cast<SharedRef *>(
+            lua_newuserdata(L, sizeof(SharedRef)));
+        new (r) SharedRef{std::move(snap), table};
+        luaL_getmetatable(L, SHARED_META);
+        lua_setmetatable(L, -2);
+    }
+
+    void push_snap_value(lua_State *L, const SnapshotPtr &snap,
+                         const SnapVal &v)
+    {
+        switch (v.type)
+        {
+        case SV_FALSE:
+        case SV_TRUE:
+            lua_pushboolean(L, v.type == SV_TRUE);
+            break;
+        case SV_INT:
+            lua_pushinteger(L, static_cast<lua_Integer>(v.i));
+            break;
+        case SV_FLOAT:
+            lua_pushnumber(L, static_cast<lua_Number>(v.n));
+            break;
+        case SV_STRING:
+            lua_pushlstring(L, snap->arena.data() + v.off, v.len);
+            break;
+        case SV_TABLE:
+            push_shared(L, snap, v.tbl);
+            break;
+        default:
+            lua_pushnil(L);
+            break;
+        }
+    }
+
+    // workers.share(tbl) -> shared | (nil, err)
+    int lua_workers_share(lua_State *L)
+    {
+        luaL_checktype(L, 1, LUA_TTABLE);
+        auto snap = std::make_shared<Snapshot>();
+        uint64_t root = 0;
+        {
+            SnapBuilder b{*snap, {}, {}, {}};
+            if (!b.table(L, 1, root, 0))
+                return push_fail(L, b.err);
+        }
+        snap->tables.shrink_to_fit();
+        snap->array.shrink_to_fit();
+        snap->slots.shrink_to_fit();
+        snap->arena.shrink_to_fit();
+        push_shared(L, std::move(snap), root);
+        return 1;
+    }
+
+    // __index : t[k], O(1). Accès à la partie séquence si k est un
+    // entier de 1..#t, sinon sondage de la partie hash.
+    int shared_index(lua_State *L)
+    {
+        SharedRef *r = check_shared(L, 1);
+        const Snapshot &s = *r->snap;
+        const SnapTable &t = s.tables[r->table];
+        SnapKey k;
+        if (!to_snap_key(L, 2, k))
+        {
+            lua_pushnil(L);
+            return 1;
+        }
+        if (k.type == SV_INT && k.i >= 1 &&
+            static_cast<uint64_t>(k.i) <= t.array_len)
+        {
+            push_snap_value(L, r->snap,
+                            s.array[t.array_first + static_cast<uint64_t>(k.i) - 1]);
+            return 1;
+        }
+        int64_t pos = find_slot(s, t, k);
+        if (pos < 0)
+        {
+            lua_pushnil(L);
+            return 1;
+        }
+        push_snap_value(L, r->snap,
+                        s.slots[t.slots_first + static_cast<uint64_t>(pos)].val);
+        return 1;
+    }
+
+    int shared_newindex(lua_State *L)
+    {
+        return luaL_error(L, "workers: shared table is read-only");
+    }
+
+    int shared_len(lua_State *L)
+    {
+        SharedRef *r = check_shared(L, 1);
+        lua_pushinteger(L, static_cast<lua_Integer>(
+                               r->snap->tables[r->table].array_len));
+        return 1;
+    }
+
+    // next(t, k) sur un proxy : séquence d'abord, puis slots de la
+    // partie hash dans l'ordre de stockage. Reprise O(1) à partir de
+    // la clé précédente (index direct ou sondage).
+    int shared_next(lua_State *L)
+    {
+        SharedRef *r = check_shared(L, 1);
+        const Snapshot &s = *r->snap;
+        const SnapTable &t = s.tables[r->table];
+        lua_settop(L, 2);
+
+        uint64_t pos = 0; // position globale : [0, array_len) puis slots
+        if (!lua_isnil(L, 2))
+        {
+            SnapKey k;
+            if (!to_snap_key(L, 2, k))
+                return luaL_error(L, "workers: invalid key to 'next'");
+            if (k.type == SV_INT && k.i >= 1 &&
+                static_cast<uint64_t>(k.i) <= t.array_len)
+            {
+                pos = static_cast<uint64_t>(k.i);
+            }
+            else
+            {
+                int64_t sp = find_slot(s, t, k);
+                if (sp < 0)
+                    return luaL_error(L, "workers: invalid key to 'next'");
+                pos = t.array_len + static_cast<uint64_t>(sp) + 1;
+            }
+        }
+        for (; pos < t.array_len; ++pos)
+        {
+            const SnapVal &v = s.array[t.array_first + pos];
+            if (v.type != SV_NIL)
+            {
+                lua_pushinteger(L, static_cast<lua_Integer>(pos + 1));
+                push_snap_value(L, r->snap, v);
+                return 2;
+            }
+        }
+        for (uint64_t sp = pos - t.array_len; sp < t.slots_len; ++sp)
+        {
+            const SnapSlot &e = s.slots[t.slots_first + sp];
+            if (e.key.type != SV_NIL)
+            {
+                push_snap_value(L, r->snap, e.key);
+                push_snap_value(L, r->snap, e.val);
+                return 2;
+            }
+        }
+        lua_pushnil(L);
+        return 1;
+    }
+
+    int shared_pairs(lua_State *L)
+    {
+        check_shared(L, 1);
+        lua_pushcfunction(L, shared_next);
+        lua_pushvalue(L, 1);
+        lua_pushnil(L);
+        return 3;
+    }
+
+    int shared_gc(lua_State *L)
+    {
+        SharedRef *r = static_cast<SharedRef *>(
+            luaL_testudata(L, 1, SHARED_META));
+        if (r)
+            r->~SharedRef();
+        return 0;
+    }
+
+    int shared_tostring(lua_State *L)
+    {
+        SharedRef *r = check_shared(L, 1);
+        const SnapTable &t = r->snap->tables[r->table];
+        char buf[96];
+        std::snprintf(buf, sizeof(buf), "WorkerShared(%llu + %llu entries, %zu bytes)",
+                      static_cast<unsigned long long>(t.array_len),
+                      static_cast<unsigned long long>(t.hash_count),
+                      r->snap->bytes());
+        lua_pushstring(L, buf);
+        return 1;
+    }
+
+    // =================================================================
+    // Pool de workers persistants (babet.workers.pool)
+    // =================================================================
+    //
+    // spawn() paie à chaque job : pthread_create + luaL_newstate +
+    // luaL_openlibs + register_bundled_modules + register_babet, puis
+    // lua_close + pthread_join. Pour des milliers de tâches courtes, ce
+    // setup (de l'ordre de la milliseconde) domine le temps utile.
+    //
+    // Le pool garde N threads vivants, chacun avec SON lua_State chaud :
+    // configuré une fois par new_worker_state(), puis par un chunk
+    // d'init optionnel (typiquement les require() des modules
+    // utilisateur). Les tâches sont sérialisées côté parent, poussées
+    // dans une file commune et exécutées par le premier thread libre.
+    // Le parent récupère un future par tâche.
+    //
+    // Isolation : les tâches exécutées par un même thread partagent son
+    // lua_State. Les globales posées par une tâche restent donc visibles
+    // des suivantes sur ce thread — c'est le prix du "chaud", documenté.
+    // La pile est remise à zéro entre deux tâches.
+
+    constexpr const char *POOL_META = "LuapilotWorkerPool";
+    constexpr const char *FUTURE_META = "LuapilotWorkerFuture";
+
+    // Bornes de taille du pool. Au-delà de 1024 threads on n'accélère
+    // plus rien, on consomme juste de la mémoire (un lua_State chaud
+    // par thread).
+    constexpr lua_Integer MAX_POOL_SIZE = 1024;
+
+    // Cache des chunks compilés dans le lua_State d'un thread du pool
+    // (clé registry, table source -> fonction). Évite de recompiler le
+    // même code à chaque submit. Borné : un script qui génère du code à
+    // la volée ne doit pas faire grossir l'état indéfiniment ; au-delà,
+    // on repart d'un cache vide.
+    constexpr const char *POOL_CHUNK_CACHE = "babet.workers.pool.chunks";
+    constexpr int MAX_CACHED_CHUNKS = 256;
+
+    // Une tâche soumise au pool. Partagée (shared_ptr) entre la file,
+    // le thread qui l'exécute et le future côté parent : le premier qui
+    // lâche sa référence ne libère rien sous les pieds des autres.
+    //
+    // Publication du résultat : le thread écrit result_buf / err_msg
+    // PUIS passe status à WORKER_DONE / WORKER_ERROR sous `mu` et
+    // réveille les join() en attente via `done_cv`.
+    //
+    // Les primitives pthread sont initialisées dans le ctor : avec les
+    // attributs par défaut, pthread_mutex_init / pthread_cond_init ne
+    // peuvent pas échouer sous glibc (contrairement à MessageQueue, on
+    // n'a pas de chemin d'échec à remonter).
+    // Nature d'une tâche de pool. TASK_MAP / TASK_REDUCE portent un
+    // morceau du tableau de workers.map / workers.reduce : la fonction
+    // est appliquée à chaque élément dans le thread, et un seul message
+    // (tableau des résultats ou accumulateur) revient au parent.
+    constexpr int TASK_CALL = 0;
+    constexpr int TASK_MAP = 1;
+    constexpr int TASK_REDUCE = 2;
+
+    struct PoolTask
+    {
+        std::string code;      // source Lua OU nom de fonction ("mod.fn")
+        bool is_function;      // true si `code` désigne une fonction
+        Message args_buf;      // argument unique sérialisé
+
+        // Morceaux de map/reduce : args_buf est le tableau des `count`
+        // éléments ; `base` + j est l'index d'origine de l'élément j.
+        int mode;
+        lua_Integer base;
+        lua_Integer count;
+
+        pthread_mutex_t mu;
+        pthread_cond_t done_cv;
+        int status; // WORKER_RUNNING tant que non terminée
+        Message result_buf;
+        std::string err_msg;
+
+        PoolTask() : is_function(false), mode(TASK_CALL), base(0), count(0),
+                     status(WORKER_RUNNING)
+        {
+            pthread_mutex_init(&mu, nullptr);
+            pthread_cond_init(&done_cv, nullptr);
+        }
+        ~PoolTask()
+        {
+            pthread_cond_destroy(&done_cv);
+            pthread_mutex_destroy(&mu);
+        }
+        PoolTask(const PoolTask &) = delete;
+        PoolTask &operator=(const PoolTask &) = delete;
+
+        void finish(int st)
+        {
+            pthread_mutex_lock(&mu);
+            status = st;
+            pthread_cond_broadcast(&done_cv);
+            pthread_mutex_unlock(&mu);
+        }
+
+        int load_status()
+        {
+            pthread_mutex_lock(&mu);
+            int st = status;
+            pthread_mutex_unlock(&mu);
+            return st;
+        }
+    };
+
+    using PoolTaskPtr = std::shared_ptr<PoolTask>;
+
+    // =================================================================
+    // Ordonnanceur à vol de tâches (work stealing)
+    // =================================================================
+    //
+    // Une file unique protégée par un seul mutex devient le point de
+    // contention dès que beaucoup de threads consomment des tâches
+    // courtes : chaque pop se sérialise sur le même verrou. Ici, chaque
+    // thread du pool possède SA deque :
+    //   - submit() distribue les tâches en round-robin sur les deques ;
+    //   - le propriétaire consomme l'AVANT de sa deque (ordre FIFO des
+    //     soumissions préservé localement) ;
+    //   - un thread dont la deque est vide vole à l'ARRIÈRE de celle
+    //     d'un autre, ce qui rééquilibre les lots inégaux (une tâche
+    //     longue ne bloque pas les tâches courtes placées derrière elle
+    //     sur le même thread).
+    // Chaque deque a son propre mutex : le propriétaire et un voleur ne
+    // se croisent que lorsqu'ils visent la même deque.
+    //
+    // Endormissement : `pending` compte les tâches en file (toutes
+    // deques confondues). Il est incrémenté AVANT l'insertion et
+    // décrémenté APRÈS le retrait, donc jamais négatif (au pire un
+    // thread voit pending > 0 et refait un tour de vol le temps que
+    // l'insertion aboutisse) ; un thread ne s'endort que si
+    // pending == 0 vu sous `mu`, et submit signale sous `mu` après
+    // incrément — pas de réveil perdu.
+
+    // Deque + statistiques d'un thread du pool. Les compteurs sont
+    // atomiques : écrits par le thread propriétaire, lus par
+    // pool:stats() depuis le parent sans verrou.
+    struct PoolSlot
+    {
+        pthread_mutex_t mu;
+        std::deque<PoolTaskPtr> q;
+
+        std::atomic<uint64_t> tasks_run{0};
+        std::atomic<uint64_t> steals{0};
+        std::atomic<uint64_t> idle_ns{0};
+        // Début du sommeil en cours (0 si le thread travaille) : permet
+        // à stats() de compter aussi l'attente pas encore terminée.
+        std::atomic<uint64_t> idle_since{0};
+
+        // Même remarque que PoolTask : init par défaut infaillible.
+        PoolSlot() { pthread_mutex_init(&mu, nullptr); }
+        ~PoolSlot() { pthread_mutex_destroy(&mu); }
+        PoolSlot(const PoolSlot &) = delete;
+        PoolSlot &operator=(const PoolSlot &) = delete;
+
+        void push_back(PoolTaskPtr t)
+        {
+            pthread_mutex_lock(&mu);
+            q.push_back(std::move(t));
+            pthread_mutex_unlock(&mu);
+        }
+
+        // Côté propriétaire : avant de la deque.
+        PoolTaskPtr pop_front()
+        {
+            PoolTaskPtr t;
+            pthread_mutex_lock(&mu);
+            if (!q.empty())
+            {
+                t = std::move(q.front());
+                q.pop_front();
+            }
+            pthread_mutex_unlock(&mu);
+            return t;
+        }
+
+        // Côté voleur : arrière de la deque.
+        PoolTaskPtr steal_back()
+        {
+            PoolTaskPtr t;
+            pthread_mutex_lock(&mu);
+            if (!q.empty())
+            {
+                t = std::move(q.back());
+                q.pop_back();
+            }
+            pthread_mutex_unlock(&mu);
+            return t;
+        }
+
+        size_t queued()
+        {
+            pthread_mutex_lock(&mu);
+            size_t n = q.size();
+            pthread_mutex_unlock(&mu);
+            return n;
+        }
+    };
+
+    // État du pool, porté par l'userdata Lua. Les threads n'accèdent
+    // qu'aux slots, à `pending`, aux champs protégés par `mu` et à
+    // `init_code` ; le reste est manipulé par le thread Lua parent
+    // uniquement.
+    struct Pool
+    {
+        std::vector<std::unique_ptr<PoolSlot>> slots;
+        std::atomic<size_t> pending{0};
+        size_t next_slot; // round-robin de submit (parent uniquement)
+
+        // `mu` protège closed, started, init_err et sert aux deux
+        // conditions : idle_cv (threads sans travail) et started_cv
+        // (démarrage synchrone dans pool()).
+        pthread_mutex_t mu;
+        pthread_cond_t idle_cv;
+        pthread_cond_t started_cv;
+        bool closed;
+        bool initialized;
+
+        // Démarrage synchrone : pool() attend que chaque thread ait
+        // terminé son init (OK ou KO) avant de rendre la main, pour
+        // remonter une erreur de chunk d'init comme (nil, err).
+        size_t started;
+        std::string init_err;
+
+        std::string init_code;
+        ThreadOpts topts; // cpu / nice / stack_size de chaque thread
+        std::vector<pthread_t> threads;
+        size_t size;
+
+        Pool() : next_slot(0), closed(false), initialized(false),
+                 started(0), size(0) {}
+
+        bool init(size_t n)
+        {
+            if (pthread_mutex_init(&mu, nullptr) != 0)
+                return false;
+            if (pthread_cond_init(&idle_cv, nullptr) != 0)
+            {
+                pthread_mutex_destroy(&mu);
+                return false;
+            }
+            if (pthread_cond_init(&started_cv, nullptr) != 0)
+            {
+                pthread_cond_destroy(&idle_cv);
+                pthread_mutex_destroy(&mu);
+                return false;
+            }
+            initialized = true;
+            slots.reserve(n);
+            for (size_t i = 0; i < n; ++i)
+                slots.push_back(std::make_unique<PoolSlot>());
+            return true;
+        }
+
+        void destroy()
+        {
+            if (!initialized)
+                return;
+            slots.clear();
+            pthread_cond_destroy(&started_cv);
+            pthread_cond_destroy(&idle_cv);
+            pthread_mutex_destroy(&mu);
+            initialized = false;
+        }
+
+        // push : false si le pool est fermé. Appelé par le parent.
+        bool push(PoolTaskPtr t)
+        {
+            pthread_mutex_lock(&mu);
+            bool is_closed = closed;
+            pthread_mutex_unlock(&mu);
+            if (is_closed)
+                return false;
+
+            // Compté AVANT d'être visible : un thread qui la prend
+            // aussitôt ne doit pas décrémenter un pending encore à 0
+            // (size_t replié -> threads qui tournent à vide).
+            pending.fetch_add(1, std::memory_order_release);
+            try
+            {
+                slots[next_slot]->push_back(std::move(t));
+            }
+            catch (...)
+            {
+                pending.fetch_sub(1, std::memory_order_release);
+                throw;
+            }
+            next_slot = (next_slot + 1) % slots.size();
+
+            pthread_mutex_lock(&mu);
+            pthread_cond_signal(&idle_cv);
+            pthread_mutex_unlock(&mu);
+            return true;
+        }
+
+        // Prochaine tâche pour le thread `self` : sa deque d'abord,
+        // puis vol chez les autres (en partant du voisin suivant pour
+        // ne pas tous viser le slot 0), puis sommeil. Rend nullptr quand
+        // le pool est fermé ET vide : les tâches déjà soumises sont
+        // drainées avant l'arrêt, chaque future finit résolu.
+        PoolTaskPtr next(size_t self)
+        {
+            PoolSlot &own = *slots[self];
+            const size_t n = slots.size();
+            for (;;)
+            {
+                if (PoolTaskPtr t = own.pop_front())
+                {
+                    pending.fetch_sub(1, std::memory_order_acq_rel);
+                    return t;
+                }
+                for (size_t k = 1; k < n; ++k)
+                {
+                    if (PoolTaskPtr t = slots[(self + k) % n]->steal_back())
+                    {
+                        pending.fetch_sub(1, std::memory_order_acq_rel);
+                        own.steals.fetch_add(1, std::memory_order_relaxed);
+                        return t;
+                    }
+                }
+
+                pthread_mutex_lock(&mu);
+                bool idle = false;
+                uint64_t t0 = 0;
+                while (pending.load(std::memory_order_acquire) == 0 && !closed)
+                {
+                    if (!idle)
+                    {
+                        idle = true;
+                        t0 = monotonic_ns();
+                        own.idle_since.store(t0, std::memory_order_relaxed);
+                    }
+                    pthread_cond_wait(&idle_cv, &mu);
+                }
+                bool done = closed && pending.load(std::memory_order_acquire) == 0;
+                pthread_mutex_unlock(&mu);
+                if (idle)
+                {
+                    own.idle_ns.fetch_add(monotonic_ns() - t0,
+                                          std::memory_order_relaxed);
+                    own.idle_since.store(0, std::memory_order_relaxed);
+                }
+                if (done)
+                    return nullptr;
+            }
+        }
+
+        void close()
+        {
+            pthread_mutex_lock(&mu);
+            closed = true;
+            pthread_cond_broadcast(&idle_cv);
+            pthread_mutex_unlock(&mu);
+        }
+
+        // Ferme le pool et rejoint tous les threads. Idempotent.
+        void shutdown()
+        {
+            if (!initialized)
+                return;
+            close();
+            for (pthread_t tid : threads)
+            {
+                pthread_join(tid, nullptr);
+            }
+            threads.clear();
+        }
+
+        void report_started(const std::string &err)
+        {
+            pthread_mutex_lock(&mu);
+            ++started;
+            if (!err.empty() && init_err.empty())
+                init_err = err;
+            pthread_cond_broadcast(&started_cv);
+            pthread_mutex_unlock(&mu);
+        }
+    };
+
+    // Argument passé à chaque thread du pool. Lu uniquement pendant
+    // l'init du thread (cf. lua_workers_pool).
+    struct PoolThreadArg
+    {
+        Pool *pool;
+        lua_Integer index; // 1..n, exposé comme worker.id
+    };
+
+    // Ce que référence un userdata future : la tâche partagée, et un
+    // drapeau "déjà consommé" (même sémantique que Worker::joined).
+    struct Future
+    {
+        PoolTaskPtr task;
+        bool consumed;
+    };
+
+    Pool *check_pool(lua_State *L, int idx)
+    {
+        return static_cast<Pool *>(luaL_checkudata(L, idx, POOL_META));
+    }
+
+    Future *check_future(lua_State *L, int idx)
+    {
+        return static_cast<Future *>(luaL_checkudata(L, idx, FUTURE_META));
+    }
+
+    // Un nom de fonction est un chemin d'identifiants Lua séparés par
+    // des points ("square", "mymod.process"). Tout le reste est traité
+    // comme du code source. Les mots-clés sont exclus : submit("return")
+    // doit rester du code, pas une recherche de global.
+    bool is_lua_keyword(const char *s, size_t len)
+    {
+        static const char *const KEYWORDS[] = {
+            "and", "break", "do", "else", "elseif", "end", "false",
+            "for", "function", "global", "goto", "if", "in", "local",
+            "nil", "not", "or", "repeat", "return", "then", "true",
+            "until", "while"};
+        for (const char *kw : KEYWORDS)
+        {
+            if (std::strlen(kw) == len && std::memcmp(kw, s, len) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    bool is_function_path(const char *s, size_t len)
+    {
+        if (len == 0)
+            return false;
+        size_t start = 0;
+        for (size_t i = 0; i <= len; ++i)
+        {
+            if (i < len && s[i] != '.')
+            {
+                unsigned char c = static_cast<unsigned char>(s[i]);
+                bool alpha = std::isalpha(c) || c == '_';
+                if (!alpha && !(i > start && std::isdigit(c)))
+                    return false;
+                continue;
+            }
+            // Fin d'un segment : non vide et pas un mot-clé.
+            if (i == start || is_lua_keyword(s + start, i - start))
+                return false;
+            start = i + 1;
+        }
+        return true;
+    }
+
+    // Pousse la valeur désignée par `path` en partant de _G. Pousse nil
+    // si un maillon manque ou n'est pas une table. Accès raw : aucune
+    // métaméthode utilisateur n'est déclenchée hors pcall.
+    void push_path_value(lua_State *L, const std::string &path)
+    {
+        lua_pushglobaltable(L);
+        size_t start = 0;
+        while (true)
+        {
+            size_t dot = path.find('.', start);
+            size_t end = (dot == std::string::npos) ? path.size() : dot;
+            if (!lua_istable(L, -1))
+            {
+                lua_pop(L, 1);
+                lua_pushnil(L);
+                return;
+            }
+            lua_pushlstring(L, path.data() + start, end - start);
+            lua_rawget(L, -2);
+            lua_remove(L, -2);
+            if (dot == std::string::npos)
+                return;
+            start = dot + 1;
+        }
+    }
+
+    // Exécute un morceau de map / reduce. Pile : 1 = tableau des
+    // éléments, 2 = fonction. Publie le résultat de la tâche.
+    void run_chunk_task(lua_State *L, PoolTask &t)
+    {
+        if (t.mode == TASK_MAP)
+        {
+            // fn(item, index) pour chaque élément, résultats rangés à la
+            // même position (un nil laisse un trou, l'ordre est gardé).
+            lua_createtable(L, static_cast<int>(t.count), 0);
+            for (lua_Integer j = 1; j <= t.count; ++j)
+            {
+                lua_pushvalue(L, 2);
+                lua_rawgeti(L, 1, j);
+                lua_pushinteger(L, t.base + j);
+                if (lua_pcall(L, 2, 1, 0) != LUA_OK)
+                {
+                    const char *m = lua_tostring(L, -1);
+                    t.err_msg = "workers.map: item " +
+                                std::to_string(t.base + j) + ": " +
+                                (m ? m : "(no message)");
+                    lua_settop(L, 0);
+                    t.finish(WORKER_ERROR);
+                    return;
+                }
+                lua_rawseti(L, 3, j);
+            }
+        }
+        else
+        {
+            // Pli gauche : acc = fn(acc, item), acc initial = 1er élément.
+            lua_rawgeti(L, 1, 1);
+            for (lua_Integer j = 2; j <= t.count; ++j)
+            {
+                lua_pushvalue(L, 2);
+                lua_pushvalue(L, 3);
+                lua_rawgeti(L, 1, j);
+                if (lua_pcall(L, 2, 1, 0) != LUA_OK)
+                {
+                    const char *m = lua_tostring(L, -1);
+                    t.err_msg = std::string("workers.reduce: ") +
+                                (m ? m : "(no message)");
+                    lua_settop(L, 0);
+                    t.finish(WORKER_ERROR);
+                    return;
+                }
+                lua_replace(L, 3);
+            }
+        }
+
+        std::string err;
+        if (!serialize_value(L, 3, t.result_buf, err))
+        {
+            t.err_msg = std::string(
+                            "workers: task return value is not transferable: ") +
+                        err;
+            lua_settop(L, 0);
+            t.finish(WORKER_ERROR);
+            return;
+        }
+        lua_settop(L, 0);
+        t.finish(WORKER_DONE);
+    }
+
+    // Sous lua_pcall (pile : args, PoolTask*) : worker.args = args
+    // puis, pour une tâche "mod.fn", pousse la valeur désignée. Le
+    // global worker et les maillons du chemin viennent de l'état du
+    // pool (init, tâches précédentes) : une métaméthode qui lève ici
+    // doit finir en erreur de tâche, pas en panic hors frame protégée.
+    int pool_prepare_task(lua_State *L)
+    {
+        const PoolTask *t = static_cast<const PoolTask *>(lua_touserdata(L, 2));
+        lua_getglobal(L, "worker");
+        if (lua_istable(L, -1))
+        {
+            lua_pushvalue(L, 1);
+            lua_setfield(L, -2, "args");
+        }
+        lua_pop(L, 1);
+        if (!t->is_function)
+        {
+            return 0;
+        }
+        push_path_value(L, t->code);
+        return 1;
+    }
+
+    // Exécute une tâche dans le lua_State chaud d'un thread du pool.
+    // `cached` compte les entrées du cache de chunks de ce thread.
+    void run_pool_task(lua_State *L, PoolTask &t, int &cached)
+    {
+        lua_settop(L, 0);
+
+        // 1. Argument de la tâche (index 1).
+        std::string err;
+        if (!deserialize_value(L, t.args_buf, err))
+        {
+            t.err_msg = err;
+            t.finish(WORKER_ERROR);
+            return;
+        }
+
+        // worker.args = argument courant (mêmes habitudes que spawn),
+        // et fonction d'une tâche "mod.fn" : en mode protégé.
+        lua_pushcfunction(L, pool_prepare_task);
+        lua_pushvalue(L, 1);
+        lua_pushlightuserdata(L, &t);
+        if (lua_pcall(L, 2, t.is_function ? 1 : 0, 0) != LUA_OK)
+        {
+            const char *m = lua_tostring(L, -1);
+            t.err_msg = m ? std::string(m)
+                          : "workers: pool: failed to prepare task (no message)";
+            lua_settop(L, 0);
+            t.finish(WORKER_ERROR);
+            return;
+        }
+
+        // 2. Résoudre la fonction à appeler (index 2).
+        if (t.is_function)
+        {
+            if (!lua_isfunction(L, -1))
+            {
+                t.err_msg = "workers: pool: '" + t.code +
+                            "' is not a function in the pool state";
+                lua_settop(L, 0);
+                t.finish(WORKER_ERROR);
+                return;
+            }
+        }
+        else
+        {
+            lua_getfield(L, LUA_REGISTRYINDEX, POOL_CHUNK_CACHE);
+            lua_pushlstring(L, t.code.data(), t.code.size());
+            lua_rawget(L, -2); // pile : args, cache, fn|nil
+            if (lua_isnil(L, -1))
+            {
+                lua_pop(L, 1);
+                // Même chunkname que spawn : messages d'erreur identiques.
+                int rc = luaL_loadbuffer(L, t.code.data(), t.code.size(),
+                                         "worker");
+                if (rc != LUA_OK)
+                {
+                    const char *m = lua_tostring(L, -1);
+                    t.err_msg = m ? std::string(m)
+                                  : "workers: failed to load code (no message)";
+                    lua_settop(L, 0);
+                    t.finish(WORKER_ERROR);
+                    return;
+                }
+                if (cached >= MAX_CACHED_CHUNKS)
+                {
+                    lua_newtable(L);
+                    lua_replace(L, -3); // pile : args, cache neuf, fn
+                    lua_pushvalue(L, -2);
+                    lua_setfield(L, LUA_REGISTRYINDEX, POOL_CHUNK_CACHE);
+                    cached = 0;
+                }
+                lua_pushlstring(L, t.code.data(), t.code.size());
+                lua_pushvalue(L, -2);
+                lua_rawset(L, -4); // cache[code] = fn
+                ++cached;
+            }
+            lua_remove(L, -2); // pile : args, fn
+        }
+
+        if (t.mode != TASK_CALL)
+        {
+            run_chunk_task(L, t);
+            return;
+        }
+
+        // 3. Appel : fn(args). Un seul résultat, comme spawn.
+        lua_pushvalue(L, 1);
+        int rc = lua_pcall(L, 1, 1, 0);
+        if (rc != LUA_OK)
+        {
+            const char *m = lua_tostring(L, -1);
+            t.err_msg = m ? std::string(m)
+                          : "workers: task raised error (no message)";
+            lua_settop(L, 0);
+            t.finish(WORKER_ERROR);
+            return;
+        }
+
+        if (!serialize_value(L, -1, t.result_buf, err))
+        {
+            t.err_msg = std::string(
+                            "workers: task return value is not transferable: ") +
+                        err;
+            lua_settop(L, 0);
+            t.finish(WORKER_ERROR);
+            return;
+        }
+        lua_settop(L, 0);
+        t.finish(WORKER_DONE);
+    }
+
+    void *pool_thread_main(void *arg)
+    {
+        // Copie locale : `arg` est libéré par pool() dès la fin des
+        // inits (cf. report_started).
+        PoolThreadArg *pa = static_cast<PoolThreadArg *>(arg);
+        Pool *p = pa->pool;
+        const lua_Integer index = pa->index;
+        PoolSlot &slot = *p->slots[static_cast<size_t>(index - 1)];
+
+        block_worker_signals();
+
+        std::string err;
+        lua_State *L = apply_thread_nice(p->topts, err) ? new_worker_state()
+                                                         : nullptr;
+        if (!L)
+        {
+            if (err.empty())
+                err = "workers: pool: failed to create lua_State";
+        }
+        else
+        {
+            // worker = { id = i } ; args est posé à chaque tâche.
+            // Pas de worker.send / worker.recv : une tâche de pool n'a
+            // pas de canal dédié avec le parent, son résultat passe par
+            // le future.
+            lua_newtable(L);
+            lua_pushinteger(L, index);
+            lua_setfield(L, -2, "id");
+            lua_setglobal(L, "worker");
+            lua_pushnil(L);
+            lua_setglobal(L, "arg");
+
+            lua_newtable(L);
+            lua_setfield(L, LUA_REGISTRYINDEX, POOL_CHUNK_CACHE);
+
+            if (!p->init_code.empty())
+            {
+                int rc = luaL_loadbuffer(L, p->init_code.data(),
+                                         p->init_code.size(), "pool_init");
+                if (rc == LUA_OK)
+                    rc = lua_pcall(L, 0, 0, 0);
+                if (rc != LUA_OK)
+                {
+                    const char *m = lua_tostring(L, -1);
+                    err = std::string("workers: pool: init failed: ") +
+                          (m ? m : "(no message)");
+                }
+                lua_settop(L, 0);
+            }
+        }
+
+        p->report_started(err);
+        if (!err.empty())
+        {
+            if (L)
+                lua_close(L);
+            return nullptr;
+        }
+
+        int cached = 0;
+        while (PoolTaskPtr t = p->next(static_cast<size_t>(index - 1)))
+        {
+            run_pool_task(L, *t, cached);
+            slot.tasks_run.fetch_add(1, std::memory_order_relaxed);
+        }
+        lua_close(L);
+        return nullptr;
+    }
+
+    // Démarre les n threads d'un pool fraîchement construit et attend
+    // la fin de leur init. false + err si une création de thread ou le
+    // chunk d'init échoue ; le pool est alors déjà arrêté (le __gc de
+    // l'userdata fera le reste). Partagé par pool() et map/reduce.
+    bool start_pool(Pool *p, size_t n, std::string &err)
+    {
+        if (!p->init(n))
+        {
+            err = "workers: pool: failed to initialize task queue";
+            return false;
+        }
+
+        // Arguments des threads : lus uniquement pendant leur init, donc
+        // libérables dès que tous ont signalé leur démarrage.
+        auto *args = new PoolThreadArg[n];
+        p->threads.reserve(n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            args[i].pool = p;
+            args[i].index = static_cast<lua_Integer>(i + 1);
+            pthread_t tid;
+            int rc = create_thread(&tid, p->topts, pool_thread_main, &args[i]);
+            if (rc != 0)
+            {
+                err = std::string("workers: pthread_create failed: ") +
+                      std::strerror(rc);
+                break;
+            }
+            p->threads.push_back(tid);
+        }
+
+        // Attendre la fin de l'init de tous les threads effectivement
+        // créés : après ça, plus aucun ne lit `args`.
+        pthread_mutex_lock(&p->mu);
+        while (p->started < p->threads.size())
+        {
+            pthread_cond_wait(&p->started_cv, &p->mu);
+        }
+        if (err.empty())
+            err = p->init_err;
+        pthread_mutex_unlock(&p->mu);
+        delete[] args;
+
+        if (!err.empty())
+        {
+            p->shutdown();
+            return false;
+        }
+        p->size = n;
+        return true;
+    }
+
+    // Pousse un userdata pool neuf (pas encore démarré) sur la pile.
+    Pool *push_new_pool(lua_State *L)
+    {
+        Pool *p = static_cast<Pool *>(lua_newuserdata(L, sizeof(Pool)));
+        new (p) Pool();
+        luaL_getmetatable(L, POOL_META);
+        lua_setmetatable(L, -2);
+        return p;
+    }
+
+    int lua_workers_pool(lua_State *L)
+    {
+        lua_Integer n = luaL_checkinteger(L, 1);
+        if (n < 1 || n > MAX_POOL_SIZE)
+        {
+            return luaL_error(L,
+                              "workers.pool: size must be in 1..%I (got %I)",
+                              MAX_POOL_SIZE, n);
+        }
+        // pool(n [, init_code] [, opts]) : opts peut aussi venir en
+        // 2e position quand il n'y a pas de chunk d'init.
+        size_t init_len = 0;
+        const char *init_code = nullptr;
+        int opts_idx = 3;
+        if (lua_istable(L, 2))
+        {
+            opts_idx = 2;
+        }
+        else if (!lua_isnoneornil(L, 2))
+        {
+            init_code = luaL_checklstring(L, 2, &init_len);
+        }
+        ThreadOpts topts;
+        if (!lua_isnoneornil(L, opts_idx))
+        {
+            luaL_checktype(L, opts_idx, LUA_TTABLE);
+            parse_thread_opts(L, opts_idx, "workers.pool", topts);
+        }
+
+        Pool *p = push_new_pool(L);
+        if (init_code)
+            p->init_code.assign(init_code, init_len);
+        p->topts = topts;
+
+        std::string err;
+        if (!start_pool(p, static_cast<size_t>(n), err))
+        {
+            lua_pop(L, 1);
+            return push_fail(L, err);
+        }
+        return 1;
+    }
+
+    // pool:submit(code_or_fn_name [, args]) -> future | (nil, err)
+    int pool_submit(lua_State *L)
+    {
+        Pool *p = check_pool(L, 1);
+        size_t code_len = 0;
+        const char *code = luaL_checklstring(L, 2, &code_len);
+
+        if (p->size == 0)
+        {
+            return push_fail(L, "workers: pool: pool is closed");
+        }
+
+        // Sérialiser l'argument. Contrairement à spawn, n'importe quelle
+        // valeur transférable est acceptée (pas seulement une table) :
+        // pool:submit("square", 7) est l'usage naturel d'une fonction.
+        auto task = std::make_shared<PoolTask>();
+        task->code.assign(code, code_len);
+        task->is_function = is_function_path(code, code_len);
+        if (!lua_isnoneornil(L, 3))
+        {
+            std::string err;
+            if (!serialize_value(L, 3, task->args_buf, err))
+            {
+                return push_fail(L, err);
+            }
+        }
+
+        if (!p->push(task))
+        {
+            return push_fail(L, "workers: pool: pool is closed");
+        }
+
+        Future *f = static_cast<Future *>(lua_newuserdata(L, sizeof(Future)));
+        new (f) Future{std::move(task), false};
+        luaL_getmetatable(L, FUTURE_META);
+        lua_setmetatable(L, -2);
+        return 1;
+    }
+
+    // pool:size() -> nombre de threads (0 une fois fermé)
+    int pool_size(lua_State *L)
+    {
+        Pool *p = check_pool(L, 1);
+        lua_pushinteger(L, static_cast<lua_Integer>(p->size));
+        return 1;
+    }
+
+    // pool:stats() -> table
+    //   {
+    //     tasks = <total>, steals = <total>, idle = <secondes, total>,
+    //     queued = <tâches en attente>,
+    //     threads = { { tasks =, steals =, idle =, queued = }, ... },
+    //   }
+    // `tasks` compte les tâches exécutées (succès ou erreur), `steals`
+    // celles prises dans la deque d'un autre thread, `idle` le temps
+    // passé endormi faute de travail (sommeil en cours inclus). Lecture
+    // sans verrou global : les valeurs sont cohérentes par compteur,
+    // pas entre compteurs.
+    int pool_stats(lua_State *L)
+    {
+        Pool *p = check_pool(L, 1);
+        uint64_t total_tasks = 0;
+        uint64_t total_steals = 0;
+        uint64_t total_idle_ns = 0;
+        size_t total_queued = 0;
+        const uint64_t now = monotonic_ns();
+
+        lua_newtable(L);                                           // stats
+        lua_createtable(L, static_cast<int>(p->slots.size()), 0); // stats, threads
+        for (size_t i = 0; i < p->slots.size(); ++i)
+        {
+            PoolSlot &slot = *p->slots[i];
+            uint64_t tasks = slot.tasks_run.load(std::memory_order_relaxed);
+            uint64_t steals = slot.steals.load(std::memory_order_relaxed);
+            uint64_t idle_ns = slot.idle_ns.load(std::memory_order_relaxed);
+            uint64_t since = slot.idle_since.load(std::memory_order_relaxed);
+            if (since != 0 && now > since)
+                idle_ns += now - since;
+            size_t queued = slot.queued();
+            total_tasks += tasks;
+            total_steals += steals;
+            total_idle_ns += idle_ns;
+            total_queued += queued;
+
+            lua_createtable(L, 0, 4);
+            lua_pushinteger(L, static_cast<lua_Integer>(tasks));
+            lua_setfield(L, -2, "tasks");
+            lua_pushinteger(L, static_cast<lua_Integer>(steals));
+            lua_setfield(L, -2, "steals");
+            lua_pushnumber(L, static_cast<lua_Number>(idle_ns) / 1e9);
+            lua_setfield(L, -2, "idle");
+            lua_pushinteger(L, static_cast<lua_Integer>(queued));
+            lua_setfield(L, -2, "queued");
+            lua_rawseti(L, -2, static_cast<lua_Integer>(i + 1));
+        }
+        lua_setfield(L, -2, "threads");
+
+        lua_pushinteger(L, static_cast<lua_Integer>(total_tasks));
+        lua_setfield(L, -2, "tasks");
+        lua_pushinteger(L, static_cast<lua_Integer>(total_steals));
+        lua_setfield(L, -2, "steals");
+        lua_pushnumber(L, static_cast<lua_Number>(total_idle_ns) / 1e9);
+        lua_setfield(L, -2, "idle");
+        lua_pushinteger(L, static_cast<lua_Integer>(total_queued));
+        lua_setfield(L, -2, "queued");
+        return 1;
+    }
+
+    // pool:close() -> (true, nil). Les tâches déjà soumises sont
+    // exécutées avant l'arrêt des threads ; bloque jusque-là.
+    int pool_close(lua_State *L)
+    {
+        Pool *p = check_pool(L, 1);
+        p->shutdown();
+        p->size = 0;
+        return push_ok(L);
+    }
+
+    int pool_gc(lua_State *L)
+    {
+        Pool *p = static_cast<Pool *>(luaL_testudata(L, 1, POOL_META));
+        if (!p)
+            return 0;
+        p->shutdown();
+        p->destroy();
+        p->~Pool();
+        return 0;
+    }
+
+    int pool_tostring(lua_State *L)
+    {
+        Pool *p = check_pool(L, 1);
+        char buf[64];
+        if (p->size == 0)
+            std::snprintf(buf, sizeof(buf), "WorkerPool(closed)");
+        else
+            std::snprintf(buf, sizeof(buf), "WorkerPool(%zu)", p->size);
+        lua_pushstring(L, buf);
+        return 1;
+    }
+
+    // Pousse le résultat d'une tâche terminée au format de worker:join
+    // ((true, value) ou (false, err)) et marque le future consommé.
+    int push_task_result(lua_State *L, Future *f, int st)
+    {
+        f->consumed = true;
+        if (st == WORKER_DONE)
+        {
+            lua_pushboolean(L, 1);
+            std::string err;
+            if (!deserialize_value(L, f->task->result_buf, err))
+            {
+                lua_pushnil(L);
+            }
+            return 2;
+        }
+        lua_pushboolean(L, 0);
+        lua_pushstring(L, f->task->err_msg.c_str());
+        return 2;
+    }
+
+    // future:join([timeout]) -> (true, value) | (false, err)
+    //                         | (false, "timeout")
+    int future_join(lua_State *L)
+    {
+        Future *f = check_future(L, 1);
+        int64_t timeout_ms = parse_timeout_arg(L, 2);
+
+        if (f->consumed)
+        {
+            lua_pushboolean(L, 0);
+            lua_pushstring(L, "workers: join: result already consumed");
+            return 2;
+        }
+
+        PoolTask &t = *f->task;
+        pthread_mutex_lock(&t.mu);
+        if (timeout_ms < 0)
+        {
+            while (t.status == WORKER_RUNNING)
+                pthread_cond_wait(&t.done_cv, &t.mu);
+        }
+        else if (timeout_ms > 0)
+        {
+            struct timespec deadline;
+            MessageQueue::compute_deadline(timeout_ms, deadline);
+            while (t.status == WORKER_RUNNING)
+            {
+                if (pthread_cond_timedwait(&t.done_cv, &t.mu, &deadline) ==
+                    ETIMEDOUT)
+                    break;
+            }
+        }
+        int st = t.status;
+        pthread_mutex_unlock(&t.mu);
+
+        if (st == WORKER_RUNNING)
+        {
+            // Pas consommé : on peut rappeler join() plus tard.
+            lua_pushboolean(L, 0);
+            lua_pushstring(L, "timeout");
+            return 2;
+        }
+        return push_task_result(L, f, st);
+    }
+
+    // future:poll() -> "running", nil | "done", value | "error", err
+    int future_poll(lua_State *L)
+    {
+        Future *f = check_future(L, 1);
+        if (f->consumed)
+        {
+            lua_pushstring(L, "error");
+            lua_pushstring(L, "workers: poll: result already consumed");
+            return 2;
+        }
+        int st = f->task->load_status();
+        if (st == WORKER_RUNNING)
+        {
+            lua_pushstring(L, "running");
+            lua_pushnil(L);
+            return 2;
+        }
+        push_task_result(L, f, st);
+        // (ok, value) -> (state, value)
+        lua_pushstring(L, st == WORKER_DONE ? "done" : "error");
+        lua_replace(L, -3);
+        return 2;
+    }
+
+    int future_gc(lua_State *L)
+    {
+        Future *f = static_cast<Future *>(luaL_testudata(L, 1, FUTURE_META));
+        if (!f)
+            return 0;
+        // Relâche la référence : si la tâche est encore en file ou en
+        // cours, le thread du pool garde la sienne et la libérera.
+        f->~Future();
+        return 0;
+    }
+
+    int future_tostring(lua_State *L)
+    {
+        Future *f = check_future(L, 1);
+        int st = f->task->load_status();
+        const char *sname = (st == WORKER_RUNNING) ? "running"
+                            : (st == WORKER_DONE)  ? "done"
+                                                   : "error";
+        char buf[48];
+        std::snprintf(buf, sizeof(buf), "WorkerFuture(%s)", sname);
+        lua_pushstring(L, buf);
+        return 1;
+    }
+
+    // =================================================================
+    // map / reduce parallèles (babet.workers.map / babet.workers.reduce)
+    // =================================================================
+    //
+    // Remplacent la boucle "worker pool pattern" écrite à la main en Lua
+    // (spawn par paquets + polling de job:poll()). Le tableau est coupé
+    // en morceaux de `chunk` éléments ; chaque morceau est UNE tâche de
+    // pool (un seul message aller, un seul retour), exécutée par un
+    // ensemble borné de threads : le pool passé en opts.pool, sinon un
+    // pool temporaire de `concurrency` threads (défaut : cpu_count(),
+    // opts cpu / nice / stack_size acceptées) arrêté en fin d'appel.
+    //
+    // Ordre et mémoire : au plus `2 * concurrency` morceaux sont en vol.
+    // Le parent attend toujours le PLUS ANCIEN ; les suivants avancent
+    // pendant ce temps. Les résultats sortent donc dans l'ordre des
+    // entrées, au fil de l'eau (opts.on_result), sans jamais sérialiser
+    // tout le tableau d'un coup.
+
+    constexpr lua_Integer CHUNKS_PER_THREAD = 4; // défaut de map : équilibrage
+    constexpr size_t INFLIGHT_PER_THREAD = 2;
+
+    struct ChunkOpts
+    {
+        lua_Integer concurrency; // 0 = défaut (cpu_count())
+        lua_Integer chunk;       // 0 = défaut selon l'opération
+        int pool_idx;            // 0 si pas de opts.pool
+        int cb_idx;              // 0 si pas de opts.on_result
+        int init_idx;            // 0 si pas de opts.init (reduce)
+        ThreadOpts topts;        // threads du pool temporaire
+    };
+
+    // Lit opts (index absolu, table ou nil). Lève luaL_error sur une
+    // option invalide : à appeler avant toute allocation C++.
+    void parse_chunk_opts(lua_State *L, int idx, const char *fname,
+                          ChunkOpts &o)
+    {
+        o = ChunkOpts{0, 0, 0, 0, 0, ThreadOpts{}};
+        if (lua_isnoneornil(L, idx))
+            return;
+        luaL_checktype(L, idx, LUA_TTABLE);
+        parse_thread_opts(L, idx, fname, o.topts);
+
+        lua_getfield(L, idx, "concurrency");
+        if (!lua_isnil(L, -1))
+        {
+            int isnum = 0;
+            lua_Integer n = lua_tointegerx(L, -1, &isnum);
+            if (!isnum || n < 1 || n > MAX_POOL_SIZE)
+                luaL_error(L, "%s: opts.concurrency must be an integer in 1..%I",
+                           fname, MAX_POOL_SIZE);
+            o.concurrency = n;
+        }
+        lua_pop(L, 1);
+
+        lua_getfield(L, idx, "chunk");
+        if (!lua_isnil(L, -1))
+        {
+            int isnum = 0;
+            lua_Integer n = lua_tointegerx(L, -1, &isnum);
+            if (!isnum || n < 1)
+                luaL_error(L, "%s: opts.chunk must be a positive integer",
+                           fname);
+            o.chunk = n;
+        }
+        lua_pop(L, 1);
+
+        // Les valeurs référencées restent dans opts (donc ancrées) : on
+        // ne garde que la table et on relit le champ au besoin.
+        lua_getfield(L, idx, "pool");
+        if (!lua_isnil(L, -1))
+        {
+            if (!luaL_testudata(L, -1, POOL_META))
+                luaL_error(L, "%s: opts.pool must be a workers pool", fname);
+            o.pool_idx = lua_gettop(L);
+        }
+        else
+            lua_pop(L, 1);
+
+        lua_getfield(L, idx, "on_result");
+        if (!lua_isnil(L, -1))
+        {
+            if (!lua_isfunction(L, -1))
+                luaL_error(L, "%s: opts.on_result must be a function", fname);
+            o.cb_idx = lua_gettop(L);
+        }
+        else
+            lua_pop(L, 1);
+
+        lua_getfield(L, idx, "init");
+        if (!lua_isnil(L, -1))
+            o.init_idx = lua_gettop(L);
+        else
+            lua_pop(L, 1);
+    }
+
+    // Pool d'exécution : celui de opts.pool, sinon un pool temporaire
+    // poussé sur la pile (ancré jusqu'à la fin de l'appel ; son __gc
+    // l'arrête si une erreur Lua interrompt map/reduce). *tmp vaut le
+    // pool temporaire, nullptr sinon. Rend nullptr + message sur la
+    // pile en cas d'échec.
+    Pool *acquire_chunk_pool(lua_State *L, const ChunkOpts &o,
+                             lua_Integer threads, Pool **tmp)
+    {
+        *tmp = nullptr;
+        if (o.pool_idx)
+        {
+            Pool *p = static_cast<Pool *>(lua_touserdata(L, o.pool_idx));
+            if (p->size == 0)
+            {
+                lua_pushstring(L, "workers: pool: pool is closed");
+                return nullptr;
+            }
+            return p;
+        }
+        Pool *p = push_new_pool(L);
+        p->topts = o.topts;
+        std::string err;
+        if (!start_pool(p, static_cast<size_t>(threads), err))
+        {
+            lua_pop(L, 1);
+            lua_pushstring(L, err.c_str());
+            return nullptr;
+        }
+        *tmp = p;
+        return p;
+    }
+
+    // Attend la fin d'une tâche (sans timeout).
+    int wait_task(PoolTask &t)
+    {
+        pthread_mutex_lock(&t.mu);
+        while (t.status == WORKER_RUNNING)
+            pthread_cond_wait(&t.done_cv, &t.mu);
+        int st = t.status;
+        pthread_mutex_unlock(&t.mu);
+        return st;
+    }
+
+    // Statuts de run_chunks.
+    constexpr int CHUNKS_OK = 0;
+    constexpr int CHUNKS_FAIL = 1;     // message d'erreur au sommet de pile
+    constexpr int CHUNKS_CB_ERROR = 2; // erreur levée par on_result (idem)
+
+    // Coeur commun : découpe items[1..n] en morceaux de `chunk`, les
+    // exécute sur le pool avec une fenêtre de `window` morceaux en vol
+    // et livre les résultats dans l'ordre :
+    //   - TASK_MAP    : résultat de l'élément i dans out[i], ou
+    //                   on_result(i, value) si cb_idx != 0 ;
+    //   - TASK_REDUCE : accumulateur du morceau k dans out[k]. Les trous
+    //                   (nil) de items sont sautés.
+    // Les erreurs Lua possibles pendant la boucle sont capturées
+    // (lua_pcall du callback) : aucun longjmp ne traverse les objets C++
+    // d'ici. L'appelant lève l'erreur CHUNKS_CB_ERROR une fois revenu.
+    int run_chunks(lua_State *L, Pool *p, int items_idx, lua_Integer n,
+                   const char *code, size_t code_len, int mode,
+                   lua_Integer chunk, size_t window, int cb_idx, int out_idx)
+    {
+        const bool is_fn = is_function_path(code, code_len);
+        std::deque<PoolTaskPtr> inflight;
+        lua_Integer next = 1; // prochain élément à découper
+        lua_Integer out_k = 0; // reduce : morceaux livrés
+
+        while (next <= n || !inflight.empty())
+        {
+            // Remplir la fenêtre.
+            while (next <= n && inflight.size() < window)
+            {
+                auto task = std::make_shared<PoolTask>();
+                task->code.assign(code, code_len);
+                task->is_function = is_fn;
+                task->mode = mode;
+                task->base = next - 1;
+
+                lua_Integer last = next + chunk - 1;
+                if (last > n)
+                    last = n;
+                lua_createtable(L, static_cast<int>(last - next + 1), 0);
+                lua_Integer k = 0;
+                for (lua_Integer i = next; i <= last; ++i)
+                {
+                    lua_rawgeti(L, items_idx, i);
+                    if (mode == TASK_REDUCE && lua_isnil(L, -1))
+                    {
+                        lua_pop(L, 1);
+                        continue;
+                    }
+                    lua_rawseti(L, -2, mode == TASK_MAP ? i - next + 1 : ++k);
+                }
+                task->count = (mode == TASK_MAP) ? last - next + 1 : k;
+                next = last + 1;
+
+                std::string err;
+                bool ok = serialize_value(L, -1, task->args_buf, err);
+                lua_pop(L, 1);
+                if (!ok)
+                {
+                    lua_pushstring(L, err.c_str());
+                    return CHUNKS_FAIL;
+                }
+                if (task->count == 0)
+                    continue; // morceau de reduce entièrement nil
+                if (!p->push(task))
+                {
+                    lua_pushstring(L, "workers: pool: pool is closed");
+                    return CHUNKS_FAIL;
+                }
+                inflight.push_back(std::move(task));
+            }
+            if (inflight.empty())
+                break;
+
+            // Livrer le plus ancien morceau.
+            PoolTaskPtr t = std::move(inflight.front());
+            inflight.pop_front();
+            if (wait_task(*t) != WORKER_DONE)
+            {
+                lua_pushstring(L, t->err_msg.c_str());
+                return CHUNKS_FAIL;
+            }
+            std::string err;
+            if (!deserialize_value(L, t->result_buf, err))
+            {
+                lua_pushstring(L, err.c_str());
+                return CHUNKS_FAIL;
+            }
+            if (mode == TASK_REDUCE)
+            {
+                lua_rawseti(L, out_idx, ++out_k);
+                continue;
+            }
+            int res = lua_gettop(L);
+            for (lua_Integer j = 1; j <= t->count; ++j)
+            {
+                if (cb_idx)
+                {
+                    lua_pushvalue(L, cb_idx);
+                    lua_pushinteger(L, t->base + j);
+                    lua_rawgeti(L, res, j);
+                    if (lua_pcall(L, 2, 0, 0) != LUA_OK)
+                        return CHUNKS_CB_ERROR;
+                }
+                else
+                {
+                    lua_rawgeti(L, res, j);
+                    lua_rawseti(L, out_idx, t->base + j);
+                }
+            }
+            lua_pop(L, 1);
+        }
+        return CHUNKS_OK;
+    }
+
+    // Fin commune de map/reduce : arrête le pool temporaire, puis
+    // traduit le statut. Pile : ..., message (si statut != OK).
+    int finish_chunks(lua_State *L, Pool *tmp, int status)
+    {
+        if (tmp)
+        {
+            tmp->shutdown();
+            tmp->size = 0;
+        }
+        if (status == CHUNKS_CB_ERROR)
+            return lua_error(L);
+        lua_pushboolean(L, 0);
+        lua_insert(L, -2);
+        return 2;
+    }
+
+    // workers.map(items, code [, opts]) -> (true, results) | (true, n)
+    //                                    | (false, err)
+    //   code : source recevant (item, index) en `...`, ou nom de
+    //          fonction ("mod.fn") du lua_State des threads.
+    //   opts : concurrency, chunk, pool, on_result(i, value).
+    int lua_workers_map(lua_State *L)
+    {
+        luaL_checktype(L, 1, LUA_TTABLE);
+        size_t code_len = 0;
+        const char *code = luaL_checklstring(L, 2, &code_len);
+        ChunkOpts o;
+        parse_chunk_opts(L, 3, "workers.map", o);
+
+        lua_Integer n = static_cast<lua_Integer>(lua_rawlen(L, 1));
+        lua_Integer threads = o.concurrency ? o.concurrency : cpu_count();
+        lua_Integer chunk = o.chunk;
+        if (chunk == 0)
+        {
+            lua_Integer parts = threads * CHUNKS_PER_THREAD;
+            chunk = n > 0 ? (n + parts - 1) / parts : 1;
+        }
+        lua_Integer nchunks = n > 0 ? (n + chunk - 1) / chunk : 0;
+        if (threads > nchunks)
+            threads = nchunks > 0 ? nchunks : 1;
+
+        int out_idx = 0;
+        if (!o.cb_idx)
+        {
+            lua_createtable(L, static_cast<int>(n), 0);
+            out_idx = lua_gettop(L);
+        }
+        if (n == 0)
+        {
+            lua_pushboolean(L, 1);
+            if (o.cb_idx)
+                lua_pushinteger(L, 0);
+            else
+                lua_pushvalue(L, out_idx);
+            return 2;
+        }
+
+        Pool *tmp = nullptr;
+        Pool *p = acquire_chunk_pool(L, o, threads, &tmp);
+        if (!p)
+        {
+            lua_pushboolean(L, 0);
+            lua_insert(L, -2);
+            return 2;
+        }
+        size_t window = static_cast<size_t>(
+            (o.pool_idx ? static_cast<lua_Integer>(p->size) : threads) *
+            INFLIGHT_PER_THREAD);
+
+        int st = run_chunks(L, p, 1, n, code, code_len, TASK_MAP, chunk,
+                            window, o.cb_idx, out_idx);
+        if (st != CHUNKS_OK)
+            return finish_chunks(L, tmp, st);
+        if (tmp)
+        {
+            tmp->shutdown();
+            tmp->size = 0;
+        }
+        lua_pushboolean(L, 1);
+        if (o.cb_idx)
+            lua_pushinteger(L, n);
+        else
+            lua_pushvalue(L, out_idx);
+        return 2;
+    }
+
+    // workers.reduce(items, code [, opts]) -> (true, value) | (false, err)
+    //   code : fonction (acc, item) -> acc, ASSOCIATIVE : chaque thread
+    //          plie son morceau de gauche à droite, puis les
+    //          accumulateurs partiels sont repliés de la même façon (en
+    //          parallèle tant qu'il en reste plus d'un morceau).
+    //   opts : concurrency, chunk, pool, init (valeur placée avant le
+    //          premier élément). Les éléments nil sont ignorés ; sans
+    //          élément ni init, le résultat est nil.
+    int lua_workers_reduce(lua_State *L)
+    {
+        luaL_checktype(L, 1, LUA_TTABLE);
+        size_t code_len = 0;
+        const char *code = luaL_checklstring(L, 2, &code_len);
+        ChunkOpts o;
+        parse_chunk_opts(L, 3, "workers.reduce", o);
+        if (o.cb_idx)
+            return luaL_error(L, "workers.reduce: opts.on_result is not supported");
+
+        // Niveau 0 : items, précédé de init s'il est fourni.
+        lua_Integer n = static_cast<lua_Integer>(lua_rawlen(L, 1));
+        int level = 1;
+        if (o.init_idx)
+        {
+            lua_createtable(L, static_cast<int>(n + 1), 0);
+            lua_pushvalue(L, o.init_idx);
+            lua_rawseti(L, -2, 1);
+            for (lua_Integer i = 1; i <= n; ++i)
+            {
+                lua_rawgeti(L, 1, i);
+                lua_rawseti(L, -2, i + 1);
+            }
+            level = lua_gettop(L);
+            ++n;
+        }
+
+        lua_Integer threads = o.concurrency ? o.concurrency : cpu_count();
+        // Par défaut un morceau par thread (au moins 2 éléments, sinon
+        // un niveau ne réduit rien).
+        lua_Integer chunk = o.chunk;
+        if (chunk == 0)
+            chunk = (n + threads - 1) / threads;
+        if (chunk < 2)
+            chunk = 2;
+        lua_Integer nchunks = n > 0 ? (n + chunk - 1) / chunk : 0;
+        if (threads > nchunks)
+            threads = nchunks > 0 ? nchunks : 1;
+
+        Pool *tmp = nullptr;
+        Pool *p = nullptr;
+        int st = CHUNKS_OK;
+        for (;;)
+        {
+            // Compacter le niveau courant suffit à savoir s'il reste
+            // quelque chose à replier : nil si vide, la valeur si seule.
+            lua_Integer count = 0;
+            lua_Integer single = 0;
+            for (lua_Integer i = 1; i <= n && count < 2; ++i)
+            {
+                lua_rawgeti(L, level, i);
+                if (!lua_isnil(L, -1))
+                {
+                    ++count;
+                    single = i;
+                }
+                lua_pop(L, 1);
+            }
+            if (count < 2)
+            {
+                if (tmp)
+                {
+                    tmp->shutdown();
+                    tmp->size = 0;
+                }
+                lua_pushboolean(L, 1);
+                if (count == 0)
+                    lua_pushnil(L);
+                else
+                    lua_rawgeti(L, level, single);
+                return 2;
+            }
+
+            if (!p)
+            {
+                p = acquire_chunk_pool(L, o, threads, &tmp);
+                if (!p)
+                {
+                    lua_pushboolean(L, 0);
+                    lua_insert(L, -2);
+                    return 2;
+                }
+            }
+            size_t window = static_cast<size_t>(
+                (o.pool_idx ? static_cast<lua_Integer>(p->size) : threads) *
+                INFLIGHT_PER_THREAD);
+
+            lua_newtable(L);
+            int out_idx = lua_gettop(L);
+            st = run_chunks(L, p, level, n, code, code_len, TASK_REDUCE,
+                            chunk, window, 0, out_idx);
+            if (st != CHUNKS_OK)
+                return finish_chunks(L, tmp, st);
+            level = out_idx;
+            n = static_cast<lua_Integer>(lua_rawlen(L, level));
+        }
+    }
+
+} // namespace
+
+void register_workers(lua_State *L)
+{
+    luaL_newmetatable(L, WORKER_META);
+    {
+        lua_pushvalue(L, -1);
+        lua_setfield(L, -2, "__index");
+        lua_pushcfunction(L, worker_gc);
+        lua_setfield(L, -2, "__gc");
+        lua_pushcfunction(L, worker_tostring);
+        lua_setfield(L, -2, "__tostring");
+        lua_pushcfunction(L, worker_join);
+        lua_setfield(L, -2, "join");
+        lua_pushcfunction(L, worker_poll);
+        lua_setfield(L, -2, "poll");
+        // Chantier 9-2 : send / recv / close
+        lua_pushcfunction(L, worker_send);
+        lua_setfield(L, -2, "send");
+        lua_pushcfunction(L, worker_recv);
+        lua_setfield(L, -2, "recv");
+        lua_pushcfunction(L, worker_send_many);
+        lua_setfield(L, -2, "send_many");
+        lua_pushcfunction(L, worker_recv_many);
+        lua_setfield(L, -2, "recv_many");
+        lua_pushcfunction(L, worker_close);
+        lua_setfield(L, -2, "close");
+        lua_pushcfunction(L, worker_cancel);
+        lua_setfield(L, -2, "cancel");
+    }
+    lua_pop(L, 1);
+
+    luaL_newmetatable(L, BUFFER_META);
+    {
+        lua_pushvalue(L, -1);
+        lua_setfield(L, -2, "__index");
+        lua_pushcfunction(L, buffer_gc);
+        lua_setfield(L, -2, "__gc");
+        lua_pushcfunction(L, buffer_tostring);
+        lua_setfield(L, -2, "__tostring");
+        lua_pushcfunction(L, buffer_size);
+        lua_setfield(L, -2, "__len");
+        lua_pushcfunction(L, buffer_size);
+        lua_setfield(L, -2, "size");
+        lua_pushcfunction(L, buffer_tostring_bytes);
+        lua_setfield(L, -2, "tostring");
+        lua_pushcfunction(L, buffer_slice);
+        lua_setfield(L, -2, "slice");
+        lua_pushcfunction(L, buffer_write);
+        lua_setfield(L, -2, "write");
+        lua_pushcfunction(L, buffer_freeze);
+        lua_setfield(L, -2, "freeze");
+        lua_pushcfunction(L, buffer_frozen);
+        lua_setfield(L, -2, "frozen");
+    }
+    lua_pop(L, 1);
+
+    luaL_newmetatable(L, CHANNEL_META);
+    {
+        lua_pushvalue(L, -1);
+        lua_setfield(L, -2, "__index");
+        lua_pushcfunction(L, channel_gc);
+        lua_setfield(L, -2, "__gc");
+        lua_pushcfunction(L, channel_tostring);
+        lua_setfield(L, -2, "__tostring");
+        lua_pushcfunction(L, channel_send);
+        lua_setfield(L, -2, "send");
+        lua_pushcfunction(L, channel_recv);
+        lua_setfield(L, -2, "recv");
+        lua_pushcfunction(L, channel_try_recv);
+        lua_setfield(L, -2, "try_recv");
+        lua_pushcfunction(L, channel_close);
+        lua_setfield(L, -2, "close");
+    }
+    lua_pop(L, 1);
+
+    // Proxy de table partagée : __index fait la recherche (pas de
+    // méthodes, toute clé est une donnée).
+    luaL_newmetatable(L, SHARED_META);
+    {
+        lua_pushcfunction(L, shared_index);
+        lua_setfield(L, -2, "__index");
+        lua_pushcfunction(L, shared_newindex);
+        lua_setfield(L, -2, "__newindex");
+        lua_pushcfunction(L, shared_len);
+        lua_setfield(L, -2, "__len");
+        lua_pushcfunction(L, shared_pairs);
+        lua_setfield(L, -2, "__pairs");
+        lua_pushcfunction(L, shared_gc);
+        lua_setfield(L, -2, "__gc");
+        lua_pushcfunction(L, shared_tostring);
+        lua_setfield(L, -2, "__tostring");
+    }
+    lua_pop(L, 1);
+
+    luaL_newmetatable(L, POOL_META);
+    {
+        lua_pushvalue(L, -1);
+        lua_setfield(L, -2, "__index");
+        lua_pushcfunction(L, pool_gc);
+        lua_setfield(L, -2, "__gc");
+        lua_pushcfunction(L, pool_tostring);
+        lua_setfield(L, -2, "__tostring");
+        lua_pushcfunction(L, pool_submit);
+        lua_setfield(L, -2, "submit");
+        lua_pushcfunction(L, pool_size);
+        lua_setfield(L, -2, "size");
+        lua_pushcfunction(L, pool_stats);
+        lua_setfield(L, -2, "stats");
+        lua_pushcfunction(L, pool_close);
+        lua_setfield(L, -2, "close");
+    }
+    lua_pop(L, 1);
+
+    luaL_newmetatable(L, FUTURE_META);
+    {
+        lua_pushvalue(L, -1);
+        lua_setfield(L, -2, "__index");
+        lua_pushcfunction(L, future_gc);
+        lua_setfield(L, -2, "__gc");
+        lua_pushcfunction(L, future_tostring);
+        lua_setfield(L, -2, "__tostring");
+        lua_pushcfunction(L, future_join);
+        lua_setfield(L, -2, "join");
+        lua_pushcfunction(L, future_poll);
+        lua_setfield(L, -2, "poll");
+    }
+    lua_pop(L, 1);
+
+    lua_newtable(L);
+    lua_pushcfunction(L, lua_workers_spawn);
+    lua_setfield(L, -2, "spawn");
+    lua_pushcfunction(L, lua_workers_pool);
+    lua_setfield(L, -2, "pool");
+    lua_pushcfunction(L, lua_workers_buffer);
+    lua_setfield(L, -2, "buffer");
+    lua_pushcfunction(L, lua_workers_channel);
+    lua_setfield(L, -2, "channel");
+    lua_pushcfunction(L, lua_workers_select);
+    lua_setfield(L, -2, "select");
+    lua_pushcfunction(L, lua_workers_cpu_count);
+    lua_setfield(L, -2, "cpu_count");
+    lua_pushcfunction(L, lua_workers_share);
+    lua_setfield(L, -2, "share");
+    lua_pushcfunction(L, lua_workers_map);
+    lua_setfield(L, -2, "map");
+    lua_pushcfunction(L, lua_workers_reduce);
+    lua_setfield(L, -2, "reduce");
+    lua_setfield(L, -2, "workers");
+}
+
+void set_workers_init_context(const std::string &projectDir,
+                              const std::string &exePath,
+                              bool embedded)
+{
+    g_init_ctx.projectDir = projectDir;
+    g_init_ctx.exePath = exePath;
+    g_init_ctx.embedded = embedded;
+    g_init_ctx.initialized = true;
+}
+
+lua_State *workers_new_state()
+{
+    return new_worker_state();
+}
+
+bool workers_is_function_path(const char *s, size_t len)
+{
+    return is_function_path(s, len);
+}
+
+void workers_push_path_value(lua_State *L, const std::string &path)
+{
+    push_path_value(L, path);
 }
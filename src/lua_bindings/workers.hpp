@@ -8,9 +8,24 @@
  * @brief Chantier 8 — Workers (concurrence à mémoire isolée).
  *
  * Modèle famille B : chaque worker est une pthread avec son propre
- * lua_State neuf, communiquant avec le parent par sérialisation JSON
- * interne. Pas de mémoire partagée, pas de race condition possible
- * au niveau Lua.
+ * lua_State neuf, communiquant avec le parent par sérialisation
+ * binaire interne (tags + longueurs : int/float distincts, strings
+ * binaires acceptées). Aucun état Lua n'est partagé : tables,
+ * fonctions et userdata ordinaires sont copiés (ou refusés) au
+ * passage de frontière.
+ *
+ * Seuls trois objets C++ sont partagés par référence entre threads,
+ * chacun avec sa propre garantie :
+ *   - buffer : octets en refcount atomique ; modifiable par un seul
+ *     thread, gelé (lecture seule, définitivement) dès qu'il franchit
+ *     une frontière de thread, donc jamais d'écriture concurrente.
+ *   - share(tbl) : snapshot immuable dès sa création, lectures
+ *     concurrentes sans verrou.
+ *   - channel : file MPMC protégée par mutex ; send / recv / close
+ *     sont sûrs depuis n'importe quel nombre de threads, l'ordre FIFO
+ *     est global à la file.
+ * Hors de ces objets, la coordination entre workers (fichiers, base
+ * de données...) reste à la charge du script.
  *
  * API publique exposée sur babet.workers :
  *   - spawn(code [, args] [, opts])
@@ -35,13 +50,66 @@
  *         "done"    : terminé OK, value = résultat (peut être nil)
  *         "error"   : terminé en erreur, value = message
  *
+ *   - w:cancel() -> (true, nil)
+ *       Annule le worker : un hook "count" du lua_State enfant lève
+ *       une erreur au plus tard ~10 000 instructions plus tard ;
+ *       join() rend (false, "cancelled"). opts.deadline (secondes)
+ *       de spawn fait de même à échéance, avec (false, "deadline").
+ *       worker.cancelled() côté worker.
+ *
+ *   - pool(n [, init_code] [, opts])
+ *       Démarre n threads persistants, chacun avec un lua_State chaud
+ *       (init_code exécuté une fois par thread, typiquement des
+ *       require()). Retourne le userdata pool, ou (nil, err) si un
+ *       thread ne démarre pas ou si init_code échoue.
+ *       pool:submit(code_or_fn_name [, arg]) -> future | (nil, err)
+ *       pool:size(), pool:close()
+ *       pool:stats() -> compteurs par thread (tâches, vols, temps
+ *       d'inactivité) de l'ordonnanceur à vol de tâches.
+ *       future:join([timeout]) / future:poll() : mêmes conventions
+ *       que w:join() / w:poll().
+ *
+ *   - map(items, code [, opts]) / reduce(items, code [, opts])
+ *       Découpe items en morceaux exécutés comme tâches de pool (pool
+ *       temporaire de opts.concurrency threads, ou opts.pool), au plus
+ *       2 morceaux par thread en vol. map rend les résultats dans
+ *       l'ordre (ou les livre au fil de l'eau via opts.on_result) ;
+ *       reduce replie avec une fonction associative (opts.init).
+ *
+ *   - buffer(size_or_string)
+ *       Bloc d'octets partagé (refcount C++) transmis aux workers par
+ *       référence, sans copie. Méthodes size/tostring/slice/write/
+ *       freeze/frozen ; gelé automatiquement au premier passage de
+ *       frontière de thread.
+ *
+ *   - w:send_many(list [, timeout]) / w:recv_many([max [, timeout]])
+ *     et worker.send_many / worker.recv_many
+ *       Envois / réceptions par lots sur les liens parent <-> worker,
+ *       qui sont des anneaux SPSC sans verrou (futex seulement quand
+ *       l'anneau est vide ou plein).
+ *
+ *   - share(tbl)
+ *       Fige une table (index hash + arène de strings) en snapshot
+ *       immuable partagé par référence ; proxy en lecture seule
+ *       (t[k] O(1), #, pairs, ipairs).
+ *
+ *   - cpu_count()
+ *       CPU utilisables : masque d'affinité borné par le quota cgroup
+ *       v2 (cpu.max). opts cpu= / nice= / stack_size= de spawn, pool,
+ *       map et reduce appliquées via les attributs pthread (niceness
+ *       par la thread elle-même).
+ *
+ *   - channel([capacity]) / select(channels [, timeout])
+ *       File MPMC bornée partagée par référence entre threads
+ *       (send/recv/try_recv/close, mêmes reasons que w:send/w:recv),
+ *       et attente sur plusieurs channels.
+ *
  * Lifecycle : auto-cleanup du lua_State et de la thread quand join()
  * ou poll()=="done"/"error" est appelé, ou via __gc en filet de
  * sécurité si l'utilisateur oublie.
  *
  * Hors v1 (envisageable en SemVer additif) : spawn(function) via
- * string.dump, w:kill() pour interrompre, pool de workers persistants,
- * channels Go-like, format de sérialisation binaire plus rapide.
+ * string.dump, w:kill() pour interrompre.
  */
 void register_workers(lua_State *L);
 
@@ -69,4 +137,28 @@ void set_workers_init_context(const std::string &projectDir,
                               const std::string &exePath,
                               bool embedded);
 
+/**
+ * @brief Crée un lua_State neuf configuré comme celui d'un worker
+ * (stdlib, modules bundlés, babet.*, require() des modules
+ * utilisateur selon set_workers_init_context). nullptr si
+ * l'allocation échoue.
+ *
+ * Pour les modules qui gèrent leurs propres threads à état Lua
+ * (handlers de babet.http.server) : l'appelant est propriétaire de
+ * l'état et doit le fermer avec lua_close depuis le même thread.
+ */
+lua_State *workers_new_state();
+
+/**
+ * @brief Indique si `s` est un chemin de fonction ("fn", "mod.fn")
+ * plutôt qu'un chunk de code, selon la même règle que pool:submit.
+ */
+bool workers_is_function_path(const char *s, size_t len);
+
+/**
+ * @brief Pousse la valeur désignée par `path` ("mod.fn") en partant
+ * de _G, ou nil si un maillon manque. Accès raw, sans métaméthode.
+ */
+void workers_push_path_value(lua_State *L, const std::string &path);
+
 #endif // WORKERS_HPP
\ No newline at end of file